@@ -8,12 +8,63 @@ struct ysLock;
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ysSceneId ysScene_Create(const ysSceneDef&);
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Async API:
+// Returns right away, and creates the scene on its job system. Creation first readies a preview: everything is in place, but the hierarchy
+// over the shapes is a coarse one, built in a fraction of the time. Once 'PreviewReady' returns true, renders may be created and the
+// materials updated, and the definition (along with the arrays it points to) is no longer needed. The full hierarchy is built next, and
+// swapped in by 'CreationFinished' once it is done and no render is left on the coarse one. (Renders started in the meantime stay on the
+// coarse one, so destroy them to move on.) Shape updates and saving wait for 'CreationFinished' to return true. 'GetCreationProgress'
+// returns a rough estimate in [0, 1]. The scene may be destroyed at any point, though that waits for the creation job to finish. With
+// ysSceneDef::m_lazyHierarchy set, the preview gets the lazy hierarchy rather than a coarse one, and creation finishes along with it.
+// The polling calls never run creation themselves: It runs on a background thread of the scene's job system, which always has one, even
+// on machines with a single hardware thread.
+ysSceneId ysScene_CreateAsync(const ysSceneDef&);
+ys_float32 ysScene_GetCreationProgress(ysSceneId);
+bool ysScene_PreviewReady(ysSceneId);
+bool ysScene_CreationFinished(ysSceneId);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // User is responsible for disposing of their copy of the scene ID.
 // A freed scene ID may be repurposed by future scene creations, so the freed ID may not only become invalid, but worse, misdirected.
 void ysScene_Destroy(ysSceneId);
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Binary scene files: ysScene_Save writes out the scene's shapes, materials, lights and hierarchy as they are laid out in memory, and
+// ysScene_CreateFromFile maps such a file and points the new scene straight into it, with no parsing and no rebuilding of the hierarchy.
+// The format is tied to the layout of the build that wrote it, so files are meant as caches, to be rewritten whenever they fail to load.
+// Any later updates to a scene created from a file stay in memory; the file itself is never written to.
+// Saving a scene whose hierarchy is lazy (see ysSceneDef::m_lazyHierarchy) builds the rest of it first, so it must have no renders.
+bool ysScene_Save(ysSceneId, const char* path); // Returns false if the file could not be written
+ysSceneId ysScene_CreateFromFile(const char* path); // Returns ys_nullSceneId if the file is missing, or was written by an incompatible build
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reads the triangles of a Wavefront OBJ or binary PLY file (chosen by the extension) into the mesh, in parallel chunks. Only the geometry
+// is read: the positions, and the normals if every face corner has one. Faces of more than three vertices are split into fans. The rest of
+// the mesh (its materials, whether it is two-sided) is left alone. The buffers are allocated for the purpose and tightly packed, with the
+// normals unit length, so they may be handed to the scene in place (see ysMeshDef::m_referenceBuffers). Returns false, leaving the mesh
+// untouched, if the file could not be read. Otherwise the buffers must be released with ysMesh_FreeImported once done with.
+bool ysMesh_Import(ysMeshDef*, const char* path);
+void ysMesh_FreeImported(ysMeshDef*);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Moves or deforms shapes in place, which is much cheaper than recreating the scene: the hierarchies are refit rather than rebuilt, save
+// for whatever parts of them degrade too far. (See ysSceneShapesUpdate::m_bvhRebuildThreshold) Must not be called while the scene has any
+// renders. Clears the scene's radiance cache.
+void ysScene_UpdateShapes(ysSceneId, const ysSceneShapesUpdate&);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Changes material parameters and emitter strengths in place. Unlike the shape updates, this may be called while renders are in progress:
+// they pick up the new values as they go, without ever seeing a half-written material. Clears the scene's radiance cache, which goes unused
+// until the renders in progress (if any) are destroyed.
+void ysScene_UpdateMaterials(ysSceneId, const ysSceneMaterialsUpdate&);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // This API is not recommended unless rendering some very basic debug info such as depth/normals, or if you know beforehand that you wish to
@@ -35,6 +86,8 @@ ysVec4 ysScene_DebugRenderPixel(ysSceneId, const ysSceneRenderInput&, const ys_f
 ysRenderId ysScene_CreateRender(ysSceneId, const ysSceneRenderInput&);
 void ysRender_BeginWork(ysRenderId);
 void ysRender_GetIntermediateOutput(ysRenderId, ysSceneRenderOutputIntermediate*);
+// Cheaper alternative to 'GetIntermediateOutput' for frequent polling: Only the tiles that changed since the last call are returned.
+void ysRender_GetIntermediateOutputIncremental(ysRenderId, ysSceneRenderOutputIncremental*);
 bool ysRender_WorkFinished(ysRenderId);
 void ysRender_GetFinalOutput(ysRenderId, ysSceneRenderOutput*);
 void ysScene_DestroyRender(ysRenderId);
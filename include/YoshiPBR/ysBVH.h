@@ -4,6 +4,8 @@
 #include "YoshiPBR/ysStructures.h"
 
 struct ysDrawInputBVH;
+struct ysMesh;
+struct ysRayCastInput;
 struct ysRayCastOutput;
 struct ysSceneRayCastInput;
 struct ysSceneRayCastOutput;
@@ -43,9 +45,27 @@ struct ysBVH
 
     void Reset();
     void Create(const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount);
+    // Builds from the Morton order of the leaves alone, in a fraction of the time Create takes, but the tree is slower to cast rays
+    // against. Meant as a stand-in while the full tree is built.
+    void CreateCoarse(const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount);
+    // Builds only the top levels of the tree, splitting the leaves in Morton order down to groups of about a thousand. The subtree over
+    // each group is built the way Create would, the first time a ray reaches it, by whichever thread gets there first. So the time goes
+    // into the parts of the scene that rays actually reach, and none of it into the rest.
+    void CreateLazy(const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount);
+    // Builds whatever subtrees of a lazy hierarchy are left and merges them in, leaving a regular one. Does nothing to regular ones. Must
+    // not be called while rays are being cast against the hierarchy.
+    void Finalize();
     void Destroy();
 
+    // Brings the bounds up to date after the leaves have moved, keeping the topology. leafAABBs is indexed by the leaf shape ids. Any
+    // subtree whose box has grown to more than rebuildThreshold times its surface area when it was built is rebuilt from its leaves, in
+    // place. Returns the number of subtrees rebuilt. Lazy hierarchies are finalized first.
+    ys_int32 Refit(const ysAABB* leafAABBs, ys_float32 rebuildThreshold);
+
     bool RayCastClosest(const ysScene* scene, ysSceneRayCastOutput*, const ysSceneRayCastInput&) const;
+    // For hierarchies over the triangles of a single mesh, whose leaves hold triangle indices rather than shape ids. The index of the
+    // triangle hit is written to the primitive index of the output.
+    bool RayCastClosest(const ysMesh* mesh, ysRayCastOutput*, const ysRayCastInput&) const;
     void RayCast(const ysScene* scene, const ysSceneRayCastInput&, void* flowControlUserData, ysRayCastFlowControlFunction flowControlFcn) const;
 
     void DebugDraw(const ysDrawInputBVH&) const;
@@ -53,5 +73,18 @@ struct ysBVH
     Node* m_nodes; // Sorted so that parents preceed children
     ys_int32 m_nodeCount;
 
-    ys_int32 m_depth;
+    // Half the surface area of each node's box as of when its subtree was last built. Parallel to m_nodes.
+    ys_float32* m_builtAreas;
+
+    ys_int32 m_depth; // Of the top levels alone, for lazy hierarchies
+
+    // Lazy hierarchies have nodes that stand in for whole subtrees yet to be built. These have neither children nor a shape, and their
+    // m_right holds the index of the subtree instead.
+    struct LazySubtree;
+    LazySubtree* m_lazySubtrees;
+    ys_int32 m_lazySubtreeCount;
+
+    // The leaves of the lazy subtrees, sorted so that those of each subtree are contiguous
+    ysAABB* m_lazyLeafAABBs;
+    ysShapeId* m_lazyLeafShapeIds;
 };
\ No newline at end of file
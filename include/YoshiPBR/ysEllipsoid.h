@@ -11,6 +11,7 @@ struct ysSurfacePoint;
 struct ysEllipsoid
 {
     ysAABB ComputeAABB() const;
+    ys_float32 ComputeSurfaceArea() const;
     bool RayCast(ysRayCastOutput*, const ysRayCastInput&) const;
     void GenerateRandomSurfacePoint(ysSurfacePoint* point, ys_float32* probabilityDensity) const;
     ys_float32 ProbabilityDensityForGeneratedPoint(const ysVec4& point) const;
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "YoshiPBR/ysAABB.h"
+
+struct ysRayCastInput;
+struct ysRayCastOutput;
+struct ysSurfacePoint;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// An indexed triangle list whose triangles share their vertices. Each triangle is a shape of its own (see ysShape::Type::e_meshTriangle),
+// so the queries below take the index of the triangle within the mesh.
+struct ysMesh
+{
+    ysAABB ComputeAABB(ys_int32 triangleIdx) const;
+    ys_float32 ComputeSurfaceArea(ys_int32 triangleIdx) const; // Counts both faces if two-sided
+    ysVec4 ComputeFaceNormal(ys_int32 triangleIdx) const;
+    bool RayCast(ys_int32 triangleIdx, ysRayCastOutput*, const ysRayCastInput&) const;
+    void GenerateRandomSurfacePoint(ys_int32 triangleIdx, ysSurfacePoint* point, ys_float32* probabilityDensity) const;
+    ys_float32 ProbabilityDensityForGeneratedPoint(ys_int32 triangleIdx, const ysVec4& point) const;
+
+    ysVec4 GetPosition(ys_int32 vertexIdx) const;
+    ysVec4 GetNormal(ys_int32 vertexIdx) const;
+    void GetVertices(ys_int32 triangleIdx, ysVec4* v) const;
+
+    // Owned by the mesh if m_ownsBuffers is set. Otherwise these point into the caller's buffers. (See ysMeshDef::m_referenceBuffers)
+    const ys_uint8* m_positions;
+    const ys_uint8* m_normals; // Unit length, one per vertex. Null if the triangles are shaded with their face normals.
+    const ys_int32* m_indices; // Three per triangle
+    ys_int32 m_positionStride; // In bytes
+    ys_int32 m_normalStride; // In bytes
+    ys_int32 m_vertexCount;
+    ys_int32 m_triangleCount;
+    bool m_ownsBuffers;
+    bool m_twoSided;
+};
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "YoshiPBR/ysBVH.h"
+#include "YoshiPBR/ysMesh.h"
+
+struct ysRayCastInput;
+struct ysRayCastOutput;
+struct ysScene;
+struct ysSurfacePoint;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A mesh that is placed in the scene through instances only. Its triangles get a (bottom-level) hierarchy of their own, in the space of the
+// mesh, which every instance shares.
+struct ysInstancedMesh
+{
+    ysMesh m_mesh;
+    ysBVH m_bvh; // The leaves hold the indices of the triangles in place of shape ids
+    ys_float32* m_areaCDF; // Running sum of the triangle areas, for picking triangles in proportion to their area
+    ys_float32 m_surfaceArea; // Counts both faces if two-sided
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A rigidly transformed copy of an instanced mesh. The whole instance is a single shape, whose triangles are told apart by the primitive
+// index of ray cast outputs and surface points. Rays are brought into the space of the mesh to traverse its hierarchy, and as the transform
+// is rigid, distances along them are the same in both spaces.
+struct ysMeshInstance
+{
+    ysAABB ComputeAABB(const ysScene*) const;
+    ys_float32 ComputeSurfaceArea(const ysScene*) const; // Counts both faces if two-sided
+    bool RayCast(const ysScene*, ysRayCastOutput*, const ysRayCastInput&) const;
+    void GenerateRandomSurfacePoint(const ysScene*, ysSurfacePoint* point, ys_float32* probabilityDensity) const;
+    ys_float32 ProbabilityDensityForGeneratedPoint(const ysScene*, const ysVec4& point) const;
+
+    // Brings a ray from world space into the space of the mesh, and hits found there back into world space
+    ysRayCastInput ToMeshSpace(const ysRayCastInput&) const;
+    void ToWorldSpace(ysRayCastOutput*) const;
+
+    ys_int32 m_meshIndex; // Into ysScene::m_instancedMeshes
+    ysTransform m_xf;
+};
\ No newline at end of file
@@ -36,4 +36,5 @@ struct ysRayCastOutput
     ysVec4 m_hitNormal;
     ysVec4 m_hitTangent;
     ys_float32 m_lambda; // hitpoint = origin + lambda * direction
+    ys_int32 m_primitiveIndex; // (See ysSceneRayCastOutput::m_primitiveIndex)
 };
\ No newline at end of file
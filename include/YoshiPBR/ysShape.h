@@ -14,6 +14,7 @@ struct ysSurfacePoint
     ysVec4 m_point;
     ysVec4 m_normal;
     ysVec4 m_tangent;
+    ys_int32 m_primitiveIndex; // (See ysSceneRayCastOutput::m_primitiveIndex)
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -24,15 +25,19 @@ struct ysShape
     {
         e_ellipsoid,
         e_triangle,
+        e_meshTriangle,
+        e_meshInstance,
     };
 
     ysAABB ComputeAABB(const ysScene* scene) const;
+    ys_float32 ComputeSurfaceArea(const ysScene* scene) const;
     bool RayCast(const ysScene* scene, ysRayCastOutput*, const ysRayCastInput&) const;
     void GenerateRandomSurfacePoint(const ysScene*, ysSurfacePoint* point, ys_float32* probabilityDensity) const;
     ys_float32 ProbabilityDensityForGeneratedPoint(const ysScene*, const ysVec4& point) const;
 
     Type m_type;
-    ys_int32 m_typeIndex;
+    ys_int32 m_typeIndex; // For e_meshTriangle, the index of the mesh
+    ys_int32 m_primitiveIndex; // For e_meshTriangle, the index of the triangle within the mesh. Otherwise ys_nullIndex.
 
     ysMaterialId m_materialId;
     ysEmissiveMaterialId m_emissiveMaterialId;
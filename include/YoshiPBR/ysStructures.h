@@ -105,6 +105,58 @@ struct ysInputTriangle : public ysShapeDef
     bool m_twoSided;
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysMeshDef : public ysShapeDef
+{
+    ysMeshDef()
+    {
+        m_positions = nullptr;
+        m_positionStride = 0;
+        m_normals = nullptr;
+        m_normalStride = 0;
+        m_vertexCount = 0;
+        m_indices = nullptr;
+        m_triangleCount = 0;
+        m_referenceBuffers = false;
+        m_twoSided = false;
+    }
+
+    // An indexed triangle list. Its triangles share the vertices, and the materials above.
+    const ysFloat3* m_positions;
+    ys_int32 m_positionStride; // Bytes from one position to the next. 0 if tightly packed.
+    const ysFloat3* m_normals; // Optional. One per vertex, interpolated over each triangle for shading.
+    ys_int32 m_normalStride; // Bytes from one normal to the next. 0 if tightly packed.
+    ys_int32 m_vertexCount;
+
+    // Three per triangle, tightly packed. Looking at the front face, the vertices go counterclockwise (as with
+    // ysInputTriangle::m_vertices).
+    const ys_int32* m_indices;
+    ys_int32 m_triangleCount;
+
+    // By default, the buffers above are copied into the scene. If this is set, the scene reads them in place instead (zero-copy), in
+    // which case they must be 4-byte aligned, the normals must already be unit length, and the buffers must stay alive until the scene
+    // is destroyed. They must not change in the meantime, other than ahead of a ysScene_UpdateShapes that names the mesh.
+    bool m_referenceBuffers;
+
+    bool m_twoSided;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysMeshInstanceDef
+{
+    ysMeshInstanceDef()
+    {
+        m_meshIndex = ys_nullIndex;
+        m_transform = ysTransform_identity;
+    }
+
+    // Places a copy of ysSceneDef::m_instancedMeshes[m_meshIndex], along with its materials, in the scene
+    ys_int32 m_meshIndex;
+    ysTransform m_transform; // From the mesh's space to world space
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct ysMaterialStandardDef
@@ -146,6 +198,15 @@ struct ysSceneDef
         m_triangles = nullptr;
         m_triangleCount = 0;
 
+        m_meshes = nullptr;
+        m_meshCount = 0;
+
+        m_instancedMeshes = nullptr;
+        m_instancedMeshCount = 0;
+
+        m_meshInstances = nullptr;
+        m_meshInstanceCount = 0;
+
         m_materialStandards = nullptr;
         m_materialStandardCount = 0;
 
@@ -157,6 +218,8 @@ struct ysSceneDef
 
         m_lightPoints = nullptr;
         m_lightPointCount = 0;
+
+        m_lazyHierarchy = false;
     }
 
     ////////////
@@ -169,6 +232,17 @@ struct ysSceneDef
     const ysInputTriangle* m_triangles;
     ys_int32 m_triangleCount;
 
+    const ysMeshDef* m_meshes;
+    ys_int32 m_meshCount;
+
+    // Meshes that are not placed in the scene themselves, only through instances. Each gets a hierarchy over its triangles that all of its
+    // instances share, so any number of instances costs little more memory than one.
+    const ysMeshDef* m_instancedMeshes;
+    ys_int32 m_instancedMeshCount;
+
+    const ysMeshInstanceDef* m_meshInstances;
+    ys_int32 m_meshInstanceCount;
+
     //////////////////////////
     // Reflective Materials //
     //////////////////////////
@@ -192,6 +266,150 @@ struct ysSceneDef
 
     const ysLightPointDef* m_lightPoints;
     ys_int32 m_lightPointCount;
+
+    ///////////////
+    // Hierarchy //
+    ///////////////
+
+    // Builds only the top levels of the hierarchy over the shapes up front, and the rest of it piece by piece as renders first reach each
+    // part, so that the time to the first pixel goes by how much of the scene is in view rather than by its size. Saving the scene or
+    // updating its shapes builds whatever is left.
+    bool m_lazyHierarchy;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The updates below refer to shapes by their index within the arrays of the ysSceneDef that the scene was created from. Only the geometry
+// changes; the materials stay as they were.
+struct ysEllipsoidUpdate
+{
+    ys_int32 m_ellipsoidIndex;
+    ysTransform m_transform;
+    ysVec4 m_radii;
+};
+
+struct ysTriangleUpdate
+{
+    ys_int32 m_triangleIndex;
+    ysVec4 m_vertices[3];
+};
+
+struct ysMeshUpdate
+{
+    ysMeshUpdate()
+    {
+        m_meshIndex = ys_nullIndex;
+        m_instanced = false;
+        m_positions = nullptr;
+        m_positionStride = 0;
+        m_normals = nullptr;
+        m_normalStride = 0;
+    }
+
+    // Into ysSceneDef::m_instancedMeshes if m_instanced is set, and ysSceneDef::m_meshes otherwise. Moving an instanced mesh's vertices
+    // moves every one of its instances.
+    ys_int32 m_meshIndex;
+    bool m_instanced;
+
+    // New vertices, laid out as in ysMeshDef. The triangles stay the same. Normals are optional; if none are given, the mesh keeps its own.
+    // Meshes created with ysMeshDef::m_referenceBuffers read their buffers in place, so leave these null and write the new vertices into
+    // those buffers before updating instead.
+    const ysFloat3* m_positions;
+    ys_int32 m_positionStride;
+    const ysFloat3* m_normals;
+    ys_int32 m_normalStride;
+};
+
+struct ysMeshInstanceUpdate
+{
+    ys_int32 m_meshInstanceIndex;
+    ysTransform m_transform;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysSceneShapesUpdate
+{
+    ysSceneShapesUpdate()
+    {
+        m_ellipsoids = nullptr;
+        m_ellipsoidCount = 0;
+
+        m_triangles = nullptr;
+        m_triangleCount = 0;
+
+        m_meshes = nullptr;
+        m_meshCount = 0;
+
+        m_meshInstances = nullptr;
+        m_meshInstanceCount = 0;
+
+        m_bvhRebuildThreshold = 2.0f;
+    }
+
+    const ysEllipsoidUpdate* m_ellipsoids;
+    ys_int32 m_ellipsoidCount;
+
+    const ysTriangleUpdate* m_triangles;
+    ys_int32 m_triangleCount;
+
+    const ysMeshUpdate* m_meshes;
+    ys_int32 m_meshCount;
+
+    const ysMeshInstanceUpdate* m_meshInstances;
+    ys_int32 m_meshInstanceCount;
+
+    // The hierarchies over the shapes are refit to their new bounds rather than rebuilt, which gets slower to trace the further the shapes
+    // stray from where they were. Any part of a hierarchy whose bounds grow past this many times their surface area when built is rebuilt.
+    // Must be at least 1. Larger values make updates cheaper at the expense of tracing.
+    ys_float32 m_bvhRebuildThreshold;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// As with the shape updates, these refer to materials and lights by their index within the arrays of the scene's ysSceneDef
+struct ysMaterialStandardUpdate
+{
+    ys_int32 m_materialStandardIndex;
+    ysMaterialStandardDef m_material;
+};
+
+struct ysEmissiveMaterialUniformUpdate
+{
+    ys_int32 m_emissiveMaterialUniformIndex;
+    ysEmissiveMaterialUniformDef m_emissiveMaterial;
+};
+
+struct ysLightPointUpdate
+{
+    ys_int32 m_lightPointIndex;
+    ysVec4 m_wattage; // The light stays where it is
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysSceneMaterialsUpdate
+{
+    ysSceneMaterialsUpdate()
+    {
+        m_materialStandards = nullptr;
+        m_materialStandardCount = 0;
+
+        m_emissiveMaterialUniforms = nullptr;
+        m_emissiveMaterialUniformCount = 0;
+
+        m_lightPoints = nullptr;
+        m_lightPointCount = 0;
+    }
+
+    const ysMaterialStandardUpdate* m_materialStandards;
+    ys_int32 m_materialStandardCount;
+
+    const ysEmissiveMaterialUniformUpdate* m_emissiveMaterialUniforms;
+    ys_int32 m_emissiveMaterialUniformCount;
+
+    const ysLightPointUpdate* m_lightPoints;
+    ys_int32 m_lightPointCount;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -219,6 +437,9 @@ struct ysSceneRayCastOutput
     ysVec4 m_hitTangent;
     ys_float32 m_lambda;
     ysShapeId m_shapeId;
+
+    // If the shape is a mesh instance, the triangle that was hit within the instanced mesh. Otherwise ys_nullIndex.
+    ys_int32 m_primitiveIndex;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -249,6 +470,11 @@ struct ysGlobalIlluminationInput_UniDirectional : public ysGlobalIlluminationInp
         m_type = Type::e_uniDirectional;
         m_sampleLight = true;
         m_maxBounceCount = 1;
+        m_lightSampleCount = 0;
+        m_russianRouletteMinBounceCount = 3;
+        m_pathGuiding = false;
+        m_pathGuidingBrdfFraction = 0.5f;
+        m_radianceCacheBounceCount = 0;
     }
 
     // We always generate directions based on the BRDF. However, sometimes generating directions by sampling points on area lights may give
@@ -258,6 +484,28 @@ struct ysGlobalIlluminationInput_UniDirectional : public ysGlobalIlluminationInp
 
     // 1 is direct illumination only.
     ys_int32 m_maxBounceCount;
+
+    // The number of lights to connect to at each bounce. The lights are chosen randomly with probability roughly proportional to their
+    // contribution, so this is much cheaper than connecting to every light in scenes with many lights. If zero, every light with
+    // infinitesimal area (e.g. point lights) is connected to, and a single area light is chosen.
+    ys_int32 m_lightSampleCount;
+
+    // Paths longer than this many bounces are terminated randomly (Russian roulette) with probability based on their throughput, so that
+    // large values of m_maxBounceCount only cost extra where the path still carries significant energy.
+    ys_int32 m_russianRouletteMinBounceCount;
+
+    // Learn where the radiance arriving at each region of the scene comes from as the render progresses, and sample bounce directions from
+    // that as well as from the BRDF. This pays off wherever most light arrives indirectly through a small opening. Directions are drawn
+    // from the BRDF with probability m_pathGuidingBrdfFraction and from the learned distribution otherwise, and the two are combined via
+    // MIS. Each pass takes one sample per pixel, and the guide is retrained between passes. Ignored when comparing GI methods.
+    bool m_pathGuiding;
+    ys_float32 m_pathGuidingBrdfFraction;
+
+    // Meant for quick previews. If positive, paths reaching a diffuse surface after this many bounces stop there and take the rest of the
+    // radiance from the scene's radiance cache instead, provided it has learned enough about that surface. Paths feed the cache as they go,
+    // and the cache persists across renders, so previews get cheaper and steadier the more the scene is rendered. The result is biased
+    // towards whatever the cache has seen so far. Zero disables both reading and filling the cache, which the scene then never allocates.
+    ys_int32 m_radianceCacheBounceCount;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -269,12 +517,55 @@ struct ysGlobalIlluminationInput_BiDirectional : public ysGlobalIlluminationInpu
         m_type = Type::e_biDirectional;
         m_maxLightSubpathVertexCount = 1;
         m_maxEyeSubpathVertexCount = 2;
+        m_lightTracing = true;
+        m_lightSubpathPoolSize = 0;
+        m_lightSubpathConnectionCount = 1;
+        m_vertexMerging = false;
+        m_mergeRadius = 0.005f;
+        m_mergeRadiusAlpha = 0.75f;
     }
 
     ys_int32 m_maxLightSubpathVertexCount;
     ys_int32 m_maxEyeSubpathVertexCount;
+
+    // Also connect every light subpath vertex directly to the eye and splat the result onto whichever pixel it lands on. This is by far the
+    // cheapest way to capture caustics (e.g. light focused by a mirror onto a diffuse surface). Ignored when comparing GI methods.
+    bool m_lightTracing;
+
+    // If positive, light subpaths are no longer traced one-for-one with eye subpaths. Instead, each batch of pixels first traces this many
+    // light subpaths in parallel, and every eye subpath is joined to m_lightSubpathConnectionCount of them drawn at random. This amortizes
+    // the cost of light subpaths across pixels. Ignored when comparing GI methods.
+    ys_int32 m_lightSubpathPoolSize;
+    ys_int32 m_lightSubpathConnectionCount;
+
+    // Also merge each eye subpath vertex with the nearby vertices of every light subpath in the pool (vertex connection and merging). This
+    // captures paths that no join can, such as caustics seen directly (light -> mirror -> diffuse -> eye). Requires a light subpath pool.
+    // The merge radius is a fraction of the scene's bounding box diagonal, and is scaled by (passIdx + 1)^((alpha - 1) / 2) with each
+    // pass so that the result converges. Each pass takes one sample per pixel.
+    bool m_vertexMerging;
+    ys_float32 m_mergeRadius;
+    ys_float32 m_mergeRadiusAlpha;
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A finished tile of the image, as handed to ysSceneRenderInput::m_tileFcn
+struct ysRenderTile
+{
+    // Pixel (0,0) is the top left corner of the image
+    ys_int32 m_x;
+    ys_int32 m_y;
+    ys_int32 m_width;
+    ys_int32 m_height;
+
+    // Stored row after row, as in ysSceneRenderOutputIntermediate. Only valid for the duration of the callback.
+    const ysFloat4* m_pixels;
+
+    ys_int32 m_samplesPerPixel;
+};
+
+typedef void ysRenderTileFcn(const ysRenderTile&, void* arg);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct ysSceneRenderInput
@@ -287,6 +578,37 @@ struct ysSceneRenderInput
         e_depth,
     };
 
+    enum Denoiser
+    {
+        e_none,
+        e_aTrous,
+    };
+
+    enum Tonemap
+    {
+        e_linear,
+        e_reinhard, // x / (1 + x)
+        e_aces,     // Fit of the ACES filmic curve
+    };
+
+    // Flags for m_outputFormatFlags
+    enum OutputFormat
+    {
+        e_outputHalf = 1 << 0,
+        e_outputSRGB8 = 1 << 1,
+    };
+
+    // Flags for m_aovFlags
+    enum AOV
+    {
+        e_aovNormal = 1 << 0,
+        e_aovDepth = 1 << 1,
+        e_aovAlbedo = 1 << 2,
+        e_aovShapeId = 1 << 3,
+        e_aovMaterialId = 1 << 4,
+        e_aovSampleCount = 1 << 5,
+    };
+
     ysSceneRenderInput()
     {
         m_eye = ysTransform_identity;
@@ -298,6 +620,18 @@ struct ysSceneRenderInput
 
         m_renderMode = RenderMode::e_regular;
 
+        m_denoiser = Denoiser::e_none;
+        m_denoiseIterationCount = 5;
+
+        m_aovFlags = 0;
+
+        m_tonemap = Tonemap::e_linear;
+        m_exposure = 1.0f;
+        m_outputFormatFlags = 0;
+
+        m_tileFcn = nullptr;
+        m_tileFcnArg = nullptr;
+
         m_giInput = nullptr;
         m_giInputCompare = nullptr;
     }
@@ -319,6 +653,32 @@ struct ysSceneRenderInput
 
     RenderMode m_renderMode;
 
+    // Regular mode only. Denoising is applied to the final output, guided by the albedo, normal and depth of the surfaces seen through each
+    // pixel, which are gathered alongside the radiance. The a-trous filter ("Edge-Avoiding A-Trous Wavelet Transform for fast Global
+    // Illumination Filtering" by Dammertz et al. 2010) doubles the reach of its 5x5 kernel with every iteration, so that n iterations blur
+    // over as many as 2^(n+1) - 2 pixels in each direction.
+    Denoiser m_denoiser;
+    ys_int32 m_denoiseIterationCount;
+
+    // Regular mode only. Any combination of the AOV flags, requesting arbitrary output variables (AOVs) of the surface first seen through
+    // each pixel. These come from the same primary rays as the radiance, at no extra ray casting cost, and are returned in their own buffers
+    // of ysSceneRenderOutput.
+    ys_uint32 m_aovFlags;
+
+    // Regular mode only. Applied to the final output, after denoising.
+    Tonemap m_tonemap;
+    ys_float32 m_exposure;
+
+    // The final output always comes as floats. Any combination of the OutputFormat flags requests it in other formats too.
+    ys_uint32 m_outputFormatFlags;
+
+    // Optional. Invoked once with every tile of the image, holding its final pixels, from whichever worker thread finished it, so it must
+    // be thread-safe. Tiles are handed over as soon as their last pixel is done, except with light tracing, which may splat onto any pixel
+    // until the very end: Those renders hand over all their tiles at once, when done. Not invoked for tiles left unfinished by a terminated
+    // render, nor at all by a terminated render with light tracing.
+    ysRenderTileFcn* m_tileFcn;
+    void* m_tileFcnArg;
+
     const ysGlobalIlluminationInput* m_giInput;
     const ysGlobalIlluminationInput* m_giInputCompare;
 };
@@ -330,9 +690,31 @@ struct ysSceneRenderOutput
     ysSceneRenderOutput()
     {
         m_pixels.Create();
+        m_pixelsHalf.Create();
+        m_pixelsSRGB8.Create();
+        m_normals.Create();
+        m_depths.Create();
+        m_albedos.Create();
+        m_shapeIds.Create();
+        m_materialIds.Create();
+        m_sampleCounts.Create();
     }
 
     ysArrayG<ysFloat3> m_pixels;
+
+    // The same pixels in the formats requested by ysSceneRenderInput::m_outputFormatFlags, three channels per pixel. Left empty otherwise.
+    ysArrayG<ys_uint16> m_pixelsHalf;
+    ysArrayG<ys_uint8> m_pixelsSRGB8;
+
+    // The AOVs requested by ysSceneRenderInput::m_aovFlags, laid out like the pixels. Those not requested are left empty.
+    // Normals, depths and albedos are averaged over each pixel's samples, where samples that miss the scene count as zero. Ids are those of
+    // the shape and reflective material hit by the pixel's first sample, or ys_nullIndex if it missed.
+    ysArrayG<ysFloat3> m_normals;
+    ysArrayG<ys_float32> m_depths;
+    ysArrayG<ysFloat3> m_albedos;
+    ysArrayG<ys_int32> m_shapeIds;
+    ysArrayG<ys_int32> m_materialIds;
+    ysArrayG<ys_int32> m_sampleCounts;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -347,6 +729,41 @@ struct ysSceneRenderOutputIntermediate
     ysArrayG<ysFloat4> m_pixels;
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Intermediate output restricted to the tiles of the image that changed since the previous call made with the same object. Pixels are as in
+// ysSceneRenderOutputIntermediate, and those never returned so far are to be taken as empty (zero alpha).
+struct ysSceneRenderOutputIncremental
+{
+    struct Tile
+    {
+        // Pixel (0,0) is the top left corner of the image
+        ys_int32 m_x;
+        ys_int32 m_y;
+        ys_int32 m_width;
+        ys_int32 m_height;
+
+        // Index of the tile's first pixel in m_pixels. Its pixels are stored row after row.
+        ys_int32 m_pixelOffset;
+    };
+
+    ysSceneRenderOutputIncremental()
+    {
+        m_tiles.Create();
+        m_pixels.Create();
+        m_tileVersions.Create();
+        m_splatVersion = 0;
+    }
+
+    ysArrayG<Tile> m_tiles;
+    ysArrayG<ysFloat4> m_pixels;
+
+    // The version token: what the caller has been handed so far, which is up to the render to maintain. Clear m_tileVersions to start over,
+    // e.g. when moving on to a new render.
+    ysArrayG<ys_uint64> m_tileVersions;
+    ys_int64 m_splatVersion;
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct ysDrawInputBVH
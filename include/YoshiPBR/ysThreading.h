@@ -21,6 +21,11 @@ struct ysLock
     std::atomic<bool> m_acquired;
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// std::atomic<float> only has fetch_add as of C++20, so this loops on compare-and-swap instead. Relaxed: callers only need the sum.
+void ysAtomicAdd(std::atomic<ys_float32>* dst, ys_float32 value);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct ysScopedLock
@@ -11,6 +11,7 @@ struct ysSurfacePoint;
 struct ysTriangle
 {
     ysAABB ComputeAABB() const;
+    ys_float32 ComputeSurfaceArea() const; // Counts both faces if two-sided
     bool RayCast(ysRayCastOutput*, const ysRayCastInput&) const;
     void GenerateRandomSurfacePoint(ysSurfacePoint* point, ys_float32* probabilityDensity) const;
     ys_float32 ProbabilityDensityForGeneratedPoint(const ysVec4& point) const;
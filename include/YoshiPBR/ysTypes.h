@@ -61,7 +61,7 @@ typedef signed long long ys_int64;
 typedef unsigned char ys_uint8;
 typedef unsigned short ys_uint16;
 typedef unsigned int ys_uint32;
-typedef signed long long ys_uint64;
+typedef unsigned long long ys_uint64;
 typedef float ys_float32;
 typedef double ys_float64;
 
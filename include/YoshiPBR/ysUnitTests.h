@@ -1,4 +1,5 @@
 #pragma once
 
 void ysUnitTest_Memory();
-void ysUnitTest_JobSystem();
\ No newline at end of file
+void ysUnitTest_JobSystem();
+void ysUnitTest_BVH();
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "common/ysMappedFile.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysMappedFile::Reset()
+{
+    m_data = nullptr;
+    m_byteCount = 0;
+    m_fileHandle = nullptr;
+    m_mappingHandle = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysMappedFile::Open(const char* path)
+{
+    Reset();
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    m_fileHandle = file;
+
+    LARGE_INTEGER byteCount;
+    if (GetFileSizeEx(file, &byteCount) == FALSE || byteCount.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+    m_byteCount = ys_uint64(byteCount.QuadPart);
+
+    m_mappingHandle = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (m_mappingHandle == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    m_data = static_cast<ys_uint8*>(MapViewOfFile(m_mappingHandle, FILE_MAP_COPY, 0, 0, 0));
+    if (m_data == nullptr)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysMappedFile::Close()
+{
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mappingHandle != nullptr)
+    {
+        CloseHandle(m_mappingHandle);
+    }
+    if (m_fileHandle != nullptr)
+    {
+        CloseHandle(m_fileHandle);
+    }
+    Reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysMappedFile::IsOpen() const
+{
+    return m_data != nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysMappedFile::Contains(const void* address) const
+{
+    const ys_uint8* bytes = static_cast<const ys_uint8*>(address);
+    return m_data != nullptr && m_data <= bytes && bytes < m_data + m_byteCount;
+}
\ No newline at end of file
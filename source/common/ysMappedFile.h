@@ -0,0 +1,23 @@
+#pragma once
+
+#include "YoshiPBR/ysTypes.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A whole file mapped into memory. The mapping is copy-on-write: the data may be written to, but the writes only ever touch private copies
+// of the pages involved and never reach the file.
+struct ysMappedFile
+{
+    void Reset();
+    bool Open(const char* path);
+    void Close();
+
+    bool IsOpen() const;
+    bool Contains(const void*) const;
+
+    ys_uint8* m_data;
+    ys_uint64 m_byteCount;
+
+    void* m_fileHandle;
+    void* m_mappingHandle;
+};
\ No newline at end of file
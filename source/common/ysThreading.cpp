@@ -46,6 +46,16 @@ void ysLock::Release()
     ysAssert(success);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysAtomicAdd(std::atomic<ys_float32>* dst, ys_float32 value)
+{
+    ys_float32 expected = dst->load(std::memory_order_relaxed);
+    while (dst->compare_exchange_weak(expected, expected + value, std::memory_order_relaxed) == false)
+    {
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ysScopedLock::ysScopedLock(ysLock* lock)
@@ -1,5 +1,8 @@
 #include "YoshiPBR/ysUnitTests.h"
+#include "YoshiPBR/ysBVH.h"
 #include "YoshiPBR/ysMemoryPool.h"
+#include "YoshiPBR/ysMesh.h"
+#include "YoshiPBR/ysRay.h"
 #include "threading/ysParallelAlgorithms.h"
 #include <thread>
 
@@ -96,4 +99,127 @@ void ysUnitTest_JobSystem()
     YS_REF(safeForShutdown);
     ysAssert(safeForShutdown);
     ysJobSystem_Destroy(jobSys);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ys_float32 sRandomFloat()
+{
+    return ys_float32(std::rand()) / ys_float32(RAND_MAX);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Casts the rays against the mesh through the hierarchy, from several threads at once. Misses are given a null primitive index.
+static void sCastRays(const ysBVH* bvh, const ysMesh* mesh, const ysRayCastInput* rays, ysRayCastOutput* outputs, ys_int32 rayCount)
+{
+    const ys_int32 k_threadCount = 4;
+    std::thread threads[k_threadCount];
+    for (ys_int32 i = 0; i < k_threadCount; ++i)
+    {
+        threads[i] = std::thread([=]()
+        {
+            for (ys_int32 j = i; j < rayCount; j += k_threadCount)
+            {
+                bool hit = bvh->RayCastClosest(mesh, outputs + j, rays[j]);
+                if (hit == false)
+                {
+                    outputs[j].m_primitiveIndex = ys_nullIndex;
+                }
+            }
+        });
+    }
+    for (ys_int32 i = 0; i < k_threadCount; ++i)
+    {
+        threads[i].join();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Lazy hierarchies must give the same closest hits as regular ones, both while their subtrees are being built by concurrent rays and once
+// finalized.
+void ysUnitTest_BVH()
+{
+    const ys_int32 k_triangleCount = 8888;
+    const ys_int32 k_rayCount = 8888;
+
+    ysFloat3* positions = static_cast<ysFloat3*>(ysMalloc(sizeof(ysFloat3) * 3 * k_triangleCount));
+    ys_int32* indices = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * 3 * k_triangleCount));
+    for (ys_int32 i = 0; i < k_triangleCount; ++i)
+    {
+        ysVec4 base = ysVecSet(sRandomFloat(), sRandomFloat(), sRandomFloat()) * ysSplat(10.0f);
+        for (ys_int32 j = 0; j < 3; ++j)
+        {
+            ysVec4 vertex = base + ysVecSet(sRandomFloat(), sRandomFloat(), sRandomFloat()) * ysSplat(0.2f);
+            positions[3 * i + j].x = vertex.x;
+            positions[3 * i + j].y = vertex.y;
+            positions[3 * i + j].z = vertex.z;
+            indices[3 * i + j] = 3 * i + j;
+        }
+    }
+
+    ysMesh mesh;
+    mesh.m_positions = reinterpret_cast<const ys_uint8*>(positions);
+    mesh.m_normals = nullptr;
+    mesh.m_indices = indices;
+    mesh.m_positionStride = sizeof(ysFloat3);
+    mesh.m_normalStride = 0;
+    mesh.m_vertexCount = 3 * k_triangleCount;
+    mesh.m_triangleCount = k_triangleCount;
+    mesh.m_ownsBuffers = false;
+    mesh.m_twoSided = true;
+
+    ysAABB* aabbs = static_cast<ysAABB*>(ysMalloc(sizeof(ysAABB) * k_triangleCount));
+    ysShapeId* triangleIds = static_cast<ysShapeId*>(ysMalloc(sizeof(ysShapeId) * k_triangleCount));
+    for (ys_int32 i = 0; i < k_triangleCount; ++i)
+    {
+        aabbs[i] = mesh.ComputeAABB(i);
+        triangleIds[i].m_index = i;
+    }
+
+    ysBVH bvh;
+    bvh.Create(aabbs, triangleIds, k_triangleCount);
+    ysBVH lazyBVH;
+    lazyBVH.CreateLazy(aabbs, triangleIds, k_triangleCount);
+    ysAssert(lazyBVH.m_lazySubtreeCount > 1);
+
+    ysRayCastInput* rays = static_cast<ysRayCastInput*>(ysMalloc(sizeof(ysRayCastInput) * k_rayCount));
+    ysRayCastOutput* expected = static_cast<ysRayCastOutput*>(ysMalloc(sizeof(ysRayCastOutput) * k_rayCount));
+    ysRayCastOutput* outputs = static_cast<ysRayCastOutput*>(ysMalloc(sizeof(ysRayCastOutput) * k_rayCount));
+    for (ys_int32 i = 0; i < k_rayCount; ++i)
+    {
+        rays[i].m_origin = ysVecSet(sRandomFloat(), sRandomFloat(), sRandomFloat()) * ysSplat(14.0f) - ysSplat(2.0f);
+        rays[i].m_direction = ysNormalize3(ysVecSet(sRandomFloat(), sRandomFloat(), sRandomFloat()) - ysVec4_half);
+        rays[i].m_maxLambda = ys_maxFloat;
+    }
+
+    sCastRays(&bvh, &mesh, rays, expected, k_rayCount);
+    for (ys_int32 pass = 0; pass < 2; ++pass)
+    {
+        // The first pass builds the lazy subtrees as it goes, and the second casts against the finalized hierarchy
+        sCastRays(&lazyBVH, &mesh, rays, outputs, k_rayCount);
+        for (ys_int32 i = 0; i < k_rayCount; ++i)
+        {
+            ysAssert(outputs[i].m_primitiveIndex == expected[i].m_primitiveIndex);
+            ysAssert(outputs[i].m_primitiveIndex == ys_nullIndex || outputs[i].m_lambda == expected[i].m_lambda);
+        }
+
+        if (pass == 0)
+        {
+            lazyBVH.Finalize();
+            ysAssert(lazyBVH.m_lazySubtreeCount == 0);
+            ysAssert(lazyBVH.m_nodeCount == 2 * k_triangleCount - 1);
+        }
+    }
+
+    ysFree(outputs);
+    ysFree(expected);
+    ysFree(rays);
+    lazyBVH.Destroy();
+    bvh.Destroy();
+    ysFree(triangleIds);
+    ysFree(aabbs);
+    ysFree(indices);
+    ysFree(positions);
 }
\ No newline at end of file
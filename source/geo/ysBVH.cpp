@@ -1,11 +1,15 @@
 #include "YoshiPBR/ysBVH.h"
 #include "YoshiPBR/ysDebugDraw.h"
+#include "YoshiPBR/ysMesh.h"
+#include "YoshiPBR/ysMeshInstance.h"
 #include "YoshiPBR/ysRay.h"
 #include "YoshiPBR/ysShape.h"
 #include "YoshiPBR/ysStructures.h"
 #include "scene/ysScene.h"
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 // Construct a 61 bit integer by inserting two zeroes between each bit of src. ( ...1 0 1 1 becomes ...001 000 001 001)
 static ys_uint64 sSparsifyUint21(const ys_uint64& src21)
@@ -35,6 +39,46 @@ static ys_uint64 sInterleaveUint21s(const ys_uint64& a, const ys_uint64& b, cons
     return (aSparse << 2) | (bSparse << 1) | (cSparse << 0);
 }
 
+//
+static ys_float32 sHalfSurfaceArea(const ysAABB& aabb)
+{
+    ysVec4 span = aabb.m_max - aabb.m_min;
+    return span.x * span.y + span.y * span.z + span.z * span.x;
+}
+
+// Number of leaves the AAC builder agglomerates at the bottom of its recursion. (See ysBVHBuilder::BuildTree)
+static const ys_int32 s_aacDelta = 8;
+
+// Most leaves a lazy node may stand in for. (See ysBVH::CreateLazy)
+static const ys_int32 s_lazySubtreeLeafCount = 1024;
+
+//
+struct ysBVH::LazySubtree
+{
+    enum State
+    {
+        e_unbuilt,
+        e_building,
+        e_built,
+    };
+
+    ys_int32 m_leafBegin; // Into m_lazyLeafAABBs and m_lazyLeafShapeIds
+    ys_int32 m_leafCount;
+
+    // Set once built. Numbered from 0, independently of the nodes of the hierarchy.
+    ysBVH::Node* m_nodes;
+    ys_int32 m_depth;
+
+    // Whichever thread moves this from e_unbuilt to e_building builds the subtree. Any others wait for e_built.
+    std::atomic<State> m_state;
+};
+
+//
+static bool sIsLazyNode(const ysBVH::Node* node)
+{
+    return node->m_left == ys_nullIndex && node->m_shapeId == ys_nullShapeId;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct ysBVHBuilder
@@ -104,7 +148,9 @@ struct ysBVHBuilder
     }
 
     //
-    void Build(ysBVH* output, const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount, ys_int32 delta)
+    // Coarse builds skip the agglomeration and pair clusters up in Morton order instead (an LBVH), which is much faster to build but
+    // slower to cast rays against
+    void Build(ysBVH* output, const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount, ys_int32 delta, bool coarse)
     {
         ysAssert(delta >= 2 && leafCount >= 0);
         if (leafCount == 0)
@@ -114,9 +160,11 @@ struct ysBVHBuilder
             output->m_depth = 0;
             return;
         }
-        m_delta = delta;
+        m_delta = coarse ? 2 : delta;
+        m_coarse = coarse;
         m_leafCount = leafCount;
         m_clusterCapacity = 2 * leafCount - 1;
+        m_nodeCapacity = 2 * leafCount - 1;
         m_nodeCount = leafCount;
 
         // Single allocation for clusters and finalization stack
@@ -127,52 +175,7 @@ struct ysBVHBuilder
         m_clusters = static_cast<Cluster*>(memBuffer);
         ys_int32* clusterIdxStack = (ys_int32*)(static_cast<ys_int8*>(memBuffer) + clustersByteCount);
 
-        ysAABB centersAABB;
-        centersAABB.SetInvalid();
-        for (ys_int32 i = 0; i < leafCount; ++i)
-        {
-            ysVec4 center = (leafAABBs[i].m_min + leafAABBs[i].m_max) * ysVec4_half;
-            centersAABB.m_min = ysMin(centersAABB.m_min, center);
-            centersAABB.m_max = ysMax(centersAABB.m_max, center);
-        }
-
-        // Compute zOrder using the cube with the centers-AABB squashed into the lowest zOrder corner. Under the assumption that leaf shapes
-        // have reasonably uniform aspect ratio and are distrbuted roughly uniformly throughout the bounds, this will bias partitioning
-        // across the longest AABB axis at each depth.
-        ysVec4 invCentersCubeSpan;
-        {
-            ysVec4 centersSpan = centersAABB.m_max - centersAABB.m_min;
-            ys_float32 centersSpanMax = ysMax(ysMax(centersSpan.x, centersSpan.y), centersSpan.z);
-            invCentersCubeSpan = (centersSpanMax < ys_epsilon) ? ysVec4_zero : ysSplat(1.0f / centersSpanMax);
-        }
-
-        // Convert a float in range [0.0f, 1.0f] to a 21 bit integer in range [0, (1<<21)-1];
-        const ysVec4 f2i = ysSplat(float((1 << 21) - 1));
-
-        for (ys_int32 i = 0; i < leafCount; ++i)
-        {
-            ysVec4 center = (leafAABBs[i].m_min + leafAABBs[i].m_max) * ysVec4_half;
-            ysVec4 centerNorm = (center - centersAABB.m_min) * invCentersCubeSpan;
-            centerNorm = ysClamp(centerNorm, ysVec4_zero, ysVec4_one);
-            ysVec4 centerGrid = centerNorm * f2i;
-            ys_uint64 centerGridX = (ys_uint64)centerGrid.x;
-            ys_uint64 centerGridY = (ys_uint64)centerGrid.y;
-            ys_uint64 centerGridZ = (ys_uint64)centerGrid.z;
-
-            Cluster* cluster = m_clusters + i;
-            cluster->m_aabb = leafAABBs[i];
-            cluster->m_zOrder = sInterleaveUint21s(centerGridX, centerGridY, centerGridZ);
-            cluster->m_srcIndex = i;
-            cluster->m_parent = ys_nullIndex;
-            cluster->m_left = ys_nullIndex;
-            cluster->m_right = ys_nullIndex;
-            cluster->m_primCount = 1;
-            cluster->m_prev = ys_nullIndex;
-            cluster->m_next = ys_nullIndex;
-            cluster->m_bestCost = ys_maxFloat;
-            cluster->m_bestMatch = ys_nullIndex;
-        }
-        std::sort(m_clusters, m_clusters + leafCount, sCompareLeafClusters);
+        SortLeafClusters(leafAABBs, leafCount);
 
         for (ys_int32 i = leafCount; i < m_clusterCapacity; ++i)
         {
@@ -247,6 +250,170 @@ struct ysBVHBuilder
         ysFree(memBuffer);
     }
 
+    // Splits the leaves in Morton order like BuildTree does, but stops at ranges of s_lazySubtreeLeafCount leaves or fewer, each of which
+    // gets a lazy node standing in for the subtree over it. The output keeps a copy of the sorted leaves to build those subtrees from.
+    void BuildLazy(ysBVH* output, const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount)
+    {
+        ysAssert(leafCount > 0);
+        m_delta = 2;
+        m_coarse = true;
+        m_leafCount = leafCount;
+        m_clusterCapacity = leafCount; // Leaf clusters only, as the top levels are written straight to nodes
+        m_nodeCapacity = 2 * leafCount - 1;
+        m_nodeCount = 0;
+        m_leafShapeIds = leafShapeIds;
+        m_lazySubtreeCount = 0;
+        m_lazyDepth = 0;
+
+        // Scratch, sized for the worst case. The top levels are copied out to fit once their size is known.
+        ys_int32 clustersByteCount = sizeof(Cluster) * m_clusterCapacity;
+        ys_int32 nodesByteCount = sizeof(ysBVH::Node) * m_nodeCapacity;
+        ys_int32 rangesByteCount = sizeof(ys_int32) * 2 * leafCount;
+        void* memBuffer = ysMalloc(clustersByteCount + nodesByteCount + rangesByteCount);
+        m_clusters = static_cast<Cluster*>(memBuffer);
+        m_lazyNodes = (ysBVH::Node*)(static_cast<ys_int8*>(memBuffer) + clustersByteCount);
+        m_lazyRanges = (ys_int32*)(static_cast<ys_int8*>(memBuffer) + clustersByteCount + nodesByteCount);
+
+        SortLeafClusters(leafAABBs, leafCount);
+        ys_int32 rootIdx = BuildLazyTree(0, leafCount, 62, ys_nullIndex, 0);
+        ysAssert(rootIdx == 0);
+        YS_REF(rootIdx);
+
+        output->m_nodeCount = m_nodeCount;
+        output->m_nodes = static_cast<ysBVH::Node*>(ysMalloc(sizeof(ysBVH::Node) * m_nodeCount));
+        ysMemCpy(output->m_nodes, m_lazyNodes, sizeof(ysBVH::Node) * m_nodeCount);
+        output->m_depth = m_lazyDepth;
+
+        output->m_lazySubtreeCount = m_lazySubtreeCount;
+        output->m_lazySubtrees = static_cast<ysBVH::LazySubtree*>(ysMalloc(sizeof(ysBVH::LazySubtree) * m_lazySubtreeCount));
+        for (ys_int32 i = 0; i < m_lazySubtreeCount; ++i)
+        {
+            ysBVH::LazySubtree* subtree = output->m_lazySubtrees + i;
+            subtree->m_leafBegin = m_lazyRanges[2 * i + 0];
+            subtree->m_leafCount = m_lazyRanges[2 * i + 1];
+            subtree->m_nodes = nullptr;
+            subtree->m_depth = 0;
+            subtree->m_state.store(ysBVH::LazySubtree::e_unbuilt, std::memory_order_relaxed);
+        }
+
+        output->m_lazyLeafAABBs = static_cast<ysAABB*>(ysMalloc(sizeof(ysAABB) * leafCount));
+        output->m_lazyLeafShapeIds = static_cast<ysShapeId*>(ysMalloc(sizeof(ysShapeId) * leafCount));
+        for (ys_int32 i = 0; i < leafCount; ++i)
+        {
+            output->m_lazyLeafAABBs[i] = m_clusters[i].m_aabb;
+            output->m_lazyLeafShapeIds[i] = leafShapeIds[m_clusters[i].m_srcIndex];
+        }
+
+        ysFree(memBuffer);
+    }
+
+    // Writes the node over the sorted leaves within [leafBegin, leafEnd), followed by its descendants, and returns its index
+    ys_int32 BuildLazyTree(ys_int32 leafBegin, ys_int32 leafEnd, ys_int32 inBitPosition, ys_int32 parentIdx, ys_int32 depth)
+    {
+        ys_int32 subLeafCount = leafEnd - leafBegin;
+        ysAssert(subLeafCount > 0);
+        ysAssert(m_nodeCount < m_nodeCapacity);
+        ys_int32 nodeIdx = m_nodeCount++;
+        ysBVH::Node* node = m_lazyNodes + nodeIdx;
+        node->m_parent = parentIdx;
+        node->m_shapeId = ys_nullShapeId;
+        node->m_left = ys_nullIndex;
+        node->m_right = ys_nullIndex;
+        m_lazyDepth = ysMax(m_lazyDepth, depth + 1);
+
+        if (subLeafCount == 1)
+        {
+            node->m_aabb = m_clusters[leafBegin].m_aabb;
+            node->m_shapeId = m_leafShapeIds[m_clusters[leafBegin].m_srcIndex];
+            return nodeIdx;
+        }
+
+        if (subLeafCount <= s_lazySubtreeLeafCount)
+        {
+            node->m_aabb = m_clusters[leafBegin].m_aabb;
+            for (ys_int32 i = leafBegin + 1; i < leafEnd; ++i)
+            {
+                node->m_aabb = ysAABB::Merge(node->m_aabb, m_clusters[i].m_aabb);
+            }
+            node->m_right = m_lazySubtreeCount;
+            m_lazyRanges[2 * m_lazySubtreeCount + 0] = leafBegin;
+            m_lazyRanges[2 * m_lazySubtreeCount + 1] = subLeafCount;
+            m_lazySubtreeCount++;
+            return nodeIdx;
+        }
+
+        ys_int32 midIdx = ys_nullIndex;
+        ys_int32 bitPosition = inBitPosition;
+        while (midIdx == ys_nullIndex && bitPosition >= 0)
+        {
+            midIdx = MakePartition(leafBegin, leafEnd, bitPosition--);
+        }
+
+        if (midIdx == ys_nullIndex)
+        {
+            // The leaves all share the same Morton code, so any split is as good as another
+            midIdx = (leafBegin + leafEnd) / 2;
+        }
+
+        ys_int32 leftIdx = BuildLazyTree(leafBegin, midIdx, bitPosition, nodeIdx, depth + 1);
+        ys_int32 rightIdx = BuildLazyTree(midIdx, leafEnd, bitPosition, nodeIdx, depth + 1);
+        node->m_left = leftIdx;
+        node->m_right = rightIdx;
+        node->m_aabb = ysAABB::Merge(m_lazyNodes[leftIdx].m_aabb, m_lazyNodes[rightIdx].m_aabb);
+        return nodeIdx;
+    }
+
+    // Initializes a leaf cluster for each leaf and sorts them by the Morton code of their centers
+    void SortLeafClusters(const ysAABB* leafAABBs, ys_int32 leafCount)
+    {
+        ysAABB centersAABB;
+        centersAABB.SetInvalid();
+        for (ys_int32 i = 0; i < leafCount; ++i)
+        {
+            ysVec4 center = (leafAABBs[i].m_min + leafAABBs[i].m_max) * ysVec4_half;
+            centersAABB.m_min = ysMin(centersAABB.m_min, center);
+            centersAABB.m_max = ysMax(centersAABB.m_max, center);
+        }
+
+        // Compute zOrder using the cube with the centers-AABB squashed into the lowest zOrder corner. Under the assumption that leaf shapes
+        // have reasonably uniform aspect ratio and are distrbuted roughly uniformly throughout the bounds, this will bias partitioning
+        // across the longest AABB axis at each depth.
+        ysVec4 invCentersCubeSpan;
+        {
+            ysVec4 centersSpan = centersAABB.m_max - centersAABB.m_min;
+            ys_float32 centersSpanMax = ysMax(ysMax(centersSpan.x, centersSpan.y), centersSpan.z);
+            invCentersCubeSpan = (centersSpanMax < ys_epsilon) ? ysVec4_zero : ysSplat(1.0f / centersSpanMax);
+        }
+
+        // Convert a float in range [0.0f, 1.0f] to a 21 bit integer in range [0, (1<<21)-1];
+        const ysVec4 f2i = ysSplat(float((1 << 21) - 1));
+
+        for (ys_int32 i = 0; i < leafCount; ++i)
+        {
+            ysVec4 center = (leafAABBs[i].m_min + leafAABBs[i].m_max) * ysVec4_half;
+            ysVec4 centerNorm = (center - centersAABB.m_min) * invCentersCubeSpan;
+            centerNorm = ysClamp(centerNorm, ysVec4_zero, ysVec4_one);
+            ysVec4 centerGrid = centerNorm * f2i;
+            ys_uint64 centerGridX = (ys_uint64)centerGrid.x;
+            ys_uint64 centerGridY = (ys_uint64)centerGrid.y;
+            ys_uint64 centerGridZ = (ys_uint64)centerGrid.z;
+
+            Cluster* cluster = m_clusters + i;
+            cluster->m_aabb = leafAABBs[i];
+            cluster->m_zOrder = sInterleaveUint21s(centerGridX, centerGridY, centerGridZ);
+            cluster->m_srcIndex = i;
+            cluster->m_parent = ys_nullIndex;
+            cluster->m_left = ys_nullIndex;
+            cluster->m_right = ys_nullIndex;
+            cluster->m_primCount = 1;
+            cluster->m_prev = ys_nullIndex;
+            cluster->m_next = ys_nullIndex;
+            cluster->m_bestCost = ys_maxFloat;
+            cluster->m_bestMatch = ys_nullIndex;
+        }
+        std::sort(m_clusters, m_clusters + leafCount, sCompareLeafClusters);
+    }
+
     //
     ys_int32 MakePartition(ys_int32 beginIdx, ys_int32 endIdx, ys_int32 zOrderBitPosition)
     {
@@ -360,12 +527,7 @@ struct ysBVHBuilder
             Cluster* clusterB = m_clusters + clusterIdxB;
             ysAssert(ysAllLE3(clusterB->m_aabb.m_min, clusterB->m_aabb.m_max));
             ysAABB mergedAABB = ysAABB::Merge(clusterA->m_aabb, clusterB->m_aabb);
-            ysVec4 mergedAABBSpan = mergedAABB.m_max - mergedAABB.m_min;
-            ys_float32 mergedAABBArea
-                = mergedAABBSpan.x * mergedAABBSpan.y
-                + mergedAABBSpan.y * mergedAABBSpan.z
-                + mergedAABBSpan.z * mergedAABBSpan.x;
-            ys_float32 cost = mergedAABBArea;
+            ys_float32 cost = sHalfSurfaceArea(mergedAABB);
             if (cost < clusterA->m_bestCost)
             {
                 clusterA->m_bestCost = cost;
@@ -380,6 +542,10 @@ struct ysBVHBuilder
     ClusterList CombineClusters(ClusterList clusterList, ys_int32 agglomeratedClusterCount)
     {
         ysAssert(agglomeratedClusterCount >= 1);
+        if (m_coarse)
+        {
+            return CombineClustersInOrder(clusterList);
+        }
         ClusterList agglomeratedList = clusterList;
 
         ys_int32 clusterIdx = clusterList.m_first;
@@ -522,15 +688,83 @@ struct ysBVHBuilder
         return agglomeratedList;
     }
 
+    // Combines the clusters down to one, each pass pairing up neighbors in the list so that the subtree comes out balanced
+    ClusterList CombineClustersInOrder(ClusterList clusterList)
+    {
+        while (clusterList.m_count > 1)
+        {
+            ClusterList pairedList;
+            pairedList.m_first = ys_nullIndex;
+            pairedList.m_last = ys_nullIndex;
+            pairedList.m_count = 0;
+
+            ys_int32 clusterIdx = clusterList.m_first;
+            while (clusterIdx != ys_nullIndex)
+            {
+                ys_int32 idxL = clusterIdx;
+                ys_int32 idxR = m_clusters[idxL].m_next;
+                ys_int32 idxPaired = idxL;
+                if (idxR == ys_nullIndex)
+                {
+                    clusterIdx = ys_nullIndex;
+                }
+                else
+                {
+                    clusterIdx = m_clusters[idxR].m_next;
+                    Cluster* nodeL = m_clusters + idxL;
+                    Cluster* nodeR = m_clusters + idxR;
+                    ysAssert(nodeL->m_parent == ys_nullIndex && nodeR->m_parent == ys_nullIndex);
+                    ysAssert(m_nodeCount < m_nodeCapacity);
+                    idxPaired = m_nodeCount++;
+                    Cluster* nodeLUR = m_clusters + idxPaired;
+                    nodeLUR->m_left = idxL;
+                    nodeLUR->m_right = idxR;
+                    nodeLUR->m_parent = ys_nullIndex;
+                    nodeL->m_parent = idxPaired;
+                    nodeR->m_parent = idxPaired;
+                    nodeLUR->m_aabb = ysAABB::Merge(nodeL->m_aabb, nodeR->m_aabb);
+                    nodeLUR->m_primCount = nodeL->m_primCount + nodeR->m_primCount;
+                    nodeL->m_prev = ys_nullIndex;
+                    nodeL->m_next = ys_nullIndex;
+                    nodeR->m_prev = ys_nullIndex;
+                    nodeR->m_next = ys_nullIndex;
+                }
+
+                Cluster* paired = m_clusters + idxPaired;
+                paired->m_prev = pairedList.m_last;
+                paired->m_next = ys_nullIndex;
+                if (pairedList.m_last != ys_nullIndex)
+                {
+                    m_clusters[pairedList.m_last].m_next = idxPaired;
+                }
+                else
+                {
+                    pairedList.m_first = idxPaired;
+                }
+                pairedList.m_last = idxPaired;
+                pairedList.m_count++;
+            }
+
+            ysAssert(pairedList.m_count == (clusterList.m_count + 1) / 2);
+            clusterList = pairedList;
+        }
+        return clusterList;
+    }
+
     Cluster* m_clusters;
     ys_int32 m_leafCount;
     ys_int32 m_nodeCount;
-    union
-    {
-        ys_int32 m_clusterCapacity;
-        ys_int32 m_nodeCapacity;
-    };
+    ys_int32 m_clusterCapacity;
+    ys_int32 m_nodeCapacity;
     ys_int32 m_delta;
+    bool m_coarse;
+
+    // Lazy builds only
+    const ysShapeId* m_leafShapeIds;
+    ysBVH::Node* m_lazyNodes;
+    ys_int32* m_lazyRanges; // Pairs of the first leaf and the leaf count of each lazy subtree
+    ys_int32 m_lazySubtreeCount;
+    ys_int32 m_lazyDepth;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -539,111 +773,522 @@ void ysBVH::Reset()
 {
     m_nodes = nullptr;
     m_nodeCount = 0;
+    m_builtAreas = nullptr;
     m_depth = 0;
+    m_lazySubtrees = nullptr;
+    m_lazySubtreeCount = 0;
+    m_lazyLeafAABBs = nullptr;
+    m_lazyLeafShapeIds = nullptr;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void ysBVH::Create(const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount)
+static void sValidate(const ysBVH* bvh)
+{
+    const ysBVH::Node* nodes = bvh->m_nodes;
+    ys_int32 nodeCount = bvh->m_nodeCount;
+    YS_REF(nodes);
+    YS_REF(nodeCount);
+    ysAssert(nodes[0].m_parent == ys_nullIndex);
+    ysAssert(nodes[0].m_left == ys_nullIndex || (0 < nodes[0].m_left && nodes[0].m_left < nodeCount));
+    ysAssert(nodes[0].m_right == ys_nullIndex || (0 < nodes[0].m_right && nodes[0].m_right < nodeCount));
+    ysAssert((nodes[0].m_left == ys_nullIndex) == (nodes[0].m_right == ys_nullIndex));
+    ysAssert(nodes[0].m_left == ys_nullIndex || nodes[0].m_left != nodes[0].m_right);
+    ysAssert((nodes[0].m_left == ys_nullIndex) == (nodes[0].m_shapeId != ys_nullShapeId));
+    for (ys_int32 i = 1; i < nodeCount; ++i)
+    {
+        const ysBVH::Node* node = nodes + i;
+        ysAssert(node->m_left == ys_nullIndex || (i < node->m_left && node->m_left < nodeCount));
+        ysAssert(node->m_right == ys_nullIndex || (i < node->m_right && node->m_right < nodeCount));
+        ysAssert((node->m_left == ys_nullIndex) == (node->m_right == ys_nullIndex));
+        ysAssert(node->m_left == ys_nullIndex || node->m_left != node->m_right);
+        ysAssert((node->m_left == ys_nullIndex) == (node->m_shapeId != ys_nullShapeId));
+        ysAssert(0 <= node->m_parent && node->m_parent < i);
+        const ysBVH::Node* parent = nodes + node->m_parent;
+        YS_REF(parent);
+        ysAssert(parent->m_aabb.Contains(node->m_aabb));
+        ysAssert(parent->m_left == i || parent->m_right == i);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sCreate(ysBVH* bvh, const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount, bool coarse)
 {
     ysBVHBuilder builder;
-    ys_int32 delta = 8;
-    builder.Build(this, leafAABBs, leafShapeIds, leafCount, delta);
+    builder.Build(bvh, leafAABBs, leafShapeIds, leafCount, s_aacDelta, coarse);
+
+    bvh->m_lazySubtrees = nullptr;
+    bvh->m_lazySubtreeCount = 0;
+    bvh->m_lazyLeafAABBs = nullptr;
+    bvh->m_lazyLeafShapeIds = nullptr;
+    bvh->m_builtAreas = nullptr;
+    if (bvh->m_nodeCount > 0)
+    {
+        bvh->m_builtAreas = static_cast<ys_float32*>(ysMalloc(sizeof(ys_float32) * bvh->m_nodeCount));
+        for (ys_int32 i = 0; i < bvh->m_nodeCount; ++i)
+        {
+            bvh->m_builtAreas[i] = sHalfSurfaceArea(bvh->m_nodes[i].m_aabb);
+        }
+    }
 
     // Validation
     {
-        ysAssert((leafCount == 0) == (m_nodeCount == 0));
-        ysAssert(m_nodeCount == 0 || m_nodeCount == 2 * leafCount - 1);
-        if (m_nodeCount == 0)
+        ysAssert((leafCount == 0) == (bvh->m_nodeCount == 0));
+        ysAssert(bvh->m_nodeCount == 0 || bvh->m_nodeCount == 2 * leafCount - 1);
+        if (bvh->m_nodeCount == 0)
         {
             return;
         }
-        ysAssert(m_nodes[0].m_parent == ys_nullIndex);
-        ysAssert(m_nodes[0].m_left == ys_nullIndex || (0 < m_nodes[0].m_left && m_nodes[0].m_left < m_nodeCount));
-        ysAssert(m_nodes[0].m_right == ys_nullIndex || (0 < m_nodes[0].m_right && m_nodes[0].m_right < m_nodeCount));
-        ysAssert((m_nodes[0].m_left == ys_nullIndex) == (m_nodes[0].m_right == ys_nullIndex));
-        ysAssert(m_nodes[0].m_left == ys_nullIndex || m_nodes[0].m_left != m_nodes[0].m_right);
-        ysAssert((m_nodes[0].m_left == ys_nullIndex) == (m_nodes[0].m_shapeId != ys_nullShapeId));
-        for (ys_int32 i = 1; i < m_nodeCount; ++i)
-        {
-            const Node* node = m_nodes + i;
-            ysAssert(node->m_left == ys_nullIndex || (i < node->m_left && node->m_left < m_nodeCount));
-            ysAssert(node->m_right == ys_nullIndex || (i < node->m_right && node->m_right < m_nodeCount));
-            ysAssert((node->m_left == ys_nullIndex) == (node->m_right == ys_nullIndex));
-            ysAssert(node->m_left == ys_nullIndex || node->m_left != node->m_right);
-            ysAssert((node->m_left == ys_nullIndex) == (node->m_shapeId != ys_nullShapeId));
-            ysAssert(0 <= node->m_parent && node->m_parent < i);
-            const Node* parent = m_nodes + node->m_parent;
-            YS_REF(parent);
-            ysAssert(parent->m_aabb.Contains(node->m_aabb));
-            ysAssert(parent->m_left == i || parent->m_right == i);
-        }
+        sValidate(bvh);
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysBVH::Create(const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount)
+{
+    sCreate(this, leafAABBs, leafShapeIds, leafCount, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysBVH::CreateCoarse(const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount)
+{
+    sCreate(this, leafAABBs, leafShapeIds, leafCount, true);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysBVH::CreateLazy(const ysAABB* leafAABBs, const ysShapeId* leafShapeIds, ys_int32 leafCount)
+{
+    if (leafCount <= 1)
+    {
+        // Nothing to put off
+        sCreate(this, leafAABBs, leafShapeIds, leafCount, false);
+        return;
+    }
+
+    ysBVHBuilder builder;
+    builder.BuildLazy(this, leafAABBs, leafShapeIds, leafCount);
+
+    // Only wanted by Refit, which finalizes the hierarchy first
+    m_builtAreas = nullptr;
+    ysAssert(m_lazySubtreeCount > 0);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void ysBVH::Destroy()
 {
+    for (ys_int32 i = 0; i < m_lazySubtreeCount; ++i)
+    {
+        ysFree(m_lazySubtrees[i].m_nodes);
+    }
+    ysFree(m_lazySubtrees);
+    ysFree(m_lazyLeafAABBs);
+    ysFree(m_lazyLeafShapeIds);
+    m_lazySubtrees = nullptr;
+    m_lazySubtreeCount = 0;
+    m_lazyLeafAABBs = nullptr;
+    m_lazyLeafShapeIds = nullptr;
+
     ysFree(m_nodes);
+    ysFree(m_builtAreas);
     m_nodes = nullptr;
+    m_builtAreas = nullptr;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-bool ysBVH::RayCastClosest(const ysScene* scene, ysSceneRayCastOutput* output, const ysSceneRayCastInput& input) const
+// Returns the subtree that the lazy node stands in for, built. Rays cast from any number of threads may reach the node at once, but only
+// the first of them builds the subtree; the rest wait for it to be done.
+static const ysBVH::LazySubtree* sGetLazySubtree(const ysBVH* bvh, ys_int32 lazySubtreeIdx)
 {
-    bool anyHit = false;
-    ysRayCastInput rci;
-    rci.m_origin = input.m_origin;
-    rci.m_direction = input.m_direction;
-    rci.m_maxLambda = input.m_maxLambda;
+    ysAssert(0 <= lazySubtreeIdx && lazySubtreeIdx < bvh->m_lazySubtreeCount);
+    ysBVH::LazySubtree* subtree = bvh->m_lazySubtrees + lazySubtreeIdx;
+    ysBVH::LazySubtree::State state = subtree->m_state.load(std::memory_order_acquire);
+    if (state == ysBVH::LazySubtree::e_built)
+    {
+        return subtree;
+    }
+
+    if (state == ysBVH::LazySubtree::e_unbuilt &&
+        subtree->m_state.compare_exchange_strong(state, ysBVH::LazySubtree::e_building, std::memory_order_acquire))
+    {
+        ysBVH built;
+        ysBVHBuilder builder;
+        const ysAABB* leafAABBs = bvh->m_lazyLeafAABBs + subtree->m_leafBegin;
+        const ysShapeId* leafShapeIds = bvh->m_lazyLeafShapeIds + subtree->m_leafBegin;
+        builder.Build(&built, leafAABBs, leafShapeIds, subtree->m_leafCount, s_aacDelta, false);
+        ysAssert(built.m_nodeCount == 2 * subtree->m_leafCount - 1);
+        sValidate(&built);
+        subtree->m_nodes = built.m_nodes;
+        subtree->m_depth = built.m_depth;
+        subtree->m_state.store(ysBVH::LazySubtree::e_built, std::memory_order_release);
+        return subtree;
+    }
+
+    while (subtree->m_state.load(std::memory_order_acquire) != ysBVH::LazySubtree::e_built)
+    {
+        std::this_thread::yield();
+    }
+    return subtree;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Node of the merged hierarchy yet to be written
+struct LazyMergeItem
+{
+    const ysBVH::Node* m_nodes;
+    ys_int32 m_nodeIdx;
+    ys_int32 m_parent;
+    ys_int32 m_depth;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysBVH::Finalize()
+{
+    if (m_lazySubtreeCount == 0)
+    {
+        return;
+    }
+
+    // Each lazy node makes way for the root of its subtree, whose box is the same
+    ys_int32 nodeCount = m_nodeCount;
+    for (ys_int32 i = 0; i < m_lazySubtreeCount; ++i)
+    {
+        const LazySubtree* subtree = sGetLazySubtree(this, i);
+        nodeCount += 2 * subtree->m_leafCount - 2;
+    }
+
+    // Written depth first, as the builder does, so that every subtree keeps to a contiguous range of nodes. (See sSubtreeEnd)
+    Node* nodes = static_cast<Node*>(ysMalloc(sizeof(Node) * nodeCount));
+    LazyMergeItem* stack = static_cast<LazyMergeItem*>(ysMalloc(sizeof(LazyMergeItem) * nodeCount));
+    stack[0].m_nodes = m_nodes;
+    stack[0].m_nodeIdx = 0;
+    stack[0].m_parent = ys_nullIndex;
+    stack[0].m_depth = 0;
+    ys_int32 stackCount = 1;
+    ys_int32 nodeIdx = 0;
+    m_depth = 0;
+    while (stackCount > 0)
+    {
+        LazyMergeItem item = stack[--stackCount];
+        const Node* src = item.m_nodes + item.m_nodeIdx;
+        if (sIsLazyNode(src))
+        {
+            const LazySubtree* subtree = m_lazySubtrees + src->m_right;
+            ysAssert(subtree->m_state.load(std::memory_order_relaxed) == LazySubtree::e_built);
+            item.m_nodes = subtree->m_nodes;
+            item.m_nodeIdx = 0;
+            src = subtree->m_nodes;
+        }
+
+        ysAssert(nodeIdx < nodeCount);
+        Node* dst = nodes + nodeIdx;
+        dst->m_aabb = src->m_aabb;
+        dst->m_shapeId = src->m_shapeId;
+        dst->m_parent = item.m_parent;
+        dst->m_left = ys_nullIndex;
+        dst->m_right = ys_nullIndex;
+        if (item.m_parent != ys_nullIndex)
+        {
+            // Left children are popped first, and their whole subtree written before the right child
+            Node* parent = nodes + item.m_parent;
+            if (parent->m_left == ys_nullIndex)
+            {
+                parent->m_left = nodeIdx;
+            }
+            else
+            {
+                ysAssert(parent->m_right == ys_nullIndex);
+                parent->m_right = nodeIdx;
+            }
+        }
+        m_depth = ysMax(m_depth, item.m_depth + 1);
+
+        if (src->m_left != ys_nullIndex)
+        {
+            ysAssert(stackCount + 2 <= nodeCount);
+            LazyMergeItem right = item;
+            right.m_nodeIdx = src->m_right;
+            right.m_parent = nodeIdx;
+            right.m_depth = item.m_depth + 1;
+            stack[stackCount++] = right;
+            LazyMergeItem left = right;
+            left.m_nodeIdx = src->m_left;
+            stack[stackCount++] = left;
+        }
+        nodeIdx++;
+    }
+    ysAssert(nodeIdx == nodeCount);
+    ysFree(stack);
+
+    Destroy();
+    m_nodes = nodes;
+    m_nodeCount = nodeCount;
+    m_builtAreas = static_cast<ys_float32*>(ysMalloc(sizeof(ys_float32) * m_nodeCount));
+    for (ys_int32 i = 0; i < m_nodeCount; ++i)
+    {
+        m_builtAreas[i] = sHalfSurfaceArea(m_nodes[i].m_aabb);
+    }
+    sValidate(this);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The builder numbers the nodes depth first, so every subtree occupies a contiguous range of nodes. The last node of the range is found by
+// always descending into whichever child comes later.
+static ys_int32 sSubtreeEnd(const ysBVH* bvh, ys_int32 rootIdx)
+{
+    ys_int32 nodeIdx = rootIdx;
+    while (bvh->m_nodes[nodeIdx].m_left != ys_nullIndex)
+    {
+        nodeIdx = ysMax(bvh->m_nodes[nodeIdx].m_left, bvh->m_nodes[nodeIdx].m_right);
+    }
+    return nodeIdx + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Builds a new subtree over the leaves within [beginIdx, endIdx) and writes it over the old one. A subtree over the same leaves has the
+// same number of nodes, and its root the same box, so nothing outside of the range is affected.
+static void sRebuildSubtree(ysBVH* bvh, ys_int32 beginIdx, ys_int32 endIdx)
+{
+    ys_int32 nodeCount = endIdx - beginIdx;
+    ys_int32 leafCount = (nodeCount + 1) / 2;
+    ysAABB* aabbs = static_cast<ysAABB*>(ysMalloc(sizeof(ysAABB) * leafCount));
+    ysShapeId* shapeIds = static_cast<ysShapeId*>(ysMalloc(sizeof(ysShapeId) * leafCount));
+    ys_int32 leafIdx = 0;
+    for (ys_int32 i = beginIdx; i < endIdx; ++i)
+    {
+        const ysBVH::Node* node = bvh->m_nodes + i;
+        if (node->m_left == ys_nullIndex)
+        {
+            ysAssert(leafIdx < leafCount);
+            aabbs[leafIdx] = node->m_aabb;
+            shapeIds[leafIdx] = node->m_shapeId;
+            leafIdx++;
+        }
+    }
+    ysAssert(leafIdx == leafCount);
+
+    ysBVH subtree;
+    ysBVHBuilder builder;
+    builder.Build(&subtree, aabbs, shapeIds, leafCount, s_aacDelta, false);
+    ysAssert(subtree.m_nodeCount == nodeCount);
+
+    ys_int32 parentIdx = bvh->m_nodes[beginIdx].m_parent;
+    for (ys_int32 i = 0; i < nodeCount; ++i)
+    {
+        const ysBVH::Node* src = subtree.m_nodes + i;
+        ysBVH::Node* dst = bvh->m_nodes + beginIdx + i;
+        dst->m_aabb = src->m_aabb;
+        dst->m_shapeId = src->m_shapeId;
+        dst->m_parent = (src->m_parent == ys_nullIndex) ? parentIdx : beginIdx + src->m_parent;
+        dst->m_left = (src->m_left == ys_nullIndex) ? ys_nullIndex : beginIdx + src->m_left;
+        dst->m_right = (src->m_right == ys_nullIndex) ? ys_nullIndex : beginIdx + src->m_right;
+        bvh->m_builtAreas[beginIdx + i] = sHalfSurfaceArea(src->m_aabb);
+    }
+
+    ysFree(subtree.m_nodes);
+    ysFree(shapeIds);
+    ysFree(aabbs);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_int32 ysBVH::Refit(const ysAABB* leafAABBs, ys_float32 rebuildThreshold)
+{
+    ysAssert(rebuildThreshold >= 1.0f);
+
+    // The bounds of the lazy subtrees would have to be refit all the same, so they may as well be built
+    Finalize();
+
+    // Children come after their parents, so walking backwards visits both children of a node before the node itself
+    for (ys_int32 i = m_nodeCount - 1; i >= 0; --i)
+    {
+        Node* node = m_nodes + i;
+        if (node->m_left == ys_nullIndex)
+        {
+            node->m_aabb = leafAABBs[node->m_shapeId.m_index];
+        }
+        else
+        {
+            node->m_aabb = ysAABB::Merge(m_nodes[node->m_left].m_aabb, m_nodes[node->m_right].m_aabb);
+        }
+    }
+
+    // Only the topmost degraded subtrees are rebuilt, which takes care of any degraded subtrees within them
+    ys_int32 rebuildCount = 0;
+    ys_int32 nodeIdx = 0;
+    while (nodeIdx < m_nodeCount)
+    {
+        const Node* node = m_nodes + nodeIdx;
+        bool degraded = (node->m_left != ys_nullIndex) && (sHalfSurfaceArea(node->m_aabb) > rebuildThreshold * m_builtAreas[nodeIdx]);
+        if (degraded == false)
+        {
+            nodeIdx++;
+            continue;
+        }
+        ys_int32 endIdx = sSubtreeEnd(this, nodeIdx);
+        sRebuildSubtree(this, nodeIdx, endIdx);
+        rebuildCount++;
+        nodeIdx = endIdx;
+    }
+
+    if (rebuildCount > 0)
+    {
+        ys_int32* depths = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * m_nodeCount));
+        depths[0] = 0;
+        m_depth = 1;
+        for (ys_int32 i = 1; i < m_nodeCount; ++i)
+        {
+            depths[i] = depths[m_nodes[i].m_parent] + 1;
+            m_depth = ysMax(m_depth, depths[i] + 1);
+        }
+        ysFree(depths);
+    }
 
+    if (m_nodeCount > 0)
+    {
+        sValidate(this);
+    }
+    return rebuildCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Traverses the nodes of either the hierarchy or one of its lazy subtrees. Returns false once leafFcn does.
+template <typename LeafFcn>
+static bool sTraverseNodes(const ysBVH* bvh, const ysBVH::Node* nodes, ys_int32 depth, const ysRayCastInput* rci, LeafFcn& leafFcn)
+{
     const ys_int32 k_stackSize = 256;
-    ysAssert(m_depth < k_stackSize);
+    ysAssert(depth < k_stackSize);
+    YS_REF(depth);
     ys_int32 nodeIndexStack[k_stackSize];
     nodeIndexStack[0] = 0;
     ys_int32 stackCount = 1;
     while (stackCount > 0)
     {
         stackCount--;
-        const Node* node = m_nodes + nodeIndexStack[stackCount];
+        const ysBVH::Node* node = nodes + nodeIndexStack[stackCount];
         ysRay ray;
-        ray.m_origin = rci.m_origin;
-        ray.m_direction = rci.m_direction;
-        bool rayIntersectsNode = node->m_aabb.IntersectsRay(ray, rci.m_maxLambda);
+        ray.m_origin = rci->m_origin;
+        ray.m_direction = rci->m_direction;
+        bool rayIntersectsNode = node->m_aabb.IntersectsRay(ray, rci->m_maxLambda);
         if (rayIntersectsNode == false)
         {
             continue;
         }
 
-        ysAssert((node->m_left == ys_nullIndex) == (node->m_right == ys_nullIndex));
+        ysAssert((node->m_left == ys_nullIndex) == (node->m_right == ys_nullIndex) || sIsLazyNode(node));
         if (node->m_left != ys_nullIndex)
         {
             ysAssert(node->m_shapeId == ys_nullShapeId);
-            nodeIndexStack[stackCount] = node->m_left;
+
+            // Visit the nearer child first, so that the hits within it clip the ray before the farther one is reached. Besides culling
+            // more of the tree, this keeps lazy hierarchies from building the subtrees behind whatever the ray hits first.
+            const ysAABB& aabbL = nodes[node->m_left].m_aabb;
+            const ysAABB& aabbR = nodes[node->m_right].m_aabb;
+            ysVec4 separation = (aabbL.m_min + aabbL.m_max) - (aabbR.m_min + aabbR.m_max);
+            bool leftIsNearer = ysDot3(separation, rci->m_direction) < 0.0f;
+            nodeIndexStack[stackCount] = leftIsNearer ? node->m_right : node->m_left;
             stackCount++;
-            nodeIndexStack[stackCount] = node->m_right;
+            nodeIndexStack[stackCount] = leftIsNearer ? node->m_left : node->m_right;
             stackCount++;
         }
+        else if (node->m_shapeId != ys_nullShapeId)
+        {
+            if (leafFcn(node->m_shapeId.m_index) == false)
+            {
+                return false;
+            }
+        }
         else
         {
-            ysAssert(node->m_shapeId != ys_nullShapeId);
-            const ysShape& shape = scene->m_shapes[node->m_shapeId.m_index];
-            ysRayCastOutput rco;
-            bool hit = shape.RayCast(scene, &rco, rci);
-            if (hit)
+            // Lazy nodes only ever appear among the top levels, never within the subtrees they stand in for
+            ysAssert(nodes == bvh->m_nodes);
+            const ysBVH::LazySubtree* subtree = sGetLazySubtree(bvh, node->m_right);
+            if (sTraverseNodes(bvh, subtree->m_nodes, subtree->m_depth, rci, leafFcn) == false)
             {
-                rci.m_maxLambda = rco.m_lambda;
-                output->m_hitPoint = rco.m_hitPoint;
-                output->m_hitNormal = rco.m_hitNormal;
-                output->m_hitTangent = rco.m_hitTangent;
-                output->m_lambda = rco.m_lambda;
-                output->m_shapeId = node->m_shapeId;
-                anyHit = true;
+                return false;
             }
         }
     }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Hands the leaf of every node the ray crosses to leafFcn, for as long as it returns true. leafFcn may clip the ray as it goes by lowering
+// rci->m_maxLambda. The subtrees of lazy hierarchies are built as the ray first reaches them.
+template <typename LeafFcn>
+static void sTraverse(const ysBVH* bvh, const ysRayCastInput* rci, LeafFcn& leafFcn)
+{
+    if (bvh->m_nodeCount == 0)
+    {
+        return;
+    }
+    sTraverseNodes(bvh, bvh->m_nodes, bvh->m_depth, rci, leafFcn);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysBVH::RayCastClosest(const ysScene* scene, ysSceneRayCastOutput* output, const ysSceneRayCastInput& input) const
+{
+    bool anyHit = false;
+    ysRayCastInput rci;
+    rci.m_origin = input.m_origin;
+    rci.m_direction = input.m_direction;
+    rci.m_maxLambda = input.m_maxLambda;
+
+    auto LeafFcn = [&](ys_int32 shapeIdx) -> bool
+    {
+        const ysShape& shape = scene->m_shapes[shapeIdx];
+        ysRayCastOutput rco;
+        bool hit = shape.RayCast(scene, &rco, rci);
+        if (hit)
+        {
+            rci.m_maxLambda = rco.m_lambda;
+            output->m_hitPoint = rco.m_hitPoint;
+            output->m_hitNormal = rco.m_hitNormal;
+            output->m_hitTangent = rco.m_hitTangent;
+            output->m_lambda = rco.m_lambda;
+            output->m_shapeId.m_index = shapeIdx;
+            output->m_primitiveIndex = rco.m_primitiveIndex;
+            anyHit = true;
+        }
+        return true;
+    };
+    sTraverse(this, &rci, LeafFcn);
+    return anyHit;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysBVH::RayCastClosest(const ysMesh* mesh, ysRayCastOutput* output, const ysRayCastInput& input) const
+{
+    bool anyHit = false;
+    ysRayCastInput rci = input;
+
+    auto LeafFcn = [&](ys_int32 triangleIdx) -> bool
+    {
+        ysRayCastOutput rco;
+        bool hit = mesh->RayCast(triangleIdx, &rco, rci);
+        if (hit)
+        {
+            rci.m_maxLambda = rco.m_lambda;
+            *output = rco;
+            output->m_primitiveIndex = triangleIdx;
+            anyHit = true;
+        }
+        return true;
+    };
+    sTraverse(this, &rci, LeafFcn);
     return anyHit;
 }
 
@@ -656,64 +1301,66 @@ void ysBVH::RayCast(const ysScene* scene, const ysSceneRayCastInput& input, void
     rci.m_direction = input.m_direction;
     rci.m_maxLambda = input.m_maxLambda;
 
-    const ys_int32 k_stackSize = 256;
-    ysAssert(m_depth < k_stackSize);
-    ys_int32 nodeIndexStack[k_stackSize];
-    nodeIndexStack[0] = 0;
-    ys_int32 stackCount = 1;
-    while (stackCount > 0)
+    // Returns false if the traversal is to stop
+    auto ReportHit = [&](const ysRayCastOutput& rco, ys_int32 shapeIdx) -> bool
     {
-        stackCount--;
-        const Node* node = m_nodes + nodeIndexStack[stackCount];
-        ysRay ray;
-        ray.m_origin = rci.m_origin;
-        ray.m_direction = rci.m_direction;
-        bool rayIntersectsNode = node->m_aabb.IntersectsRay(ray, rci.m_maxLambda);
-        if (rayIntersectsNode == false)
+        ysSceneRayCastOutput srco;
+        srco.m_hitPoint = rco.m_hitPoint;
+        srco.m_hitNormal = rco.m_hitNormal;
+        srco.m_hitTangent = rco.m_hitTangent;
+        srco.m_lambda = rco.m_lambda;
+        srco.m_shapeId.m_index = shapeIdx;
+        srco.m_primitiveIndex = rco.m_primitiveIndex;
+        ysRayCastFlowControlCode code = fcn(srco, dat);
+        switch (code)
         {
-            continue;
+            case ysRayCastFlowControlCode::e_stop:
+                return false;
+            case ysRayCastFlowControlCode::e_continue:
+                return true;
+            case ysRayCastFlowControlCode::e_clip:
+                rci.m_maxLambda = rco.m_lambda;
+                return true;
+            default:
+                ysAssert(false);
+                return false;
         }
+    };
 
-        ysAssert((node->m_left == ys_nullIndex) == (node->m_right == ys_nullIndex));
-        if (node->m_left != ys_nullIndex)
+    auto LeafFcn = [&](ys_int32 shapeIdx) -> bool
+    {
+        const ysShape& shape = scene->m_shapes[shapeIdx];
+        if (shape.m_type != ysShape::Type::e_meshInstance)
         {
-            ysAssert(node->m_shapeId == ys_nullShapeId);
-            nodeIndexStack[stackCount] = node->m_left;
-            stackCount++;
-            nodeIndexStack[stackCount] = node->m_right;
-            stackCount++;
+            ysRayCastOutput rco;
+            bool hit = shape.RayCast(scene, &rco, rci);
+            return (hit == false) || ReportHit(rco, shapeIdx);
         }
-        else
+
+        // Every triangle of the instance that the ray crosses is a hit of its own, so descend into the hierarchy of the instanced mesh
+        // rather than settle for the closest hit
+        const ysMeshInstance* instance = scene->m_meshInstances + shape.m_typeIndex;
+        const ysInstancedMesh* instancedMesh = scene->m_instancedMeshes + instance->m_meshIndex;
+        ysRayCastInput localRCI = instance->ToMeshSpace(rci);
+        bool keepGoing = true;
+        auto TriangleFcn = [&](ys_int32 triangleIdx) -> bool
         {
-            ysAssert(node->m_shapeId != ys_nullShapeId);
-            const ysShape& shape = scene->m_shapes[node->m_shapeId.m_index];
             ysRayCastOutput rco;
-            bool hit = shape.RayCast(scene, &rco, rci);
-            if (hit)
+            bool hit = instancedMesh->m_mesh.RayCast(triangleIdx, &rco, localRCI);
+            if (hit == false)
             {
-                ysSceneRayCastOutput srco;
-                srco.m_hitPoint = rco.m_hitPoint;
-                srco.m_hitNormal = rco.m_hitNormal;
-                srco.m_hitTangent = rco.m_hitTangent;
-                srco.m_lambda = rco.m_lambda;
-                srco.m_shapeId = node->m_shapeId;
-                ysRayCastFlowControlCode code = fcn(srco, dat);
-                switch (code)
-                {
-                    case ysRayCastFlowControlCode::e_stop:
-                        return;
-                    case ysRayCastFlowControlCode::e_continue:
-                        continue;
-                    case ysRayCastFlowControlCode::e_clip:
-                        rci.m_maxLambda = rco.m_lambda;
-                        continue;
-                    default:
-                        ysAssert(false);
-                        return;
-                }
+                return true;
             }
-        }
-    }
+            instance->ToWorldSpace(&rco);
+            rco.m_primitiveIndex = triangleIdx;
+            keepGoing = ReportHit(rco, shapeIdx);
+            localRCI.m_maxLambda = rci.m_maxLambda; // Lengths are the same in both spaces
+            return keepGoing;
+        };
+        sTraverse(&instancedMesh->m_bvh, &localRCI, TriangleFcn);
+        return keepGoing;
+    };
+    sTraverse(this, &rci, LeafFcn);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -764,7 +1411,7 @@ void ysBVH::DebugDraw(const ysDrawInputBVH& input) const
             continue;
         }
         ysAssert(depth < input.depth);
-        ysAssert((node->m_left == ys_nullIndex) == (node->m_right == ys_nullIndex));
+        ysAssert((node->m_left == ys_nullIndex) == (node->m_right == ys_nullIndex) || sIsLazyNode(node));
         if (node->m_left != ys_nullIndex)
         {
             nodeIndexStack[stackCount] = node->m_left;
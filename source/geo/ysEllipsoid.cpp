@@ -24,6 +24,19 @@ ysAABB ysEllipsoid::ComputeAABB() const
     return aabb;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysEllipsoid::ComputeSurfaceArea() const
+{
+    // There is no closed form in terms of elementary functions. Use Knud Thomsen's approximation (relative error at most ~1.061%).
+    // https://en.wikipedia.org/wiki/Ellipsoid#Approximate_formula
+    const ys_float32 p = 1.6075f;
+    ys_float32 ap = powf(m_s.x, p);
+    ys_float32 bp = powf(m_s.y, p);
+    ys_float32 cp = powf(m_s.z, p);
+    return 2.0f * ys_2pi * powf((ap * bp + ap * cp + bp * cp) / 3.0f, 1.0f / p);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool ysEllipsoid::RayCast(ysRayCastOutput* output, const ysRayCastInput& input) const
@@ -0,0 +1,200 @@
+#include "ysHashGrid.h"
+#include "threading/ysParallelAlgorithms.h"
+
+#include <math.h>
+#include <new>
+
+static const ys_int32 s_chunkSize = 256;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ys_int32 sComputeCell(ys_float32 x)
+{
+    return ys_int32(floorf(x));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sCountPoints(ysHashGrid::Chunk& chunk, ysHashGrid* grid)
+{
+    for (ys_int32 i = chunk.m_begin; i < chunk.m_end; ++i)
+    {
+        ysVec4 p = grid->m_points[i] * ysSplat(grid->m_cellSizeInv);
+        ys_int32 bucket = grid->ComputeBucket(sComputeCell(p.x), sComputeCell(p.y), sComputeCell(p.z));
+        grid->m_pointBuckets[i] = bucket;
+        grid->m_bucketCursors[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sScatterPoints(ysHashGrid::Chunk& chunk, ysHashGrid* grid)
+{
+    for (ys_int32 i = chunk.m_begin; i < chunk.m_end; ++i)
+    {
+        ys_int32 slot = grid->m_bucketCursors[grid->m_pointBuckets[i]].fetch_add(1, std::memory_order_relaxed);
+        grid->m_pointIndices[slot] = i;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysHashGrid::Reset()
+{
+    m_points = nullptr;
+    m_pointCount = 0;
+    m_capacity = 0;
+    m_radius = 0.0f;
+    m_cellSizeInv = 0.0f;
+    m_bucketStarts = nullptr;
+    m_bucketCursors = nullptr;
+    m_bucketCount = 0;
+    m_pointBuckets = nullptr;
+    m_pointIndices = nullptr;
+    m_chunks = nullptr;
+    m_chunkCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysHashGrid::Create(ys_int32 capacity)
+{
+    ysAssert(capacity > 0);
+    Reset();
+    m_capacity = capacity;
+
+    // Roughly one bucket per point keeps both the table and the chains short
+    m_bucketCount = 1;
+    while (m_bucketCount < capacity)
+    {
+        m_bucketCount *= 2;
+    }
+
+    m_bucketStarts = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * (m_bucketCount + 1)));
+    m_bucketCursors = static_cast<std::atomic<ys_int32>*>(ysMalloc(sizeof(std::atomic<ys_int32>) * m_bucketCount));
+    for (ys_int32 i = 0; i < m_bucketCount; ++i)
+    {
+        new (m_bucketCursors + i) std::atomic<ys_int32>(0);
+    }
+    m_pointBuckets = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * m_capacity));
+    m_pointIndices = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * m_capacity));
+    m_chunks = static_cast<Chunk*>(ysMalloc(sizeof(Chunk) * ((m_capacity + s_chunkSize - 1) / s_chunkSize)));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysHashGrid::Destroy()
+{
+    ysSafeFree(m_bucketStarts);
+    ysSafeFree(m_bucketCursors);
+    ysSafeFree(m_pointBuckets);
+    ysSafeFree(m_pointIndices);
+    ysSafeFree(m_chunks);
+    Reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_int32 ysHashGrid::ComputeBucket(ys_int32 cellX, ys_int32 cellY, ys_int32 cellZ) const
+{
+    ys_uint32 hash = (ys_uint32(cellX) * 73856093u) ^ (ys_uint32(cellY) * 19349663u) ^ (ys_uint32(cellZ) * 83492791u);
+    return ys_int32(hash & ys_uint32(m_bucketCount - 1));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysHashGrid::Build(ysJobSystem* jobSystem, const ysVec4* points, ys_int32 pointCount, ys_float32 radius)
+{
+    ysAssert(pointCount <= m_capacity && radius > 0.0f);
+    m_points = points;
+    m_pointCount = pointCount;
+    m_radius = radius;
+    m_cellSizeInv = 1.0f / (2.0f * radius);
+
+    for (ys_int32 i = 0; i < m_bucketCount; ++i)
+    {
+        m_bucketCursors[i].store(0, std::memory_order_relaxed);
+    }
+
+    m_chunkCount = (pointCount + s_chunkSize - 1) / s_chunkSize;
+    for (ys_int32 i = 0; i < m_chunkCount; ++i)
+    {
+        m_chunks[i].m_begin = i * s_chunkSize;
+        m_chunks[i].m_end = ysMin((i + 1) * s_chunkSize, pointCount);
+    }
+
+    auto ForEachChunk = [&](void(*fcn)(Chunk&, ysHashGrid*))
+    {
+        if (jobSystem == nullptr)
+        {
+            for (ys_int32 i = 0; i < m_chunkCount; ++i)
+            {
+                fcn(m_chunks[i], this);
+            }
+        }
+        else if (m_chunkCount > 0)
+        {
+            ysParallelFor(jobSystem, m_chunks, m_chunkCount, this, 2, fcn);
+        }
+    };
+
+    // Count the points in each bucket
+    ForEachChunk(sCountPoints);
+
+    // Exclusive prefix sum over the bucket counts. The cursors are then rewound to the start of each bucket to be used for scattering.
+    ys_int32 sum = 0;
+    for (ys_int32 i = 0; i < m_bucketCount; ++i)
+    {
+        m_bucketStarts[i] = sum;
+        sum += m_bucketCursors[i].load(std::memory_order_relaxed);
+        m_bucketCursors[i].store(m_bucketStarts[i], std::memory_order_relaxed);
+    }
+    m_bucketStarts[m_bucketCount] = sum;
+    ysAssert(sum == pointCount);
+
+    ForEachChunk(sScatterPoints);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysHashGrid::Query(const ysVec4& point, QueryFunction fcn, void* userData) const
+{
+    if (m_pointCount == 0)
+    {
+        return;
+    }
+
+    // Any point within the radius lies in one of the two cells straddling the query point along each axis
+    ysVec4 p = point * ysSplat(m_cellSizeInv) - ysVec4_half;
+    ys_int32 cellX = sComputeCell(p.x);
+    ys_int32 cellY = sComputeCell(p.y);
+    ys_int32 cellZ = sComputeCell(p.z);
+    ys_float32 radiusSqr = m_radius * m_radius;
+
+    // Distinct cells may hash to the same bucket, which must not be visited twice
+    ys_int32 visitedBuckets[8];
+    ys_int32 visitedBucketCount = 0;
+    for (ys_int32 i = 0; i < 8; ++i)
+    {
+        ys_int32 bucket = ComputeBucket(cellX + (i & 1), cellY + ((i >> 1) & 1), cellZ + ((i >> 2) & 1));
+        bool visited = false;
+        for (ys_int32 j = 0; j < visitedBucketCount; ++j)
+        {
+            visited = visited || (visitedBuckets[j] == bucket);
+        }
+        if (visited)
+        {
+            continue;
+        }
+        visitedBuckets[visitedBucketCount++] = bucket;
+
+        for (ys_int32 k = m_bucketStarts[bucket]; k < m_bucketStarts[bucket + 1]; ++k)
+        {
+            ys_int32 pointIdx = m_pointIndices[k];
+            if (ysLengthSqr3(m_points[pointIdx] - point) <= radiusSqr)
+            {
+                fcn(pointIdx, userData);
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "YoshiPBR/ysMath.h"
+
+#include <atomic>
+
+struct ysJobSystem;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Uniform grid over a set of points for gathering every point within a fixed radius of a query point. The cells are unbounded and hashed
+// into a table of buckets, and are one diameter wide so that a query visits at most 2x2x2 of them. Meant to be rebuilt from scratch every
+// render pass (see ysScene::DoRenderWork), so the build is split across the job system: points are hashed, counted and scattered into
+// their buckets in parallel, with only the prefix sum over bucket counts done serially.
+struct ysHashGrid
+{
+    struct Chunk
+    {
+        ys_int32 m_begin;
+        ys_int32 m_end;
+    };
+
+    typedef void(*QueryFunction)(ys_int32 pointIdx, void* userData);
+
+    void Reset();
+    void Create(ys_int32 capacity);
+    void Destroy();
+
+    // The points are not copied and must outlive any subsequent queries. The job system may be null, in which case the build is serial.
+    void Build(ysJobSystem*, const ysVec4* points, ys_int32 pointCount, ys_float32 radius);
+
+    // Calls fcn for every point within the radius of the query point, in no particular order.
+    void Query(const ysVec4& point, QueryFunction fcn, void* userData) const;
+
+    ys_int32 ComputeBucket(ys_int32 cellX, ys_int32 cellY, ys_int32 cellZ) const;
+
+    const ysVec4* m_points;
+    ys_int32 m_pointCount;
+    ys_int32 m_capacity;
+
+    ys_float32 m_radius;
+    ys_float32 m_cellSizeInv;
+
+    // Bucket b holds m_pointIndices[m_bucketStarts[b], m_bucketStarts[b + 1]). The bucket count is a power of two.
+    ys_int32* m_bucketStarts;
+    std::atomic<ys_int32>* m_bucketCursors;
+    ys_int32 m_bucketCount;
+
+    ys_int32* m_pointBuckets;
+    ys_int32* m_pointIndices;
+
+    Chunk* m_chunks;
+    ys_int32 m_chunkCount;
+};
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "YoshiPBR/ysMesh.h"
+#include "YoshiPBR/ysShape.h"
+#include "YoshiPBR/ysRay.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ysVec4 sLoad(const ys_uint8* buffer, ys_int32 stride, ys_int32 idx)
+{
+    const ysFloat3* f = reinterpret_cast<const ysFloat3*>(buffer + ys_int64(stride) * idx);
+    return ysVecSet(f->x, f->y, f->z);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Interpolates the vertex normals at the given barycentric coordinates, and builds a tangent perpendicular to the result from the first
+// edge. Falls back to the face normal if the vertex normals cancel out.
+static void sComputeShadingFrame(const ysMesh* mesh, ys_int32 triangleIdx, ys_float32 b0, ys_float32 b1, ys_float32 b2,
+    const ysVec4& faceNormal, const ysVec4& edge, ysVec4* normal, ysVec4* tangent)
+{
+    const ys_int32* indices = mesh->m_indices + 3 * triangleIdx;
+    ysVec4 n = ysSplat(b0) * mesh->GetNormal(indices[0]) +
+               ysSplat(b1) * mesh->GetNormal(indices[1]) +
+               ysSplat(b2) * mesh->GetNormal(indices[2]);
+    *normal = ysIsSafeToNormalize3(n) ? ysNormalize3(n) : faceNormal;
+    ysVec4 t = edge - ysSplatDot3(*normal, edge) * *normal;
+    *tangent = ysIsSafeToNormalize3(t) ? ysNormalize3(t) : ysVec4_zero;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysVec4 ysMesh::GetPosition(ys_int32 vertexIdx) const
+{
+    ysAssert(0 <= vertexIdx && vertexIdx < m_vertexCount);
+    return sLoad(m_positions, m_positionStride, vertexIdx);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysVec4 ysMesh::GetNormal(ys_int32 vertexIdx) const
+{
+    ysAssert(m_normals != nullptr && 0 <= vertexIdx && vertexIdx < m_vertexCount);
+    return sLoad(m_normals, m_normalStride, vertexIdx);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysMesh::GetVertices(ys_int32 triangleIdx, ysVec4* v) const
+{
+    ysAssert(0 <= triangleIdx && triangleIdx < m_triangleCount);
+    const ys_int32* indices = m_indices + 3 * triangleIdx;
+    v[0] = GetPosition(indices[0]);
+    v[1] = GetPosition(indices[1]);
+    v[2] = GetPosition(indices[2]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysAABB ysMesh::ComputeAABB(ys_int32 triangleIdx) const
+{
+    ysVec4 v[3];
+    GetVertices(triangleIdx, v);
+    ysAABB aabb;
+    aabb.m_min = ysMin(ysMin(v[0], v[1]), v[2]);
+    aabb.m_max = ysMax(ysMax(v[0], v[1]), v[2]);
+    return aabb;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysMesh::ComputeSurfaceArea(ys_int32 triangleIdx) const
+{
+    ysVec4 v[3];
+    GetVertices(triangleIdx, v);
+    ys_float32 area = 0.5f * ysLength3(ysCross(v[1] - v[0], v[2] - v[0]));
+    return m_twoSided ? 2.0f * area : area;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysVec4 ysMesh::ComputeFaceNormal(ys_int32 triangleIdx) const
+{
+    ysVec4 v[3];
+    GetVertices(triangleIdx, v);
+    ysVec4 ab_x_ac = ysCross(v[1] - v[0], v[2] - v[0]);
+    return ysIsSafeToNormalize3(ab_x_ac) ? ysNormalize3(ab_x_ac) : ysVec4_zero;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysMesh::RayCast(ys_int32 triangleIdx, ysRayCastOutput* output, const ysRayCastInput& input) const
+{
+    // Same as ysTriangle::RayCast, except that the face normal is left unnormalized until there is a hit
+    ysVec4 v[3];
+    GetVertices(triangleIdx, v);
+
+    const ysVec4& o = input.m_origin;
+    const ysVec4& d = input.m_direction;
+
+    ysVec4 e1 = v[1] - v[0];
+    ysVec4 e2 = v[2] - v[0];
+    ysVec4 m = ysCross(e1, e2);
+
+    const ys_float32 dnTol = ys_epsilon;
+    ys_float32 dm = ysDot3(d, m);
+    if (dm * dm < dnTol * dnTol * ysDot3(m, m))
+    {
+        return false;
+    }
+
+    bool backFace = (dm > 0.0f);
+    if (backFace && m_twoSided == false)
+    {
+        return false;
+    }
+
+    ysVec4 s = o - v[0];
+    ysVec4 s1 = ysCross(d, e2);
+    ysVec4 s2 = ysCross(s, e1);
+
+    ysVec4 tb1b2 = ysVecSet(ysDot3(s2, e2), ysDot3(s1, s), ysDot3(s2, d)) / ysSplatDot3(s1, e1);
+    ys_float32 t = tb1b2.x;
+    ys_float32 b1 = tb1b2.y;
+    ys_float32 b2 = tb1b2.z;
+    ys_float32 b0 = 1.0f - b1 - b2;
+
+    if (t < 0.0f || input.m_maxLambda < t)
+    {
+        return false;
+    }
+
+    if (b0 < 0.0f || b0 > 1.0f ||
+        b1 < 0.0f || b1 > 1.0f ||
+        b2 < 0.0f || b2 > 1.0f)
+    {
+        return false;
+    }
+
+    ysVec4 n = ysNormalize3(m);
+    ysVec4 tangent = ysIsSafeToNormalize3(e1) ? ysNormalize3(e1) : ysVec4_zero;
+    if (m_normals != nullptr)
+    {
+        sComputeShadingFrame(this, triangleIdx, b0, b1, b2, n, e1, &n, &tangent);
+    }
+
+    output->m_hitPoint = ysSplat(b0) * v[0] + ysSplat(b1) * v[1] + ysSplat(b2) * v[2];
+    output->m_hitNormal = backFace ? -n : n;
+    output->m_hitTangent = tangent;
+    output->m_lambda = t;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysMesh::GenerateRandomSurfacePoint(ys_int32 triangleIdx, ysSurfacePoint* point, ys_float32* probabilityDensity) const
+{
+    // https://mathworld.wolfram.com/TrianglePointPicking.html
+    ysVec4 v[3];
+    GetVertices(triangleIdx, v);
+    ysVec4 u = v[1] - v[0];
+    ysVec4 w = v[2] - v[0];
+    ysVec4 m = ysCross(u, w);
+    ys_float32 a = ysRandom(0.0f, 1.0f);
+    ys_float32 b = ysRandom(0.0f, 1.0f);
+
+    // For two-sided meshes, the half of the parallelogram outside the triangle picks the back face
+    bool backFace = false;
+    if (a + b > 1.0f)
+    {
+        a = 1.0f - a;
+        b = 1.0f - b;
+        backFace = m_twoSided;
+    }
+
+    ysVec4 n = ysIsSafeToNormalize3(m) ? ysNormalize3(m) : ysVec4_zero;
+    ysVec4 tangent = ysIsSafeToNormalize3(u) ? ysNormalize3(u) : ysVec4_zero;
+    if (m_normals != nullptr)
+    {
+        sComputeShadingFrame(this, triangleIdx, 1.0f - a - b, a, b, n, u, &n, &tangent);
+    }
+
+    point->m_point = v[0] + ysSplat(a) * u + ysSplat(b) * w;
+    point->m_normal = backFace ? -n : n;
+    point->m_tangent = tangent;
+    *probabilityDensity = (m_twoSided ? 1.0f : 2.0f) / ysLength3(m);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysMesh::ProbabilityDensityForGeneratedPoint(ys_int32 triangleIdx, const ysVec4&) const
+{
+    ysVec4 v[3];
+    GetVertices(triangleIdx, v);
+    return (m_twoSided ? 1.0f : 2.0f) / ysLength3(ysCross(v[1] - v[0], v[2] - v[0]));
+}
\ No newline at end of file
@@ -0,0 +1,1281 @@
+#include "YoshiPBR/YoshiPBR.h"
+#include "common/ysMappedFile.h"
+#include "threading/ysParallelAlgorithms.h"
+
+#include <math.h>
+#include <string.h>
+#include <thread>
+
+// Each job parses about this much of the file
+static const ys_int64 s_objChunkByteCount = 1 << 20;
+static const ys_int32 s_plyChunkElementCount = 1 << 16;
+
+static const ys_int64 s_maxElementCount = 0x7FFFFFFF;
+static const ys_int32 s_jobSystemWorkerCapacity = 64;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The import runs on a job system of its own, as there is no scene yet to borrow one from. The calling thread is one of the workers.
+static ysJobSystem* sCreateJobSystem()
+{
+    ysJobSystemDef def;
+    def.m_workerCount = ysClamp(ys_int32(std::thread::hardware_concurrency()), 1, s_jobSystemWorkerCapacity);
+    return ysJobSystem_Create(def);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sSetNormalized(ysFloat3* dst, ys_float32 x, ys_float32 y, ys_float32 z)
+{
+    ysVec4 n = ysVecSet(x, y, z);
+    n = ysIsSafeToNormalize3(n) ? ysNormalize3(n) : ysVec4_zero;
+    dst->x = n.x;
+    dst->y = n.y;
+    dst->z = n.z;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool sIsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool sIsDigit(char c)
+{
+    return '0' <= c && c <= '9';
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static const char* sSkipSpaces(const char* p, const char* end)
+{
+    while (p < end && sIsSpace(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns the start of the next line
+static const char* sSkipLine(const char* p, const char* end)
+{
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return (newline != nullptr) ? newline + 1 : end;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Whether the line at p starts with the given keyword, followed by a space
+static bool sHasKeyword(const char* p, const char* end, const char* keyword)
+{
+    while (*keyword != '\0')
+    {
+        if (p == end || *p != *keyword)
+        {
+            return false;
+        }
+        p++;
+        keyword++;
+    }
+    return p < end && sIsSpace(*p);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns the end of the number, or null if there is none at p. Neither this nor sParseFloat below need the text to be null terminated.
+static const char* sParseInt(const char* p, const char* end, ys_int32* value)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    if (p == end || sIsDigit(*p) == false)
+    {
+        return nullptr;
+    }
+
+    ys_int64 magnitude = 0;
+    while (p < end && sIsDigit(*p))
+    {
+        magnitude = 10 * magnitude + (*p - '0');
+        if (magnitude > s_maxElementCount)
+        {
+            return nullptr;
+        }
+        p++;
+    }
+
+    *value = ys_int32(negative ? -magnitude : magnitude);
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Accumulates the digits into an integer and scales it by a power of ten once at the end. Exact enough for single precision, and several
+// times faster than strtof, which would also need the number copied out to be null terminated.
+static const char* sParseFloat(const char* p, const char* end, ys_float32* value)
+{
+    static const ys_float64 s_powersOf10[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    const ys_int32 exactPowerCount = ys_int32(sizeof(s_powersOf10) / sizeof(s_powersOf10[0]));
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    ys_float64 mantissa = 0.0;
+    ys_int32 exponent = 0;
+    bool anyDigits = false;
+    while (p < end && sIsDigit(*p))
+    {
+        mantissa = 10.0 * mantissa + (*p - '0');
+        anyDigits = true;
+        p++;
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && sIsDigit(*p))
+        {
+            mantissa = 10.0 * mantissa + (*p - '0');
+            exponent--;
+            anyDigits = true;
+            p++;
+        }
+    }
+    if (anyDigits == false)
+    {
+        return nullptr;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        ys_int32 explicitExponent;
+        p = sParseInt(p, end, &explicitExponent);
+        if (p == nullptr)
+        {
+            return nullptr;
+        }
+        exponent += explicitExponent;
+    }
+
+    ys_int32 absExponent = ysAbs(exponent);
+    ys_float64 scale = (absExponent < exactPowerCount) ? s_powersOf10[absExponent] : pow(10.0, ys_float64(absExponent));
+    ys_float64 result = (exponent < 0) ? mantissa / scale : mantissa * scale;
+    *value = ys_float32(negative ? -result : result);
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static const char* sParseFloat3(const char* p, const char* end, ys_float32* xyz)
+{
+    for (ys_int32 i = 0; i < 3 && p != nullptr; ++i)
+    {
+        p = sParseFloat(sSkipSpaces(p, end), end, xyz + i);
+    }
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Gives meshes whose corners index positions and normals separately (as OBJ faces do) one vertex per distinct pair of the two. The corners
+// that share a position are chained together, so that each corner need only be compared with those few. On return, cornerPositions holds
+// the new vertex of each corner.
+static void sWeldCorners(ysMeshDef* mesh, const ysFloat3* positions, ys_int32 positionCount, const ysFloat3* normals,
+    ys_int32* cornerPositions, const ys_int32* cornerNormals, ys_int32 cornerCount)
+{
+    ys_int32* heads = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * positionCount));
+    for (ys_int32 i = 0; i < positionCount; ++i)
+    {
+        heads[i] = ys_nullIndex;
+    }
+
+    // The first corner to use a pair stands for all of the others
+    ys_int32* nexts = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * cornerCount));
+    ys_int32* vertices = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * cornerCount));
+    ys_int32 vertexCount = 0;
+    for (ys_int32 i = 0; i < cornerCount; ++i)
+    {
+        ys_int32 position = cornerPositions[i];
+        ys_int32 match = heads[position];
+        while (match != ys_nullIndex && cornerNormals[match] != cornerNormals[i])
+        {
+            match = nexts[match];
+        }
+
+        if (match == ys_nullIndex)
+        {
+            nexts[i] = heads[position];
+            heads[position] = i;
+            vertices[i] = vertexCount++;
+        }
+        else
+        {
+            vertices[i] = vertices[match];
+        }
+    }
+    ysFree(nexts);
+    ysFree(heads);
+
+    ysFloat3* weldedPositions = static_cast<ysFloat3*>(ysMalloc(sizeof(ysFloat3) * vertexCount));
+    ysFloat3* weldedNormals = static_cast<ysFloat3*>(ysMalloc(sizeof(ysFloat3) * vertexCount));
+    for (ys_int32 i = 0; i < cornerCount; ++i)
+    {
+        weldedPositions[vertices[i]] = positions[cornerPositions[i]];
+        weldedNormals[vertices[i]] = normals[cornerNormals[i]];
+        cornerPositions[i] = vertices[i];
+    }
+    ysFree(vertices);
+
+    mesh->m_positions = weldedPositions;
+    mesh->m_normals = weldedNormals;
+    mesh->m_vertexCount = vertexCount;
+}
+
+/////////
+// OBJ //
+/////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A run of whole lines. The first pass counts what the chunk holds, from which the prefix sums give it a range of each output array to
+// parse into during the second pass.
+struct ysObjChunk
+{
+    const char* m_begin;
+    const char* m_end;
+    ys_int32 m_positionCount;
+    ys_int32 m_normalCount;
+    ys_int32 m_triangleCount;
+    ys_int32 m_positionBase;
+    ys_int32 m_normalBase;
+    ys_int32 m_triangleBase;
+    bool m_allCornersHaveNormals;
+    bool m_cornerIndicesMatch; // Whether each corner's position and normal indices are the same
+    bool m_failed;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysObjImport
+{
+    ysFloat3* m_positions;
+    ysFloat3* m_normals;
+    ys_int32* m_cornerPositions; // Three per triangle
+    ys_int32* m_cornerNormals;
+    ys_int32 m_positionCount;
+    ys_int32 m_normalCount;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sCountObjChunk(ysObjChunk& chunk, ysObjImport*)
+{
+    ys_int64 positionCount = 0;
+    ys_int64 normalCount = 0;
+    ys_int64 triangleCount = 0;
+    const char* end = chunk.m_end;
+    for (const char* p = chunk.m_begin; p < end; p = sSkipLine(p, end))
+    {
+        p = sSkipSpaces(p, end);
+        if (sHasKeyword(p, end, "v"))
+        {
+            positionCount++;
+        }
+        else if (sHasKeyword(p, end, "vn"))
+        {
+            normalCount++;
+        }
+        else if (sHasKeyword(p, end, "f"))
+        {
+            // Faces are split into fans of triangles
+            ys_int32 cornerCount = 0;
+            p = sSkipSpaces(p + 1, end);
+            while (p < end && *p != '\n')
+            {
+                cornerCount++;
+                while (p < end && *p != '\n' && sIsSpace(*p) == false)
+                {
+                    p++;
+                }
+                p = sSkipSpaces(p, end);
+            }
+            triangleCount += ysMax(cornerCount - 2, 0);
+            if (p == end)
+            {
+                break;
+            }
+        }
+    }
+
+    chunk.m_failed = (positionCount > s_maxElementCount || normalCount > s_maxElementCount || triangleCount > s_maxElementCount);
+    chunk.m_positionCount = ys_int32(positionCount);
+    chunk.m_normalCount = ys_int32(normalCount);
+    chunk.m_triangleCount = ys_int32(triangleCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// OBJ indices start at 1, and count back from the last element seen so far if negative
+static bool sResolveObjIndex(ys_int32* index, ys_int32 elementsSeenCount, ys_int32 elementCount)
+{
+    if (*index > 0)
+    {
+        *index -= 1;
+    }
+    else if (*index < 0)
+    {
+        *index += elementsSeenCount;
+    }
+    else
+    {
+        return false;
+    }
+    return 0 <= *index && *index < elementCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reads a face corner (v, v/vt, v//vn or v/vt/vn). Texture coordinates are skipped over.
+static const char* sParseObjCorner(const char* p, const char* end, ys_int32* position, ys_int32* normal, bool* hasNormal)
+{
+    *hasNormal = false;
+    p = sParseInt(p, end, position);
+    if (p == nullptr || p == end || *p != '/')
+    {
+        return p;
+    }
+
+    p++;
+    if (p < end && *p != '/')
+    {
+        ys_int32 texCoord;
+        p = sParseInt(p, end, &texCoord);
+        if (p == nullptr)
+        {
+            return nullptr;
+        }
+    }
+
+    if (p < end && *p == '/')
+    {
+        p = sParseInt(p + 1, end, normal);
+        *hasNormal = true;
+    }
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sParseObjChunk(ysObjChunk& chunk, ysObjImport* import)
+{
+    ys_int32 positionIdx = chunk.m_positionBase;
+    ys_int32 normalIdx = chunk.m_normalBase;
+    ys_int32* cornerPositions = import->m_cornerPositions + 3 * ys_int64(chunk.m_triangleBase);
+    ys_int32* cornerNormals = import->m_cornerNormals + 3 * ys_int64(chunk.m_triangleBase);
+    ys_int32 cornerIdx = 0;
+    chunk.m_allCornersHaveNormals = true;
+    chunk.m_cornerIndicesMatch = true;
+
+    const char* end = chunk.m_end;
+    for (const char* p = chunk.m_begin; p < end; p = sSkipLine(p, end))
+    {
+        p = sSkipSpaces(p, end);
+        if (sHasKeyword(p, end, "v"))
+        {
+            ys_float32 xyz[3];
+            if (sParseFloat3(p + 1, end, xyz) == nullptr)
+            {
+                chunk.m_failed = true;
+                return;
+            }
+            ysFloat3* position = import->m_positions + positionIdx++;
+            position->x = xyz[0];
+            position->y = xyz[1];
+            position->z = xyz[2];
+        }
+        else if (sHasKeyword(p, end, "vn"))
+        {
+            ys_float32 xyz[3];
+            if (sParseFloat3(p + 2, end, xyz) == nullptr)
+            {
+                chunk.m_failed = true;
+                return;
+            }
+            sSetNormalized(import->m_normals + normalIdx++, xyz[0], xyz[1], xyz[2]);
+        }
+        else if (sHasKeyword(p, end, "f"))
+        {
+            ys_int32 fanPositions[2] = { ys_nullIndex, ys_nullIndex };
+            ys_int32 fanNormals[2] = { ys_nullIndex, ys_nullIndex };
+            ys_int32 faceCornerCount = 0;
+            p = sSkipSpaces(p + 1, end);
+            while (p < end && *p != '\n')
+            {
+                ys_int32 position;
+                ys_int32 normal = ys_nullIndex;
+                bool hasNormal;
+                p = sParseObjCorner(p, end, &position, &normal, &hasNormal);
+                if (p == nullptr ||
+                    sResolveObjIndex(&position, positionIdx, import->m_positionCount) == false ||
+                    (hasNormal && sResolveObjIndex(&normal, normalIdx, import->m_normalCount) == false))
+                {
+                    chunk.m_failed = true;
+                    return;
+                }
+                chunk.m_allCornersHaveNormals = chunk.m_allCornersHaveNormals && hasNormal;
+                chunk.m_cornerIndicesMatch = chunk.m_cornerIndicesMatch && (position == normal);
+
+                if (faceCornerCount >= 2)
+                {
+                    if (cornerIdx + 3 > 3 * chunk.m_triangleCount)
+                    {
+                        chunk.m_failed = true;
+                        return;
+                    }
+                    cornerPositions[cornerIdx + 0] = fanPositions[0];
+                    cornerPositions[cornerIdx + 1] = fanPositions[1];
+                    cornerPositions[cornerIdx + 2] = position;
+                    cornerNormals[cornerIdx + 0] = fanNormals[0];
+                    cornerNormals[cornerIdx + 1] = fanNormals[1];
+                    cornerNormals[cornerIdx + 2] = normal;
+                    cornerIdx += 3;
+                }
+                ys_int32 fanIdx = ysMin(faceCornerCount, 1);
+                fanPositions[fanIdx] = position;
+                fanNormals[fanIdx] = normal;
+                faceCornerCount++;
+                p = sSkipSpaces(p, end);
+            }
+            if (p == end)
+            {
+                break;
+            }
+        }
+    }
+
+    chunk.m_failed = chunk.m_failed || (cornerIdx != 3 * chunk.m_triangleCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool sImportObj(ysMeshDef* mesh, const ysMappedFile& file)
+{
+    // Split the file at line breaks into chunks of about equal size
+    const char* text = reinterpret_cast<const char*>(file.m_data);
+    const char* textEnd = text + file.m_byteCount;
+    ys_int64 maxChunkCount = ys_int64(file.m_byteCount) / s_objChunkByteCount + 1;
+    ysObjChunk* chunks = static_cast<ysObjChunk*>(ysMalloc(sizeof(ysObjChunk) * maxChunkCount));
+    ys_int32 chunkCount = 0;
+    for (const char* p = text; p < textEnd; ++chunkCount)
+    {
+        ysObjChunk* chunk = chunks + chunkCount;
+        ysMemSet(chunk, 0, sizeof(ysObjChunk));
+        chunk->m_begin = p;
+        p = (textEnd - p > s_objChunkByteCount) ? sSkipLine(p + s_objChunkByteCount, textEnd) : textEnd;
+        chunk->m_end = p;
+    }
+
+    ysObjImport import;
+    ysMemSet(&import, 0, sizeof(ysObjImport));
+
+    ysJobSystem* jobSystem = sCreateJobSystem();
+    ysParallelFor(jobSystem, chunks, chunkCount, &import, 2, sCountObjChunk);
+
+    bool failed = false;
+    ys_int64 positionCount = 0;
+    ys_int64 normalCount = 0;
+    ys_int64 triangleCount = 0;
+    for (ys_int32 i = 0; i < chunkCount; ++i)
+    {
+        ysObjChunk* chunk = chunks + i;
+        chunk->m_positionBase = ys_int32(positionCount);
+        chunk->m_normalBase = ys_int32(normalCount);
+        chunk->m_triangleBase = ys_int32(triangleCount);
+        positionCount += chunk->m_positionCount;
+        normalCount += chunk->m_normalCount;
+        triangleCount += chunk->m_triangleCount;
+        failed = failed || chunk->m_failed;
+        failed = failed || positionCount > s_maxElementCount || normalCount > s_maxElementCount || 3 * triangleCount > s_maxElementCount;
+    }
+    failed = failed || (positionCount == 0) || (triangleCount == 0);
+
+    if (failed == false)
+    {
+        import.m_positionCount = ys_int32(positionCount);
+        import.m_normalCount = ys_int32(normalCount);
+        import.m_positions = static_cast<ysFloat3*>(ysMalloc(sizeof(ysFloat3) * positionCount));
+        import.m_normals = static_cast<ysFloat3*>(ysMalloc(sizeof(ysFloat3) * normalCount));
+        import.m_cornerPositions = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * 3 * triangleCount));
+        import.m_cornerNormals = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * 3 * triangleCount));
+        ysParallelFor(jobSystem, chunks, chunkCount, &import, 2, sParseObjChunk);
+    }
+    ysJobSystem_Destroy(jobSystem);
+
+    bool allCornersHaveNormals = (normalCount > 0);
+    bool cornerIndicesMatch = true;
+    for (ys_int32 i = 0; i < chunkCount && failed == false; ++i)
+    {
+        failed = chunks[i].m_failed;
+        allCornersHaveNormals = allCornersHaveNormals && chunks[i].m_allCornersHaveNormals;
+        cornerIndicesMatch = cornerIndicesMatch && chunks[i].m_cornerIndicesMatch;
+    }
+    ysFree(chunks);
+
+    if (failed)
+    {
+        ysFree(import.m_positions);
+        ysFree(import.m_normals);
+        ysFree(import.m_cornerPositions);
+        ysFree(import.m_cornerNormals);
+        return false;
+    }
+
+    // Normals are all or nothing, so faces without them anywhere leave the whole mesh with face normals
+    ys_int32 cornerCount = 3 * ys_int32(triangleCount);
+    if (allCornersHaveNormals == false)
+    {
+        mesh->m_positions = import.m_positions;
+        mesh->m_normals = nullptr;
+        mesh->m_vertexCount = import.m_positionCount;
+        ysFree(import.m_normals);
+    }
+    else if (cornerIndicesMatch && positionCount == normalCount)
+    {
+        mesh->m_positions = import.m_positions;
+        mesh->m_normals = import.m_normals;
+        mesh->m_vertexCount = import.m_positionCount;
+    }
+    else
+    {
+        sWeldCorners(mesh, import.m_positions, import.m_positionCount, import.m_normals, import.m_cornerPositions, import.m_cornerNormals,
+            cornerCount);
+        ysFree(import.m_positions);
+        ysFree(import.m_normals);
+    }
+    ysFree(import.m_cornerNormals);
+
+    mesh->m_positionStride = 0;
+    mesh->m_normalStride = 0;
+    mesh->m_indices = import.m_cornerPositions;
+    mesh->m_triangleCount = ys_int32(triangleCount);
+    return true;
+}
+
+/////////
+// PLY //
+/////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysPlyProperty
+{
+    enum Type
+    {
+        e_int8,
+        e_uint8,
+        e_int16,
+        e_uint16,
+        e_int32,
+        e_uint32,
+        e_float32,
+        e_float64,
+        e_invalid,
+    };
+
+    static Type TypeFromName(const char* name, ys_int32 nameLength);
+    static ys_int32 TypeSize(Type);
+
+    Type m_type; // Of the entries, for lists
+    Type m_countType; // Lists only
+    bool m_isList;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysPlyProperty::Type ysPlyProperty::TypeFromName(const char* name, ys_int32 nameLength)
+{
+    struct NamedType
+    {
+        const char* m_name;
+        Type m_type;
+    };
+    static const NamedType s_namedTypes[] =
+    {
+        { "char", e_int8 }, { "int8", e_int8 }, { "uchar", e_uint8 }, { "uint8", e_uint8 },
+        { "short", e_int16 }, { "int16", e_int16 }, { "ushort", e_uint16 }, { "uint16", e_uint16 },
+        { "int", e_int32 }, { "int32", e_int32 }, { "uint", e_uint32 }, { "uint32", e_uint32 },
+        { "float", e_float32 }, { "float32", e_float32 }, { "double", e_float64 }, { "float64", e_float64 },
+    };
+    for (const NamedType& namedType : s_namedTypes)
+    {
+        if (ys_int32(strlen(namedType.m_name)) == nameLength && memcmp(namedType.m_name, name, nameLength) == 0)
+        {
+            return namedType.m_type;
+        }
+    }
+    return e_invalid;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_int32 ysPlyProperty::TypeSize(Type type)
+{
+    switch (type)
+    {
+        case e_int8:
+        case e_uint8:
+            return 1;
+        case e_int16:
+        case e_uint16:
+            return 2;
+        case e_int32:
+        case e_uint32:
+        case e_float32:
+            return 4;
+        case e_float64:
+            return 8;
+        default:
+            ysAssert(false);
+            return 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ys_float64 sReadPlyScalar(const ys_uint8* src, ysPlyProperty::Type type, bool swapBytes)
+{
+    alignas(8) ys_uint8 bytes[8];
+    ys_int32 size = ysPlyProperty::TypeSize(type);
+    for (ys_int32 i = 0; i < size; ++i)
+    {
+        bytes[i] = swapBytes ? src[size - 1 - i] : src[i];
+    }
+
+    switch (type)
+    {
+        case ysPlyProperty::e_int8:
+            return *reinterpret_cast<const ys_int8*>(bytes);
+        case ysPlyProperty::e_uint8:
+            return *reinterpret_cast<const ys_uint8*>(bytes);
+        case ysPlyProperty::e_int16:
+            return *reinterpret_cast<const ys_int16*>(bytes);
+        case ysPlyProperty::e_uint16:
+            return *reinterpret_cast<const ys_uint16*>(bytes);
+        case ysPlyProperty::e_int32:
+            return *reinterpret_cast<const ys_int32*>(bytes);
+        case ysPlyProperty::e_uint32:
+            return *reinterpret_cast<const ys_uint32*>(bytes);
+        case ysPlyProperty::e_float32:
+            return *reinterpret_cast<const ys_float32*>(bytes);
+        case ysPlyProperty::e_float64:
+            return *reinterpret_cast<const ys_float64*>(bytes);
+        default:
+            ysAssert(false);
+            return 0.0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Where everything of interest lies in the file, as described by its header
+struct ysPlyLayout
+{
+    enum VertexProperty
+    {
+        e_x,
+        e_y,
+        e_z,
+        e_nx,
+        e_ny,
+        e_nz,
+        e_vertexPropertyCount,
+    };
+
+    const ys_uint8* m_vertices;
+    ys_int32 m_vertexCount;
+    ys_int32 m_vertexStride;
+    ys_int32 m_vertexOffsets[e_vertexPropertyCount]; // ys_nullIndex if absent
+    ysPlyProperty::Type m_vertexTypes[e_vertexPropertyCount];
+
+    // Each face is a list of vertex indices, in between properties of fixed size that are skipped over
+    const ys_uint8* m_faces;
+    const ys_uint8* m_facesEnd;
+    ys_int32 m_faceCount;
+    ys_int32 m_faceBytesBeforeList;
+    ys_int32 m_faceBytesAfterList;
+    ysPlyProperty m_faceList;
+
+    bool m_swapBytes;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns the token at p and its length, and advances p past it. Tokens never span lines.
+static const char* sNextPlyToken(const char** p, const char* end, ys_int32* length)
+{
+    const char* token = sSkipSpaces(*p, end);
+    const char* tokenEnd = token;
+    while (tokenEnd < end && *tokenEnd != '\n' && sIsSpace(*tokenEnd) == false)
+    {
+        tokenEnd++;
+    }
+    *p = tokenEnd;
+    *length = ys_int32(tokenEnd - token);
+    return token;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool sTokenIs(const char* token, ys_int32 length, const char* word)
+{
+    return ys_int32(strlen(word)) == length && memcmp(token, word, length) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Only the vertex and face elements are read. Other elements may come before them as long as they are of fixed size, so as to be skipped.
+static bool sParsePlyHeader(ysPlyLayout* layout, const ysMappedFile& file)
+{
+    const char* text = reinterpret_cast<const char*>(file.m_data);
+    const char* end = text + file.m_byteCount;
+    ys_int32 length;
+    const char* token;
+
+    const char* p = text;
+    token = sNextPlyToken(&p, end, &length);
+    if (sTokenIs(token, length, "ply") == false)
+    {
+        return false;
+    }
+
+    // The element being described, and where its data starts (known until an element of varying size is passed)
+    enum Element
+    {
+        e_vertexElement,
+        e_faceElement,
+        e_otherElement,
+        e_noElement,
+    };
+    Element element = e_noElement;
+    ys_int64 elementCount = 0;
+    ys_int64 elementStride = 0;
+    bool elementHasList = false;
+    ys_int64 dataOffset = 0;
+    bool dataOffsetKnown = true;
+    ys_int64 vertexOffset = -1;
+    ys_int64 faceOffset = -1;
+    bool faceListFound = false;
+    bool headerEnded = false;
+    bool binary = false;
+
+    for (ys_int32 i = 0; i < ysPlyLayout::e_vertexPropertyCount; ++i)
+    {
+        layout->m_vertexOffsets[i] = ys_nullIndex;
+        layout->m_vertexTypes[i] = ysPlyProperty::e_invalid;
+    }
+    layout->m_vertexCount = 0;
+    layout->m_faceCount = 0;
+    layout->m_faceBytesBeforeList = 0;
+    layout->m_faceBytesAfterList = 0;
+    layout->m_swapBytes = false;
+
+    // Closes off the element being described, now that all of its properties are known
+    auto EndElement = [&]()
+    {
+        switch (element)
+        {
+            case e_vertexElement:
+                if (elementHasList || dataOffsetKnown == false)
+                {
+                    return false;
+                }
+                vertexOffset = dataOffset;
+                layout->m_vertexCount = ys_int32(elementCount);
+                layout->m_vertexStride = ys_int32(elementStride);
+                break;
+            case e_faceElement:
+                if (faceListFound == false || dataOffsetKnown == false)
+                {
+                    return false;
+                }
+                faceOffset = dataOffset;
+                layout->m_faceCount = ys_int32(elementCount);
+                break;
+            default:
+                break;
+        }
+        dataOffset += elementCount * elementStride;
+        dataOffsetKnown = dataOffsetKnown && (elementHasList == false);
+        return true;
+    };
+
+    for (p = sSkipLine(p, end); p < end && headerEnded == false; p = sSkipLine(p, end))
+    {
+        token = sNextPlyToken(&p, end, &length);
+        if (sTokenIs(token, length, "format"))
+        {
+            token = sNextPlyToken(&p, end, &length);
+            binary = sTokenIs(token, length, "binary_little_endian") || sTokenIs(token, length, "binary_big_endian");
+            layout->m_swapBytes = sTokenIs(token, length, "binary_big_endian");
+        }
+        else if (sTokenIs(token, length, "element"))
+        {
+            if (EndElement() == false)
+            {
+                return false;
+            }
+
+            token = sNextPlyToken(&p, end, &length);
+            element = e_otherElement;
+            if (sTokenIs(token, length, "vertex"))
+            {
+                element = e_vertexElement;
+            }
+            else if (sTokenIs(token, length, "face"))
+            {
+                element = e_faceElement;
+            }
+            ys_int32 count;
+            if (sParseInt(sSkipSpaces(p, end), end, &count) == nullptr || count < 0)
+            {
+                return false;
+            }
+            elementCount = count;
+            elementStride = 0;
+            elementHasList = false;
+        }
+        else if (sTokenIs(token, length, "property"))
+        {
+            ysPlyProperty property;
+            property.m_isList = false;
+            property.m_countType = ysPlyProperty::e_invalid;
+            token = sNextPlyToken(&p, end, &length);
+            if (sTokenIs(token, length, "list"))
+            {
+                property.m_isList = true;
+                token = sNextPlyToken(&p, end, &length);
+                property.m_countType = ysPlyProperty::TypeFromName(token, length);
+                token = sNextPlyToken(&p, end, &length);
+                if (property.m_countType == ysPlyProperty::e_invalid || property.m_countType == ysPlyProperty::e_float32 ||
+                    property.m_countType == ysPlyProperty::e_float64)
+                {
+                    return false;
+                }
+            }
+            property.m_type = ysPlyProperty::TypeFromName(token, length);
+            if (property.m_type == ysPlyProperty::e_invalid || element == e_noElement)
+            {
+                return false;
+            }
+            const char* name = sNextPlyToken(&p, end, &length);
+
+            if (element == e_vertexElement && property.m_isList == false)
+            {
+                static const char* s_vertexPropertyNames[ysPlyLayout::e_vertexPropertyCount] = { "x", "y", "z", "nx", "ny", "nz" };
+                for (ys_int32 i = 0; i < ysPlyLayout::e_vertexPropertyCount; ++i)
+                {
+                    if (sTokenIs(name, length, s_vertexPropertyNames[i]))
+                    {
+                        layout->m_vertexOffsets[i] = ys_int32(elementStride);
+                        layout->m_vertexTypes[i] = property.m_type;
+                    }
+                }
+            }
+
+            if (element == e_faceElement)
+            {
+                if (property.m_isList && (sTokenIs(name, length, "vertex_indices") || sTokenIs(name, length, "vertex_index")))
+                {
+                    if (faceListFound || property.m_type == ysPlyProperty::e_float32 || property.m_type == ysPlyProperty::e_float64)
+                    {
+                        return false;
+                    }
+                    layout->m_faceList = property;
+                    layout->m_faceBytesBeforeList = ys_int32(elementStride);
+                    faceListFound = true;
+                }
+                else if (property.m_isList)
+                {
+                    // Only the one list can be skipped over without reading each face's count
+                    return false;
+                }
+                else if (faceListFound)
+                {
+                    layout->m_faceBytesAfterList += ysPlyProperty::TypeSize(property.m_type);
+                }
+            }
+
+            if (property.m_isList)
+            {
+                elementHasList = true;
+            }
+            else
+            {
+                elementStride += ysPlyProperty::TypeSize(property.m_type);
+            }
+        }
+        else if (sTokenIs(token, length, "end_header"))
+        {
+            if (EndElement() == false)
+            {
+                return false;
+            }
+            headerEnded = true;
+        }
+    }
+
+    // ASCII files are not supported. They are slow to read in any case, and should be converted to binary.
+    if (headerEnded == false || binary == false || vertexOffset < 0 || faceOffset < 0)
+    {
+        return false;
+    }
+
+    for (ys_int32 i = ysPlyLayout::e_x; i <= ysPlyLayout::e_z; ++i)
+    {
+        if (layout->m_vertexOffsets[i] == ys_nullIndex)
+        {
+            return false;
+        }
+    }
+
+    ys_int64 headerByteCount = reinterpret_cast<const ys_uint8*>(p) - file.m_data;
+    ys_int64 vertexByteCount = ys_int64(layout->m_vertexCount) * layout->m_vertexStride;
+    ys_int64 fileByteCount = ys_int64(file.m_byteCount);
+    if (headerByteCount + vertexOffset + vertexByteCount > fileByteCount || headerByteCount + faceOffset > fileByteCount)
+    {
+        return false;
+    }
+    layout->m_vertices = file.m_data + headerByteCount + vertexOffset;
+    layout->m_faces = file.m_data + headerByteCount + faceOffset;
+    layout->m_facesEnd = file.m_data + file.m_byteCount;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A range of vertices or faces
+struct ysPlyChunk
+{
+    ys_int32 m_begin;
+    ys_int32 m_count;
+    bool m_failed;
+    bool m_notTriangles; // A face was found with other than three vertices
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysPlyImport
+{
+    ysPlyLayout m_layout;
+    ysFloat3* m_positions;
+    ysFloat3* m_normals;
+    ys_int32* m_indices;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sReadPlyVertices(ysPlyChunk& chunk, ysPlyImport* import)
+{
+    const ysPlyLayout& layout = import->m_layout;
+    ys_float32 values[ysPlyLayout::e_vertexPropertyCount];
+    for (ys_int32 i = chunk.m_begin; i < chunk.m_begin + chunk.m_count; ++i)
+    {
+        const ys_uint8* vertex = layout.m_vertices + ys_int64(layout.m_vertexStride) * i;
+        for (ys_int32 j = 0; j < ysPlyLayout::e_vertexPropertyCount; ++j)
+        {
+            values[j] = 0.0f;
+            if (layout.m_vertexOffsets[j] != ys_nullIndex)
+            {
+                values[j] = ys_float32(sReadPlyScalar(vertex + layout.m_vertexOffsets[j], layout.m_vertexTypes[j], layout.m_swapBytes));
+            }
+        }
+
+        ysFloat3* position = import->m_positions + i;
+        position->x = values[ysPlyLayout::e_x];
+        position->y = values[ysPlyLayout::e_y];
+        position->z = values[ysPlyLayout::e_z];
+        if (import->m_normals != nullptr)
+        {
+            sSetNormalized(import->m_normals + i, values[ysPlyLayout::e_nx], values[ysPlyLayout::e_ny], values[ysPlyLayout::e_nz]);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool sReadPlyIndex(ys_int32* dst, const ys_uint8* src, const ysPlyLayout& layout)
+{
+    ys_float64 index = sReadPlyScalar(src, layout.m_faceList.m_type, layout.m_swapBytes);
+    *dst = ys_int32(index);
+    return 0.0 <= index && index < ys_float64(layout.m_vertexCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Assumes that every face is a triangle, which puts the faces at a fixed stride. Finding otherwise sends the import down the serial path.
+static void sReadPlyTriangles(ysPlyChunk& chunk, ysPlyImport* import)
+{
+    const ysPlyLayout& layout = import->m_layout;
+    ys_int32 countSize = ysPlyProperty::TypeSize(layout.m_faceList.m_countType);
+    ys_int32 indexSize = ysPlyProperty::TypeSize(layout.m_faceList.m_type);
+    ys_int64 stride = layout.m_faceBytesBeforeList + countSize + 3 * indexSize + layout.m_faceBytesAfterList;
+    for (ys_int32 i = chunk.m_begin; i < chunk.m_begin + chunk.m_count; ++i)
+    {
+        const ys_uint8* list = layout.m_faces + stride * i + layout.m_faceBytesBeforeList;
+        if (sReadPlyScalar(list, layout.m_faceList.m_countType, layout.m_swapBytes) != 3.0)
+        {
+            chunk.m_notTriangles = true;
+            return;
+        }
+
+        ys_int32* indices = import->m_indices + 3 * ys_int64(i);
+        for (ys_int32 j = 0; j < 3; ++j)
+        {
+            if (sReadPlyIndex(indices + j, list + countSize + j * indexSize, layout) == false)
+            {
+                chunk.m_failed = true;
+                return;
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// For faces of any size, split into fans of triangles. Each face must be visited to find the next, so this runs serially: once to count
+// the triangles and once more to read them. If indices is null, only the count is taken.
+static bool sReadPlyPolygons(ys_int32* indices, ys_int64* triangleCount, const ysPlyLayout& layout)
+{
+    ys_int32 countSize = ysPlyProperty::TypeSize(layout.m_faceList.m_countType);
+    ys_int32 indexSize = ysPlyProperty::TypeSize(layout.m_faceList.m_type);
+    const ys_uint8* p = layout.m_faces;
+    *triangleCount = 0;
+    for (ys_int32 i = 0; i < layout.m_faceCount; ++i)
+    {
+        p += layout.m_faceBytesBeforeList;
+        if (layout.m_facesEnd - p < countSize)
+        {
+            return false;
+        }
+        ys_int64 cornerCount = ys_int64(sReadPlyScalar(p, layout.m_faceList.m_countType, layout.m_swapBytes));
+        p += countSize;
+        if (cornerCount < 0 || layout.m_facesEnd - p < cornerCount * indexSize + layout.m_faceBytesAfterList)
+        {
+            return false;
+        }
+
+        if (indices != nullptr)
+        {
+            for (ys_int64 j = 2; j < cornerCount; ++j)
+            {
+                ys_int32* triangle = indices + 3 * *triangleCount + 3 * (j - 2);
+                if (sReadPlyIndex(triangle + 0, p, layout) == false ||
+                    sReadPlyIndex(triangle + 1, p + (j - 1) * indexSize, layout) == false ||
+                    sReadPlyIndex(triangle + 2, p + j * indexSize, layout) == false)
+                {
+                    return false;
+                }
+            }
+        }
+        *triangleCount += ysMax(cornerCount - 2, ys_int64(0));
+        if (3 * *triangleCount > s_maxElementCount)
+        {
+            return false;
+        }
+        p += cornerCount * indexSize + layout.m_faceBytesAfterList;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ysPlyChunk* sCreatePlyChunks(ys_int32 elementCount, ys_int32* chunkCount)
+{
+    *chunkCount = (elementCount + s_plyChunkElementCount - 1) / s_plyChunkElementCount;
+    ysPlyChunk* chunks = static_cast<ysPlyChunk*>(ysMalloc(sizeof(ysPlyChunk) * *chunkCount));
+    for (ys_int32 i = 0; i < *chunkCount; ++i)
+    {
+        chunks[i].m_begin = i * s_plyChunkElementCount;
+        chunks[i].m_count = ysMin(s_plyChunkElementCount, elementCount - chunks[i].m_begin);
+        chunks[i].m_failed = false;
+        chunks[i].m_notTriangles = false;
+    }
+    return chunks;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool sImportPly(ysMeshDef* mesh, const ysMappedFile& file)
+{
+    ysPlyImport import;
+    import.m_indices = nullptr;
+    if (sParsePlyHeader(&import.m_layout, file) == false)
+    {
+        return false;
+    }
+
+    const ysPlyLayout& layout = import.m_layout;
+    if (layout.m_vertexCount == 0 || layout.m_faceCount == 0 || 3 * ys_int64(layout.m_faceCount) > s_maxElementCount)
+    {
+        return false;
+    }
+
+    bool hasNormals = true;
+    for (ys_int32 i = ysPlyLayout::e_nx; i <= ysPlyLayout::e_nz; ++i)
+    {
+        hasNormals = hasNormals && (layout.m_vertexOffsets[i] != ys_nullIndex);
+    }
+
+    import.m_positions = static_cast<ysFloat3*>(ysMalloc(sizeof(ysFloat3) * layout.m_vertexCount));
+    import.m_normals = hasNormals ? static_cast<ysFloat3*>(ysMalloc(sizeof(ysFloat3) * layout.m_vertexCount)) : nullptr;
+
+    ysJobSystem* jobSystem = sCreateJobSystem();
+
+    ys_int32 vertexChunkCount;
+    ysPlyChunk* vertexChunks = sCreatePlyChunks(layout.m_vertexCount, &vertexChunkCount);
+    ysParallelFor(jobSystem, vertexChunks, vertexChunkCount, &import, 2, sReadPlyVertices);
+    ysFree(vertexChunks);
+
+    // Triangle meshes are the norm, and can be read in parallel if the file is long enough for the faces to all be triangles
+    bool failed = false;
+    bool notTriangles = true;
+    ys_int64 triangleCount = layout.m_faceCount;
+    ys_int64 triangleStride = layout.m_faceBytesBeforeList + ysPlyProperty::TypeSize(layout.m_faceList.m_countType) +
+        3 * ysPlyProperty::TypeSize(layout.m_faceList.m_type) + layout.m_faceBytesAfterList;
+    if (triangleStride * layout.m_faceCount <= layout.m_facesEnd - layout.m_faces)
+    {
+        import.m_indices = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * 3 * triangleCount));
+        ys_int32 faceChunkCount;
+        ysPlyChunk* faceChunks = sCreatePlyChunks(layout.m_faceCount, &faceChunkCount);
+        ysParallelFor(jobSystem, faceChunks, faceChunkCount, &import, 2, sReadPlyTriangles);
+        notTriangles = false;
+        for (ys_int32 i = 0; i < faceChunkCount; ++i)
+        {
+            failed = failed || faceChunks[i].m_failed;
+            notTriangles = notTriangles || faceChunks[i].m_notTriangles;
+        }
+        ysFree(faceChunks);
+        if (notTriangles)
+        {
+            ysSafeFree(import.m_indices);
+        }
+    }
+    ysJobSystem_Destroy(jobSystem);
+
+    if (notTriangles && failed == false)
+    {
+        failed = (sReadPlyPolygons(nullptr, &triangleCount, layout) == false) || triangleCount == 0;
+        if (failed == false)
+        {
+            import.m_indices = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * 3 * triangleCount));
+            failed = (sReadPlyPolygons(import.m_indices, &triangleCount, layout) == false);
+        }
+    }
+
+    if (failed)
+    {
+        ysFree(import.m_positions);
+        ysFree(import.m_normals);
+        ysFree(import.m_indices);
+        return false;
+    }
+
+    mesh->m_positions = import.m_positions;
+    mesh->m_positionStride = 0;
+    mesh->m_normals = import.m_normals;
+    mesh->m_normalStride = 0;
+    mesh->m_vertexCount = layout.m_vertexCount;
+    mesh->m_indices = import.m_indices;
+    mesh->m_triangleCount = ys_int32(triangleCount);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool sHasExtension(const char* path, const char* extension)
+{
+    size_t pathLength = strlen(path);
+    size_t extensionLength = strlen(extension);
+    if (pathLength < extensionLength)
+    {
+        return false;
+    }
+
+    const char* pathExtension = path + pathLength - extensionLength;
+    for (size_t i = 0; i < extensionLength; ++i)
+    {
+        char c = pathExtension[i];
+        c = ('A' <= c && c <= 'Z') ? char(c - 'A' + 'a') : c;
+        if (c != extension[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysMesh_Import(ysMeshDef* mesh, const char* path)
+{
+    bool isObj = sHasExtension(path, ".obj");
+    bool isPly = sHasExtension(path, ".ply");
+    if (isObj == false && isPly == false)
+    {
+        return false;
+    }
+
+    // Mapping the file lets the jobs read their parts of it straight from the page cache, with no copies in between
+    ysMappedFile file;
+    if (file.Open(path) == false)
+    {
+        return false;
+    }
+
+    ysMeshDef imported;
+    bool success = isObj ? sImportObj(&imported, file) : sImportPly(&imported, file);
+    file.Close();
+    if (success == false)
+    {
+        return false;
+    }
+
+    mesh->m_positions = imported.m_positions;
+    mesh->m_positionStride = imported.m_positionStride;
+    mesh->m_normals = imported.m_normals;
+    mesh->m_normalStride = imported.m_normalStride;
+    mesh->m_vertexCount = imported.m_vertexCount;
+    mesh->m_indices = imported.m_indices;
+    mesh->m_triangleCount = imported.m_triangleCount;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysMesh_FreeImported(ysMeshDef* mesh)
+{
+    ysFree(const_cast<ysFloat3*>(mesh->m_positions));
+    ysFree(const_cast<ysFloat3*>(mesh->m_normals));
+    ysFree(const_cast<ys_int32*>(mesh->m_indices));
+    mesh->m_positions = nullptr;
+    mesh->m_normals = nullptr;
+    mesh->m_indices = nullptr;
+    mesh->m_vertexCount = 0;
+    mesh->m_triangleCount = 0;
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "YoshiPBR/ysMeshInstance.h"
+#include "YoshiPBR/ysShape.h"
+#include "YoshiPBR/ysRay.h"
+#include "scene/ysScene.h"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysRayCastInput ysMeshInstance::ToMeshSpace(const ysRayCastInput& input) const
+{
+    ysRayCastInput local;
+    local.m_origin = ysInvMul(m_xf, input.m_origin);
+    local.m_direction = ysInvRotate(m_xf.q, input.m_direction);
+    local.m_maxLambda = input.m_maxLambda;
+    return local;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysMeshInstance::ToWorldSpace(ysRayCastOutput* output) const
+{
+    output->m_hitPoint = ysMul(m_xf, output->m_hitPoint);
+    output->m_hitNormal = ysRotate(m_xf.q, output->m_hitNormal);
+    output->m_hitTangent = ysRotate(m_xf.q, output->m_hitTangent);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysAABB ysMeshInstance::ComputeAABB(const ysScene* scene) const
+{
+    // Bound the corners of the mesh's own box
+    const ysInstancedMesh* instancedMesh = scene->m_instancedMeshes + m_meshIndex;
+    ysAssert(instancedMesh->m_bvh.m_nodeCount > 0);
+    const ysAABB& localAABB = instancedMesh->m_bvh.m_nodes[0].m_aabb;
+    ysAABB aabb;
+    aabb.SetInvalid();
+    for (ys_int32 i = 0; i < 8; ++i)
+    {
+        ysVec4 corner = ysVecSet(
+            (i & 1) ? localAABB.m_max.x : localAABB.m_min.x,
+            (i & 2) ? localAABB.m_max.y : localAABB.m_min.y,
+            (i & 4) ? localAABB.m_max.z : localAABB.m_min.z);
+        corner = ysMul(m_xf, corner);
+        aabb.m_min = ysMin(aabb.m_min, corner);
+        aabb.m_max = ysMax(aabb.m_max, corner);
+    }
+    return aabb;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysMeshInstance::ComputeSurfaceArea(const ysScene* scene) const
+{
+    return scene->m_instancedMeshes[m_meshIndex].m_surfaceArea;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysMeshInstance::RayCast(const ysScene* scene, ysRayCastOutput* output, const ysRayCastInput& input) const
+{
+    const ysInstancedMesh* instancedMesh = scene->m_instancedMeshes + m_meshIndex;
+    bool hit = instancedMesh->m_bvh.RayCastClosest(&instancedMesh->m_mesh, output, ToMeshSpace(input));
+    if (hit)
+    {
+        ToWorldSpace(output);
+    }
+    return hit;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysMeshInstance::GenerateRandomSurfacePoint(const ysScene* scene, ysSurfacePoint* point, ys_float32* probabilityDensity) const
+{
+    // Picking the triangle in proportion to its area, and then a point uniformly on the triangle, picks points uniformly on the instance
+    const ysInstancedMesh* instancedMesh = scene->m_instancedMeshes + m_meshIndex;
+    const ysMesh* mesh = &instancedMesh->m_mesh;
+    const ys_float32* cdf = instancedMesh->m_areaCDF;
+    ys_float32 u = ysRandom(0.0f, cdf[mesh->m_triangleCount - 1]);
+    ys_int32 triangleIdx = ys_int32(std::upper_bound(cdf, cdf + mesh->m_triangleCount, u) - cdf);
+    triangleIdx = ysMin(triangleIdx, mesh->m_triangleCount - 1);
+
+    ys_float32 triangleProbabilityDensity;
+    mesh->GenerateRandomSurfacePoint(triangleIdx, point, &triangleProbabilityDensity);
+    point->m_point = ysMul(m_xf, point->m_point);
+    point->m_normal = ysRotate(m_xf.q, point->m_normal);
+    point->m_tangent = ysRotate(m_xf.q, point->m_tangent);
+    point->m_primitiveIndex = triangleIdx;
+    *probabilityDensity = 1.0f / instancedMesh->m_surfaceArea;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysMeshInstance::ProbabilityDensityForGeneratedPoint(const ysScene* scene, const ysVec4&) const
+{
+    return 1.0f / scene->m_instancedMeshes[m_meshIndex].m_surfaceArea;
+}
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "YoshiPBR/ysShape.h"
 #include "YoshiPBR/ysEllipsoid.h"
+#include "YoshiPBR/ysMesh.h"
+#include "YoshiPBR/ysMeshInstance.h"
+#include "YoshiPBR/ysRay.h"
 #include "YoshiPBR/ysTriangle.h"
 #include "scene/ysScene.h"
 
@@ -14,6 +17,16 @@ ysAABB ysShape::ComputeAABB(const ysScene* scene) const
             const ysTriangle& triangle = scene->m_triangles[m_typeIndex];
             return triangle.ComputeAABB();
         }
+        case Type::e_meshTriangle:
+        {
+            const ysMesh& mesh = scene->m_meshes[m_typeIndex];
+            return mesh.ComputeAABB(m_primitiveIndex);
+        }
+        case Type::e_meshInstance:
+        {
+            const ysMeshInstance& instance = scene->m_meshInstances[m_typeIndex];
+            return instance.ComputeAABB(scene);
+        }
         case Type::e_ellipsoid:
         {
             const ysEllipsoid& ellipsoid = scene->m_ellipsoids[m_typeIndex];
@@ -29,10 +42,43 @@ ysAABB ysShape::ComputeAABB(const ysScene* scene) const
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysShape::ComputeSurfaceArea(const ysScene* scene) const
+{
+    switch (m_type)
+    {
+        case Type::e_triangle:
+        {
+            const ysTriangle& triangle = scene->m_triangles[m_typeIndex];
+            return triangle.ComputeSurfaceArea();
+        }
+        case Type::e_meshTriangle:
+        {
+            const ysMesh& mesh = scene->m_meshes[m_typeIndex];
+            return mesh.ComputeSurfaceArea(m_primitiveIndex);
+        }
+        case Type::e_meshInstance:
+        {
+            const ysMeshInstance& instance = scene->m_meshInstances[m_typeIndex];
+            return instance.ComputeSurfaceArea(scene);
+        }
+        case Type::e_ellipsoid:
+        {
+            const ysEllipsoid& ellipsoid = scene->m_ellipsoids[m_typeIndex];
+            return ellipsoid.ComputeSurfaceArea();
+        }
+        default:
+            ysAssert(false);
+            return 0.0f;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool ysShape::RayCast(const ysScene* scene, ysRayCastOutput* output, const ysRayCastInput& input) const
 {
+    output->m_primitiveIndex = ys_nullIndex;
     switch (m_type)
     {
         case Type::e_triangle:
@@ -40,6 +86,16 @@ bool ysShape::RayCast(const ysScene* scene, ysRayCastOutput* output, const ysRay
             const ysTriangle& triangle = scene->m_triangles[m_typeIndex];
             return triangle.RayCast(output, input);
         }
+        case Type::e_meshTriangle:
+        {
+            const ysMesh& mesh = scene->m_meshes[m_typeIndex];
+            return mesh.RayCast(m_primitiveIndex, output, input);
+        }
+        case Type::e_meshInstance:
+        {
+            const ysMeshInstance& instance = scene->m_meshInstances[m_typeIndex];
+            return instance.RayCast(scene, output, input);
+        }
         case Type::e_ellipsoid:
         {
             const ysEllipsoid& ellipsoid = scene->m_ellipsoids[m_typeIndex];
@@ -55,6 +111,7 @@ bool ysShape::RayCast(const ysScene* scene, ysRayCastOutput* output, const ysRay
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void ysShape::GenerateRandomSurfacePoint(const ysScene* scene, ysSurfacePoint* point, ys_float32* probabilityDensity) const
 {
+    point->m_primitiveIndex = ys_nullIndex;
     switch (m_type)
     {
         case Type::e_triangle:
@@ -63,6 +120,18 @@ void ysShape::GenerateRandomSurfacePoint(const ysScene* scene, ysSurfacePoint* p
             triangle.GenerateRandomSurfacePoint(point, probabilityDensity);
             break;
         }
+        case Type::e_meshTriangle:
+        {
+            const ysMesh& mesh = scene->m_meshes[m_typeIndex];
+            mesh.GenerateRandomSurfacePoint(m_primitiveIndex, point, probabilityDensity);
+            break;
+        }
+        case Type::e_meshInstance:
+        {
+            const ysMeshInstance& instance = scene->m_meshInstances[m_typeIndex];
+            instance.GenerateRandomSurfacePoint(scene, point, probabilityDensity);
+            break;
+        }
         case Type::e_ellipsoid:
         {
             const ysEllipsoid& ellipsoid = scene->m_ellipsoids[m_typeIndex];
@@ -88,6 +157,18 @@ ys_float32 ysShape::ProbabilityDensityForGeneratedPoint(const ysScene* scene, co
             probDens = triangle.ProbabilityDensityForGeneratedPoint(point);
             break;
         }
+        case Type::e_meshTriangle:
+        {
+            const ysMesh& mesh = scene->m_meshes[m_typeIndex];
+            probDens = mesh.ProbabilityDensityForGeneratedPoint(m_primitiveIndex, point);
+            break;
+        }
+        case Type::e_meshInstance:
+        {
+            const ysMeshInstance& instance = scene->m_meshInstances[m_typeIndex];
+            probDens = instance.ProbabilityDensityForGeneratedPoint(scene, point);
+            break;
+        }
         case Type::e_ellipsoid:
         {
             const ysEllipsoid& ellipsoid = scene->m_ellipsoids[m_typeIndex];
@@ -12,6 +12,14 @@ ysAABB ysTriangle::ComputeAABB() const
     return aabb;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysTriangle::ComputeSurfaceArea() const
+{
+    ys_float32 area = 0.5f * ysLength3(ysCross(m_v[1] - m_v[0], m_v[2] - m_v[0]));
+    return m_twoSided ? 2.0f * area : area;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool ysTriangle::RayCast(ysRayCastOutput* output, const ysRayCastInput& input) const
@@ -0,0 +1,437 @@
+#include "ysLightBVH.h"
+#include "light/ysLight.h"
+#include "light/ysLightPoint.h"
+#include "mat/emissive/ysEmissiveMaterial.h"
+#include "scene/ysScene.h"
+#include "YoshiPBR/ysEllipsoid.h"
+#include "YoshiPBR/ysMesh.h"
+#include "YoshiPBR/ysShape.h"
+#include "YoshiPBR/ysTriangle.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ys_float32 sScalarPower(const ysVec4& rgb)
+{
+    return (rgb.x + rgb.y + rgb.z) * (1.0f / 3.0f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// cos(max(0, a - b)) and sin(max(0, a - b)) given the sines and cosines of angles a and b in [0, pi]
+static ys_float32 sCosSubClamped(ys_float32 sinA, ys_float32 cosA, ys_float32 sinB, ys_float32 cosB)
+{
+    if (cosA > cosB)
+    {
+        return 1.0f;
+    }
+    return cosA * cosB + sinA * sinB;
+}
+
+static ys_float32 sSinSubClamped(ys_float32 sinA, ys_float32 cosA, ys_float32 sinB, ys_float32 cosB)
+{
+    if (cosA > cosB)
+    {
+        return 0.0f;
+    }
+    return sinA * cosB - cosA * sinB;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The smallest (approximately) cone containing the two input cones. Angles are half-angles.
+static void sMergeCones(ysVec4* axis, ys_float32* cosTheta, const ysVec4& axisA, ys_float32 cosThetaA, const ysVec4& axisB, ys_float32 cosThetaB)
+{
+    ys_float32 thetaA = acosf(ysClamp(cosThetaA, -1.0f, 1.0f));
+    ys_float32 thetaB = acosf(ysClamp(cosThetaB, -1.0f, 1.0f));
+    ys_float32 thetaD = acosf(ysClamp(ysDot3(axisA, axisB), -1.0f, 1.0f));
+    if (ysMin(thetaD + thetaB, ys_pi) <= thetaA)
+    {
+        *axis = axisA;
+        *cosTheta = cosThetaA;
+        return;
+    }
+    if (ysMin(thetaD + thetaA, ys_pi) <= thetaB)
+    {
+        *axis = axisB;
+        *cosTheta = cosThetaB;
+        return;
+    }
+
+    ys_float32 thetaO = (thetaA + thetaD + thetaB) * 0.5f;
+    ysVec4 rotationAxis = ysCross(axisA, axisB);
+    if (thetaO >= ys_pi || ysIsSafeToNormalize3(rotationAxis) == false)
+    {
+        *axis = axisA;
+        *cosTheta = -1.0f;
+        return;
+    }
+
+    ys_float32 thetaR = thetaO - thetaA;
+    ysVec4 q = ysQuatFromAxisAngle(ysNormalize3(rotationAxis), thetaR);
+    *axis = ysRotate(q, axisA);
+    *cosTheta = cosf(thetaO);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysLightBVH::Reset()
+{
+    m_tree.Reset();
+    m_nodes = nullptr;
+    m_emitterLeaves = nullptr;
+    m_emitterCount = 0;
+    m_emissiveShapeCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bounds each emitter on its own. The emitters are listed in the order given in the header.
+static void sComputeEmitterNodes(const ysScene* scene, ys_int32 emissiveShapeCount, ys_int32 lightCount, ysLightBVH::Node* emitterNodes,
+    ysAABB* aabbs, ysShapeId* emitterIds)
+{
+    ys_int32 emitterIdx = 0;
+    for (ys_int32 i = 0; i < emissiveShapeCount; ++i, ++emitterIdx)
+    {
+        const ysShape* shape = scene->m_shapes + scene->m_emissiveShapeIndices[i];
+        const ysEmissiveMaterial* emissive = scene->m_emissiveMaterials + shape->m_emissiveMaterialId.m_index;
+
+        ysLightBVH::Node* node = emitterNodes + emitterIdx;
+        node->m_power = sScalarPower(emissive->EvaluateIrradiance(scene).m_value) * shape->ComputeSurfaceArea(scene);
+        node->m_cosThetaE = 0.0f; // All of our emissive materials emit over the entire hemisphere
+        switch (shape->m_type)
+        {
+            case ysShape::Type::e_triangle:
+            {
+                const ysTriangle* triangle = scene->m_triangles + shape->m_typeIndex;
+                node->m_axis = triangle->m_n;
+                node->m_cosThetaO = triangle->m_twoSided ? -1.0f : 1.0f;
+                break;
+            }
+            case ysShape::Type::e_meshTriangle:
+            {
+                // Vertex normals bend the emitting normal away from the face normal, so the cone can only be trusted without them
+                const ysMesh* mesh = scene->m_meshes + shape->m_typeIndex;
+                node->m_axis = mesh->ComputeFaceNormal(shape->m_primitiveIndex);
+                node->m_cosThetaO = (mesh->m_twoSided || mesh->m_normals != nullptr) ? -1.0f : 1.0f;
+                break;
+            }
+            default:
+            {
+                node->m_axis = ysVec4_unitZ;
+                node->m_cosThetaO = -1.0f;
+                break;
+            }
+        }
+
+        aabbs[emitterIdx] = shape->ComputeAABB(scene);
+        emitterIds[emitterIdx].m_index = emitterIdx;
+    }
+
+    for (ys_int32 i = 0; i < lightCount; ++i, ++emitterIdx)
+    {
+        const ysLight* light = scene->m_lights + i;
+        ysLightBVH::Node* node = emitterNodes + emitterIdx;
+        switch (light->m_type)
+        {
+            case ysLight::Type::e_point:
+            {
+                const ysLightPoint* lightPoint = scene->m_lightPoints + light->m_typeIndex;
+                node->m_power = sScalarPower(lightPoint->m_radiantIntensity) * (2.0f * ys_2pi);
+                node->m_axis = ysVec4_unitZ;
+                node->m_cosThetaO = -1.0f;
+                node->m_cosThetaE = 0.0f;
+                aabbs[emitterIdx].m_min = lightPoint->m_position;
+                aabbs[emitterIdx].m_max = lightPoint->m_position;
+                break;
+            }
+            default:
+            {
+                ysAssert(false);
+                break;
+            }
+        }
+        emitterIds[emitterIdx].m_index = emitterIdx;
+    }
+
+    ysAssert(emitterIdx == emissiveShapeCount + lightCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Merges the bounds of the emitters up the tree. emitterLeaves is optional.
+static void sComputeNodes(const ysBVH& tree, const ysLightBVH::Node* emitterNodes, ysLightBVH::Node* nodes, ys_int32* emitterLeaves)
+{
+    // Parents preceed children, so a reverse sweep visits both children before their parent.
+    for (ys_int32 i = tree.m_nodeCount - 1; i >= 0; --i)
+    {
+        const ysBVH::Node* treeNode = tree.m_nodes + i;
+        ysLightBVH::Node* node = nodes + i;
+        if (treeNode->m_left == ys_nullIndex)
+        {
+            ys_int32 idx = treeNode->m_shapeId.m_index;
+            ysAssert(0 <= idx && 2 * idx < tree.m_nodeCount + 1);
+            *node = emitterNodes[idx];
+            if (emitterLeaves != nullptr)
+            {
+                emitterLeaves[idx] = i;
+            }
+            continue;
+        }
+
+        const ysLightBVH::Node* nodeL = nodes + treeNode->m_left;
+        const ysLightBVH::Node* nodeR = nodes + treeNode->m_right;
+        if (nodeL->m_power <= 0.0f || nodeR->m_power <= 0.0f)
+        {
+            // A powerless child should not widen the bounds
+            *node = (nodeL->m_power <= 0.0f) ? *nodeR : *nodeL;
+        }
+        else
+        {
+            sMergeCones(&node->m_axis, &node->m_cosThetaO, nodeL->m_axis, nodeL->m_cosThetaO, nodeR->m_axis, nodeR->m_cosThetaO);
+            node->m_cosThetaE = ysMin(nodeL->m_cosThetaE, nodeR->m_cosThetaE);
+        }
+        node->m_power = nodeL->m_power + nodeR->m_power;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysLightBVH::Create(const ysScene* scene, bool includeEmissiveShapes, bool includeLights)
+{
+    ys_int32 emissiveShapeCount = includeEmissiveShapes ? scene->m_emissiveShapeCount : 0;
+    ys_int32 lightCount = includeLights ? scene->m_lightCount : 0;
+    m_emitterCount = emissiveShapeCount + lightCount;
+    if (m_emitterCount == 0)
+    {
+        Reset();
+        return;
+    }
+
+    ysAABB* aabbs = static_cast<ysAABB*>(ysMalloc(sizeof(ysAABB) * m_emitterCount));
+    ysShapeId* emitterIds = static_cast<ysShapeId*>(ysMalloc(sizeof(ysShapeId) * m_emitterCount));
+    Node* emitterNodes = static_cast<Node*>(ysMalloc(sizeof(Node) * m_emitterCount));
+    sComputeEmitterNodes(scene, emissiveShapeCount, lightCount, emitterNodes, aabbs, emitterIds);
+    m_emissiveShapeCount = emissiveShapeCount;
+
+    m_tree.Create(aabbs, emitterIds, m_emitterCount);
+    ysAssert(m_tree.m_nodeCount == 2 * m_emitterCount - 1);
+
+    Node* nodes = static_cast<Node*>(ysMalloc(sizeof(Node) * m_tree.m_nodeCount));
+    m_emitterLeaves = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * m_emitterCount));
+    sComputeNodes(m_tree, emitterNodes, nodes, m_emitterLeaves);
+    m_nodes = nodes;
+
+    ysFree(emitterNodes);
+    ysFree(emitterIds);
+    ysFree(aabbs);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysLightBVH::Node* ysLightBVH::UpdateEmission(const ysScene* scene)
+{
+    if (m_emitterCount == 0)
+    {
+        return nullptr;
+    }
+
+    // The hierarchy holds either every emitter of a kind or none of them
+    ys_int32 lightCount = m_emitterCount - m_emissiveShapeCount;
+    ysAssert(m_emissiveShapeCount == 0 || m_emissiveShapeCount == scene->m_emissiveShapeCount);
+    ysAssert(lightCount == 0 || lightCount == scene->m_lightCount);
+
+    ysAABB* aabbs = static_cast<ysAABB*>(ysMalloc(sizeof(ysAABB) * m_emitterCount));
+    ysShapeId* emitterIds = static_cast<ysShapeId*>(ysMalloc(sizeof(ysShapeId) * m_emitterCount));
+    Node* emitterNodes = static_cast<Node*>(ysMalloc(sizeof(Node) * m_emitterCount));
+    sComputeEmitterNodes(scene, m_emissiveShapeCount, lightCount, emitterNodes, aabbs, emitterIds);
+
+    Node* nodes = static_cast<Node*>(ysMalloc(sizeof(Node) * m_tree.m_nodeCount));
+    sComputeNodes(m_tree, emitterNodes, nodes, nullptr);
+
+    ysFree(emitterNodes);
+    ysFree(emitterIds);
+    ysFree(aabbs);
+    return m_nodes.exchange(nodes);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysLightBVH::Destroy()
+{
+    m_tree.Destroy();
+    ysSafeFree(m_nodes);
+    ysSafeFree(m_emitterLeaves);
+    m_emitterCount = 0;
+    m_emissiveShapeCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysLightBVH::ComputeImportance(const Node* nodes, ys_int32 nodeIdx, const ysVec4& point, const ysVec4& normal) const
+{
+    const ysAABB& aabb = m_tree.m_nodes[nodeIdx].m_aabb;
+    const Node* node = nodes + nodeIdx;
+    if (node->m_power <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    ysVec4 center = (aabb.m_min + aabb.m_max) * ysVec4_half;
+    ys_float32 radiusSqr = ysLengthSqr3(aabb.m_max - aabb.m_min) * 0.25f;
+    ysVec4 v = point - center;
+    ys_float32 distSqr = ysLengthSqr3(v);
+    ysVec4 w = ysIsSafeToNormalize3(v) ? ysNormalize3(v) : ysVec4_zero;
+
+    // Angle subtended by the bounding sphere of the node. Everything is possible from inside the sphere.
+    ys_float32 sinThetaB = 0.0f;
+    ys_float32 cosThetaB = -1.0f;
+    if (distSqr > radiusSqr)
+    {
+        ys_float32 sinSqr = radiusSqr / distSqr;
+        sinThetaB = sqrtf(sinSqr);
+        cosThetaB = sqrtf(1.0f - sinSqr);
+    }
+
+    // Minimum angle between an emitter normal and the direction towards the point
+    ys_float32 cosThetaW = ysDot3(node->m_axis, w);
+    ys_float32 sinThetaW = sqrtf(ysMax(0.0f, 1.0f - cosThetaW * cosThetaW));
+    ys_float32 sinThetaO = sqrtf(ysMax(0.0f, 1.0f - node->m_cosThetaO * node->m_cosThetaO));
+    ys_float32 cosThetaWO = sCosSubClamped(sinThetaW, cosThetaW, sinThetaO, node->m_cosThetaO);
+    ys_float32 sinThetaWO = sSinSubClamped(sinThetaW, cosThetaW, sinThetaO, node->m_cosThetaO);
+    ys_float32 cosThetaP = sCosSubClamped(sinThetaWO, cosThetaWO, sinThetaB, cosThetaB);
+    if (cosThetaP <= node->m_cosThetaE)
+    {
+        return 0.0f;
+    }
+
+    // Clamp the distance to the node's extent so that nearby clusters are not infinitely important
+    ys_float32 importance = node->m_power * cosThetaP / ysMax(distSqr, radiusSqr);
+
+    if (ysIsSafeToNormalize3(normal))
+    {
+        // One-sided, as every material only reflects. Ray casts flip the normals of two-sided surfaces towards the viewer, so this is the
+        // side that matters for them too. Clusters entirely below the horizon come out non-positive, and are clamped away below.
+        ys_float32 cosThetaI = -ysDot3(w, normal);
+        ys_float32 sinThetaI = sqrtf(ysMax(0.0f, 1.0f - cosThetaI * cosThetaI));
+        importance *= sCosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+    }
+
+    return ysMax(importance, 0.0f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_int32 ysLightBVH::SampleEmitter(const ysVec4& point, const ysVec4& normal, ys_float32* probability) const
+{
+    *probability = 0.0f;
+    const Node* nodes = m_nodes;
+    if (m_tree.m_nodeCount == 0 || ComputeImportance(nodes, 0, point, normal) <= 0.0f)
+    {
+        return ys_nullIndex;
+    }
+
+    ys_float32 p = 1.0f;
+    ys_int32 nodeIdx = 0;
+    while (true)
+    {
+        const ysBVH::Node* treeNode = m_tree.m_nodes + nodeIdx;
+        if (treeNode->m_left == ys_nullIndex)
+        {
+            *probability = p;
+            return treeNode->m_shapeId.m_index;
+        }
+
+        ys_float32 importanceL = ComputeImportance(nodes, treeNode->m_left, point, normal);
+        ys_float32 importanceR = ComputeImportance(nodes, treeNode->m_right, point, normal);
+        ys_float32 importanceLR = importanceL + importanceR;
+        if (importanceLR <= 0.0f)
+        {
+            return ys_nullIndex;
+        }
+
+        ys_float32 pL = importanceL / importanceLR;
+        bool goLeft = (importanceR <= 0.0f) || (importanceL > 0.0f && ysRandom(0.0f, 1.0f) < pL);
+        nodeIdx = goLeft ? treeNode->m_left : treeNode->m_right;
+        p *= goLeft ? pL : 1.0f - pL;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysLightBVH::ProbabilityForEmitter(const ysVec4& point, const ysVec4& normal, ys_int32 emitterIdx) const
+{
+    ysAssert(0 <= emitterIdx && emitterIdx < m_emitterCount);
+    const Node* nodes = m_nodes;
+    ys_int32 nodeIdx = m_emitterLeaves[emitterIdx];
+    ys_float32 p = 1.0f;
+    while (nodeIdx != 0)
+    {
+        ys_int32 parentIdx = m_tree.m_nodes[nodeIdx].m_parent;
+        const ysBVH::Node* parent = m_tree.m_nodes + parentIdx;
+        ys_int32 siblingIdx = (parent->m_left == nodeIdx) ? parent->m_right : parent->m_left;
+        ys_float32 importance = ComputeImportance(nodes, nodeIdx, point, normal);
+        if (importance <= 0.0f)
+        {
+            return 0.0f;
+        }
+        ys_float32 importanceSibling = ComputeImportance(nodes, siblingIdx, point, normal);
+        p *= importance / (importance + importanceSibling);
+        nodeIdx = parentIdx;
+    }
+    return (ComputeImportance(nodes, 0, point, normal) > 0.0f) ? p : 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_int32 ysLightBVH::SampleEmitter(ys_float32* probability) const
+{
+    *probability = 0.0f;
+    const Node* nodes = m_nodes;
+    if (m_tree.m_nodeCount == 0 || nodes[0].m_power <= 0.0f)
+    {
+        return ys_nullIndex;
+    }
+
+    ys_float32 p = 1.0f;
+    ys_int32 nodeIdx = 0;
+    while (true)
+    {
+        const ysBVH::Node* treeNode = m_tree.m_nodes + nodeIdx;
+        if (treeNode->m_left == ys_nullIndex)
+        {
+            *probability = p;
+            return treeNode->m_shapeId.m_index;
+        }
+
+        ys_float32 powerL = nodes[treeNode->m_left].m_power;
+        ys_float32 powerR = nodes[treeNode->m_right].m_power;
+        ys_float32 pL = powerL / (powerL + powerR);
+        bool goLeft = (powerR <= 0.0f) || (powerL > 0.0f && ysRandom(0.0f, 1.0f) < pL);
+        nodeIdx = goLeft ? treeNode->m_left : treeNode->m_right;
+        p *= goLeft ? pL : 1.0f - pL;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysLightBVH::ProbabilityForEmitter(ys_int32 emitterIdx) const
+{
+    ysAssert(0 <= emitterIdx && emitterIdx < m_emitterCount);
+    const Node* nodes = m_nodes;
+    ys_int32 nodeIdx = m_emitterLeaves[emitterIdx];
+    ys_float32 p = 1.0f;
+    while (nodeIdx != 0)
+    {
+        ys_int32 parentIdx = m_tree.m_nodes[nodeIdx].m_parent;
+        const ysBVH::Node* parent = m_tree.m_nodes + parentIdx;
+        ys_int32 siblingIdx = (parent->m_left == nodeIdx) ? parent->m_right : parent->m_left;
+        ys_float32 power = nodes[nodeIdx].m_power;
+        if (power <= 0.0f)
+        {
+            return 0.0f;
+        }
+        p *= power / (power + nodes[siblingIdx].m_power);
+        nodeIdx = parentIdx;
+    }
+    return p;
+}
\ No newline at end of file
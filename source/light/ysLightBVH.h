@@ -0,0 +1,64 @@
+#pragma once
+
+#include "YoshiPBR/ysBVH.h"
+
+#include <atomic>
+
+struct ysScene;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Hierarchy over the emitters in the scene (emissive shapes and/or lights with infinitesimal area) used to select a single emitter with
+// probability roughly proportional to its contribution at a given shading point. Each node bounds the power, positions and emission
+// directions of the emitters beneath it, so that whole clusters of distant or back-facing emitters can be discounted without visiting them.
+// Based on "Importance Sampling of Many Lights With Adaptive Tree Splitting" (Conty Estevez and Kulla, 2018).
+//
+// Emitters are identified by a single index:
+//     [0, E)       -> scene->m_emissiveShapeIndices[index]
+//     [E, E + L)   -> scene->m_lights[index - E]
+// ... where E = scene->m_emissiveShapeCount and L = scene->m_lightCount (either being 0 if the hierarchy excludes those emitters)
+struct ysLightBVH
+{
+    struct Node
+    {
+        ysVec4 m_axis;          // Axis of the cone bounding the surface normals of the emitters (arbitrary if m_cosThetaO = -1)
+        ys_float32 m_cosThetaO; // Cosine of the half-angle of the normal cone
+        ys_float32 m_cosThetaE; // Cosine of the maximum angle between a normal and an emitted direction (pi/2 for diffuse emitters)
+        ys_float32 m_power;     // Total emitted power (averaged over color channels)
+    };
+
+    void Reset();
+    void Create(const ysScene* scene, bool includeEmissiveShapes, bool includeLights);
+    void Destroy();
+
+    // Recomputes the power and directional bounds after the emitters' strengths have changed, keeping the tree. The new bounds are swapped
+    // in whole, so that concurrent queries see either the old bounds or the new ones. Returns the old bounds, for the caller to free once
+    // no query may still be reading them.
+    Node* UpdateEmission(const ysScene* scene);
+
+    // Returns the emitter index (see above) or ys_nullIndex if no emitter can contribute to the point. The normal is optional (pass zero)
+    // and is only used to discount emitters lying below the horizon, so it must face the side of the surface being lit. 'probability' is the
+    // discrete probability of having chosen the emitter.
+    ys_int32 SampleEmitter(const ysVec4& point, const ysVec4& normal, ys_float32* probability) const;
+
+    // The probability that SampleEmitter would return the specified emitter from the given shading point.
+    ys_float32 ProbabilityForEmitter(const ysVec4& point, const ysVec4& normal, ys_int32 emitterIdx) const;
+
+    // Same as above, but in proportion to power alone, for when there is no shading point (e.g. to start a light subpath)
+    ys_int32 SampleEmitter(ys_float32* probability) const;
+    ys_float32 ProbabilityForEmitter(ys_int32 emitterIdx) const;
+
+    // 'nodes' is a snapshot of m_nodes, taken once per query so that a query is not split across an update
+    ys_float32 ComputeImportance(const Node* nodes, ys_int32 nodeIdx, const ysVec4& point, const ysVec4& normal) const;
+
+    // Topology and spatial bounds. Leaf shape ids hold emitter indices rather than actual shape indices.
+    ysBVH m_tree;
+
+    // Directional and power bounds. Parallel to m_tree.m_nodes.
+    std::atomic<Node*> m_nodes;
+
+    // Maps each emitter index to its leaf in m_tree
+    ys_int32* m_emitterLeaves;
+    ys_int32 m_emitterCount;
+    ys_int32 m_emissiveShapeCount; // E above
+};
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "ysCamera.h"
+#include "YoshiPBR/ysStructures.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysCamera::Reset()
+{
+    m_eye = ysTransform_identity;
+    m_halfWidth = 0.0f;
+    m_halfHeight = 0.0f;
+    m_pixelHalfWidth = 0.0f;
+    m_pixelHalfHeight = 0.0f;
+    m_pixelCountX = 0;
+    m_pixelCountY = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysCamera::Create(const ysSceneRenderInput& input)
+{
+    const ys_float32 aspectRatio = ys_float32(input.m_pixelCountX) / ys_float32(input.m_pixelCountY);
+    m_eye = input.m_eye;
+    m_halfHeight = tanf(input.m_fovY);
+    m_halfWidth = m_halfHeight * aspectRatio;
+    m_pixelHalfHeight = m_halfHeight / ys_float32(input.m_pixelCountY);
+    m_pixelHalfWidth = m_halfWidth / ys_float32(input.m_pixelCountX);
+    m_pixelCountX = input.m_pixelCountX;
+    m_pixelCountY = input.m_pixelCountY;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_int32 ysCamera::ComputePixelIndex(ys_float32* cosTheta, const ysVec4& dirWS) const
+{
+    ysVec4 dirLS = ysInvRotate(m_eye.q, dirWS);
+    ys_float32 depth = -dirLS.z;
+    if (depth < ys_epsilon * ysLength3(dirLS))
+    {
+        return ys_nullIndex;
+    }
+
+    // Invert the mapping from pixel (i,j) to the range of points [xMid - pixelHalfWidth, xMid + pixelHalfWidth] on the image plane
+    ys_float32 x = dirLS.x / depth;
+    ys_float32 y = dirLS.y / depth;
+    ys_float32 jReal = (x / m_halfWidth + 1.0f) * ys_float32(m_pixelCountX) * 0.5f - 0.5f;
+    ys_float32 iReal = (1.0f - y / m_halfHeight) * ys_float32(m_pixelCountY) * 0.5f - 0.5f;
+    if (jReal < 0.0f || iReal < 0.0f)
+    {
+        return ys_nullIndex;
+    }
+    ys_int32 j = ys_int32(jReal);
+    ys_int32 i = ys_int32(iReal);
+    if (j >= m_pixelCountX || i >= m_pixelCountY)
+    {
+        return ys_nullIndex;
+    }
+
+    *cosTheta = depth / ysLength3(dirLS);
+    return m_pixelCountX * i + j;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysCamera::ComputeCosTheta(const ysVec4& dirWS) const
+{
+    ysVec4 dirLS = ysInvRotate(m_eye.q, dirWS);
+    return -dirLS.z;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysCamera::EvaluateImportance(ys_float32 cosTheta) const
+{
+    // The solid angle subtended by an area element dA on the image plane is dA * cos^3(theta), so integrating this against radiance over
+    // the pixel yields the radiance averaged over the pixel's area.
+    ys_float32 pixelArea = 4.0f * m_pixelHalfWidth * m_pixelHalfHeight;
+    ys_float32 cos3 = cosTheta * cosTheta * cosTheta;
+    return 1.0f / (pixelArea * cos3);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysCamera::ProbabilityDensityForGeneratedDirection(ys_float32 cosTheta) const
+{
+    ys_float32 imageArea = 4.0f * m_halfWidth * m_halfHeight;
+    ys_float32 cos3 = cosTheta * cosTheta * cosTheta;
+    return 1.0f / (imageArea * cos3);
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "YoshiPBR/ysMath.h"
+
+struct ysSceneRenderInput;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pinhole camera matching the pixel layout used when tracing eye paths (see ysScene::DoRenderWork). The image plane lies at unit distance
+// down the eye's -z axis. Importance is normalized such that a pixel measures the average radiance over its footprint on the image plane.
+struct ysCamera
+{
+    void Reset();
+    void Create(const ysSceneRenderInput&);
+
+    // Finds the pixel seen along the world space direction from the eye. Returns ys_nullIndex if the direction misses the image.
+    // 'cosTheta' is the cosine of the angle between the direction and the eye's viewing axis.
+    ys_int32 ComputePixelIndex(ys_float32* cosTheta, const ysVec4& dirWS) const;
+
+    // The cosine of the angle between the (normalized) world space direction and the eye's viewing axis
+    ys_float32 ComputeCosTheta(const ysVec4& dirWS) const;
+
+    // Importance per solid angle emitted from the eye towards a single pixel, i.e. W(x_eye, w) for directions w within that pixel.
+    ys_float32 EvaluateImportance(ys_float32 cosTheta) const;
+
+    // Probability per solid angle of generating a direction when picking a pixel uniformly and then a point uniformly within the pixel.
+    // Note: This is relative to the whole image, so that eye and light subpath strategies are weighted for equal numbers of samples.
+    ys_float32 ProbabilityDensityForGeneratedDirection(ys_float32 cosTheta) const;
+
+    ysTransform m_eye;
+
+    // One-sided extents of the image and of a single pixel on the image plane
+    ys_float32 m_halfWidth;
+    ys_float32 m_halfHeight;
+    ys_float32 m_pixelHalfWidth;
+    ys_float32 m_pixelHalfHeight;
+
+    ys_int32 m_pixelCountX;
+    ys_int32 m_pixelCountY;
+};
\ No newline at end of file
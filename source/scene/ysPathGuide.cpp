@@ -0,0 +1,582 @@
+#include "ysPathGuide.h"
+#include "threading/ysParallelAlgorithms.h"
+
+#include <math.h>
+
+// A kd-tree leaf is split once this many records have been deposited into it
+static const ys_int32 s_spatialSplitRecordCount = 4096;
+static const ys_int32 s_maxSpatialDepth = 24;
+
+// A quadtree node is subdivided if it carries more than this fraction of the total flux
+static const ys_float32 s_quadSplitFluxFraction = 0.01f;
+static const ys_int32 s_maxQuadDepth = 16;
+
+// Bounds on the number of records a leaf's training quadtree must gather before the sampling quadtree is rebuilt from it
+static const ys_int32 s_minRebuildRecordCount = 256;
+static const ys_int32 s_maxRebuildRecordCount = 4096;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sDirectionToSquare(const ysVec4& dirWS, ys_float32* u, ys_float32* v)
+{
+    ys_float32 cosTheta = ysClamp(dirWS.z, -1.0f, 1.0f);
+    ys_float32 phi = atan2f(dirWS.y, dirWS.x);
+    if (phi < 0.0f)
+    {
+        phi += ys_2pi;
+    }
+    // Keep both coordinates strictly below 1 so that they always fall into a quadrant
+    const ys_float32 uvMax = 1.0f - ys_epsilon;
+    *u = ysClamp(0.5f * (cosTheta + 1.0f), 0.0f, uvMax);
+    *v = ysClamp(phi / ys_2pi, 0.0f, uvMax);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ysVec4 sSquareToDirection(ys_float32 u, ys_float32 v)
+{
+    ys_float32 cosTheta = 2.0f * u - 1.0f;
+    ys_float32 sinTheta = sqrtf(ysMax(0.0f, 1.0f - cosTheta * cosTheta));
+    ys_float32 phi = ys_2pi * v;
+    return ysVecSet(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta, 0.0f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ys_float32 sGetAxis(const ysVec4& v, ys_int32 axis)
+{
+    ysAssert(0 <= axis && axis < 3);
+    return (&v.x)[axis];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sSetAxis(ysVec4* v, ys_int32 axis, ys_float32 value)
+{
+    ysAssert(0 <= axis && axis < 3);
+    (&v->x)[axis] = value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rebuilds the quadtree such that every node holding more than a small fraction of the total flux is subdivided, and no other node is.
+static void sRefineNodes(ysPathGuide::QuadTree* tree, ys_float32 totalFlux)
+{
+    if (totalFlux <= 0.0f)
+    {
+        return;
+    }
+
+    // The new tree is built top-down from the old one. Where the new tree is finer than the old one, the flux of the old quadrant is
+    // assumed to be spread uniformly over it. Where it is coarser, the old subtree's flux is simply summed up into the new quadrant (which
+    // the old node already holds).
+    struct StackEntry
+    {
+        ys_int32 newNodeIdx;
+        ys_int32 oldNodeIdx; // ys_nullIndex if this region lies within an undivided quadrant of the old tree
+        ys_float32 flux;
+        ys_int32 depth;
+    };
+
+    ysArrayG<ysPathGuide::QuadNode> newNodes;
+    newNodes.Allocate();
+
+    StackEntry stack[4 * s_maxQuadDepth];
+    ys_int32 stackCount = 0;
+    stack[stackCount++] = { 0, 0, totalFlux, 1 };
+    while (stackCount > 0)
+    {
+        StackEntry entry = stack[--stackCount];
+
+        ysPathGuide::QuadNode node;
+        for (ys_int32 q = 0; q < 4; ++q)
+        {
+            ys_float32 flux = entry.flux * 0.25f;
+            ys_int32 oldChildIdx = ys_nullIndex;
+            if (entry.oldNodeIdx != ys_nullIndex)
+            {
+                const ysPathGuide::QuadNode& oldNode = tree->m_nodes[entry.oldNodeIdx];
+                flux = oldNode.m_flux[q];
+                oldChildIdx = oldNode.m_children[q];
+            }
+
+            node.m_flux[q] = flux;
+            node.m_children[q] = ys_nullIndex;
+            if (flux > s_quadSplitFluxFraction * totalFlux && entry.depth < s_maxQuadDepth)
+            {
+                ysAssert(stackCount < 4 * s_maxQuadDepth);
+                node.m_children[q] = newNodes.GetCount();
+                newNodes.Allocate();
+                stack[stackCount++] = { node.m_children[q], oldChildIdx, flux, entry.depth + 1 };
+            }
+        }
+        newNodes[entry.newNodeIdx] = node;
+    }
+
+    tree->SetNodeCount(newNodes.GetCount());
+    ysMemCpy(tree->m_nodes, newNodes.GetEntries(), sizeof(ysPathGuide::QuadNode) * newNodes.GetCount());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::QuadTree::Create()
+{
+    m_nodes = static_cast<QuadNode*>(ysMalloc(sizeof(QuadNode)));
+    m_nodeCount = 1;
+    m_nodeCapacity = 1;
+    for (ys_int32 q = 0; q < 4; ++q)
+    {
+        m_nodes[0].m_flux[q] = 0.0f;
+        m_nodes[0].m_children[q] = ys_nullIndex;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::QuadTree::Destroy()
+{
+    ysSafeFree(m_nodes);
+    m_nodeCount = 0;
+    m_nodeCapacity = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::QuadTree::CopyFrom(const QuadTree& src)
+{
+    SetNodeCount(src.m_nodeCount);
+    ysMemCpy(m_nodes, src.m_nodes, sizeof(QuadNode) * src.m_nodeCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::QuadTree::SetNodeCount(ys_int32 nodeCount)
+{
+    if (nodeCount > m_nodeCapacity)
+    {
+        ys_int32 nodeCapacity = ysMax(nodeCount, (m_nodeCapacity >> 1) + m_nodeCapacity);
+        QuadNode* nodes = static_cast<QuadNode*>(ysMalloc(sizeof(QuadNode) * nodeCapacity));
+        ysMemCpy(nodes, m_nodes, sizeof(QuadNode) * m_nodeCount);
+        ysSwap(m_nodes, nodes);
+        ysFree(nodes);
+        m_nodeCapacity = nodeCapacity;
+    }
+    m_nodeCount = nodeCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::Distribution::Create()
+{
+    m_tree.Create();
+    m_trainingTree.Create();
+    m_flux = 0.0f;
+    m_trainingFlux = 0.0f;
+    m_trainingRecordCount = 0;
+    m_recordCount = 0;
+    m_recordBegin = 0;
+    m_recordEnd = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::Distribution::Destroy()
+{
+    m_tree.Destroy();
+    m_trainingTree.Destroy();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::Distribution::CopyFrom(const Distribution& src)
+{
+    m_tree.CopyFrom(src.m_tree);
+    m_trainingTree.CopyFrom(src.m_trainingTree);
+    m_flux = src.m_flux;
+    m_trainingFlux = src.m_trainingFlux;
+    m_trainingRecordCount = src.m_trainingRecordCount;
+    m_recordCount = src.m_recordCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysVec4 ysPathGuide::Distribution::GenerateRandomDirection() const
+{
+    ysAssert(m_flux > 0.0f);
+    ys_float32 u0 = 0.0f;
+    ys_float32 v0 = 0.0f;
+    ys_float32 size = 1.0f;
+    ys_int32 nodeIdx = 0;
+    for (;;)
+    {
+        const QuadNode& node = m_tree.m_nodes[nodeIdx];
+        ys_float32 total = node.m_flux[0] + node.m_flux[1] + node.m_flux[2] + node.m_flux[3];
+        ysAssert(total > 0.0f);
+
+        // Choose a quadrant in proportion to its flux, never settling on an empty one due to round-off
+        ys_float32 r = ysRandom(0.0f, total);
+        ys_int32 quadrant = ys_nullIndex;
+        for (ys_int32 q = 0; q < 4; ++q)
+        {
+            if (node.m_flux[q] <= 0.0f)
+            {
+                continue;
+            }
+            quadrant = q;
+            r -= node.m_flux[q];
+            if (r < 0.0f)
+            {
+                break;
+            }
+        }
+        ysAssert(quadrant != ys_nullIndex);
+
+        size *= 0.5f;
+        u0 += (quadrant & 1) ? size : 0.0f;
+        v0 += (quadrant & 2) ? size : 0.0f;
+
+        nodeIdx = node.m_children[quadrant];
+        if (nodeIdx == ys_nullIndex)
+        {
+            break;
+        }
+    }
+    return sSquareToDirection(u0 + ysRandom(0.0f, size), v0 + ysRandom(0.0f, size));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysPathGuide::Distribution::ProbabilityDensityForGeneratedDirection(const ysVec4& dirWS) const
+{
+    if (m_flux <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    ys_float32 u, v;
+    sDirectionToSquare(dirWS, &u, &v);
+
+    // Density over the unit square, which has the same total measure as the sphere once scaled by 4pi
+    ys_float32 p = 1.0f;
+    ys_int32 nodeIdx = 0;
+    while (nodeIdx != ys_nullIndex)
+    {
+        const QuadNode& node = m_tree.m_nodes[nodeIdx];
+        ys_float32 total = node.m_flux[0] + node.m_flux[1] + node.m_flux[2] + node.m_flux[3];
+        if (total <= 0.0f)
+        {
+            return 0.0f;
+        }
+        ys_int32 qu = (u >= 0.5f) ? 1 : 0;
+        ys_int32 qv = (v >= 0.5f) ? 1 : 0;
+        ys_int32 quadrant = qu + 2 * qv;
+        p *= 4.0f * node.m_flux[quadrant] / total;
+        u = 2.0f * u - ys_float32(qu);
+        v = 2.0f * v - ys_float32(qv);
+        nodeIdx = node.m_children[quadrant];
+    }
+    return p / (2.0f * ys_2pi);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::Distribution::Splat(const ysVec4& dirWS, ys_float32 weight)
+{
+    ysAssert(weight >= 0.0f);
+    ys_float32 u, v;
+    sDirectionToSquare(dirWS, &u, &v);
+
+    m_trainingFlux += weight;
+    m_trainingRecordCount++;
+    ys_int32 nodeIdx = 0;
+    while (nodeIdx != ys_nullIndex)
+    {
+        QuadNode& node = m_trainingTree.m_nodes[nodeIdx];
+        ys_int32 qu = (u >= 0.5f) ? 1 : 0;
+        ys_int32 qv = (v >= 0.5f) ? 1 : 0;
+        ys_int32 quadrant = qu + 2 * qv;
+        node.m_flux[quadrant] += weight;
+        u = 2.0f * u - ys_float32(qu);
+        v = 2.0f * v - ys_float32(qv);
+        nodeIdx = node.m_children[quadrant];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::Distribution::Rebuild()
+{
+    // The training tree is refined around its own flux and becomes the new sampling tree. Training then starts over on the refined tree,
+    // so that estimates made at a coarse resolution early on don't linger once the tree can resolve the radiance better.
+    sRefineNodes(&m_trainingTree, m_trainingFlux);
+    m_tree.CopyFrom(m_trainingTree);
+    m_flux = m_trainingFlux;
+
+    for (ys_int32 i = 0; i < m_trainingTree.m_nodeCount; ++i)
+    {
+        for (ys_int32 q = 0; q < 4; ++q)
+        {
+            m_trainingTree.m_nodes[i].m_flux[q] = 0.0f;
+        }
+    }
+    m_trainingFlux = 0.0f;
+    m_trainingRecordCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sLocateRecord(ysPathGuide::Record& record, ysPathGuide* guide)
+{
+    record.m_leafIdx = guide->FindLeaf(0, record.m_posWS);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sTrainDistribution(ysPathGuide::Distribution& distribution, ysPathGuide* guide)
+{
+    if (distribution.m_recordBegin == distribution.m_recordEnd)
+    {
+        return;
+    }
+    for (ys_int32 k = distribution.m_recordBegin; k < distribution.m_recordEnd; ++k)
+    {
+        const ysPathGuide::Record& record = guide->m_records[guide->m_sortedRecords[k]];
+        distribution.Splat(record.m_dirWS, record.m_weight);
+    }
+
+    // Each rebuild waits for (roughly) as many records as went into every previous one, up to a point. This way the sampling tree is
+    // refreshed often while little is known, and is built from ever more records as the render progresses.
+    ys_int32 previousRecordCount = distribution.m_recordCount - distribution.m_trainingRecordCount;
+    ys_int32 rebuildRecordCount = ysClamp(previousRecordCount, s_minRebuildRecordCount, s_maxRebuildRecordCount);
+    if (distribution.m_trainingRecordCount >= rebuildRecordCount)
+    {
+        distribution.Rebuild();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::Reset()
+{
+    m_spatialNodes.Create();
+    m_distributions.Create();
+    m_records = nullptr;
+    m_sortedRecords = nullptr;
+    m_recordCount = 0;
+    m_recordCapacity = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::Create(const ysAABB& bounds, ys_int32 recordCapacity)
+{
+    ysAssert(recordCapacity > 0);
+    Reset();
+
+    // Pad the bounds slightly so that points on the boundary don't end up in the wrong leaf due to round-off
+    ysVec4 padding = (bounds.m_max - bounds.m_min) * ysSplat(0.001f) + ysSplat(ys_epsilon);
+
+    SpatialNode* root = m_spatialNodes.Allocate();
+    root->m_aabb.m_min = bounds.m_min - padding;
+    root->m_aabb.m_max = bounds.m_max + padding;
+    root->m_child = ys_nullIndex;
+    root->m_axis = 0;
+    root->m_split = 0.0f;
+    root->m_distributionIdx = 0;
+    root->m_depth = 0;
+    m_distributions.Allocate()->Create();
+
+    m_recordCapacity = recordCapacity;
+    m_records = static_cast<Record*>(ysMalloc(sizeof(Record) * m_recordCapacity));
+    m_sortedRecords = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * m_recordCapacity));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::Destroy()
+{
+    for (ys_int32 i = 0; i < m_distributions.GetCount(); ++i)
+    {
+        m_distributions[i].Destroy();
+    }
+    m_distributions.Destroy();
+    m_spatialNodes.Destroy();
+    ysSafeFree(m_records);
+    ysSafeFree(m_sortedRecords);
+    Reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::AddRecord(const ysVec4& posWS, const ysVec4& dirWS, ys_float32 weight)
+{
+    ys_int32 recordIdx = m_recordCount.fetch_add(1, std::memory_order_relaxed);
+    if (recordIdx >= m_recordCapacity)
+    {
+        return;
+    }
+    Record* record = m_records + recordIdx;
+    record->m_posWS = posWS;
+    record->m_dirWS = dirWS;
+    record->m_weight = weight;
+    record->m_leafIdx = ys_nullIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_int32 ysPathGuide::GetRecordCount() const
+{
+    return ysMin(m_recordCount.load(std::memory_order_relaxed), m_recordCapacity);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_int32 ysPathGuide::FindLeaf(ys_int32 nodeIdx, const ysVec4& posWS) const
+{
+    ysAssert(0 <= nodeIdx && nodeIdx < m_spatialNodes.GetCount());
+    for (;;)
+    {
+        const SpatialNode& node = m_spatialNodes[nodeIdx];
+        if (node.m_child == ys_nullIndex)
+        {
+            return nodeIdx;
+        }
+        nodeIdx = (sGetAxis(posWS, node.m_axis) < node.m_split) ? node.m_child : node.m_child + 1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+const ysPathGuide::Distribution* ysPathGuide::FindDistribution(const ysVec4& posWS) const
+{
+    if (m_spatialNodes.GetCount() == 0)
+    {
+        return nullptr;
+    }
+    const SpatialNode& leaf = m_spatialNodes[FindLeaf(0, posWS)];
+    const Distribution* distribution = &m_distributions[leaf.m_distributionIdx];
+    return (distribution->m_flux > 0.0f) ? distribution : nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPathGuide::Update(ysJobSystem* jobSystem)
+{
+    ys_int32 recordCount = GetRecordCount();
+    if (recordCount == 0)
+    {
+        return;
+    }
+
+    // Locate every record's leaf
+    if (jobSystem == nullptr)
+    {
+        for (ys_int32 i = 0; i < recordCount; ++i)
+        {
+            sLocateRecord(m_records[i], this);
+        }
+    }
+    else
+    {
+        ysParallelFor(jobSystem, m_records, recordCount, this, 1024, sLocateRecord);
+    }
+
+    ys_int32 distributionCount = m_distributions.GetCount();
+    for (ys_int32 i = 0; i < distributionCount; ++i)
+    {
+        m_distributions[i].m_recordBegin = 0;
+        m_distributions[i].m_recordEnd = 0;
+    }
+    for (ys_int32 i = 0; i < recordCount; ++i)
+    {
+        const SpatialNode& leaf = m_spatialNodes[m_records[i].m_leafIdx];
+        m_distributions[leaf.m_distributionIdx].m_recordCount++;
+    }
+
+    // Split the leaves that have seen enough records. Their new children start out with a copy of the parent's quadtree, and half of its
+    // records each. Just one level of splitting per update; crowded children are split again by the following updates.
+    ys_int32 spatialNodeCount = m_spatialNodes.GetCount();
+    for (ys_int32 i = 0; i < spatialNodeCount; ++i)
+    {
+        // Children are appended to the array, so the node must be fetched again whenever it grows
+        if (m_spatialNodes[i].m_child != ys_nullIndex || m_spatialNodes[i].m_depth >= s_maxSpatialDepth)
+        {
+            continue;
+        }
+        ys_int32 distributionIdx = m_spatialNodes[i].m_distributionIdx;
+        if (m_distributions[distributionIdx].m_recordCount < s_spatialSplitRecordCount)
+        {
+            continue;
+        }
+
+        ysAABB aabb = m_spatialNodes[i].m_aabb;
+        ysVec4 extent = aabb.m_max - aabb.m_min;
+        ys_int32 axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+        ys_float32 split = 0.5f * (sGetAxis(aabb.m_min, axis) + sGetAxis(aabb.m_max, axis));
+
+        ys_int32 childIdx = m_spatialNodes.GetCount();
+        ys_int32 siblingDistributionIdx = m_distributions.GetCount();
+        Distribution* siblingDistribution = m_distributions.Allocate();
+        siblingDistribution->Create();
+        siblingDistribution->CopyFrom(m_distributions[distributionIdx]);
+        siblingDistribution->m_recordCount /= 2;
+        m_distributions[distributionIdx].m_recordCount -= siblingDistribution->m_recordCount;
+
+        for (ys_int32 k = 0; k < 2; ++k)
+        {
+            SpatialNode* child = m_spatialNodes.Allocate();
+            child->m_aabb = aabb;
+            sSetAxis((k == 0) ? &child->m_aabb.m_max : &child->m_aabb.m_min, axis, split);
+            child->m_child = ys_nullIndex;
+            child->m_axis = 0;
+            child->m_split = 0.0f;
+            child->m_distributionIdx = (k == 0) ? distributionIdx : siblingDistributionIdx;
+            child->m_depth = m_spatialNodes[i].m_depth + 1;
+        }
+
+        SpatialNode& node = m_spatialNodes[i];
+        node.m_child = childIdx;
+        node.m_axis = axis;
+        node.m_split = split;
+        node.m_distributionIdx = ys_nullIndex;
+    }
+
+    // Sort the records by distribution (counting sort). Records from leaves split just now are pushed down into the children.
+    distributionCount = m_distributions.GetCount();
+    for (ys_int32 i = 0; i < recordCount; ++i)
+    {
+        Record& record = m_records[i];
+        record.m_leafIdx = FindLeaf(record.m_leafIdx, record.m_posWS);
+        m_distributions[m_spatialNodes[record.m_leafIdx].m_distributionIdx].m_recordEnd++;
+    }
+    ys_int32 sum = 0;
+    for (ys_int32 i = 0; i < distributionCount; ++i)
+    {
+        Distribution& distribution = m_distributions[i];
+        ys_int32 count = distribution.m_recordEnd;
+        distribution.m_recordBegin = sum;
+        distribution.m_recordEnd = sum;
+        sum += count;
+    }
+    ysAssert(sum == recordCount);
+    for (ys_int32 i = 0; i < recordCount; ++i)
+    {
+        Distribution& distribution = m_distributions[m_spatialNodes[m_records[i].m_leafIdx].m_distributionIdx];
+        m_sortedRecords[distribution.m_recordEnd++] = i;
+    }
+
+    // Each leaf is trained independently of the others
+    if (jobSystem == nullptr)
+    {
+        for (ys_int32 i = 0; i < distributionCount; ++i)
+        {
+            sTrainDistribution(m_distributions[i], this);
+        }
+    }
+    else
+    {
+        ysParallelFor(jobSystem, m_distributions.GetEntries(), distributionCount, this, 2, sTrainDistribution);
+    }
+
+    m_recordCount = 0;
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "YoshiPBR/ysAABB.h"
+#include "YoshiPBR/ysArrayG.h"
+
+#include <atomic>
+
+struct ysJobSystem;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Approximation of the radiance arriving at every point of the scene, learned over the course of a render and used to sample directions
+// at path vertices alongside the BRDF. Based on "Practical Path Guiding for Efficient Light-Transport Simulation" (Muller et al. 2017).
+//
+// Space is partitioned by a kd-tree over the scene bounds. Each leaf owns a quadtree over the unit square, which maps onto the sphere of
+// directions via the area-preserving cylindrical map (u, v) -> (cos(theta), phi) = (2u - 1, 2pi * v). Every quadtree node stores the
+// radiance arriving through each of its four quadrants, so that directions can be drawn in proportion to it by descending the tree.
+//
+// Paths deposit their radiance estimates with AddRecord while a pass is rendered. Between passes, Update splits crowded kd-tree leaves
+// (each child inheriting a copy of its parent's quadtrees), then splats the records into a training quadtree in each leaf. Once a leaf has
+// gathered enough records, its training quadtree is refined around the radiance it holds and replaces the quadtree used for sampling.
+// Only the bookkeeping that sorts records by leaf is serial; the leaves themselves are trained in parallel.
+struct ysPathGuide
+{
+    struct Record
+    {
+        ysVec4 m_posWS;
+        ysVec4 m_dirWS;
+        ys_float32 m_weight; // Incident radiance over the probability density (per solid angle) with which the direction was sampled
+        ys_int32 m_leafIdx;  // Scratch for Update
+    };
+
+    struct QuadNode
+    {
+        ys_float32 m_flux[4];     // Indexed by quadrant: (u >= 1/2) + 2 * (v >= 1/2)
+        ys_int32 m_children[4];   // ys_nullIndex if the quadrant is not subdivided (its flux is then spread uniformly over it)
+    };
+
+    // Nodes in a plain buffer rather than a ysArrayG, as distributions are themselves relocated bytewise when m_distributions grows
+    struct QuadTree
+    {
+        void Create();
+        void Destroy();
+        void CopyFrom(const QuadTree&);
+        void SetNodeCount(ys_int32); // Keeps the existing nodes
+
+        QuadNode* m_nodes; // The root is at index 0
+        ys_int32 m_nodeCount;
+        ys_int32 m_nodeCapacity;
+    };
+
+    struct Distribution
+    {
+        void Create();
+        void Destroy();
+        void CopyFrom(const Distribution&);
+
+        ysVec4 GenerateRandomDirection() const;
+        ys_float32 ProbabilityDensityForGeneratedDirection(const ysVec4& dirWS) const;
+
+        // Records go into the training tree, leaving the sampling tree untouched until the next rebuild
+        void Splat(const ysVec4& dirWS, ys_float32 weight);
+        void Rebuild();
+
+        // Sampling tree
+        QuadTree m_tree;
+        ys_float32 m_flux; // Total over the whole sphere
+
+        // Training tree, with the same layout
+        QuadTree m_trainingTree;
+        ys_float32 m_trainingFlux;
+        ys_int32 m_trainingRecordCount; // Since the last rebuild
+
+        ys_int32 m_recordCount; // Total deposited over the render (including those inherited from the parent leaf when split)
+
+        // Scratch for Update: The records to splat are m_sortedRecords[m_recordBegin, m_recordEnd)
+        ys_int32 m_recordBegin;
+        ys_int32 m_recordEnd;
+    };
+
+    struct SpatialNode
+    {
+        ysAABB m_aabb;
+        ys_int32 m_child;           // Children are stored consecutively. ys_nullIndex for leaves.
+        ys_int32 m_axis;
+        ys_float32 m_split;
+        ys_int32 m_distributionIdx; // Leaves only
+        ys_int32 m_depth;
+    };
+
+    void Reset();
+    void Create(const ysAABB& bounds, ys_int32 recordCapacity);
+    void Destroy();
+
+    // Thread-safe. Records beyond the capacity are dropped until the next Update.
+    void AddRecord(const ysVec4& posWS, const ysVec4& dirWS, ys_float32 weight);
+    ys_int32 GetRecordCount() const;
+
+    // Null if nothing has been learned about the radiance arriving at this point yet. Not to be called during Update.
+    const Distribution* FindDistribution(const ysVec4& posWS) const;
+
+    // Trains the guide on every record deposited since the last update. The job system may be null, in which case training is serial.
+    void Update(ysJobSystem*);
+
+    ys_int32 FindLeaf(ys_int32 nodeIdx, const ysVec4& posWS) const;
+
+    ysArrayG<SpatialNode> m_spatialNodes;
+    ysArrayG<Distribution> m_distributions;
+
+    Record* m_records;
+    ys_int32* m_sortedRecords;
+    std::atomic<ys_int32> m_recordCount;
+    ys_int32 m_recordCapacity;
+};
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include "ysPostProcess.h"
+#include "threading/ysJobSystem.h"
+#include "threading/ysParallelAlgorithms.h"
+
+// Work is divided into spans of this many rows (or pixels, for per-pixel operations), and strips of this many columns
+static const ys_int32 s_rowsPerSpan = 16;
+static const ys_int32 s_pixelsPerSpan = 4096;
+static const ys_int32 s_columnsPerStrip = 64;
+
+// Linear values in [0, 1] are quantized to this many steps before looking up their sRGB encoding, which is fine enough for every step to
+// change the 8-bit result by at most one
+static const ys_int32 s_srgbTableSize = 4096;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct Span
+{
+    ys_int32 begin;
+    ys_int32 end;
+};
+
+// Splits [0, count) into consecutive spans of the given size (save for the last)
+static Span* sCreateSpans(ys_int32 count, ys_int32 spanSize, ys_int32* spanCount)
+{
+    *spanCount = (count + spanSize - 1) / spanSize;
+    Span* spans = static_cast<Span*>(ysMalloc(sizeof(Span) * ysMax(*spanCount, 1)));
+    for (ys_int32 i = 0; i < *spanCount; ++i)
+    {
+        spans[i].begin = spanSize * i;
+        spans[i].end = ysMin(spanSize * (i + 1), count);
+    }
+    return spans;
+}
+
+template <typename SharedDataT>
+static void sForEachSpan(ysJobSystem* jobSystem, ys_int32 count, ys_int32 spanSize, SharedDataT* sd, void(*fcn)(Span&, SharedDataT*))
+{
+    ys_int32 spanCount;
+    Span* spans = sCreateSpans(count, spanSize, &spanCount);
+    if (jobSystem == nullptr)
+    {
+        for (ys_int32 i = 0; i < spanCount; ++i)
+        {
+            fcn(spans[i], sd);
+        }
+    }
+    else if (spanCount > 0)
+    {
+        ysParallelFor(jobSystem, spans, spanCount, sd, 2, fcn);
+    }
+    ysFree(spans);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct BoxFilterData
+{
+    const ysVec4* src;
+    ysVec4* tmp;
+    ysVec4* dst;
+    ys_int32 pixelCountX;
+    ys_int32 pixelCountY;
+    ys_int32 halfWidthX;
+    ys_int32 halfWidthY;
+};
+
+// Horizontal pass over a span of rows. Only the columns whose window fits inside the image are written.
+static void sBoxFilterRows(Span& span, BoxFilterData* bd)
+{
+    const ys_int32 hx = bd->halfWidthX;
+    const ysVec4 scale = ysSplat(1.0f / ys_float32(2 * hx + 1));
+    for (ys_int32 y = span.begin; y < span.end; ++y)
+    {
+        const ysVec4* src = bd->src + bd->pixelCountX * y;
+        ysVec4* tmp = bd->tmp + bd->pixelCountX * y;
+
+        ysVec4 sum = ysVec4_zero;
+        for (ys_int32 x = 0; x < 2 * hx + 1; ++x)
+        {
+            sum += src[x];
+        }
+        tmp[hx] = sum * scale;
+        for (ys_int32 x = hx + 1; x < bd->pixelCountX - hx; ++x)
+        {
+            sum += src[x + hx] - src[x - hx - 1];
+            tmp[x] = sum * scale;
+        }
+    }
+}
+
+// Vertical pass over a strip of columns, which also copies over the pixels left unfiltered. Running along the rows of a strip (rather than
+// down one column at a time) keeps the memory accesses sequential.
+static void sBoxFilterColumns(Span& strip, BoxFilterData* bd)
+{
+    const ys_int32 X = bd->pixelCountX;
+    const ys_int32 Y = bd->pixelCountY;
+    const ys_int32 hx = bd->halfWidthX;
+    const ys_int32 hy = bd->halfWidthY;
+    const ysVec4 scale = ysSplat(1.0f / ys_float32(2 * hy + 1));
+
+    // The columns of the strip whose window fits horizontally
+    ys_int32 xBegin = ysMax(strip.begin, hx);
+    ys_int32 xEnd = ysMin(strip.end, X - hx);
+
+    ysVec4 sums[s_columnsPerStrip];
+    for (ys_int32 x = xBegin; x < xEnd; ++x)
+    {
+        ysVec4 sum = ysVec4_zero;
+        for (ys_int32 y = 0; y < 2 * hy + 1; ++y)
+        {
+            sum += bd->tmp[X * y + x];
+        }
+        sums[x - strip.begin] = sum;
+    }
+
+    for (ys_int32 y = 0; y < Y; ++y)
+    {
+        const ysVec4* src = bd->src + X * y;
+        ysVec4* dst = bd->dst + X * y;
+        if (y < hy || Y - hy <= y || xBegin >= xEnd)
+        {
+            ysMemCpy(dst + strip.begin, src + strip.begin, sizeof(ysVec4) * (strip.end - strip.begin));
+            continue;
+        }
+
+        for (ys_int32 x = strip.begin; x < xBegin; ++x)
+        {
+            dst[x] = src[x];
+        }
+        if (y > hy)
+        {
+            const ysVec4* tmpAdd = bd->tmp + X * (y + hy);
+            const ysVec4* tmpSub = bd->tmp + X * (y - hy - 1);
+            for (ys_int32 x = xBegin; x < xEnd; ++x)
+            {
+                sums[x - strip.begin] += tmpAdd[x] - tmpSub[x];
+            }
+        }
+        for (ys_int32 x = xBegin; x < xEnd; ++x)
+        {
+            dst[x] = sums[x - strip.begin] * scale;
+        }
+        for (ys_int32 x = xEnd; x < strip.end; ++x)
+        {
+            dst[x] = src[x];
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPostProcess_BoxFilter(ysJobSystem* jobSystem, const ysVec4* src, ysVec4* dst, ys_int32 pixelCountX, ys_int32 pixelCountY,
+    ys_int32 halfWidthX, ys_int32 halfWidthY)
+{
+    ysAssert(src != dst && halfWidthX >= 0 && halfWidthY >= 0);
+    ys_int32 pixelCount = pixelCountX * pixelCountY;
+    if (pixelCountX < 2 * halfWidthX + 1 || pixelCountY < 2 * halfWidthY + 1)
+    {
+        // No window fits
+        ysMemCpy(dst, src, sizeof(ysVec4) * pixelCount);
+        return;
+    }
+
+    BoxFilterData boxFilterData;
+    boxFilterData.src = src;
+    boxFilterData.tmp = static_cast<ysVec4*>(ysMalloc(sizeof(ysVec4) * pixelCount));
+    boxFilterData.dst = dst;
+    boxFilterData.pixelCountX = pixelCountX;
+    boxFilterData.pixelCountY = pixelCountY;
+    boxFilterData.halfWidthX = halfWidthX;
+    boxFilterData.halfWidthY = halfWidthY;
+    sForEachSpan(jobSystem, pixelCountY, s_rowsPerSpan, &boxFilterData, sBoxFilterRows);
+    sForEachSpan(jobSystem, pixelCountX, s_columnsPerStrip, &boxFilterData, sBoxFilterColumns);
+    ysFree(boxFilterData.tmp);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct TonemapData
+{
+    ysVec4* pixels;
+    ysSceneRenderInput::Tonemap tonemap;
+    ys_float32 exposure;
+};
+
+static void sTonemap(Span& span, TonemapData* td)
+{
+    const ysVec4 exposure = ysSplat(td->exposure);
+    switch (td->tonemap)
+    {
+        case ysSceneRenderInput::Tonemap::e_linear:
+        {
+            for (ys_int32 i = span.begin; i < span.end; ++i)
+            {
+                td->pixels[i] = td->pixels[i] * exposure;
+            }
+            break;
+        }
+        case ysSceneRenderInput::Tonemap::e_reinhard:
+        {
+            for (ys_int32 i = span.begin; i < span.end; ++i)
+            {
+                ysVec4 x = ysMax(td->pixels[i] * exposure, ysVec4_zero);
+                td->pixels[i] = x / (ysVec4_one + x);
+            }
+            break;
+        }
+        case ysSceneRenderInput::Tonemap::e_aces:
+        {
+            // Krzysztof Narkowicz's fit of the ACES filmic curve: x * (a * x + b) / (x * (c * x + d) + e)
+            const ysVec4 a = ysSplat(2.51f);
+            const ysVec4 b = ysSplat(0.03f);
+            const ysVec4 c = ysSplat(2.43f);
+            const ysVec4 d = ysSplat(0.59f);
+            const ysVec4 e = ysSplat(0.14f);
+            for (ys_int32 i = span.begin; i < span.end; ++i)
+            {
+                ysVec4 x = ysMax(td->pixels[i] * exposure, ysVec4_zero);
+                ysVec4 y = (x * (a * x + b)) / (x * (c * x + d) + e);
+                td->pixels[i] = ysMin(y, ysVec4_one);
+            }
+            break;
+        }
+        default:
+        {
+            ysAssert(false);
+            break;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPostProcess_Tonemap(ysJobSystem* jobSystem, ysVec4* pixels, ys_int32 pixelCount, ysSceneRenderInput::Tonemap tonemap, ys_float32 exposure)
+{
+    if (tonemap == ysSceneRenderInput::Tonemap::e_linear && exposure == 1.0f)
+    {
+        return;
+    }
+    TonemapData tonemapData;
+    tonemapData.pixels = pixels;
+    tonemapData.tonemap = tonemap;
+    tonemapData.exposure = exposure;
+    sForEachSpan(jobSystem, pixelCount, s_pixelsPerSpan, &tonemapData, sTonemap);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ConversionData
+{
+    const ysVec4* src;
+    void* dst;
+};
+
+static void sConvertToFloat3(Span& span, ConversionData* cd)
+{
+    ysFloat3* dst = static_cast<ysFloat3*>(cd->dst);
+    for (ys_int32 i = span.begin; i < span.end; ++i)
+    {
+        dst[i].x = cd->src[i].x;
+        dst[i].y = cd->src[i].y;
+        dst[i].z = cd->src[i].z;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPostProcess_ConvertToFloat3(ysJobSystem* jobSystem, const ysVec4* src, ysFloat3* dst, ys_int32 pixelCount)
+{
+    ConversionData conversionData;
+    conversionData.src = src;
+    conversionData.dst = dst;
+    sForEachSpan(jobSystem, pixelCount, s_pixelsPerSpan, &conversionData, sConvertToFloat3);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Converts the 4 channels at once, returning each half in the low 16 bits of its lane (sign-extended, so that the lanes can be packed with
+// signed saturation). Based on Fabian Giesen's branchless float to half conversion, rounding to nearest even. NaNs stay NaNs and values too
+// large for a half become infinities.
+static __m128i sFloatToHalf(__m128 f)
+{
+    const __m128i signMask = _mm_set1_epi32(ys_int32(0x80000000u));
+    const __m128i f32Infinity = _mm_set1_epi32(255 << 23);
+    const __m128i f16Max = _mm_set1_epi32((127 + 16) << 23);        // Magnitudes from here on round to infinity
+    const __m128i f16MinNormal = _mm_set1_epi32((127 - 14) << 23);  // Magnitudes below this make subnormal halves
+    const __m128i f16Infinity = _mm_set1_epi32(0x7c00);
+    const __m128i f16NanBit = _mm_set1_epi32(0x200);
+    const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23)); // Rebiases the exponent, and rounds half up
+
+    __m128 sign = _mm_and_ps(f, _mm_castsi128_ps(signMask));
+    __m128 absF = _mm_xor_ps(f, sign);
+    __m128i absBits = _mm_castps_si128(absF);
+    __m128i isNan = _mm_cmpgt_epi32(absBits, f32Infinity);
+    __m128i isFinite = _mm_cmpgt_epi32(f16Max, absBits);
+    __m128i isSubnormal = _mm_cmpgt_epi32(f16MinNormal, absBits);
+    __m128i infinityOrNan = _mm_or_si128(_mm_and_si128(isNan, f16NanBit), f16Infinity);
+
+    // Subnormals: Adding the magic number lines up the mantissa bits that survive with the bottom of the float, and rounds them in the
+    // process
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absF, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+    // Normals: Round half up, plus one more if the mantissa would end up odd, which amounts to rounding half to even
+    __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absBits, normalBias), mantissaOdd), 13);
+
+    __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+    __m128i magnitude = _mm_or_si128(_mm_and_si128(isFinite, finite), _mm_andnot_si128(isFinite, infinityOrNan));
+    return _mm_or_si128(magnitude, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+static void sConvertToHalf(Span& span, ConversionData* cd)
+{
+    ys_uint16* dst = static_cast<ys_uint16*>(cd->dst);
+    for (ys_int32 i = span.begin; i < span.end; ++i)
+    {
+        __m128i halves = sFloatToHalf(cd->src[i].simd);
+        ys_uint16 packed[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(packed), _mm_packs_epi32(halves, halves));
+        dst[3 * i + 0] = packed[0];
+        dst[3 * i + 1] = packed[1];
+        dst[3 * i + 2] = packed[2];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPostProcess_ConvertToHalf(ysJobSystem* jobSystem, const ysVec4* src, ys_uint16* dst, ys_int32 pixelCount)
+{
+    ConversionData conversionData;
+    conversionData.src = src;
+    conversionData.dst = dst;
+    sForEachSpan(jobSystem, pixelCount, s_pixelsPerSpan, &conversionData, sConvertToHalf);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct SRGBTable
+{
+    SRGBTable()
+    {
+        for (ys_int32 i = 0; i < s_srgbTableSize; ++i)
+        {
+            ys_float32 linear = ys_float32(i) / ys_float32(s_srgbTableSize - 1);
+            ys_float32 encoded = (linear <= 0.0031308f) ? 12.92f * linear : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+            m_entries[i] = ys_uint8(ysClamp(ys_int32(255.0f * encoded + 0.5f), 0, 255));
+        }
+    }
+
+    ys_uint8 m_entries[s_srgbTableSize];
+};
+
+static void sConvertToSRGB8(Span& span, ConversionData* cd)
+{
+    // Built on first use (thread-safe for function-local statics)
+    static const SRGBTable s_table;
+
+    ys_uint8* dst = static_cast<ys_uint8*>(cd->dst);
+    const __m128 scale = _mm_set1_ps(ys_float32(s_srgbTableSize - 1));
+    for (ys_int32 i = span.begin; i < span.end; ++i)
+    {
+        // Clamping also maps NaNs to 0, since _mm_max_ps returns its second operand when either is a NaN
+        __m128 clamped = _mm_min_ps(_mm_max_ps(cd->src[i].simd, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        ys_int32 indices[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), _mm_cvtps_epi32(_mm_mul_ps(clamped, scale)));
+        dst[3 * i + 0] = s_table.m_entries[indices[0]];
+        dst[3 * i + 1] = s_table.m_entries[indices[1]];
+        dst[3 * i + 2] = s_table.m_entries[indices[2]];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysPostProcess_ConvertToSRGB8(ysJobSystem* jobSystem, const ysVec4* src, ys_uint8* dst, ys_int32 pixelCount)
+{
+    ConversionData conversionData;
+    conversionData.src = src;
+    conversionData.dst = dst;
+    sForEachSpan(jobSystem, pixelCount, s_pixelsPerSpan, &conversionData, sConvertToSRGB8);
+}
\ No newline at end of file
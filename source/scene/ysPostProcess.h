@@ -0,0 +1,26 @@
+#pragma once
+
+#include "YoshiPBR/ysMath.h"
+#include "YoshiPBR/ysStructures.h"
+
+struct ysJobSystem;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Post-processing of final images, whose pixels are stored row after row. Every operation splits the image into spans of rows (or strips of
+// columns) and runs them in parallel on the job system, or serially if the job system is null.
+
+// Averages each pixel over the (2 * halfWidthX + 1) x (2 * halfWidthY + 1) window around it, as two separable passes of running sums, so
+// the cost per pixel does not depend on the window size. Pixels whose window does not fit inside the image are copied as they are.
+// src and dst must not overlap.
+void ysPostProcess_BoxFilter(ysJobSystem*, const ysVec4* src, ysVec4* dst, ys_int32 pixelCountX, ys_int32 pixelCountY,
+    ys_int32 halfWidthX, ys_int32 halfWidthY);
+
+// In place. Scales by the exposure, then compresses the result into [0, 1) unless the tonemap is e_linear.
+void ysPostProcess_Tonemap(ysJobSystem*, ysVec4* pixels, ys_int32 pixelCount, ysSceneRenderInput::Tonemap, ys_float32 exposure);
+
+// Conversions to packed RGB formats, three channels per pixel. Halves are IEEE 754 binary16, rounded to nearest even. 8-bit sRGB clamps to
+// [0, 1] before encoding.
+void ysPostProcess_ConvertToFloat3(ysJobSystem*, const ysVec4* src, ysFloat3* dst, ys_int32 pixelCount);
+void ysPostProcess_ConvertToHalf(ysJobSystem*, const ysVec4* src, ys_uint16* dst, ys_int32 pixelCount);
+void ysPostProcess_ConvertToSRGB8(ysJobSystem*, const ysVec4* src, ys_uint8* dst, ys_int32 pixelCount);
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "ysRadianceCache.h"
+#include "YoshiPBR/ysThreading.h"
+
+#include <math.h>
+#include <new>
+
+// Cells are looked for in this many consecutive slots, starting from the one the cell hashes to
+static const ys_int32 s_probeLength = 8;
+
+// Entries with fewer samples than this are too noisy to terminate paths into
+static const ys_int32 s_minSampleCount = 4;
+
+// Each component of the normal is quantized to this many levels
+static const ys_int32 s_normalLevelCount = 4;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ys_int32 sQuantizeNormal(ys_float32 n)
+{
+    return ysClamp(ys_int32((n + 1.0f) * 0.5f * ys_float32(s_normalLevelCount)), 0, s_normalLevelCount - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRadianceCache::Reset()
+{
+    m_entries = nullptr;
+    m_capacity = 0;
+    m_cellSizeInv = 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRadianceCache::Create(ys_float32 cellSize, ys_int32 capacity)
+{
+    ysAssert(cellSize > 0.0f && capacity > 0);
+    Reset();
+    m_capacity = 1;
+    while (m_capacity < capacity)
+    {
+        m_capacity *= 2;
+    }
+    m_cellSizeInv = 1.0f / cellSize;
+    m_entries = static_cast<Entry*>(ysMalloc(sizeof(Entry) * m_capacity));
+    for (ys_int32 i = 0; i < m_capacity; ++i)
+    {
+        Entry* entry = m_entries + i;
+        new (&entry->m_key) std::atomic<ys_uint32>(0);
+        new (&entry->m_irradianceSum[0]) std::atomic<ys_float32>(0.0f);
+        new (&entry->m_irradianceSum[1]) std::atomic<ys_float32>(0.0f);
+        new (&entry->m_irradianceSum[2]) std::atomic<ys_float32>(0.0f);
+        new (&entry->m_sampleCount) std::atomic<ys_int32>(0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRadianceCache::Destroy()
+{
+    ysSafeFree(m_entries);
+    Reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRadianceCache::Clear()
+{
+    for (ys_int32 i = 0; i < m_capacity; ++i)
+    {
+        Entry* entry = m_entries + i;
+        entry->m_key.store(0, std::memory_order_relaxed);
+        entry->m_irradianceSum[0].store(0.0f, std::memory_order_relaxed);
+        entry->m_irradianceSum[1].store(0.0f, std::memory_order_relaxed);
+        entry->m_irradianceSum[2].store(0.0f, std::memory_order_relaxed);
+        entry->m_sampleCount.store(0, std::memory_order_relaxed);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_int32 ysRadianceCache::ComputeSlot(const ysVec4& posWS, const ysVec4& normalWS, ys_uint32* key) const
+{
+    ysVec4 p = posWS * ysSplat(m_cellSizeInv);
+    ys_uint32 cellX = ys_uint32(ys_int32(floorf(p.x)));
+    ys_uint32 cellY = ys_uint32(ys_int32(floorf(p.y)));
+    ys_uint32 cellZ = ys_uint32(ys_int32(floorf(p.z)));
+    ys_uint32 normal = ys_uint32(sQuantizeNormal(normalWS.x) +
+        s_normalLevelCount * (sQuantizeNormal(normalWS.y) + s_normalLevelCount * sQuantizeNormal(normalWS.z)));
+
+    // Two independent hashes: one picks the slot, the other tells apart the cells that pick the same slot
+    ys_uint32 slotHash = (cellX * 73856093u) ^ (cellY * 19349663u) ^ (cellZ * 83492791u) ^ (normal * 2654435761u);
+    ys_uint32 keyHash = (cellX * 2246822519u) ^ (cellY * 3266489917u) ^ (cellZ * 668265263u) ^ (normal * 374761393u);
+    *key = (keyHash == 0) ? 1 : keyHash;
+    return ys_int32(slotHash & ys_uint32(m_capacity - 1));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysRadianceCache::Lookup(const ysVec4& posWS, const ysVec4& normalWS, ysVec4* irradiance) const
+{
+    ys_uint32 key;
+    ys_int32 slot = ComputeSlot(posWS, normalWS, &key);
+    for (ys_int32 i = 0; i < s_probeLength; ++i)
+    {
+        const Entry* entry = m_entries + ((slot + i) & (m_capacity - 1));
+        ys_uint32 entryKey = entry->m_key.load(std::memory_order_relaxed);
+        if (entryKey == 0)
+        {
+            // Cells are never removed, so the probe for this one would have stopped here had it been inserted
+            return false;
+        }
+        if (entryKey != key)
+        {
+            continue;
+        }
+
+        ys_int32 sampleCount = entry->m_sampleCount.load(std::memory_order_relaxed);
+        if (sampleCount < s_minSampleCount)
+        {
+            return false;
+        }
+        // The sums and the count are updated separately, so the mean is only approximately consistent while other threads add samples
+        ysVec4 sum = ysVecSet(
+            entry->m_irradianceSum[0].load(std::memory_order_relaxed),
+            entry->m_irradianceSum[1].load(std::memory_order_relaxed),
+            entry->m_irradianceSum[2].load(std::memory_order_relaxed), 0.0f);
+        *irradiance = ysMax(sum / ysSplat(ys_float32(sampleCount)), ysVec4_zero);
+        return true;
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRadianceCache::AddSample(const ysVec4& posWS, const ysVec4& normalWS, const ysVec4& irradiance)
+{
+    ysAssert(ysAllGE3(irradiance, ysVec4_zero));
+    ys_uint32 key;
+    ys_int32 slot = ComputeSlot(posWS, normalWS, &key);
+    for (ys_int32 i = 0; i < s_probeLength; ++i)
+    {
+        Entry* entry = m_entries + ((slot + i) & (m_capacity - 1));
+        ys_uint32 entryKey = entry->m_key.load(std::memory_order_relaxed);
+        if (entryKey == 0)
+        {
+            // Claim the free slot, unless another thread beats us to it (possibly with the very same cell)
+            if (entry->m_key.compare_exchange_strong(entryKey, key, std::memory_order_relaxed))
+            {
+                entryKey = key;
+            }
+        }
+        if (entryKey != key)
+        {
+            continue;
+        }
+
+        ysAtomicAdd(entry->m_irradianceSum + 0, irradiance.x);
+        ysAtomicAdd(entry->m_irradianceSum + 1, irradiance.y);
+        ysAtomicAdd(entry->m_irradianceSum + 2, irradiance.z);
+        entry->m_sampleCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+}
\ No newline at end of file
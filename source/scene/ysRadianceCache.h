@@ -0,0 +1,39 @@
+#pragma once
+
+#include "YoshiPBR/ysMath.h"
+
+#include <atomic>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// World-space cache of the irradiance arriving at diffuse surfaces, shared by every render of a scene. Surface points are quantized into
+// cells by position and normal, and each cell is hashed into a fixed-size table (open addressing with a short linear probe). Entries keep a
+// running mean that any number of threads may add to concurrently, so the cache fills up and keeps improving as paths are traced. Cells
+// that cannot find a free slot are simply not cached. (See ysGlobalIlluminationInput_UniDirectional::m_radianceCacheBounceCount)
+struct ysRadianceCache
+{
+    struct Entry
+    {
+        std::atomic<ys_uint32> m_key; // 0 if the slot is free
+        std::atomic<ys_float32> m_irradianceSum[3];
+        std::atomic<ys_int32> m_sampleCount;
+    };
+
+    void Reset();
+    void Create(ys_float32 cellSize, ys_int32 capacity);
+    void Destroy();
+
+    // Not thread-safe. Forgets everything learned so far, e.g. after the lighting has changed.
+    void Clear();
+
+    // Thread-safe. Returns false if the cell holding the point has yet to gather enough samples to be trusted.
+    bool Lookup(const ysVec4& posWS, const ysVec4& normalWS, ysVec4* irradiance) const;
+    void AddSample(const ysVec4& posWS, const ysVec4& normalWS, const ysVec4& irradiance);
+
+    // Returns the key of the cell in *key and the slot where the probe for it begins
+    ys_int32 ComputeSlot(const ysVec4& posWS, const ysVec4& normalWS, ys_uint32* key) const;
+
+    Entry* m_entries;
+    ys_int32 m_capacity; // A power of two
+    ys_float32 m_cellSizeInv;
+};
\ No newline at end of file
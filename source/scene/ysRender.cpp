@@ -1,6 +1,10 @@
 #include "ysRender.h"
+#include "scene/ysPostProcess.h"
 #include "scene/ysScene.h"
 #include "threading/ysJobSystem.h"
+#include "threading/ysParallelAlgorithms.h"
+
+#include <new>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -8,9 +12,29 @@ void ysRender::Reset()
 {
     m_scene = nullptr;
     m_pixels = nullptr;
-    m_exposedPixels = nullptr;
     m_pixelCount = 0;
-    m_interruptLock.Reset();
+    m_tileCoverage = nullptr;
+    m_tileCountX = 0;
+    m_tileCountY = 0;
+    m_aovNormals = nullptr;
+    m_aovDepths = nullptr;
+    m_aovAlbedos = nullptr;
+    m_aovShapeIds = nullptr;
+    m_aovMaterialIds = nullptr;
+    m_aovSampleCounts = nullptr;
+    m_aovFlags = 0;
+    m_camera.Reset();
+    m_splats = nullptr;
+    m_splatPathCount = 0;
+    m_lightSubpathPool = nullptr;
+    m_lightSubpathPoolCount = 0;
+    m_lightSubpathsPerEyeSubpath = 1.0f;
+    m_lightVertexPositions = nullptr;
+    m_lightVertexRefs = nullptr;
+    m_lightVertexCount = 0;
+    m_lightVertexGrid.Reset();
+    m_mergeEta = 0.0f;
+    m_pathGuide.Reset();
     m_state = State::e_pending;
 }
 
@@ -76,18 +100,87 @@ void ysRender::Create(const ysScene* scene, const ysSceneRenderInput& input)
     }
 
     m_pixelCount = input.m_pixelCountX * input.m_pixelCountY;
-    m_pixels = static_cast<Pixel*>(ysMalloc(sizeof(Pixel) * m_pixelCount * 2));
-    m_exposedPixels = m_pixels + m_pixelCount;
+    m_pixels = static_cast<ysVec4*>(ysMalloc(sizeof(ysVec4) * m_pixelCount));
     for (ys_int32 i = 0; i < m_pixelCount; ++i)
     {
-        m_pixels[i].m_value = ysVec4_zero;
-        m_pixels[i].m_isNull = true;
+        m_pixels[i] = ysVec4_zero;
+    }
+
+    m_tileCountX = (input.m_pixelCountX + s_tileSize - 1) / s_tileSize;
+    m_tileCountY = (input.m_pixelCountY + s_tileSize - 1) / s_tileSize;
+    m_tileCoverage = static_cast<std::atomic<ys_uint64>*>(ysMalloc(sizeof(std::atomic<ys_uint64>) * m_tileCountX * m_tileCountY));
+    for (ys_int32 i = 0; i < m_tileCountX * m_tileCountY; ++i)
+    {
+        new (m_tileCoverage + i) std::atomic<ys_uint64>(0);
+    }
 
-        m_exposedPixels[i].m_value = ysVec4_zero;
-        m_exposedPixels[i].m_isNull = true;
+    m_aovFlags = 0;
+    if (m_input.m_renderMode == ysSceneRenderInput::RenderMode::e_regular)
+    {
+        m_aovFlags = m_input.m_aovFlags;
+        if (m_input.m_denoiser != ysSceneRenderInput::Denoiser::e_none)
+        {
+            m_aovFlags |= ysSceneRenderInput::AOV::e_aovNormal | ysSceneRenderInput::AOV::e_aovDepth | ysSceneRenderInput::AOV::e_aovAlbedo;
+        }
+    }
+    m_aovNormals = nullptr;
+    m_aovDepths = nullptr;
+    m_aovAlbedos = nullptr;
+    m_aovShapeIds = nullptr;
+    m_aovMaterialIds = nullptr;
+    m_aovSampleCounts = nullptr;
+    if (m_aovFlags & ysSceneRenderInput::AOV::e_aovNormal)
+    {
+        m_aovNormals = static_cast<ysVec4*>(ysMalloc(sizeof(ysVec4) * m_pixelCount));
+    }
+    if (m_aovFlags & ysSceneRenderInput::AOV::e_aovDepth)
+    {
+        m_aovDepths = static_cast<ys_float32*>(ysMalloc(sizeof(ys_float32) * m_pixelCount));
+    }
+    if (m_aovFlags & ysSceneRenderInput::AOV::e_aovAlbedo)
+    {
+        m_aovAlbedos = static_cast<ysVec4*>(ysMalloc(sizeof(ysVec4) * m_pixelCount));
+    }
+    if (m_aovFlags & ysSceneRenderInput::AOV::e_aovShapeId)
+    {
+        m_aovShapeIds = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * m_pixelCount));
+    }
+    if (m_aovFlags & ysSceneRenderInput::AOV::e_aovMaterialId)
+    {
+        m_aovMaterialIds = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * m_pixelCount));
+    }
+    if (m_aovFlags & ysSceneRenderInput::AOV::e_aovSampleCount)
+    {
+        m_aovSampleCounts = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * m_pixelCount));
+    }
+    for (ys_int32 i = 0; i < m_pixelCount; ++i)
+    {
+        BeginAOVs(i);
     }
 
-    m_interruptLock.Reset();
+    m_camera.Create(input);
+
+    m_splats = nullptr;
+    m_splatPathCount = 0;
+    m_lightSubpathPool = nullptr;
+    m_lightSubpathPoolCount = 0;
+    m_lightSubpathsPerEyeSubpath = 1.0f;
+    m_lightVertexPositions = nullptr;
+    m_lightVertexRefs = nullptr;
+    m_lightVertexCount = 0;
+    m_lightVertexGrid.Reset();
+    m_mergeEta = 0.0f;
+    m_pathGuide.Reset();
+    if (m_input.m_renderMode == ysSceneRenderInput::RenderMode::e_regular &&
+        m_input.m_giInput->m_type == ysGlobalIlluminationInput::Type::e_biDirectional &&
+        static_cast<const ysGlobalIlluminationInput_BiDirectional*>(m_input.m_giInput)->m_lightTracing)
+    {
+        m_splats = static_cast<std::atomic<ys_float32>*>(ysMalloc(sizeof(std::atomic<ys_float32>) * m_pixelCount * 3));
+        for (ys_int32 i = 0; i < m_pixelCount * 3; ++i)
+        {
+            new (m_splats + i) std::atomic<ys_float32>(0.0f);
+        }
+    }
 
     m_state = State::e_initialized;
 }
@@ -97,6 +190,14 @@ void ysRender::Create(const ysScene* scene, const ysSceneRenderInput& input)
 void ysRender::Destroy()
 {
     ysFree(m_pixels);
+    ysFree(m_tileCoverage);
+    ysFree(m_aovNormals);
+    ysFree(m_aovDepths);
+    ysFree(m_aovAlbedos);
+    ysFree(m_aovShapeIds);
+    ysFree(m_aovMaterialIds);
+    ysFree(m_aovSampleCounts);
+    ysFree(m_splats);
     Reset();
 }
 
@@ -111,6 +212,19 @@ void ysRender::DoWork()
     {
         return;
     }
+
+    // Light tracing splats onto any pixel up until the last light subpath, so tiles only hold their final values now
+    if (m_input.m_tileFcn != nullptr && m_splats != nullptr)
+    {
+        for (ys_int32 tileY = 0; tileY < m_tileCountY; ++tileY)
+        {
+            for (ys_int32 tileX = 0; tileX < m_tileCountX; ++tileX)
+            {
+                ys_uint64 coverage = m_tileCoverage[m_tileCountX * tileY + tileX].load(std::memory_order_acquire);
+                HandOverTile(tileX, tileY, coverage);
+            }
+        }
+    }
     m_state = State::e_finished;
 }
 
@@ -121,25 +235,64 @@ void ysRender::GetOutputIntermediate(ysSceneRenderOutputIntermediate* output)
     ysAssert(m_state == State::e_working || m_state == State::e_finished);
     output->m_pixels.SetCount(m_pixelCount);
 
-    ysScopedLock scoped(&m_interruptLock);
+    for (ys_int32 tileY = 0; tileY < m_tileCountY; ++tileY)
+    {
+        for (ys_int32 tileX = 0; tileX < m_tileCountX; ++tileX)
+        {
+            // Pixels published after this load simply show up in the next intermediate output
+            ys_uint64 coverage = m_tileCoverage[m_tileCountX * tileY + tileX].load(std::memory_order_acquire);
+            ysFloat4* dst = output->m_pixels.GetEntries() + m_input.m_pixelCountX * s_tileSize * tileY + s_tileSize * tileX;
+            WriteIntermediateTile(tileX, tileY, coverage, dst, m_input.m_pixelCountX);
+        }
+    }
+}
 
-    for (ys_int32 i = 0; i < m_pixelCount; ++i)
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRender::GetOutputIncremental(ysSceneRenderOutputIncremental* output)
+{
+    ysAssert(m_state == State::e_working || m_state == State::e_finished);
+
+    // A tile's coverage only ever grows, so it doubles as the tile's version
+    ys_int32 tileCount = m_tileCountX * m_tileCountY;
+    if (output->m_tileVersions.GetCount() != tileCount)
     {
-        ysFloat4& intermediatePixel = output->m_pixels[i];
-        const ysRender::Pixel& workingPixel = m_exposedPixels[i];
-        if (workingPixel.m_isNull)
+        output->m_tileVersions.SetCount(tileCount);
+        for (ys_int32 i = 0; i < tileCount; ++i)
         {
-            intermediatePixel.r = 0.0f;
-            intermediatePixel.g = 0.0f;
-            intermediatePixel.b = 0.0f;
-            intermediatePixel.a = 0.0f;
+            output->m_tileVersions[i] = 0;
         }
-        else
+        output->m_splatVersion = 0;
+    }
+
+    // Light tracing splats onto any pixel at any time, so every published pixel is stale whenever more light subpaths have been traced
+    ys_int64 splatVersion = m_splatPathCount.load(std::memory_order_relaxed);
+    bool splatsChanged = (m_splats != nullptr && splatVersion != output->m_splatVersion);
+    output->m_splatVersion = splatVersion;
+
+    output->m_tiles.SetCount(0);
+    output->m_pixels.SetCount(0);
+    for (ys_int32 tileY = 0; tileY < m_tileCountY; ++tileY)
+    {
+        for (ys_int32 tileX = 0; tileX < m_tileCountX; ++tileX)
         {
-            intermediatePixel.r = workingPixel.m_value.x;
-            intermediatePixel.g = workingPixel.m_value.y;
-            intermediatePixel.b = workingPixel.m_value.z;
-            intermediatePixel.a = 1.0f;
+            ys_int32 tileIdx = m_tileCountX * tileY + tileX;
+            ys_uint64 coverage = m_tileCoverage[tileIdx].load(std::memory_order_acquire);
+            bool changed = (coverage != output->m_tileVersions[tileIdx]) || (splatsChanged && coverage != 0);
+            if (changed == false)
+            {
+                continue;
+            }
+            output->m_tileVersions[tileIdx] = coverage;
+
+            ysSceneRenderOutputIncremental::Tile* tile = output->m_tiles.Allocate();
+            tile->m_x = s_tileSize * tileX;
+            tile->m_y = s_tileSize * tileY;
+            tile->m_width = ysMin(s_tileSize, m_input.m_pixelCountX - tile->m_x);
+            tile->m_height = ysMin(s_tileSize, m_input.m_pixelCountY - tile->m_y);
+            tile->m_pixelOffset = output->m_pixels.GetCount();
+            output->m_pixels.SetCount(tile->m_pixelOffset + tile->m_width * tile->m_height);
+            WriteIntermediateTile(tileX, tileY, coverage, output->m_pixels.GetEntries() + tile->m_pixelOffset, tile->m_width);
         }
     }
 }
@@ -152,7 +305,48 @@ void ysRender::GetOutputFinal(ysSceneRenderOutput* output)
     output->m_pixels.SetCount(m_pixelCount);
     ysFloat3* outPixels = output->m_pixels.GetEntries();
 
-    // Tone Mapping
+    // AOVs. Buffers gathered only for the denoiser's sake are not handed out.
+    {
+        ys_uint32 aovFlags = m_aovFlags & m_input.m_aovFlags;
+        output->m_normals.SetCount((aovFlags & ysSceneRenderInput::AOV::e_aovNormal) ? m_pixelCount : 0);
+        output->m_depths.SetCount((aovFlags & ysSceneRenderInput::AOV::e_aovDepth) ? m_pixelCount : 0);
+        output->m_albedos.SetCount((aovFlags & ysSceneRenderInput::AOV::e_aovAlbedo) ? m_pixelCount : 0);
+        output->m_shapeIds.SetCount((aovFlags & ysSceneRenderInput::AOV::e_aovShapeId) ? m_pixelCount : 0);
+        output->m_materialIds.SetCount((aovFlags & ysSceneRenderInput::AOV::e_aovMaterialId) ? m_pixelCount : 0);
+        output->m_sampleCounts.SetCount((aovFlags & ysSceneRenderInput::AOV::e_aovSampleCount) ? m_pixelCount : 0);
+        for (ys_int32 i = 0; i < output->m_normals.GetCount(); ++i)
+        {
+            output->m_normals[i].x = m_aovNormals[i].x;
+            output->m_normals[i].y = m_aovNormals[i].y;
+            output->m_normals[i].z = m_aovNormals[i].z;
+        }
+        for (ys_int32 i = 0; i < output->m_albedos.GetCount(); ++i)
+        {
+            output->m_albedos[i].x = m_aovAlbedos[i].x;
+            output->m_albedos[i].y = m_aovAlbedos[i].y;
+            output->m_albedos[i].z = m_aovAlbedos[i].z;
+        }
+        if (output->m_depths.GetCount() > 0)
+        {
+            ysMemCpy(output->m_depths.GetEntries(), m_aovDepths, sizeof(ys_float32) * m_pixelCount);
+        }
+        if (output->m_shapeIds.GetCount() > 0)
+        {
+            ysMemCpy(output->m_shapeIds.GetEntries(), m_aovShapeIds, sizeof(ys_int32) * m_pixelCount);
+        }
+        if (output->m_materialIds.GetCount() > 0)
+        {
+            ysMemCpy(output->m_materialIds.GetEntries(), m_aovMaterialIds, sizeof(ys_int32) * m_pixelCount);
+        }
+        if (output->m_sampleCounts.GetCount() > 0)
+        {
+            ysMemCpy(output->m_sampleCounts.GetEntries(), m_aovSampleCounts, sizeof(ys_int32) * m_pixelCount);
+        }
+    }
+
+    // Every mode produces an image of ysVec4s, which is then tonemapped and converted to the requested formats
+    ysVec4* image = static_cast<ysVec4*>(ysMalloc(sizeof(ysVec4) * m_pixelCount));
+    ysJobSystem* jobSystem = m_scene->m_jobSystem;
     switch (m_input.m_renderMode)
     {
         case ysSceneRenderInput::RenderMode::e_regular:
@@ -160,67 +354,24 @@ void ysRender::GetOutputFinal(ysSceneRenderOutput* output)
         {
             for (ys_int32 i = 0; i < m_pixelCount; ++i)
             {
-                outPixels[i].r = m_pixels[i].m_value.x;
-                outPixels[i].g = m_pixels[i].m_value.y;
-                outPixels[i].b = m_pixels[i].m_value.z;
+                image[i] = m_pixels[i] + GetSplat(i);
+            }
+            if (m_input.m_renderMode == ysSceneRenderInput::RenderMode::e_regular)
+            {
+                if (m_input.m_denoiser != ysSceneRenderInput::Denoiser::e_none)
+                {
+                    Denoise(image);
+                }
+                ysPostProcess_Tonemap(jobSystem, image, m_pixelCount, m_input.m_tonemap, m_input.m_exposure);
             }
             break;
         }
         case ysSceneRenderInput::RenderMode::e_compare:
         {
+            // Just uniformly average the values for now.
             const ys_int32 kernelHalfWidthX = 4;
             const ys_int32 kernelHalfWidthY = 4;
-            ys_float32 kernel[1 + 2 * kernelHalfWidthY][1 + 2 * kernelHalfWidthX];
-            {
-                // Just uniformly average the values for now.
-                ys_float32 w = 1.0f / ((1.0f + 2.0f * kernelHalfWidthY) * (1.0f + 2.0f * kernelHalfWidthX));
-                for (ys_int32 yIdx = -kernelHalfWidthY; yIdx <= kernelHalfWidthY; ++yIdx)
-                {
-                    ys_int32 i = yIdx + kernelHalfWidthY;
-                    for (ys_int32 xIdx = -kernelHalfWidthX; xIdx <= kernelHalfWidthX; ++xIdx)
-                    {
-                        ys_int32 j = xIdx + kernelHalfWidthX;
-                        kernel[i][j] = w;
-                    }
-                }
-            }
-
-            for (ys_int32 yDst = 0; yDst < m_input.m_pixelCountY; ++yDst)
-            {
-                for (ys_int32 xDst = 0; xDst < m_input.m_pixelCountX; ++xDst)
-                {
-                    ys_int32 pixelIdx = m_input.m_pixelCountX * yDst + xDst;
-
-                    if (yDst < kernelHalfWidthY || m_input.m_pixelCountY - yDst <= kernelHalfWidthY ||
-                        xDst < kernelHalfWidthX || m_input.m_pixelCountX - xDst <= kernelHalfWidthX)
-                    {
-                        outPixels[pixelIdx].r = m_pixels[pixelIdx].m_value.x;
-                        outPixels[pixelIdx].g = m_pixels[pixelIdx].m_value.y;
-                        outPixels[pixelIdx].b = m_pixels[pixelIdx].m_value.z;
-                        continue;
-                    }
-
-                    ysVec4 p = ysVec4_zero;
-                    for (ys_int32 dy = -kernelHalfWidthY; dy <= kernelHalfWidthY; ++dy)
-                    {
-                        ys_int32 iKernel = dy + kernelHalfWidthY;
-                        ys_int32 ySrc = yDst + dy;
-                        for (ys_int32 dx = -kernelHalfWidthX; dx <= kernelHalfWidthX; ++dx)
-                        {
-                            ys_int32 jKernel = dx + kernelHalfWidthX;
-                            ys_int32 xSrc = xDst + dx;
-
-                            ys_float32 w = kernel[iKernel][jKernel];
-                            ysVec4 pSrc = m_pixels[m_input.m_pixelCountX * ySrc + xSrc].m_value;
-                            p += ysSplat(w) * pSrc;
-                        }
-                    }
-
-                    outPixels[pixelIdx].r = p.x;
-                    outPixels[pixelIdx].g = p.y;
-                    outPixels[pixelIdx].b = p.z;
-                }
-            }
+            ysPostProcess_BoxFilter(jobSystem, m_pixels, image, m_input.m_pixelCountX, m_input.m_pixelCountY, kernelHalfWidthX, kernelHalfWidthY);
             break;
         }
         case ysSceneRenderInput::RenderMode::e_depth:
@@ -229,8 +380,7 @@ void ysRender::GetOutputFinal(ysSceneRenderOutput* output)
             ys_float32 maxDepth = 0.0f;
             for (ys_int32 i = 0; i < m_pixelCount; ++i)
             {
-                ysRender::Pixel* pixel = m_pixels + i;
-                ys_float32 depth = pixel->m_value.x;
+                ys_float32 depth = m_pixels[i].x;
                 if (depth < 0.0f)
                 {
                     continue;
@@ -241,22 +391,15 @@ void ysRender::GetOutputFinal(ysSceneRenderOutput* output)
 
             for (ys_int32 i = 0; i < m_pixelCount; ++i)
             {
-                ysFloat3* outPixel = outPixels + i;
-
-                ysRender::Pixel* pixel = m_pixels + i;
-                ys_float32 depth = pixel->m_value.x;
+                ys_float32 depth = m_pixels[i].x;
                 if (depth < 0.0f)
                 {
-                    outPixel->r = 1.0f;
-                    outPixel->g = 0.0f;
-                    outPixel->b = 0.0f;
+                    image[i] = ysVecSet(1.0f, 0.0f, 0.0f);
                 }
                 else
                 {
                     ys_float32 normalizedDepth = (depth - minDepth) / (maxDepth - minDepth);
-                    outPixel->r = normalizedDepth;
-                    outPixel->g = normalizedDepth;
-                    outPixel->b = normalizedDepth;
+                    image[i] = ysVecSet(normalizedDepth, normalizedDepth, normalizedDepth);
                 }
             }
             break;
@@ -267,6 +410,287 @@ void ysRender::GetOutputFinal(ysSceneRenderOutput* output)
             break;
         }
     }
+
+    ysPostProcess_ConvertToFloat3(jobSystem, image, outPixels, m_pixelCount);
+
+    output->m_pixelsHalf.SetCount((m_input.m_outputFormatFlags & ysSceneRenderInput::OutputFormat::e_outputHalf) ? 3 * m_pixelCount : 0);
+    if (output->m_pixelsHalf.GetCount() > 0)
+    {
+        ysPostProcess_ConvertToHalf(jobSystem, image, output->m_pixelsHalf.GetEntries(), m_pixelCount);
+    }
+
+    output->m_pixelsSRGB8.SetCount((m_input.m_outputFormatFlags & ysSceneRenderInput::OutputFormat::e_outputSRGB8) ? 3 * m_pixelCount : 0);
+    if (output->m_pixelsSRGB8.GetCount() > 0)
+    {
+        ysPostProcess_ConvertToSRGB8(jobSystem, image, output->m_pixelsSRGB8.GetEntries(), m_pixelCount);
+    }
+
+    ysFree(image);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRender::BeginAOVs(ys_int32 pixelIdx)
+{
+    if (m_aovNormals != nullptr)
+    {
+        m_aovNormals[pixelIdx] = ysVec4_zero;
+    }
+    if (m_aovDepths != nullptr)
+    {
+        m_aovDepths[pixelIdx] = 0.0f;
+    }
+    if (m_aovAlbedos != nullptr)
+    {
+        m_aovAlbedos[pixelIdx] = ysVec4_zero;
+    }
+    if (m_aovShapeIds != nullptr)
+    {
+        m_aovShapeIds[pixelIdx] = ys_nullIndex;
+    }
+    if (m_aovMaterialIds != nullptr)
+    {
+        m_aovMaterialIds[pixelIdx] = ys_nullIndex;
+    }
+    if (m_aovSampleCounts != nullptr)
+    {
+        m_aovSampleCounts[pixelIdx] = 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRender::AccumulateAOVs(ys_int32 pixelIdx, ys_int32 sampleIdx, const Features& sample)
+{
+    // Ids cannot be averaged, so those of the first sample stick
+    bool firstSample = (sampleIdx == 0);
+
+    if (m_aovNormals != nullptr)
+    {
+        m_aovNormals[pixelIdx] += sample.m_normalWS;
+    }
+    if (m_aovDepths != nullptr)
+    {
+        m_aovDepths[pixelIdx] += sample.m_depth;
+    }
+    if (m_aovAlbedos != nullptr)
+    {
+        m_aovAlbedos[pixelIdx] += sample.m_albedo;
+    }
+    if (m_aovShapeIds != nullptr && firstSample)
+    {
+        m_aovShapeIds[pixelIdx] = sample.m_shapeIdx;
+    }
+    if (m_aovMaterialIds != nullptr && firstSample)
+    {
+        m_aovMaterialIds[pixelIdx] = sample.m_materialIdx;
+    }
+    if (m_aovSampleCounts != nullptr)
+    {
+        m_aovSampleCounts[pixelIdx]++;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRender::EndAOVs(ys_int32 pixelIdx, ys_float32 samplesPerPixelInv)
+{
+    if (m_aovNormals != nullptr)
+    {
+        ysVec4& n = m_aovNormals[pixelIdx];
+        n = ysIsSafeToNormalize3(n) ? ysNormalize3(n) : ysVec4_zero;
+    }
+    if (m_aovDepths != nullptr)
+    {
+        m_aovDepths[pixelIdx] *= samplesPerPixelInv;
+    }
+    if (m_aovAlbedos != nullptr)
+    {
+        m_aovAlbedos[pixelIdx] *= ysSplat(samplesPerPixelInv);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct DenoiseTile
+{
+    ys_int32 xBegin;
+    ys_int32 yBegin;
+    ys_int32 xEnd;
+    ys_int32 yEnd;
+};
+
+struct DenoiseData
+{
+    const ysVec4* normals;
+    const ys_float32* depths;
+    const ysVec4* albedos;
+    ysVec4* src;
+    ysVec4* dst;
+    ys_int32 pixelCountX;
+    ys_int32 pixelCountY;
+    ys_int32 stepWidth;
+    ys_float32 colorSigmaSqr;
+    ys_float32 depthSigma; // Per pixel of distance, relative to the depth
+};
+
+// Edge-stopping parameters. Colors are compared after compressing them to [0, 1) with x / (1 + x), so that the same sigma suits any
+// exposure. Depths may differ by this many pixels' worth of footprint per pixel of distance before weights fall off, which lets surfaces
+// seen at grazing angles blur along themselves. Normals and albedos are compared directly.
+static const ys_float32 s_denoiseColorSigma = 1.0f;
+static const ys_float32 s_denoiseDepthSigma = 8.0f;
+static const ys_float32 s_denoiseNormalPower = 64.0f;
+static const ys_float32 s_denoiseAlbedoSigma = 0.1f;
+static const ys_int32 s_denoiseTileSize = 32;
+
+static void sDenoiseTile(DenoiseTile& tile, DenoiseData* dd)
+{
+    // The B3 spline, by distance from the center tap
+    const ys_float32 kernel[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+    for (ys_int32 y = tile.yBegin; y < tile.yEnd; ++y)
+    {
+        for (ys_int32 x = tile.xBegin; x < tile.xEnd; ++x)
+        {
+            ys_int32 p = dd->pixelCountX * y + x;
+            const ysVec4& np = dd->normals[p];
+            ys_float32 zp = dd->depths[p];
+            const ysVec4& ap = dd->albedos[p];
+            ysVec4 cp = dd->src[p];
+            ysVec4 rp = cp / (ysVec4_one + ysMax(cp, ysVec4_zero));
+            bool pMissed = (ysLengthSqr3(np) == 0.0f);
+
+            ysVec4 sum = ysVec4_zero;
+            ys_float32 sumW = 0.0f;
+            for (ys_int32 dy = -2; dy <= 2; ++dy)
+            {
+                ys_int32 yq = y + dy * dd->stepWidth;
+                if (yq < 0 || dd->pixelCountY <= yq)
+                {
+                    continue;
+                }
+                for (ys_int32 dx = -2; dx <= 2; ++dx)
+                {
+                    ys_int32 xq = x + dx * dd->stepWidth;
+                    if (xq < 0 || dd->pixelCountX <= xq)
+                    {
+                        continue;
+                    }
+
+                    ys_int32 q = dd->pixelCountX * yq + xq;
+                    const ysVec4& nq = dd->normals[q];
+                    ysVec4 cq = dd->src[q];
+                    ysVec4 rq = cq / (ysVec4_one + ysMax(cq, ysVec4_zero));
+
+                    // Pixels that saw nothing only blend with each other
+                    bool qMissed = (ysLengthSqr3(nq) == 0.0f);
+                    if (pMissed != qMissed)
+                    {
+                        continue;
+                    }
+
+                    ys_float32 w = kernel[ysAbs(dx)] * kernel[ysAbs(dy)];
+                    w *= expf(-ysLengthSqr3(rp - rq) / dd->colorSigmaSqr);
+                    if (pMissed == false && q != p)
+                    {
+                        ys_float32 distance = ys_float32(dd->stepWidth) * sqrtf(ys_float32(dx * dx + dy * dy));
+                        w *= powf(ysMax(ysDot3(np, nq), 0.0f), s_denoiseNormalPower);
+                        w *= expf(-ysAbs(zp - dd->depths[q]) / (dd->depthSigma * zp * distance));
+                        w *= expf(-ysLengthSqr3(ap - dd->albedos[q]) / (s_denoiseAlbedoSigma * s_denoiseAlbedoSigma));
+                    }
+
+                    sum += ysSplat(w) * cq;
+                    sumW += w;
+                }
+            }
+
+            // The center tap always has a positive weight
+            ysAssert(sumW > 0.0f);
+            dd->dst[p] = sum / ysSplat(sumW);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRender::Denoise(ysVec4* radiance) const
+{
+    ysAssert(m_input.m_denoiser == ysSceneRenderInput::Denoiser::e_aTrous);
+    ysAssert(m_aovNormals != nullptr && m_aovDepths != nullptr && m_aovAlbedos != nullptr);
+
+    // Texture detail is kept out of the filter's way by filtering the incident lighting rather than the radiance, i.e. dividing out the
+    // albedo beforehand and multiplying it back in afterwards. Where the albedo is black, the radiance is filtered as is.
+    auto Demodulator = [](const ysVec4& albedo) -> ysVec4
+    {
+        return ysVecSet(
+            albedo.x > ys_epsilon ? albedo.x : 1.0f,
+            albedo.y > ys_epsilon ? albedo.y : 1.0f,
+            albedo.z > ys_epsilon ? albedo.z : 1.0f, 1.0f);
+    };
+
+    ysVec4* buffers = static_cast<ysVec4*>(ysMalloc(sizeof(ysVec4) * m_pixelCount));
+    for (ys_int32 i = 0; i < m_pixelCount; ++i)
+    {
+        radiance[i] = radiance[i] / Demodulator(m_aovAlbedos[i]);
+    }
+
+    ys_int32 tileCountX = (m_input.m_pixelCountX + s_denoiseTileSize - 1) / s_denoiseTileSize;
+    ys_int32 tileCountY = (m_input.m_pixelCountY + s_denoiseTileSize - 1) / s_denoiseTileSize;
+    ys_int32 tileCount = tileCountX * tileCountY;
+    DenoiseTile* tiles = static_cast<DenoiseTile*>(ysMalloc(sizeof(DenoiseTile) * tileCount));
+    for (ys_int32 i = 0; i < tileCountY; ++i)
+    {
+        for (ys_int32 j = 0; j < tileCountX; ++j)
+        {
+            DenoiseTile* tile = tiles + tileCountX * i + j;
+            tile->xBegin = s_denoiseTileSize * j;
+            tile->yBegin = s_denoiseTileSize * i;
+            tile->xEnd = ysMin(tile->xBegin + s_denoiseTileSize, m_input.m_pixelCountX);
+            tile->yEnd = ysMin(tile->yBegin + s_denoiseTileSize, m_input.m_pixelCountY);
+        }
+    }
+
+    // The footprint of a pixel at unit depth
+    ys_float32 pixelAngle = 2.0f * tanf(m_input.m_fovY) / ys_float32(m_input.m_pixelCountY);
+
+    DenoiseData denoiseData;
+    denoiseData.normals = m_aovNormals;
+    denoiseData.depths = m_aovDepths;
+    denoiseData.albedos = m_aovAlbedos;
+    denoiseData.src = radiance;
+    denoiseData.dst = buffers;
+    denoiseData.pixelCountX = m_input.m_pixelCountX;
+    denoiseData.pixelCountY = m_input.m_pixelCountY;
+    denoiseData.depthSigma = s_denoiseDepthSigma * pixelAngle;
+    for (ys_int32 iteration = 0; iteration < m_input.m_denoiseIterationCount; ++iteration)
+    {
+        // The color weights tighten as the kernel widens, so that the later iterations only smooth what is left of the noise
+        ys_float32 colorSigma = s_denoiseColorSigma / ys_float32(1 << iteration);
+        denoiseData.stepWidth = 1 << iteration;
+        denoiseData.colorSigmaSqr = colorSigma * colorSigma;
+        if (m_scene->m_jobSystem == nullptr)
+        {
+            for (ys_int32 i = 0; i < tileCount; ++i)
+            {
+                sDenoiseTile(tiles[i], &denoiseData);
+            }
+        }
+        else
+        {
+            ysParallelFor(m_scene->m_jobSystem, tiles, tileCount, &denoiseData, 2, sDenoiseTile);
+        }
+        ysSwap(denoiseData.src, denoiseData.dst);
+    }
+
+    // After an odd number of iterations, the result is in the scratch buffer
+    const ysVec4* result = denoiseData.src;
+    for (ys_int32 i = 0; i < m_pixelCount; ++i)
+    {
+        radiance[i] = result[i] * Demodulator(m_aovAlbedos[i]);
+    }
+
+    ysFree(tiles);
+    ysFree(buffers);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -287,6 +711,113 @@ void ysRender::Terminate(const ysScene* scene)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRender::PublishPixel(ys_int32 pixelIdx)
+{
+    ysAssert(0 <= pixelIdx && pixelIdx < m_pixelCount);
+    ys_int32 x = pixelIdx % m_input.m_pixelCountX;
+    ys_int32 y = pixelIdx / m_input.m_pixelCountX;
+    ys_int32 tileX = x / s_tileSize;
+    ys_int32 tileY = y / s_tileSize;
+    ys_int32 tileIdx = m_tileCountX * tileY + tileX;
+    ys_uint64 bit = ys_uint64(1) << (s_tileSize * (y % s_tileSize) + (x % s_tileSize));
+    if (m_input.m_tileFcn == nullptr || m_splats != nullptr)
+    {
+        // Tiles with light tracing splats are handed over once the whole render is done (see DoWork)
+        m_tileCoverage[tileIdx].fetch_or(bit, std::memory_order_release);
+        return;
+    }
+
+    // Acquiring as well makes the pixels published by other workers visible to whichever worker completes the tile
+    ys_uint64 coverage = m_tileCoverage[tileIdx].fetch_or(bit, std::memory_order_acq_rel) | bit;
+    HandOverTile(tileX, tileY, coverage);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRender::HandOverTile(ys_int32 tileX, ys_int32 tileY, ys_uint64 coverage)
+{
+    ysRenderTile tile;
+    tile.m_x = s_tileSize * tileX;
+    tile.m_y = s_tileSize * tileY;
+    tile.m_width = ysMin(s_tileSize, m_input.m_pixelCountX - tile.m_x);
+    tile.m_height = ysMin(s_tileSize, m_input.m_pixelCountY - tile.m_y);
+    ys_uint64 rowMask = (ys_uint64(1) << tile.m_width) - 1;
+    for (ys_int32 row = 0; row < tile.m_height; ++row)
+    {
+        if (((coverage >> (s_tileSize * row)) & rowMask) != rowMask)
+        {
+            return;
+        }
+    }
+
+    ysFloat4 pixels[s_tileSize * s_tileSize];
+    WriteIntermediateTile(tileX, tileY, coverage, pixels, tile.m_width);
+    tile.m_pixels = pixels;
+    tile.m_samplesPerPixel = m_input.m_samplesPerPixel;
+    m_input.m_tileFcn(tile, m_input.m_tileFcnArg);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRender::WriteIntermediateTile(ys_int32 tileX, ys_int32 tileY, ys_uint64 coverage, ysFloat4* dst, ys_int32 dstStride) const
+{
+    ys_int32 yBegin = s_tileSize * tileY;
+    ys_int32 xBegin = s_tileSize * tileX;
+    ys_int32 yEnd = ysMin(yBegin + s_tileSize, m_input.m_pixelCountY);
+    ys_int32 xEnd = ysMin(xBegin + s_tileSize, m_input.m_pixelCountX);
+    for (ys_int32 y = yBegin; y < yEnd; ++y)
+    {
+        for (ys_int32 x = xBegin; x < xEnd; ++x)
+        {
+            ys_int32 pixelIdx = m_input.m_pixelCountX * y + x;
+            ysFloat4& intermediatePixel = dst[dstStride * (y - yBegin) + (x - xBegin)];
+            ys_uint64 bit = ys_uint64(1) << (s_tileSize * (y - yBegin) + (x - xBegin));
+            if ((coverage & bit) == 0)
+            {
+                intermediatePixel.r = 0.0f;
+                intermediatePixel.g = 0.0f;
+                intermediatePixel.b = 0.0f;
+                intermediatePixel.a = 0.0f;
+            }
+            else
+            {
+                ysVec4 value = m_pixels[pixelIdx] + GetSplat(pixelIdx);
+                intermediatePixel.r = value.x;
+                intermediatePixel.g = value.y;
+                intermediatePixel.b = value.z;
+                intermediatePixel.a = 1.0f;
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRender::AddSplat(ys_int32 pixelIdx, const ysVec4& value)
+{
+    ysAssert(m_splats != nullptr && 0 <= pixelIdx && pixelIdx < m_pixelCount);
+    std::atomic<ys_float32>* dst = m_splats + 3 * pixelIdx;
+    ysAtomicAdd(dst + 0, value.x);
+    ysAtomicAdd(dst + 1, value.y);
+    ysAtomicAdd(dst + 2, value.z);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysVec4 ysRender::GetSplat(ys_int32 pixelIdx) const
+{
+    ys_int64 pathCount = m_splatPathCount.load(std::memory_order_relaxed);
+    if (m_splats == nullptr || pathCount == 0)
+    {
+        return ysVec4_zero;
+    }
+    const std::atomic<ys_float32>* src = m_splats + 3 * pixelIdx;
+    ysVec4 sum = ysVecSet(src[0].load(std::memory_order_relaxed), src[1].load(std::memory_order_relaxed), src[2].load(std::memory_order_relaxed), 0.0f);
+    return sum / ysSplat(ys_float32(pathCount));
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 static ysRender* sGetRenderFromId(ysRenderId id)
@@ -337,6 +868,14 @@ void ysRender_GetIntermediateOutput(ysRenderId id, ysSceneRenderOutputIntermedia
     render->GetOutputIntermediate(output);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysRender_GetIntermediateOutputIncremental(ysRenderId id, ysSceneRenderOutputIncremental* output)
+{
+    ysRender* render = sGetRenderFromId(id);
+    render->GetOutputIncremental(output);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool ysRender_WorkFinished(ysRenderId id)
@@ -4,9 +4,13 @@
 #include "YoshiPBR/ysStructures.h"
 #include "YoshiPBR/ysThreading.h"
 
+#include "geo/ysHashGrid.h"
+#include "scene/ysCamera.h"
+#include "scene/ysPathGuide.h"
+
 #include <atomic>
 
-struct ysLock;
+struct ysLightSubpath;
 struct ysScene;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -22,10 +26,14 @@ struct ysRender
         e_terminated,
     };
 
-    struct Pixel
+    // The surface first seen along a single primary ray. Misses are all zeros, with null ids.
+    struct Features
     {
-        ysVec4 m_value;
-        bool m_isNull;
+        ysVec4 m_albedo;
+        ysVec4 m_normalWS;
+        ys_float32 m_depth;
+        ys_int32 m_shapeIdx;
+        ys_int32 m_materialIdx;
     };
 
     void Reset();
@@ -34,21 +42,87 @@ struct ysRender
 
     void DoWork();
     void GetOutputIntermediate(ysSceneRenderOutputIntermediate*);
+    void GetOutputIncremental(ysSceneRenderOutputIncremental*);
     void GetOutputFinal(ysSceneRenderOutput*);
     void Terminate(const ysScene*);
 
+    // Thread-safe. Makes the pixel's final value visible to GetOutputIntermediate. The pixel must not be written to afterwards.
+    // Hands the pixel's tile over to the input's m_tileFcn if it was the last of its pixels, unless light tracing may splat onto it later.
+    void PublishPixel(ys_int32 pixelIdx);
+
+    // Invokes the input's m_tileFcn with the tile, if the coverage spans all of its pixels
+    void HandOverTile(ys_int32 tileX, ys_int32 tileY, ys_uint64 coverage);
+
+    // Writes out the intermediate values of a tile's pixels, given the tile's coverage. dst points to the tile's top left pixel, and
+    // consecutive rows are dstStride pixels apart.
+    void WriteIntermediateTile(ys_int32 tileX, ys_int32 tileY, ys_uint64 coverage, ysFloat4* dst, ys_int32 dstStride) const;
+
+    // A pixel's AOVs are summed over its samples like its radiance, then averaged once the last sample is in. Only the buffers present are
+    // written to. Not thread-safe for a given pixel.
+    void BeginAOVs(ys_int32 pixelIdx);
+    void AccumulateAOVs(ys_int32 pixelIdx, ys_int32 sampleIdx, const Features& sample);
+    void EndAOVs(ys_int32 pixelIdx, ys_float32 samplesPerPixelInv);
+
+    // Filters the radiance of every pixel in place. (See ysSceneRenderInput::m_denoiser)
+    void Denoise(ysVec4* radiance) const;
+
+    // Thread-safe. Adds to the running sum of light subpath contributions for the pixel.
+    void AddSplat(ys_int32 pixelIdx, const ysVec4& value);
+    ysVec4 GetSplat(ys_int32 pixelIdx) const;
+
     const ysScene* m_scene;
 
     // Save off the input. This is a deep copy, which is why we have pre allocated some space for GI inputs.
     ysSceneRenderInput m_input;
     ysGlobalIlluminationInput_UniDirectional m_inputsUni[2];
-    ysGlobalIlluminationInput_UniDirectional m_inputsBi[2];
+    ysGlobalIlluminationInput_BiDirectional m_inputsBi[2];
 
-    Pixel* m_pixels;
-    Pixel* m_exposedPixels;
+    // Pixels are published for intermediate output in square tiles, without locks. Every pixel is written by a single worker and left alone
+    // once done, at which point its bit in its tile's coverage mask is set with release semantics. Readers acquire the masks and only
+    // read the pixels they cover, so they never see a pixel mid-write and never hold up the workers.
+    static const ys_int32 s_tileSize = 8; // Coverage bit y * s_tileSize + x for the pixel at (x, y) within the tile
+    static_assert(s_tileSize * s_tileSize <= 64, "Tile coverage must fit in 64 bits");
+    ysVec4* m_pixels;
     ys_int32 m_pixelCount;
+    std::atomic<ys_uint64>* m_tileCoverage;
+    ys_int32 m_tileCountX;
+    ys_int32 m_tileCountY;
+
+    // Planar AOV buffers, gathered from the primary rays. Each is null unless requested by the input or needed by the denoiser, and m_aovFlags
+    // tells which are present. (See ysSceneRenderOutput for what each holds)
+    ysVec4* m_aovNormals; // Normalized once the pixel is done, unless every sample missed
+    ys_float32* m_aovDepths;
+    ysVec4* m_aovAlbedos;
+    ys_int32* m_aovShapeIds;
+    ys_int32* m_aovMaterialIds;
+    ys_int32* m_aovSampleCounts;
+    ys_uint32 m_aovFlags;
+
+    ysCamera m_camera;
+
+    // Light subpaths connected directly to the camera (t=1 strategies) may land on any pixel, so their contributions are summed here
+    // separately from m_pixels using atomics (3 channels per pixel). Null unless the render uses bidirectional path tracing with light
+    // tracing enabled. Each pixel's estimate is the sum divided by the number of light subpaths traced so far.
+    std::atomic<ys_float32>* m_splats;
+    std::atomic<ys_int64> m_splatPathCount;
+
+    // Bidirectional only. Light subpaths shared by every eye subpath in the current batch of pixels, or null if each eye subpath traces
+    // its own (see ysGlobalIlluminationInput_BiDirectional::m_lightSubpathPoolSize). Owned and refilled by ysScene::DoRenderWork.
+    ysLightSubpath* m_lightSubpathPool;
+    ys_int32 m_lightSubpathPoolCount;
+    ys_float32 m_lightSubpathsPerEyeSubpath; // Over the whole render. Needed to weight the light tracing (t=1) strategies.
+
+    // Vertex merging only. Every vertex of the pooled light subpaths except the one on the light, as a position and a reference
+    // (pool index * ysLightSubpath::s_nLCeil + vertex index). Rebuilt along with the pool, and indexed by m_lightVertexGrid.
+    ysVec4* m_lightVertexPositions;
+    ys_int32* m_lightVertexRefs;
+    std::atomic<ys_int32> m_lightVertexCount;
+    ysHashGrid m_lightVertexGrid;
+    ys_float32 m_mergeEta; // For the current pass. (See ysScene::GenerateSubpathInput::mergeEta)
 
-    ysLock m_interruptLock;
+    // Unidirectional only. Trained between passes by ysScene::DoRenderWork when path guiding is enabled, and unused (m_records is null)
+    // otherwise. (See ysGlobalIlluminationInput_UniDirectional::m_pathGuiding)
+    ysPathGuide m_pathGuide;
 
     std::atomic<State> m_state;
 
@@ -7,15 +7,20 @@
 #include "mat/reflective/ysMaterial.h"
 #include "mat/reflective/ysMaterialMirror.h"
 #include "mat/reflective/ysMaterialStandard.h"
+#include "scene/ysRadianceCache.h"
 #include "threading/ysJobSystem.h"
 #include "threading/ysParallelAlgorithms.h"
 #include "YoshiPBR/ysEllipsoid.h"
+#include "YoshiPBR/ysMesh.h"
+#include "YoshiPBR/ysMeshInstance.h"
 #include "YoshiPBR/ysRay.h"
 #include "YoshiPBR/ysShape.h"
 #include "YoshiPBR/ysStructures.h"
 #include "YoshiPBR/ysThreading.h"
 #include "YoshiPBR/ysTriangle.h"
 
+#include <algorithm>
+
 ysScene* ysScene::s_scenes[YOSHIPBR_MAX_SCENE_COUNT] = { nullptr };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -35,6 +40,7 @@ struct CollectClosestReflectiveData
 {
     const ysScene* m_scene;
     ysShapeId m_ignoreShapeId;
+    ys_int32 m_ignorePrimitiveIndex;
 
     bool m_hit;
     ysSceneRayCastOutput m_output;
@@ -43,7 +49,7 @@ struct CollectClosestReflectiveData
 static ysRayCastFlowControlCode sCollectClosestReflective(const ysSceneRayCastOutput& hitOutput, void* voidData)
 {
     CollectClosestReflectiveData* data = static_cast<CollectClosestReflectiveData*>(voidData);
-    if (hitOutput.m_shapeId == data->m_ignoreShapeId)
+    if (hitOutput.m_shapeId == data->m_ignoreShapeId && hitOutput.m_primitiveIndex == data->m_ignorePrimitiveIndex)
     {
         return ysRayCastFlowControlCode::e_continue;
     }
@@ -58,20 +64,24 @@ static ysRayCastFlowControlCode sCollectClosestReflective(const ysSceneRayCastOu
     return ysRayCastFlowControlCode::e_continue;
 }
 
-static bool sRayCastClosestReflective(const ysScene* scene, ysSceneRayCastOutput* output, const ysSceneRayCastInput& input, const ysShapeId& ignoreShapeId)
+// Hits on the ignored shape are skipped, unless the shape is a mesh instance, in which case only hits on the ignored triangle are skipped
+static bool sRayCastClosestReflective(const ysScene* scene, ysSceneRayCastOutput* output, const ysSceneRayCastInput& input, const ysShapeId& ignoreShapeId,
+    ys_int32 ignorePrimitiveIdx)
 {
     CollectClosestReflectiveData data;
     data.m_scene = scene;
     data.m_ignoreShapeId = ignoreShapeId;
+    data.m_ignorePrimitiveIndex = ignorePrimitiveIdx;
     data.m_hit = false;
     scene->m_bvh.RayCast(scene, input, &data, sCollectClosestReflective);
     *output = data.m_output;
     return data.m_hit;
 }
 
-static bool sRayCastClosestReflective(const ysScene* scene, ysSceneRayCastOutput* output, const ysSceneRayCastInput& input, const ysShape* ignoreShape)
+static bool sRayCastClosestReflective(const ysScene* scene, ysSceneRayCastOutput* output, const ysSceneRayCastInput& input, const ysShape* ignoreShape,
+    ys_int32 ignorePrimitiveIdx)
 {
-    return sRayCastClosestReflective(scene, output, input, sShapeIdFromPtr(scene, ignoreShape));
+    return sRayCastClosestReflective(scene, output, input, sShapeIdFromPtr(scene, ignoreShape), ignorePrimitiveIdx);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -90,6 +100,7 @@ struct CollectEmissivesAndClosestReflectiveData
 {
     const ysScene* m_scene;
     ysShapeId m_ignoreShapeId;
+    ys_int32 m_ignorePrimitiveIndex;
 
     SingleReflectiveMultipleEmissives* m_output;
 };
@@ -97,7 +108,7 @@ struct CollectEmissivesAndClosestReflectiveData
 static ysRayCastFlowControlCode sCollectEmissivesAndClosestReflective(const ysSceneRayCastOutput& hitOutput, void* voidData)
 {
     CollectEmissivesAndClosestReflectiveData* data = static_cast<CollectEmissivesAndClosestReflectiveData*>(voidData);
-    if (hitOutput.m_shapeId == data->m_ignoreShapeId)
+    if (hitOutput.m_shapeId == data->m_ignoreShapeId && hitOutput.m_primitiveIndex == data->m_ignorePrimitiveIndex)
     {
         return ysRayCastFlowControlCode::e_continue;
     }
@@ -123,7 +134,8 @@ static void sRayCastClosestReflective_CollectEmissives
     const ysScene* scene,
     SingleReflectiveMultipleEmissives* output,
     const ysSceneRayCastInput& input,
-    const ysShapeId& ignoreShapeId
+    const ysShapeId& ignoreShapeId,
+    ys_int32 ignorePrimitiveIdx
 )
 {
     output->m_hitReflective = false;
@@ -132,6 +144,7 @@ static void sRayCastClosestReflective_CollectEmissives
     CollectEmissivesAndClosestReflectiveData data;
     data.m_scene = scene;
     data.m_ignoreShapeId = ignoreShapeId;
+    data.m_ignorePrimitiveIndex = ignorePrimitiveIdx;
     data.m_output = output;
 
     scene->m_bvh.RayCast(scene, input, &data, sCollectEmissivesAndClosestReflective);
@@ -154,34 +167,412 @@ static void sRayCastClosestReflective_CollectEmissives
     output->m_emissiveCount = n;
 }
 
-static void sRayCastClosestReflective_CollectEmissives(const ysScene* scene, SingleReflectiveMultipleEmissives* output, const ysSceneRayCastInput& input, const ysShape* ingoreShape)
+static void sRayCastClosestReflective_CollectEmissives(const ysScene* scene, SingleReflectiveMultipleEmissives* output, const ysSceneRayCastInput& input, const ysShape* ingoreShape,
+    ys_int32 ignorePrimitiveIdx)
 {
-    sRayCastClosestReflective_CollectEmissives(scene, output, input, sShapeIdFromPtr(scene, ingoreShape));
+    sRayCastClosestReflective_CollectEmissives(scene, output, input, sShapeIdFromPtr(scene, ingoreShape), ignorePrimitiveIdx);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Radiance emitted by the hit surface towards 'dirWS'. The surface must be emissive.
+static ysVec4 sEmittedRadiance(const ysScene* scene, const ysVec4& dirWS, const ysSceneRayCastOutput& o)
+{
+    const ysShape* s = scene->m_shapes + o.m_shapeId.m_index;
+    ysAssert(s->m_emissiveMaterialId != ys_nullEmissiveMaterialId);
+    const ysEmissiveMaterial* e = scene->m_emissiveMaterials + s->m_emissiveMaterialId.m_index;
+    ysMtx44 R;
+    R.cx = o.m_hitTangent;
+    R.cy = ysCross(o.m_hitNormal, o.m_hitTangent);
+    R.cz = o.m_hitNormal;
+    // In principle, sampling directionally-specular emission is inconceivable for unidirectional path tracing.
+    ysRadiance L = e->EvaluateRadiance(scene, ysMulT33(R, dirWS));
+    return L.m_isFinite ? L.m_value : ysVec4_zero;
+}
+
 static ysVec4 sAccumulateDirectRadiance(const ysScene* scene, const ysVec4& dirWS, const ysSceneRayCastOutput* emissiveHits, ys_int32 emissiveHitCount)
 {
     ysVec4 radiance = ysVec4_zero;
     for (ys_int32 i = 0; i < emissiveHitCount; ++i)
     {
-        const ysSceneRayCastOutput& o = emissiveHits[i];
-        const ysShape* s = scene->m_shapes + o.m_shapeId.m_index;
-        ysAssert(s->m_materialId == ys_nullMaterialId);
-        ysAssert(s->m_emissiveMaterialId != ys_nullEmissiveMaterialId);
-        const ysEmissiveMaterial* e = scene->m_emissiveMaterials + s->m_emissiveMaterialId.m_index;
-        ysMtx44 R;
-        R.cx = o.m_hitTangent;
-        R.cy = ysCross(o.m_hitNormal, o.m_hitTangent);
-        R.cz = o.m_hitNormal;
-        ysRadiance L = e->EvaluateRadiance(scene, ysMulT33(R, dirWS));
-        if (L.m_isFinite)
+        ysAssert(scene->m_shapes[emissiveHits[i].m_shapeId.m_index].m_materialId == ys_nullMaterialId);
+        radiance += sEmittedRadiance(scene, dirWS, emissiveHits[i]);
+    }
+    return radiance;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copies the vertices into the mesh's tightly packed buffers, normalizing the normals along the way. Strides of 0 mean tightly packed. The
+// buffers must be writable, i.e. owned by the mesh or mapped from a scene file.
+static void sGatherVertices(ysMesh* dst, const ysFloat3* srcPositions, ys_int32 srcPositionStride, const ysFloat3* srcNormals,
+    ys_int32 srcNormalStride)
+{
+    ysAssert(dst->m_positionStride == ys_int32(sizeof(ysFloat3)) && dst->m_normalStride == ys_int32(sizeof(ysFloat3)));
+    ys_int32 positionStride = (srcPositionStride == 0) ? ys_int32(sizeof(ysFloat3)) : srcPositionStride;
+    ys_int32 normalStride = (srcNormalStride == 0) ? ys_int32(sizeof(ysFloat3)) : srcNormalStride;
+
+    const ys_uint8* positionBytes = reinterpret_cast<const ys_uint8*>(srcPositions);
+    ysFloat3* positions = reinterpret_cast<ysFloat3*>(const_cast<ys_uint8*>(dst->m_positions));
+    for (ys_int32 i = 0; i < dst->m_vertexCount; ++i)
+    {
+        positions[i] = *reinterpret_cast<const ysFloat3*>(positionBytes + ys_int64(positionStride) * i);
+    }
+
+    if (srcNormals != nullptr)
+    {
+        ysAssert(dst->m_normals != nullptr);
+        const ys_uint8* normalBytes = reinterpret_cast<const ys_uint8*>(srcNormals);
+        ysFloat3* normals = reinterpret_cast<ysFloat3*>(const_cast<ys_uint8*>(dst->m_normals));
+        for (ys_int32 i = 0; i < dst->m_vertexCount; ++i)
         {
-            radiance += L.m_value;
+            const ysFloat3* srcNormal = reinterpret_cast<const ysFloat3*>(normalBytes + ys_int64(normalStride) * i);
+            ysVec4 n = ysVecSet(srcNormal->x, srcNormal->y, srcNormal->z);
+            n = ysIsSafeToNormalize3(n) ? ysNormalize3(n) : ysVec4_zero;
+            normals[i].x = n.x;
+            normals[i].y = n.y;
+            normals[i].z = n.z;
         }
     }
-    return radiance;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sCreateMesh(ysMesh* dst, const ysMeshDef& src)
+{
+    dst->m_vertexCount = src.m_vertexCount;
+    dst->m_triangleCount = src.m_triangleCount;
+    dst->m_twoSided = src.m_twoSided;
+    if (src.m_referenceBuffers)
+    {
+        ys_int32 positionStride = (src.m_positionStride == 0) ? ys_int32(sizeof(ysFloat3)) : src.m_positionStride;
+        ys_int32 normalStride = (src.m_normalStride == 0) ? ys_int32(sizeof(ysFloat3)) : src.m_normalStride;
+        ysAssert(positionStride % 4 == 0 && normalStride % 4 == 0);
+        ysAssert(reinterpret_cast<ys_uint64>(src.m_positions) % 4 == 0);
+        ysAssert(reinterpret_cast<ys_uint64>(src.m_normals) % 4 == 0);
+        ysAssert(reinterpret_cast<ys_uint64>(src.m_indices) % 4 == 0);
+        dst->m_positions = reinterpret_cast<const ys_uint8*>(src.m_positions);
+        dst->m_normals = reinterpret_cast<const ys_uint8*>(src.m_normals);
+        dst->m_indices = src.m_indices;
+        dst->m_positionStride = positionStride;
+        dst->m_normalStride = normalStride;
+        dst->m_ownsBuffers = false;
+    }
+    else
+    {
+        ysFloat3* positions = static_cast<ysFloat3*>(ysMalloc(sizeof(ysFloat3) * src.m_vertexCount));
+        ysFloat3* normals = nullptr;
+        if (src.m_normals != nullptr)
+        {
+            normals = static_cast<ysFloat3*>(ysMalloc(sizeof(ysFloat3) * src.m_vertexCount));
+        }
+
+        ys_int32* indices = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * 3 * src.m_triangleCount));
+        ysMemCpy(indices, src.m_indices, sizeof(ys_int32) * 3 * src.m_triangleCount);
+
+        dst->m_positions = reinterpret_cast<const ys_uint8*>(positions);
+        dst->m_normals = reinterpret_cast<const ys_uint8*>(normals);
+        dst->m_indices = indices;
+        dst->m_positionStride = ys_int32(sizeof(ysFloat3));
+        dst->m_normalStride = ys_int32(sizeof(ysFloat3));
+        dst->m_ownsBuffers = true;
+        sGatherVertices(dst, src.m_positions, src.m_positionStride, src.m_normals, src.m_normalStride);
+    }
+
+    for (ys_int32 i = 0; i < 3 * dst->m_triangleCount; ++i)
+    {
+        ysAssert(0 <= dst->m_indices[i] && dst->m_indices[i] < dst->m_vertexCount);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sDestroyMesh(ysMesh* mesh)
+{
+    // Meshes that reference the caller's buffers leave them alone
+    if (mesh->m_ownsBuffers)
+    {
+        ysFree(const_cast<ys_uint8*>(mesh->m_positions));
+        ysFree(const_cast<ys_uint8*>(mesh->m_normals));
+        ysFree(const_cast<ys_int32*>(mesh->m_indices));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sSetEllipsoid(ysEllipsoid* dst, const ysTransform& xf, const ysVec4& radii)
+{
+    dst->m_xf = xf;
+    dst->m_s = radii;
+    dst->m_sInv.x = ysSafeReciprocal(dst->m_s.x);
+    dst->m_sInv.y = ysSafeReciprocal(dst->m_s.y);
+    dst->m_sInv.z = ysSafeReciprocal(dst->m_s.z);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sSetTriangleVertices(ysTriangle* dst, const ysVec4* vertices)
+{
+    dst->m_v[0] = vertices[0];
+    dst->m_v[1] = vertices[1];
+    dst->m_v[2] = vertices[2];
+    ysVec4 ab = dst->m_v[1] - dst->m_v[0];
+    ysVec4 ac = dst->m_v[2] - dst->m_v[0];
+    ysVec4 ab_x_ac = ysCross(ab, ac);
+    dst->m_n = ysIsSafeToNormalize3(ab_x_ac) ? ysNormalize3(ab_x_ac) : ysVec4_zero;
+    dst->m_t = ysIsSafeToNormalize3(ab) ? ysNormalize3(ab) : ysVec4_zero; // TODO...
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sSetMaterialStandard(ysMaterialStandard* dst, const ysMaterialStandardDef& src)
+{
+    dst->m_albedoDiffuse = ysMax(src.m_albedoDiffuse, ysVec4_zero);
+    dst->m_albedoSpecular = ysMax(src.m_albedoSpecular, ysVec4_zero);
+    dst->m_albedoDiffuse.w = 0.0f;
+    dst->m_albedoSpecular.w = 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sSetEmissiveMaterialUniform(ysEmissiveMaterialUniform* dst, const ysEmissiveMaterialUniformDef& src)
+{
+    dst->m_radiance = ysMax(src.m_radiance, ysVec4_zero);
+    dst->m_radiance.w = 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ysVec4 sRadiantIntensity(const ysVec4& wattage)
+{
+    // A point light emits its power evenly over the sphere of directions
+    return wattage * ysSplat(0.25f / ys_pi);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Writes the bounds of every triangle of the instanced mesh to triangleAABBs, and brings its area CDF and total area up to date
+static void sComputeInstancedMeshAreas(ysInstancedMesh* instancedMesh, ysAABB* triangleAABBs)
+{
+    const ysMesh* mesh = &instancedMesh->m_mesh;
+    instancedMesh->m_surfaceArea = 0.0f;
+    for (ys_int32 i = 0; i < mesh->m_triangleCount; ++i)
+    {
+        triangleAABBs[i] = mesh->ComputeAABB(i);
+        instancedMesh->m_surfaceArea += mesh->ComputeSurfaceArea(i);
+        instancedMesh->m_areaCDF[i] = instancedMesh->m_surfaceArea;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sSetShapeMaterialIds(ysShape* shape, const ysShapeDef* def, ys_int32 materialStandardStartIdx, ys_int32 materialMirrorStartIdx,
+    ys_int32 emissiveMaterialUniformStartIdx)
+{
+    switch (def->m_materialType)
+    {
+        case ysMaterialType::e_none:
+            shape->m_materialId = ys_nullMaterialId;
+            break;
+        case ysMaterialType::e_standard:
+            shape->m_materialId.m_index = materialStandardStartIdx + def->m_materialTypeIndex;
+            break;
+        case ysMaterialType::e_mirror:
+            shape->m_materialId.m_index = materialMirrorStartIdx + def->m_materialTypeIndex;
+            break;
+        default:
+            ysAssert(false);
+            break;
+    }
+
+    switch (def->m_emissiveMaterialType)
+    {
+        case ysEmissiveMaterialType::e_none:
+            shape->m_emissiveMaterialId = ys_nullEmissiveMaterialId;
+            break;
+        case ysEmissiveMaterialType::e_uniform:
+            shape->m_emissiveMaterialId.m_index = emissiveMaterialUniformStartIdx + def->m_emissiveMaterialTypeIndex;
+            break;
+        default:
+            ysAssert(false);
+            break;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Every ellipsoid, triangle, mesh triangle and mesh instance is a shape of its own
+static ys_int32 sShapeCount(const ysSceneDef& def)
+{
+    ys_int32 shapeCount = def.m_ellipsoidCount + def.m_triangleCount;
+    for (ys_int32 i = 0; i < def.m_meshCount; ++i)
+    {
+        shapeCount += def.m_meshes[i].m_triangleCount;
+    }
+    shapeCount += def.m_meshInstanceCount;
+    return shapeCount;
+}
+
+// Shapes are created in spans of this many. Each span counts its emissive shapes along the way, so that m_emissiveShapeIndices can then be
+// filled in parallel too, every span from its own offset.
+static const ys_int32 s_shapesPerSpan = 4096;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ShapeSpan
+{
+    ys_int32 begin;
+    ys_int32 end;
+    ys_int32 emissiveShapeCount;
+    ys_int32 emissiveShapeStartIdx; // Into ysScene::m_emissiveShapeIndices
+};
+
+struct CreateShapesData
+{
+    ysScene* scene;
+    const ysSceneDef* def;
+    const ys_int32* meshShapeStartIndices; // The shape index of the first triangle of every mesh, and past the end, of the first instance
+    ysAABB* aabbs;
+    ysShapeId* shapeIds;
+    ys_int32 materialStandardStartIdx;
+    ys_int32 materialMirrorStartIdx;
+    ys_int32 emissiveMaterialUniformStartIdx;
+};
+
+static void sCreateSceneMesh(ysMesh& dst, CreateShapesData* sd)
+{
+    ys_int32 meshIdx = ys_int32(&dst - sd->scene->m_meshes);
+    sCreateMesh(&dst, sd->def->m_meshes[meshIdx]);
+}
+
+// The (bottom-level) hierarchy of the instanced mesh, which the instances need for their bounds
+static void sCreateInstancedMesh(ysInstancedMesh& dst, CreateShapesData* sd)
+{
+    ys_int32 instancedMeshIdx = ys_int32(&dst - sd->scene->m_instancedMeshes);
+    sCreateMesh(&dst.m_mesh, sd->def->m_instancedMeshes[instancedMeshIdx]);
+    const ysMesh* mesh = &dst.m_mesh;
+    ysAssert(mesh->m_triangleCount > 0);
+
+    ysAABB* triangleAABBs = static_cast<ysAABB*>(ysMalloc(sizeof(ysAABB) * mesh->m_triangleCount));
+    ysShapeId* triangleIds = static_cast<ysShapeId*>(ysMalloc(sizeof(ysShapeId) * mesh->m_triangleCount));
+    dst.m_areaCDF = static_cast<ys_float32*>(ysMalloc(sizeof(ys_float32) * mesh->m_triangleCount));
+    sComputeInstancedMeshAreas(&dst, triangleAABBs);
+    for (ys_int32 i = 0; i < mesh->m_triangleCount; ++i)
+    {
+        triangleIds[i].m_index = i;
+    }
+    dst.m_bvh.Create(triangleAABBs, triangleIds, mesh->m_triangleCount);
+    ysFree(triangleIds);
+    ysFree(triangleAABBs);
+}
+
+// Fills in the shapes of the span, along with their types, their bounds and ids for the hierarchy. The meshes and instanced meshes must
+// already be in place.
+static void sCreateShapeSpan(ShapeSpan& span, CreateShapesData* sd)
+{
+    ysScene* scene = sd->scene;
+    const ysSceneDef* def = sd->def;
+    const ys_int32* meshShapeStartIndices = sd->meshShapeStartIndices;
+    const ys_int32 triangleStartIdx = scene->m_ellipsoidCount;
+    const ys_int32 meshStartIdx = triangleStartIdx + scene->m_triangleCount;
+    const ys_int32 meshInstanceStartIdx = meshShapeStartIndices[scene->m_meshCount];
+
+    // The last mesh starting at or before the span. Meshes without triangles share their start with the next mesh, and are skipped over.
+    const ys_int32* meshStart = std::upper_bound(meshShapeStartIndices, meshShapeStartIndices + scene->m_meshCount, span.begin);
+    ys_int32 meshIdx = ysMax(ys_int32(meshStart - meshShapeStartIndices) - 1, 0);
+
+    span.emissiveShapeCount = 0;
+    for (ys_int32 shapeIdx = span.begin; shapeIdx < span.end; ++shapeIdx)
+    {
+        ysShape* shape = scene->m_shapes + shapeIdx;
+        const ysShapeDef* shapeDef = nullptr;
+        if (shapeIdx < triangleStartIdx)
+        {
+            ys_int32 i = shapeIdx;
+            ysEllipsoid* dst = scene->m_ellipsoids + i;
+            const ysEllipsoidDef& src = def->m_ellipsoids[i];
+            sSetEllipsoid(dst, src.m_transform, src.m_radii);
+
+            shape->m_type = ysShape::Type::e_ellipsoid;
+            shape->m_typeIndex = i;
+            shape->m_primitiveIndex = ys_nullIndex;
+            shapeDef = &src;
+
+            sd->aabbs[shapeIdx] = dst->ComputeAABB();
+        }
+        else if (shapeIdx < meshStartIdx)
+        {
+            ys_int32 i = shapeIdx - triangleStartIdx;
+            ysTriangle* dst = scene->m_triangles + i;
+            const ysInputTriangle& src = def->m_triangles[i];
+            sSetTriangleVertices(dst, src.m_vertices);
+            dst->m_twoSided = src.m_twoSided;
+
+            shape->m_type = ysShape::Type::e_triangle;
+            shape->m_typeIndex = i;
+            shape->m_primitiveIndex = ys_nullIndex;
+            shapeDef = &src;
+
+            sd->aabbs[shapeIdx] = dst->ComputeAABB();
+        }
+        else if (shapeIdx < meshInstanceStartIdx)
+        {
+            while (shapeIdx >= meshShapeStartIndices[meshIdx + 1])
+            {
+                ++meshIdx;
+            }
+            ys_int32 j = shapeIdx - meshShapeStartIndices[meshIdx];
+
+            shape->m_type = ysShape::Type::e_meshTriangle;
+            shape->m_typeIndex = meshIdx;
+            shape->m_primitiveIndex = j;
+            shapeDef = def->m_meshes + meshIdx;
+
+            sd->aabbs[shapeIdx] = scene->m_meshes[meshIdx].ComputeAABB(j);
+        }
+        else
+        {
+            ys_int32 i = shapeIdx - meshInstanceStartIdx;
+            ysMeshInstance* dst = scene->m_meshInstances + i;
+            const ysMeshInstanceDef& src = def->m_meshInstances[i];
+            ysAssert(0 <= src.m_meshIndex && src.m_meshIndex < scene->m_instancedMeshCount);
+            dst->m_meshIndex = src.m_meshIndex;
+            dst->m_xf = src.m_transform;
+
+            shape->m_type = ysShape::Type::e_meshInstance;
+            shape->m_typeIndex = i;
+            shape->m_primitiveIndex = ys_nullIndex;
+            shapeDef = def->m_instancedMeshes + src.m_meshIndex;
+
+            sd->aabbs[shapeIdx] = dst->ComputeAABB(scene);
+        }
+
+        sSetShapeMaterialIds(shape, shapeDef, sd->materialStandardStartIdx, sd->materialMirrorStartIdx,
+            sd->emissiveMaterialUniformStartIdx);
+        sd->shapeIds[shapeIdx].m_index = shapeIdx;
+
+        if (shape->m_emissiveMaterialId != ys_nullEmissiveMaterialId)
+        {
+            span.emissiveShapeCount++;
+        }
+    }
+
+    scene->m_createdShapeSpanCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void sGatherEmissiveShapeIndices(ShapeSpan& span, CreateShapesData* sd)
+{
+    ysScene* scene = sd->scene;
+    ys_int32 emissiveShapeIdx = span.emissiveShapeStartIdx;
+    for (ys_int32 i = span.begin; i < span.end; ++i)
+    {
+        const ysShape* shape = scene->m_shapes + i;
+        if (shape->m_emissiveMaterialId != ys_nullEmissiveMaterialId)
+        {
+            scene->m_emissiveShapeIndices[emissiveShapeIdx++] = i;
+        }
+    }
+    ysAssert(emissiveShapeIdx == span.emissiveShapeStartIdx + span.emissiveShapeCount);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -192,6 +583,9 @@ void ysScene::Reset()
     m_shapes = nullptr;
     m_ellipsoids = nullptr;
     m_triangles = nullptr;
+    m_meshes = nullptr;
+    m_instancedMeshes = nullptr;
+    m_meshInstances = nullptr;
     m_materials = nullptr;
     m_materialStandards = nullptr;
     m_materialMirrors = nullptr;
@@ -203,6 +597,9 @@ void ysScene::Reset()
     m_shapeCount = 0;
     m_ellipsoidCount = 0;
     m_triangleCount = 0;
+    m_meshCount = 0;
+    m_instancedMeshCount = 0;
+    m_meshInstanceCount = 0;
     m_materialCount = 0;
     m_materialStandardCount = 0;
     m_materialMirrorCount = 0;
@@ -211,147 +608,286 @@ void ysScene::Reset()
     m_lightCount = 0;
     m_lightPointCount = 0;
     m_emissiveShapeCount = 0;
+    m_lightBVH.Reset();
+    m_infinitesimalLightBVH.Reset();
     m_renders.Create();
+    m_retiredBuffers.Create();
+    m_radianceCache = nullptr;
+    m_radianceCacheStale.store(false, std::memory_order_relaxed);
     m_jobSystem = nullptr;
+    m_file.Reset();
+    m_creationStage.store(CreationStage::e_created, std::memory_order_relaxed);
+    m_createdShapeSpanCount.store(0, std::memory_order_relaxed);
+    m_shapeSpanCount = 0;
+    m_pendingBVH.Reset();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void ysScene::Create(const ysSceneDef& def)
 {
-    {
-        m_shapeCount = def.m_ellipsoidCount + def.m_triangleCount;
-        m_shapes = static_cast<ysShape*>(ysMalloc(sizeof(ysShape) * m_shapeCount));
+    m_file.Reset();
 
-        m_ellipsoidCount = def.m_ellipsoidCount;
-        m_ellipsoids = static_cast<ysEllipsoid*>(ysMalloc(sizeof(ysEllipsoid) * m_ellipsoidCount));
+    // Up front, so that the shapes can be created in parallel
+    CreateJobSystem();
 
-        m_triangleCount = def.m_triangleCount;
-        m_triangles = static_cast<ysTriangle*>(ysMalloc(sizeof(ysTriangle) * m_triangleCount));
+    ysAABB* aabbs;
+    ysShapeId* shapeIds;
+    CreateShapes(def, &aabbs, &shapeIds);
+    if (def.m_lazyHierarchy)
+    {
+        m_bvh.CreateLazy(aabbs, shapeIds, m_shapeCount);
     }
-
+    else
     {
-        m_materialCount = def.m_materialStandardCount + def.m_materialMirrorCount;
-        m_materials = static_cast<ysMaterial*>(ysMalloc(sizeof(ysMaterial) * m_materialCount));
+        m_bvh.Create(aabbs, shapeIds, m_shapeCount);
+    }
+    ysFree(shapeIds);
+    ysFree(aabbs);
 
-        m_materialStandardCount = def.m_materialStandardCount;
-        m_materialStandards = static_cast<ysMaterialStandard*>(ysMalloc(sizeof(ysMaterialStandard) * m_materialStandardCount));
+    CreateMaterialsAndLights(def);
+    CreateDerivedState();
 
-        m_materialMirrorCount = def.m_materialMirrorCount;
-        m_materialMirrors = static_cast<ysMaterialMirror*>(ysMalloc(sizeof(ysMaterialMirror) * m_materialMirrorCount));
-    }
+    m_pendingBVH.Reset();
+    m_creationStage.store(CreationStage::e_created, std::memory_order_release);
+}
 
-    {
-        m_emissiveMaterialCount = def.m_emissiveMaterialUniformCount;
-        m_emissiveMaterials = static_cast<ysEmissiveMaterial*>(ysMalloc(sizeof(ysEmissiveMaterial) * m_emissiveMaterialCount));
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sCreationDoWork(ysJobSystem*, ysJob*, void* scenePtr)
+{
+    ysScene* scene = static_cast<ysScene*>(scenePtr);
+    scene->DoCreationWork();
+}
 
-        m_emissiveMaterialUniformCount = def.m_emissiveMaterialUniformCount;
-        m_emissiveMaterialUniforms = static_cast<ysEmissiveMaterialUniform*>(ysMalloc(sizeof(ysEmissiveMaterialUniform) * m_emissiveMaterialUniformCount));
-    }
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::CreateAsync(const ysSceneDef& def)
+{
+    m_file.Reset();
+    m_creationDef = def;
+    m_creationStage.store(CreationStage::e_creatingShapes, std::memory_order_relaxed);
+    m_createdShapeSpanCount.store(0, std::memory_order_relaxed);
+    m_shapeSpanCount = (sShapeCount(def) + s_shapesPerSpan - 1) / s_shapesPerSpan;
+
+    // On the calling thread, which is the one that destroys it
+    CreateJobSystem();
+
+    ysJobDef jobDef;
+    jobDef.m_fcn = sCreationDoWork;
+    jobDef.m_fcnArg = this;
+    jobDef.m_parentJob = nullptr;
+    ysJob* job = ysJobSystem_CreateJob(m_jobSystem, jobDef);
+    ysJobSystem_SubmitJob(m_jobSystem, job);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::DoCreationWork()
+{
+    const ysSceneDef& def = m_creationDef;
+
+    ysAABB* aabbs;
+    ysShapeId* shapeIds;
+    CreateShapes(def, &aabbs, &shapeIds);
 
+    m_creationStage.store(CreationStage::e_creatingPreview, std::memory_order_release);
+    bool lazyHierarchy = def.m_lazyHierarchy;
+    if (lazyHierarchy)
     {
-        m_lightCount = def.m_lightPointCount;
-        m_lights = static_cast<ysLight*>(ysMalloc(sizeof(ysLight) * m_lightCount));
+        m_bvh.CreateLazy(aabbs, shapeIds, m_shapeCount);
+    }
+    else
+    {
+        m_bvh.CreateCoarse(aabbs, shapeIds, m_shapeCount);
+    }
+    CreateMaterialsAndLights(def);
+    CreateDerivedState();
+    m_pendingBVH.Reset();
 
-        m_lightPointCount = def.m_lightPointCount;
-        m_lightPoints = static_cast<ysLightPoint*>(ysMalloc(sizeof(ysLightPoint) * m_lightPointCount));
+    if (lazyHierarchy)
+    {
+        // The lazy hierarchy builds the rest of itself as renders need it, so there is no full one to wait for
+        ysFree(shapeIds);
+        ysFree(aabbs);
+        m_creationStage.store(CreationStage::e_created, std::memory_order_release);
+        return;
     }
 
-    ys_int32 materialStandardStartIdx = 0;
-    ys_int32 materialMirrorStartIdx = m_materialStandardCount;
+    // Renders may start against the coarse hierarchy from here on. The definition is not read past this point.
+    m_creationStage.store(CreationStage::e_buildingHierarchy, std::memory_order_release);
+    m_pendingBVH.Create(aabbs, shapeIds, m_shapeCount);
+    ysFree(shapeIds);
+    ysFree(aabbs);
 
-    ys_int32 emissiveMaterialUniformStartIdx = 0;
+    m_creationStage.store(CreationStage::e_hierarchyBuilt, std::memory_order_release);
+}
 
-    ////////////
-    // Shapes //
-    ////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysScene::IsPreviewReady() const
+{
+    return m_creationStage.load(std::memory_order_acquire) >= CreationStage::e_buildingHierarchy;
+}
 
-    auto SetShapeMaterialIds = [&](ysShape* shape, const ysShapeDef* def)
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysScene::FinishCreation()
+{
+    CreationStage stage = m_creationStage.load(std::memory_order_acquire);
+    if (stage == CreationStage::e_hierarchyBuilt && m_renders.GetCount() == 0)
     {
-        switch (def->m_materialType)
-        {
-            case ysMaterialType::e_none:
-                shape->m_materialId = ys_nullMaterialId;
-                break;
-            case ysMaterialType::e_standard:
-                shape->m_materialId.m_index = materialStandardStartIdx + def->m_materialTypeIndex;
-                break;
-            case ysMaterialType::e_mirror:
-                shape->m_materialId.m_index = materialMirrorStartIdx + def->m_materialTypeIndex;
-                break;
-            default:
-                ysAssert(false);
-                break;
-        }
+        m_bvh.Destroy();
+        m_bvh = m_pendingBVH;
+        m_pendingBVH.Reset();
+        stage = CreationStage::e_created;
+        m_creationStage.store(stage, std::memory_order_release);
+    }
+    return stage == CreationStage::e_created;
+}
 
-        switch (def->m_emissiveMaterialType)
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysScene::GetCreationProgress() const
+{
+    // Rough shares of the work, going by large scenes, whose time goes mostly into the full hierarchy
+    const ys_float32 shapesShare = 0.2f;
+    const ys_float32 previewShare = 0.1f;
+    switch (m_creationStage.load(std::memory_order_acquire))
+    {
+        case CreationStage::e_creatingShapes:
         {
-            case ysEmissiveMaterialType::e_none:
-                shape->m_emissiveMaterialId = ys_nullEmissiveMaterialId;
-                break;
-            case ysEmissiveMaterialType::e_uniform:
-                shape->m_emissiveMaterialId.m_index = emissiveMaterialUniformStartIdx + def->m_emissiveMaterialTypeIndex;
-                break;
-            default:
-                ysAssert(false);
-                break;
+            ys_int32 createdShapeSpanCount = m_createdShapeSpanCount.load(std::memory_order_relaxed);
+            return shapesShare * ys_float32(createdShapeSpanCount) / ys_float32(ysMax(m_shapeSpanCount, 1));
         }
-    };
+        case CreationStage::e_creatingPreview:
+            return shapesShare;
+        case CreationStage::e_buildingHierarchy:
+            return shapesShare + previewShare;
+        default:
+            return 1.0f;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::CreateShapes(const ysSceneDef& def, ysAABB** aabbsOut, ysShapeId** shapeIdsOut)
+{
+    {
+        m_shapeCount = sShapeCount(def);
+        m_shapes = static_cast<ysShape*>(ysMalloc(sizeof(ysShape) * m_shapeCount));
+
+        m_ellipsoidCount = def.m_ellipsoidCount;
+        m_ellipsoids = static_cast<ysEllipsoid*>(ysMalloc(sizeof(ysEllipsoid) * m_ellipsoidCount));
+
+        m_triangleCount = def.m_triangleCount;
+        m_triangles = static_cast<ysTriangle*>(ysMalloc(sizeof(ysTriangle) * m_triangleCount));
+
+        m_meshCount = def.m_meshCount;
+        m_meshes = static_cast<ysMesh*>(ysMalloc(sizeof(ysMesh) * m_meshCount));
 
-    ys_int32 shapeIdx = 0;
+        m_instancedMeshCount = def.m_instancedMeshCount;
+        m_instancedMeshes = static_cast<ysInstancedMesh*>(ysMalloc(sizeof(ysInstancedMesh) * m_instancedMeshCount));
+
+        m_meshInstanceCount = def.m_meshInstanceCount;
+        m_meshInstances = static_cast<ysMeshInstance*>(ysMalloc(sizeof(ysMeshInstance) * m_meshInstanceCount));
+    }
 
     ysAABB* aabbs = static_cast<ysAABB*>(ysMalloc(sizeof(ysAABB) * m_shapeCount));
     ysShapeId* shapeIds = static_cast<ysShapeId*>(ysMalloc(sizeof(ysShapeId) * m_shapeCount));
 
-    for (ys_int32 i = 0; i < m_ellipsoidCount; ++i, ++shapeIdx)
+    ys_int32* meshShapeStartIndices = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * (m_meshCount + 1)));
+    meshShapeStartIndices[0] = m_ellipsoidCount + m_triangleCount;
+    for (ys_int32 i = 0; i < m_meshCount; ++i)
     {
-        ysEllipsoid* dst = m_ellipsoids + i;
-        const ysEllipsoidDef& src = def.m_ellipsoids[i];
-        dst->m_xf = src.m_transform;
-        dst->m_s = src.m_radii;
-        dst->m_sInv.x = ysSafeReciprocal(dst->m_s.x);
-        dst->m_sInv.y = ysSafeReciprocal(dst->m_s.y);
-        dst->m_sInv.z = ysSafeReciprocal(dst->m_s.z);
-
-        ysShape* shape = m_shapes + shapeIdx;
-        shape->m_type = ysShape::Type::e_ellipsoid;
-        shape->m_typeIndex = i;
+        meshShapeStartIndices[i + 1] = meshShapeStartIndices[i] + def.m_meshes[i].m_triangleCount;
+    }
+    ysAssert(meshShapeStartIndices[m_meshCount] + m_meshInstanceCount == m_shapeCount);
+
+    CreateShapesData createShapesData;
+    createShapesData.scene = this;
+    createShapesData.def = &def;
+    createShapesData.meshShapeStartIndices = meshShapeStartIndices;
+    createShapesData.aabbs = aabbs;
+    createShapesData.shapeIds = shapeIds;
+    createShapesData.materialStandardStartIdx = 0;
+    createShapesData.materialMirrorStartIdx = def.m_materialStandardCount;
+    createShapesData.emissiveMaterialUniformStartIdx = 0;
+
+    // The meshes (and the hierarchies of the instanced meshes) come first, as the shapes referring to them need them for their bounds
+    if (m_meshCount > 0)
+    {
+        ysParallelFor(m_jobSystem, m_meshes, m_meshCount, &createShapesData, 2, sCreateSceneMesh);
+    }
+    if (m_instancedMeshCount > 0)
+    {
+        ysParallelFor(m_jobSystem, m_instancedMeshes, m_instancedMeshCount, &createShapesData, 2, sCreateInstancedMesh);
+    }
 
-        SetShapeMaterialIds(shape, &src);
+    ys_int32 shapeSpanCount = (m_shapeCount + s_shapesPerSpan - 1) / s_shapesPerSpan;
+    ShapeSpan* shapeSpans = static_cast<ShapeSpan*>(ysMalloc(sizeof(ShapeSpan) * ysMax(shapeSpanCount, 1)));
+    for (ys_int32 i = 0; i < shapeSpanCount; ++i)
+    {
+        shapeSpans[i].begin = s_shapesPerSpan * i;
+        shapeSpans[i].end = ysMin(s_shapesPerSpan * (i + 1), m_shapeCount);
+    }
+    m_createdShapeSpanCount.store(0, std::memory_order_relaxed);
+    if (shapeSpanCount > 0)
+    {
+        ysParallelFor(m_jobSystem, shapeSpans, shapeSpanCount, &createShapesData, 2, sCreateShapeSpan);
+    }
+    ysFree(meshShapeStartIndices);
 
-        aabbs[shapeIdx] = dst->ComputeAABB();
-        shapeIds[shapeIdx].m_index = shapeIdx;
+    // Add emissive shapes to the special list so that we can randomly choose an area light to sample. The spans counted theirs when the
+    // shapes were created, so a running sum over the spans tells each one where its indices go.
+    // TODO: Might also be good to have separate BVHs for reflective and emissive shapes.
+    m_emissiveShapeCount = 0;
+    for (ys_int32 i = 0; i < shapeSpanCount; ++i)
+    {
+        shapeSpans[i].emissiveShapeStartIdx = m_emissiveShapeCount;
+        m_emissiveShapeCount += shapeSpans[i].emissiveShapeCount;
+    }
+    m_emissiveShapeIndices = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * m_emissiveShapeCount));
+    if (m_emissiveShapeCount > 0)
+    {
+        ysParallelFor(m_jobSystem, shapeSpans, shapeSpanCount, &createShapesData, 2, sGatherEmissiveShapeIndices);
     }
+    ysFree(shapeSpans);
 
-    for (ys_int32 i = 0; i < m_triangleCount; ++i, ++shapeIdx)
+    *aabbsOut = aabbs;
+    *shapeIdsOut = shapeIds;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::CreateMaterialsAndLights(const ysSceneDef& def)
+{
     {
-        ysTriangle* dst = m_triangles + i;
-        const ysInputTriangle& src = def.m_triangles[i];
-        dst->m_v[0] = src.m_vertices[0];
-        dst->m_v[1] = src.m_vertices[1];
-        dst->m_v[2] = src.m_vertices[2];
-        ysVec4 ab = dst->m_v[1] - dst->m_v[0];
-        ysVec4 ac = dst->m_v[2] - dst->m_v[0];
-        ysVec4 ab_x_ac = ysCross(ab, ac);
-        dst->m_n = ysIsSafeToNormalize3(ab_x_ac) ? ysNormalize3(ab_x_ac) : ysVec4_zero;
-        dst->m_t = ysIsSafeToNormalize3(ab) ? ysNormalize3(ab) : ysVec4_zero; // TODO...
-        dst->m_twoSided = src.m_twoSided;
+        m_materialCount = def.m_materialStandardCount + def.m_materialMirrorCount;
+        m_materials = static_cast<ysMaterial*>(ysMalloc(sizeof(ysMaterial) * m_materialCount));
+
+        m_materialStandardCount = def.m_materialStandardCount;
+        m_materialStandards = static_cast<ysMaterialStandard*>(ysMalloc(sizeof(ysMaterialStandard) * m_materialStandardCount));
 
-        ysShape* shape = m_shapes + shapeIdx;
-        shape->m_type = ysShape::Type::e_triangle;
-        shape->m_typeIndex = i;
-        
-        SetShapeMaterialIds(shape, &src);
+        m_materialMirrorCount = def.m_materialMirrorCount;
+        m_materialMirrors = static_cast<ysMaterialMirror*>(ysMalloc(sizeof(ysMaterialMirror) * m_materialMirrorCount));
+    }
+
+    {
+        m_emissiveMaterialCount = def.m_emissiveMaterialUniformCount;
+        m_emissiveMaterials = static_cast<ysEmissiveMaterial*>(ysMalloc(sizeof(ysEmissiveMaterial) * m_emissiveMaterialCount));
 
-        aabbs[shapeIdx] = dst->ComputeAABB();
-        shapeIds[shapeIdx].m_index = shapeIdx;
+        m_emissiveMaterialUniformCount = def.m_emissiveMaterialUniformCount;
+        m_emissiveMaterialUniforms = static_cast<ysEmissiveMaterialUniform*>(ysMalloc(sizeof(ysEmissiveMaterialUniform) * m_emissiveMaterialUniformCount));
     }
 
-    ysAssert(shapeIdx == m_shapeCount);
+    {
+        m_lightCount = def.m_lightPointCount;
+        m_lights = static_cast<ysLight*>(ysMalloc(sizeof(ysLight) * m_lightCount));
 
-    m_bvh.Create(aabbs, shapeIds, m_shapeCount);
-    ysFree(shapeIds);
-    ysFree(aabbs);
+        m_lightPointCount = def.m_lightPointCount;
+        m_lightPoints = static_cast<ysLightPoint*>(ysMalloc(sizeof(ysLightPoint) * m_lightPointCount));
+    }
 
     //////////////////////////
     // Reflective Materials //
@@ -363,10 +899,7 @@ void ysScene::Create(const ysSceneDef& def)
         {
             ysMaterialStandard* dst = m_materialStandards + i;
             const ysMaterialStandardDef* src = def.m_materialStandards + i;
-            dst->m_albedoDiffuse = ysMax(src->m_albedoDiffuse, ysVec4_zero);
-            dst->m_albedoSpecular = ysMax(src->m_albedoSpecular, ysVec4_zero);
-            dst->m_albedoDiffuse.w = 0.0f;
-            dst->m_albedoSpecular.w = 0.0f;
+            sSetMaterialStandard(dst, *src);
 
             ysMaterial* material = m_materials + materialIdx;
             material->m_type = ysMaterial::Type::e_standard;
@@ -398,8 +931,7 @@ void ysScene::Create(const ysSceneDef& def)
         {
             ysEmissiveMaterialUniform* dst = m_emissiveMaterialUniforms + i;
             const ysEmissiveMaterialUniformDef* src = def.m_emissiveMaterialUniforms + i;
-            dst->m_radiance = ysMax(src->m_radiance, ysVec4_zero);
-            dst->m_radiance.w = 0.0f;
+            sSetEmissiveMaterialUniform(dst, *src);
 
             ysEmissiveMaterial* emissiveMaterial = m_emissiveMaterials + emissiveMaterialIdx;
             emissiveMaterial->m_type = ysEmissiveMaterial::Type::e_uniform;
@@ -415,13 +947,12 @@ void ysScene::Create(const ysSceneDef& def)
 
     ys_int32 lightIdx = 0;
 
-    ysVec4 invSphereRadians = ysSplat(0.25f / ys_pi);
     for (ys_int32 i = 0; i < m_lightPointCount; ++i, ++lightIdx)
     {
         ysLightPoint* dst = m_lightPoints + i;
         const ysLightPointDef* src = def.m_lightPoints + i;
         dst->m_position = src->m_position;
-        dst->m_radiantIntensity = src->m_wattage * invSphereRadians;
+        dst->m_radiantIntensity = sRadiantIntensity(src->m_wattage);
 
         ysLight* light = m_lights + lightIdx;
         light->m_type = ysLight::Type::e_point;
@@ -429,37 +960,35 @@ void ysScene::Create(const ysSceneDef& def)
     }
 
     ysAssert(lightIdx == m_lightCount);
+}
 
-    // Add emissive shapes to the special list so that we can randomly choose an area light to sample
-    // TODO: Might also be good to have separate BVHs for reflective and emissive shapes.
-    m_emissiveShapeCount = 0;
-    for (ys_int32 i = 0; i < m_shapeCount; ++i)
-    {
-        const ysShape* shape = m_shapes + i;
-        if (shape->m_emissiveMaterialId != ys_nullEmissiveMaterialId)
-        {
-            m_emissiveShapeCount++;
-        }
-    }
-    m_emissiveShapeIndices = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * m_emissiveShapeCount));
-
-    ys_int32 emissiveShapeIdx = 0;
-    for (ys_int32 i = 0; i < m_shapeCount; ++i)
-    {
-        const ysShape* shape = m_shapes + i;
-        if (shape->m_emissiveMaterialId != ys_nullEmissiveMaterialId)
-        {
-            m_emissiveShapeIndices[emissiveShapeIdx++] = i;
-        }
-    }
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::CreateDerivedState()
+{
+    m_lightBVH.Create(this, true, false);
+    m_infinitesimalLightBVH.Create(this, false, true);
 
     const ys_int32 expectedMaxRenderConcurrency = 8;
     m_renders.Create(expectedMaxRenderConcurrency);
+    m_retiredBuffers.Create();
 
-    ys_uint32 hardwareConcurrency = std::thread::hardware_concurrency();
+    // Only created once a render asks for it, as most never do (see RequestRadianceCache)
+    m_radianceCache = nullptr;
+    m_radianceCacheStale.store(false, std::memory_order_relaxed);
+}
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::CreateJobSystem()
+{
+    // hardware_concurrency may return 0 when it cannot tell
+    ys_int32 hardwareConcurrency = ys_int32(std::thread::hardware_concurrency());
+
+    // Worker 0 is the calling thread itself, which only runs jobs when it waits on them. Asynchronous creation and renders are submitted to
+    // it and left for the other workers to steal, so there must be at least one other, even on machines with a single hardware thread.
     ysJobSystemDef jobSysDef;
-    jobSysDef.m_workerCount = hardwareConcurrency - 1;
+    jobSysDef.m_workerCount = ysMax(hardwareConcurrency - 1, 2);
     m_jobSystem = ysJobSystem_Create(jobSysDef);
 }
 
@@ -467,12 +996,31 @@ void ysScene::Create(const ysSceneDef& def)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void ysScene::Destroy()
 {
+    // Runs whatever is left of an asynchronous creation to completion first
+    ysJobSystem_Destroy(m_jobSystem);
+    m_jobSystem = nullptr;
     ysAssert(m_renders.GetCount() == 0);
 
+    ReleaseMappedBuffers();
     m_bvh.Destroy();
+    m_pendingBVH.Destroy();
     ysSafeFree(m_shapes);
     ysSafeFree(m_ellipsoids);
     ysSafeFree(m_triangles);
+    for (ys_int32 i = 0; i < m_meshCount; ++i)
+    {
+        sDestroyMesh(m_meshes + i);
+    }
+    ysSafeFree(m_meshes);
+    for (ys_int32 i = 0; i < m_instancedMeshCount; ++i)
+    {
+        ysInstancedMesh* instancedMesh = m_instancedMeshes + i;
+        sDestroyMesh(&instancedMesh->m_mesh);
+        instancedMesh->m_bvh.Destroy();
+        ysFree(instancedMesh->m_areaCDF);
+    }
+    ysSafeFree(m_instancedMeshes);
+    ysSafeFree(m_meshInstances);
     ysSafeFree(m_materials);
     ysSafeFree(m_materialStandards);
     ysSafeFree(m_materialMirrors);
@@ -484,6 +1032,9 @@ void ysScene::Destroy()
     m_shapeCount = 0;
     m_ellipsoidCount = 0;
     m_triangleCount = 0;
+    m_meshCount = 0;
+    m_instancedMeshCount = 0;
+    m_meshInstanceCount = 0;
     m_materialCount = 0;
     m_materialStandardCount = 0;
     m_materialMirrorCount = 0;
@@ -492,18 +1043,320 @@ void ysScene::Destroy()
     m_lightCount = 0;
     m_lightPointCount = 0;
     m_emissiveShapeCount = 0;
+    m_lightBVH.Destroy();
+    m_infinitesimalLightBVH.Destroy();
     m_renders.Destroy();
-    ysJobSystem_Destroy(m_jobSystem);
-    m_jobSystem = nullptr;
+    FreeRetiredBuffers();
+    m_retiredBuffers.Destroy();
+    if (m_radianceCache != nullptr)
+    {
+        m_radianceCache->Destroy();
+        ysFree(m_radianceCache);
+        m_radianceCache = nullptr;
+    }
+    m_file.Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool sUsesRadianceCache(const ysGlobalIlluminationInput* input)
+{
+    if (input == nullptr || input->m_type != ysGlobalIlluminationInput::Type::e_uniDirectional)
+    {
+        return false;
+    }
+    return static_cast<const ysGlobalIlluminationInput_UniDirectional*>(input)->m_radianceCacheBounceCount > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::RequestRadianceCache(const ysSceneRenderInput& input)
+{
+    bool compare = (input.m_renderMode == ysSceneRenderInput::RenderMode::e_compare);
+    bool requested = sUsesRadianceCache(input.m_giInput) || (compare && sUsesRadianceCache(input.m_giInputCompare));
+    if (requested == false || m_radianceCache != nullptr)
+    {
+        return;
+    }
+
+    // Cells a fraction of the scene's extent wide are fine enough for irradiance, which varies slowly over diffuse surfaces
+    ys_float32 cellSize = 1.0f;
+    if (m_bvh.m_nodeCount > 0)
+    {
+        const ysAABB& sceneAABB = m_bvh.m_nodes[0].m_aabb;
+        cellSize = ysMax(ysLength3(sceneAABB.m_max - sceneAABB.m_min) / 256.0f, ys_epsilon);
+    }
+    const ys_int32 radianceCacheCapacity = 1 << 18;
+    ysRadianceCache* radianceCache = static_cast<ysRadianceCache*>(ysMalloc(sizeof(ysRadianceCache)));
+    radianceCache->Create(cellSize, radianceCacheCapacity);
+    m_radianceCacheStale.store(false, std::memory_order_relaxed);
+    m_radianceCache = radianceCache;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::ReleaseMappedBuffers()
+{
+    if (m_file.IsOpen() == false)
+    {
+        return;
+    }
+
+    // Material updates swap in buffers of their own, so any of these may have since left the mapping
+    auto Release = [this](auto* buffer) { return m_file.Contains(buffer) ? nullptr : buffer; };
+    m_shapes = Release(m_shapes);
+    m_ellipsoids = Release(m_ellipsoids);
+    m_triangles = Release(m_triangles);
+    m_meshInstances = Release(m_meshInstances);
+    m_materials = Release(m_materials);
+    m_materialStandards = Release(m_materialStandards.load());
+    m_materialMirrors = Release(m_materialMirrors);
+    m_emissiveMaterials = Release(m_emissiveMaterials);
+    m_emissiveMaterialUniforms = Release(m_emissiveMaterialUniforms.load());
+    m_lights = Release(m_lights);
+    m_lightPoints = Release(m_lightPoints.load());
+    m_emissiveShapeIndices = Release(m_emissiveShapeIndices);
+    m_bvh.m_nodes = Release(m_bvh.m_nodes);
+    m_bvh.m_builtAreas = Release(m_bvh.m_builtAreas);
+    for (ys_int32 i = 0; i < m_instancedMeshCount; ++i)
+    {
+        ysInstancedMesh* instancedMesh = m_instancedMeshes + i;
+        instancedMesh->m_bvh.m_nodes = Release(instancedMesh->m_bvh.m_nodes);
+        instancedMesh->m_bvh.m_builtAreas = Release(instancedMesh->m_bvh.m_builtAreas);
+        instancedMesh->m_areaCDF = Release(instancedMesh->m_areaCDF);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::UpdateShapes(const ysSceneShapesUpdate& update)
+{
+    // Renders read the scene from worker threads for as long as they exist
+    ysAssert(m_renders.GetCount() == 0);
+    ysAssert(update.m_bvhRebuildThreshold >= 1.0f);
+
+    // Shapes are laid out by type, in the same order as in Create
+    ys_int32 firstTriangleShapeIdx = m_ellipsoidCount;
+    ys_int32 firstMeshShapeIdx = firstTriangleShapeIdx + m_triangleCount;
+    ys_int32 firstMeshInstanceShapeIdx = m_shapeCount - m_meshInstanceCount;
+
+    // The light hierarchy bounds the emissive shapes too, and needs rebuilding if any of them changed
+    bool emittersChanged = false;
+    auto ShapeChanged = [&](ys_int32 shapeIdx)
+    {
+        emittersChanged = emittersChanged || (m_shapes[shapeIdx].m_emissiveMaterialId != ys_nullEmissiveMaterialId);
+    };
+
+    for (ys_int32 i = 0; i < update.m_ellipsoidCount; ++i)
+    {
+        const ysEllipsoidUpdate& src = update.m_ellipsoids[i];
+        ysAssert(0 <= src.m_ellipsoidIndex && src.m_ellipsoidIndex < m_ellipsoidCount);
+        sSetEllipsoid(m_ellipsoids + src.m_ellipsoidIndex, src.m_transform, src.m_radii);
+        ShapeChanged(src.m_ellipsoidIndex);
+    }
+
+    for (ys_int32 i = 0; i < update.m_triangleCount; ++i)
+    {
+        const ysTriangleUpdate& src = update.m_triangles[i];
+        ysAssert(0 <= src.m_triangleIndex && src.m_triangleIndex < m_triangleCount);
+        sSetTriangleVertices(m_triangles + src.m_triangleIndex, src.m_vertices);
+        ShapeChanged(firstTriangleShapeIdx + src.m_triangleIndex);
+    }
+
+    for (ys_int32 i = 0; i < update.m_meshCount; ++i)
+    {
+        const ysMeshUpdate& src = update.m_meshes[i];
+        ysMesh* mesh = nullptr;
+        if (src.m_instanced)
+        {
+            ysAssert(0 <= src.m_meshIndex && src.m_meshIndex < m_instancedMeshCount);
+            mesh = &m_instancedMeshes[src.m_meshIndex].m_mesh;
+        }
+        else
+        {
+            ysAssert(0 <= src.m_meshIndex && src.m_meshIndex < m_meshCount);
+            mesh = m_meshes + src.m_meshIndex;
+        }
+
+        // The buffers of meshes loaded from files lie in the (copy-on-write) mapping, and are as good as owned
+        bool writable = mesh->m_ownsBuffers || m_file.Contains(mesh->m_positions);
+        ysAssert(writable == (src.m_positions != nullptr));
+        if (writable)
+        {
+            sGatherVertices(mesh, src.m_positions, src.m_positionStride, src.m_normals, src.m_normalStride);
+        }
+
+        if (src.m_instanced)
+        {
+            // Refit the mesh's own hierarchy. Its instances are taken care of along with every other shape below.
+            ysInstancedMesh* instancedMesh = m_instancedMeshes + src.m_meshIndex;
+            ysAABB* triangleAABBs = static_cast<ysAABB*>(ysMalloc(sizeof(ysAABB) * mesh->m_triangleCount));
+            sComputeInstancedMeshAreas(instancedMesh, triangleAABBs);
+            instancedMesh->m_bvh.Refit(triangleAABBs, update.m_bvhRebuildThreshold);
+            ysFree(triangleAABBs);
+            for (ys_int32 j = 0; j < m_meshInstanceCount; ++j)
+            {
+                if (m_meshInstances[j].m_meshIndex == src.m_meshIndex)
+                {
+                    ShapeChanged(firstMeshInstanceShapeIdx + j);
+                }
+            }
+        }
+        else
+        {
+            // The triangles of a mesh share its materials, so any one of them will do
+            ys_int32 meshShapeIdx = firstMeshShapeIdx;
+            for (ys_int32 j = 0; j < src.m_meshIndex; ++j)
+            {
+                meshShapeIdx += m_meshes[j].m_triangleCount;
+            }
+            if (mesh->m_triangleCount > 0)
+            {
+                ShapeChanged(meshShapeIdx);
+            }
+        }
+    }
+
+    for (ys_int32 i = 0; i < update.m_meshInstanceCount; ++i)
+    {
+        const ysMeshInstanceUpdate& src = update.m_meshInstances[i];
+        ysAssert(0 <= src.m_meshInstanceIndex && src.m_meshInstanceIndex < m_meshInstanceCount);
+        m_meshInstances[src.m_meshInstanceIndex].m_xf = src.m_transform;
+        ShapeChanged(firstMeshInstanceShapeIdx + src.m_meshInstanceIndex);
+    }
+
+    // Every leaf is refit, whether or not its shape changed, which is still far cheaper than rebuilding
+    ysAABB* aabbs = static_cast<ysAABB*>(ysMalloc(sizeof(ysAABB) * m_shapeCount));
+    for (ys_int32 i = 0; i < m_shapeCount; ++i)
+    {
+        aabbs[i] = m_shapes[i].ComputeAABB(this);
+    }
+    m_bvh.Refit(aabbs, update.m_bvhRebuildThreshold);
+    ysFree(aabbs);
+
+    if (emittersChanged)
+    {
+        m_lightBVH.Destroy();
+        m_lightBVH.Create(this, true, false);
+    }
+
+    // Whatever the cache has learned about the old geometry no longer holds
+    if (m_radianceCache != nullptr)
+    {
+        m_radianceCache->Clear();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::RetireBuffer(void* buffer)
+{
+    // Buffers in the mapped file go away along with the mapping
+    if (m_file.Contains(buffer))
+    {
+        return;
+    }
+
+    if (m_renders.GetCount() == 0)
+    {
+        ysFree(buffer);
+        return;
+    }
+    ys_int32 count = m_retiredBuffers.GetCount();
+    m_retiredBuffers.SetCount(count + 1);
+    m_retiredBuffers[count] = buffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::FreeRetiredBuffers()
+{
+    ysAssert(m_renders.GetCount() == 0);
+    for (ys_int32 i = 0; i < m_retiredBuffers.GetCount(); ++i)
+    {
+        ysFree(m_retiredBuffers[i]);
+    }
+    m_retiredBuffers.SetCount(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::UpdateMaterials(const ysSceneMaterialsUpdate& update)
+{
+    if (update.m_materialStandardCount > 0)
+    {
+        ysMaterialStandard* materialStandards = static_cast<ysMaterialStandard*>(ysMalloc(sizeof(ysMaterialStandard) * m_materialStandardCount));
+        ysMemCpy(materialStandards, m_materialStandards, sizeof(ysMaterialStandard) * m_materialStandardCount);
+        for (ys_int32 i = 0; i < update.m_materialStandardCount; ++i)
+        {
+            const ysMaterialStandardUpdate& src = update.m_materialStandards[i];
+            ysAssert(0 <= src.m_materialStandardIndex && src.m_materialStandardIndex < m_materialStandardCount);
+            sSetMaterialStandard(materialStandards + src.m_materialStandardIndex, src.m_material);
+        }
+        RetireBuffer(m_materialStandards.exchange(materialStandards));
+    }
+
+    bool emissionChanged = false;
+
+    if (update.m_emissiveMaterialUniformCount > 0)
+    {
+        ysEmissiveMaterialUniform* uniforms = static_cast<ysEmissiveMaterialUniform*>(ysMalloc(sizeof(ysEmissiveMaterialUniform) * m_emissiveMaterialUniformCount));
+        ysMemCpy(uniforms, m_emissiveMaterialUniforms, sizeof(ysEmissiveMaterialUniform) * m_emissiveMaterialUniformCount);
+        for (ys_int32 i = 0; i < update.m_emissiveMaterialUniformCount; ++i)
+        {
+            const ysEmissiveMaterialUniformUpdate& src = update.m_emissiveMaterialUniforms[i];
+            ysAssert(0 <= src.m_emissiveMaterialUniformIndex && src.m_emissiveMaterialUniformIndex < m_emissiveMaterialUniformCount);
+            sSetEmissiveMaterialUniform(uniforms + src.m_emissiveMaterialUniformIndex, src.m_emissiveMaterial);
+        }
+        RetireBuffer(m_emissiveMaterialUniforms.exchange(uniforms));
+        emissionChanged = true;
+    }
+
+    if (update.m_lightPointCount > 0)
+    {
+        ysLightPoint* lightPoints = static_cast<ysLightPoint*>(ysMalloc(sizeof(ysLightPoint) * m_lightPointCount));
+        ysMemCpy(lightPoints, m_lightPoints, sizeof(ysLightPoint) * m_lightPointCount);
+        for (ys_int32 i = 0; i < update.m_lightPointCount; ++i)
+        {
+            const ysLightPointUpdate& src = update.m_lightPoints[i];
+            ysAssert(0 <= src.m_lightPointIndex && src.m_lightPointIndex < m_lightPointCount);
+            lightPoints[src.m_lightPointIndex].m_radiantIntensity = sRadiantIntensity(src.m_wattage);
+        }
+        RetireBuffer(m_lightPoints.exchange(lightPoints));
+        emissionChanged = true;
+    }
+
+    // The light hierarchies choose emitters in proportion to their power
+    if (emissionChanged)
+    {
+        RetireBuffer(m_lightBVH.UpdateEmission(this));
+        RetireBuffer(m_infinitesimalLightBVH.UpdateEmission(this));
+    }
+
+    // Whatever the cache has learned was lit by the old materials. Renders in progress may still be reading it, so like the retired buffers
+    // it is only cleared once they are gone.
+    if (m_radianceCache == nullptr)
+    {
+        return;
+    }
+    if (m_renders.GetCount() == 0)
+    {
+        m_radianceCache->Clear();
+    }
+    else
+    {
+        m_radianceCacheStale.store(true, std::memory_order_relaxed);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct ysScene::ysSurfaceData
 {
-    void SetShape(const ysScene* scene, const ysShapeId& shapeId)
+    void SetShape(const ysScene* scene, const ysShapeId& shapeId, ys_int32 primitiveIdx)
     {
         m_shape = scene->m_shapes + shapeId.m_index;
+        m_primitiveIndex = primitiveIdx;
         m_material = (m_shape->m_materialId == ys_nullMaterialId)
             ? nullptr
             : scene->m_materials + m_shape->m_materialId.m_index;
@@ -513,6 +1366,7 @@ struct ysScene::ysSurfaceData
     }
 
     const ysShape* m_shape;
+    ys_int32 m_primitiveIndex; // (See ysSceneRayCastOutput::m_primitiveIndex)
     const ysMaterial* m_material;
     const ysEmissiveMaterial* m_emissive;
     ysVec4 m_posWS;
@@ -521,168 +1375,304 @@ struct ysScene::ysSurfaceData
     ysVec4 m_incomingDirectionWS;
 };
 
+static const ys_float32 s_minRussianRouletteContinuationProbability = 0.001f;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-ysVec4 ysScene::SampleRadiance(const ysSurfaceData& surfaceData, ys_int32 bounceCount, ys_int32 maxBounceCount,
-    bool sampleLight) const
+// The closest hit on the specified shape among the emissive surfaces the ray crosses, or nullptr if the shape is occluded (or was missed)
+static const ysSceneRayCastOutput* sFindEmissiveHit(const SingleReflectiveMultipleEmissives& srme, ys_int32 shapeIdx)
 {
-    // Our labeling scheme is based on the path taken by photons: surface 0 --> surface 1 --> surface 2
-    // In this context, surface 1 is the current one, and surface 0 is the new randomly sampled surface.
-    const ysVec4& x1 = surfaceData.m_posWS;
-    const ysVec4& n1 = surfaceData.m_normalWS;
-    const ysVec4& t1 = surfaceData.m_tangentWS;
-    const ysVec4& w12 = surfaceData.m_incomingDirectionWS;
-    const ysShape* shape1 = surfaceData.m_shape;
-    const ysMaterial* mat1 = surfaceData.m_material;
-
-    ysMtx44 R1; // The frame at surface 1
+    const ysSceneRayCastOutput* hit = nullptr;
+    for (ys_int32 i = 0; i < srme.m_emissiveCount; ++i)
     {
-        R1.cx = t1;
-        R1.cy = ysCross(n1, t1);
-        R1.cz = n1;
+        const ysSceneRayCastOutput& o = srme.m_emissiveOutputs[i];
+        if (o.m_shapeId.m_index == shapeIdx && (hit == nullptr || o.m_lambda < hit->m_lambda))
+        {
+            hit = &o;
+        }
     }
-    ysVec4 w12_LS1 = ysMulT33(R1, w12); // direction 1->2 expressed in the frame of surface 1 (LS1: "in the local space of surface 1").
-
-    ysVec4 emittedRadiance = ysVec4_zero;
-    if (surfaceData.m_emissive != nullptr)
+    if (hit == nullptr && srme.m_hitReflective && srme.m_reflectiveOutput.m_shapeId.m_index == shapeIdx)
     {
-        // In principle, sampling directionally-specular emission is inconceivable for unidirectional path tracing.
-        ysRadiance emitL = surfaceData.m_emissive->EvaluateRadiance(this, w12_LS1);
-        emittedRadiance = emitL.m_isFinite ? emitL.m_value : ysVec4_zero;
+        hit = &srme.m_reflectiveOutput;
     }
+    return hit;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Index of the emissive shape into m_emissiveShapeIndices, which is also its emitter index in m_lightBVH
+static ys_int32 sEmitterIndexFromShapeIndex(const ysScene* scene, ys_int32 shapeIdx)
+{
+    // The emissive shapes are gathered in shape order
+    const ys_int32* begin = scene->m_emissiveShapeIndices;
+    const ys_int32* end = begin + scene->m_emissiveShapeCount;
+    const ys_int32* it = std::lower_bound(begin, end, shapeIdx);
+    ysAssert(it != end && *it == shapeIdx);
+    return ys_int32(it - begin);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysVec4 ysScene::SampleRadiance(const ysSurfaceData& firstSurface, const ysGlobalIlluminationInput_UniDirectional& input, ysPathGuide* guide) const
+{
+    const ys_int32 maxBounceCount = input.m_maxBounceCount;
+    const bool sampleLight = input.m_sampleLight && m_emissiveShapeCount > 0;
+    const ys_int32 emitterSampleCount = ysMax(input.m_lightSampleCount, 1);
+
+    // Where the guide has learned something, directions are drawn from the BRDF with this probability and from the guide otherwise. It is
+    // kept away from zero so that directions the guide has not (yet) seen any radiance arrive from can still be sampled.
+    const ys_float32 guidedBrdfFraction = ysClamp(input.m_pathGuidingBrdfFraction, 0.05f, 1.0f);
 
-    if (bounceCount == maxBounceCount)
+    // Once the path is complete, every bounce direction is handed to the guide along with the radiance that was found along it
+    struct GuideRecord
     {
-        return emittedRadiance;
-    }
+        ysVec4 posWS;
+        ysVec4 dirWS;
+        ysVec4 radianceBefore; // The path's radiance before anything was found along the direction
+        ysVec4 throughput;     // Including the bounce itself
+        ys_float32 probability;
+    };
+    const ys_int32 k_maxGuideRecordCount = 16;
+    GuideRecord guideRecords[k_maxGuideRecordCount];
+    ys_int32 guideRecordCount = 0;
+
+    // Likewise, the irradiance found at every diffuse surface on the path is handed to the radiance cache
+    bool useCache = input.m_radianceCacheBounceCount > 0 && m_radianceCacheStale.load(std::memory_order_relaxed) == false;
+    ysRadianceCache* cache = useCache ? m_radianceCache : nullptr;
+    struct CacheRecord
+    {
+        ysVec4 posWS;
+        ysVec4 normalWS;
+        ysVec4 radianceBefore; // The path's radiance before anything was reflected by the surface
+        ysVec4 throughput;     // Up to the surface
+        ysVec4 brdf;
+    };
+    const ys_int32 k_maxCacheRecordCount = 16;
+    CacheRecord cacheRecords[k_maxCacheRecordCount];
+    ys_int32 cacheRecordCount = 0;
+
+    // The path is extended one surface at a time rather than recursively. At each surface we gather the radiance that reaches it directly
+    // from emitters, then continue along a single direction sampled from the BRDF. 'throughput' is the product of BRDF * cosine / probability
+    // over the path so far, i.e. the factor converting radiance reflected at the current surface into radiance seen at the first surface.
+    // Splitting the incoming radiance this way (direct emission via MIS of all strategies, indirect via the BRDF sample alone) keeps the
+    // cost linear in the path length, where it used to grow exponentially with the number of emissive shapes.
+    ysSurfaceData surface1 = firstSurface;
+    ysVec4 throughput = ysVec4_one;
+    ysVec4 radiance = ysVec4_zero;
 
-    // The space of directions to sample point lights is infinitesimal and therefore DISJOINT from the space of directions to sample
-    // surfaces in general (including area lights, which are simpy emissive surfaces). Hence, we assign our point light samples the full
-    // weight of 1 in the context of multiple importance sampling (MIS).
-    ysVec4 pointLitRadiance = ysVec4_zero;
-    for (ys_int32 i = 0; i < m_lightPointCount; ++i)
+    // Reused for every ray cast along the path
+    ysSceneRayCastInput srci;
+    srci.m_maxLambda = ys_maxFloat;
+    SingleReflectiveMultipleEmissives srme;
+
+    for (ys_int32 bounceCount = 0; ; ++bounceCount)
     {
-        const ysLightPoint* light = m_lightPoints + i;
-        ysVec4 v10 = light->m_position - x1;
-        if (ysIsSafeToNormalize3(v10) == false)
+        // Our labeling scheme is based on the path taken by photons: surface 0 --> surface 1 --> surface 2
+        // In this context, surface 1 is the current one, and surface 0 is the new randomly sampled surface.
+        const ysVec4& x1 = surface1.m_posWS;
+        const ysVec4& n1 = surface1.m_normalWS;
+        const ysVec4& t1 = surface1.m_tangentWS;
+        const ysVec4& w12 = surface1.m_incomingDirectionWS;
+        const ysShape* shape1 = surface1.m_shape;
+        ys_int32 primitive1 = surface1.m_primitiveIndex;
+        const ysMaterial* mat1 = surface1.m_material;
+
+        ysMtx44 R1; // The frame at surface 1
         {
-            continue;
+            R1.cx = t1;
+            R1.cy = ysCross(n1, t1);
+            R1.cz = n1;
         }
+        ysVec4 w12_LS1 = ysMulT33(R1, w12); // direction 1->2 expressed in the frame of surface 1 (LS1: "in the local space of surface 1").
 
-        ysVec4 w10 = ysNormalize3(v10);
-        ys_float32 cos10_1 = ysDot3(w10, n1);
-        if (cos10_1 <= 0.0f)
+        if (bounceCount == 0 && surface1.m_emissive != nullptr)
         {
-            continue;
+            // Emission from subsequent surfaces is accounted for when the ray that found them is cast (see below).
+            // In principle, sampling directionally-specular emission is inconceivable for unidirectional path tracing.
+            ysRadiance emitL = surface1.m_emissive->EvaluateRadiance(this, w12_LS1);
+            radiance += emitL.m_isFinite ? emitL.m_value : ysVec4_zero;
         }
 
-        ysSceneRayCastInput srci;
-        srci.m_maxLambda = 1.0f;
-        srci.m_direction = v10;
-        srci.m_origin = x1;
+        if (bounceCount == maxBounceCount)
+        {
+            break;
+        }
 
-        ysSceneRayCastOutput srco;
-        bool occluded = sRayCastClosestReflective(this, &srco, srci, shape1);
-        if (occluded)
+        if (cache != nullptr && mat1->m_type == ysMaterial::Type::e_standard)
         {
-            continue;
+            // The BRDF is the same for every pair of directions
+            ysBSDF f = mat1->EvaluateBRDF(this, ysVec4_unitZ, w12_LS1);
+
+            // Past enough bounces, the surface's cached irradiance stands in for the rest of the path. Any error in it is blurred by the
+            // reflections in between by the time it reaches the eye.
+            ysVec4 irradiance;
+            if (bounceCount == input.m_radianceCacheBounceCount && cache->Lookup(x1, n1, &irradiance))
+            {
+                radiance += throughput * f.m_value * irradiance;
+                break;
+            }
+
+            if (cacheRecordCount < k_maxCacheRecordCount)
+            {
+                CacheRecord* record = cacheRecords + cacheRecordCount++;
+                record->posWS = x1;
+                record->normalWS = n1;
+                record->radianceBefore = radiance;
+                record->throughput = throughput;
+                record->brdf = f.m_value;
+            }
         }
 
-        ys_float32 rr10 = ysLengthSqr3(v10);
-        ysVec4 projIrradiance = light->m_radiantIntensity * ysSplat(cos10_1) / ysSplat(rr10);
-        ysVec4 w10_LS1 = ysMulT33(R1, w10);
-        ysBSDF brdf = surfaceData.m_material->EvaluateBRDF(this, w10_LS1, w12_LS1);
-        // In principle, impossible for unidirectional path tracing to sample specular reflection of a point light.
-        pointLitRadiance += brdf.m_isFinite ? projIrradiance * brdf.m_value : ysVec4_zero;
-    }
+        // The guide knows nothing of specular reflection, so mirrors are left to the BRDF alone
+        const ysPathGuide::Distribution* guide1 = nullptr;
+        if (guide != nullptr && mat1->m_type == ysMaterial::Type::e_standard)
+        {
+            guide1 = guide->FindDistribution(x1);
+        }
+        const ys_float32 brdfFraction = (guide1 != nullptr) ? guidedBrdfFraction : 1.0f;
 
-    ysVec4 surfaceLitRadiance = ysVec4_zero;
-    {
-        // For MIS, we adopt the recommended approach in Chapter 8 of Veach's thesis: the standard balance heuristic with added power
-        // heuristic (exponent = 2) to boost low variance strategies. We use a single sample per strategy, with strategies as follows:
-        // - Pick a direction by sampling the hemisphere, ideally according to the BRDF. (This corresponds to a single strategy)
-        // - Pick a direction by selecting point on the surface of each emissive shape that, barring occlusion by other scene
-        //   geometry, is visible from the current point. (This corresponds to m_emissiveShapeCount strategies)
-        // Each such direction could conceivably have been generated by another strategy. For instance, a given direction may point towards
-        // multiple light sources. It is under these circumstances that MIS must be employed.
+        // The probability density with which the path is continued along the direction w10, whether it came from the BRDF or the guide
+        auto ComputeDirectionalProbability = [&](const ysVec4& w10, const ysVec4& w10_LS1) -> ysDirectionalProbabilityDensity
+        {
+            ysDirectionalProbabilityDensity p = mat1->ProbabilityDensityForGeneratedIncomingDirection(this, w10_LS1, w12_LS1);
+            if (guide1 != nullptr)
+            {
+                ysAssert(p.m_perSolidAngle.m_isFinite);
+                ys_float32 pGuide = guide1->ProbabilityDensityForGeneratedDirection(w10);
+                p.m_perSolidAngle.m_value = brdfFraction * p.m_perSolidAngle.m_value + (1.0f - brdfFraction) * pGuide;
+                p.m_perProjectedSolidAngle.m_value = (w10_LS1.z > 0.0f) ? p.m_perSolidAngle.m_value / w10_LS1.z : 0.0f;
+            }
+            return p;
+        };
 
-        // Sample the hemisphere (ideally according to the BRDF*cosine)
+        // The space of directions to sample point lights is infinitesimal and therefore DISJOINT from the space of directions to sample
+        // surfaces in general (including area lights, which are simpy emissive surfaces). Hence, we assign our point light samples the full
+        // weight of 1 in the context of multiple importance sampling (MIS).
+        auto ComputePointLitRadiance = [&](const ysLightPoint* light) -> ysVec4
         {
-            ysVec4 w10_LS1;
-            ysBSDF f012;
-            ysDirectionalProbabilityDensity p = mat1->GenerateRandomDirection(this, &w10_LS1, w12_LS1, &f012);
-            ysVec4 w10 = ysMul33(R1, w10_LS1);
-        
-            ysSceneRayCastInput srci;
-            srci.m_maxLambda = ys_maxFloat;
-            srci.m_direction = w10;
-            srci.m_origin = x1;
-        
-            SingleReflectiveMultipleEmissives srme;
-            sRayCastClosestReflective_CollectEmissives(this, &srme, srci, shape1);
-            if (srme.m_hitReflective || srme.m_emissiveCount > 0)
+            ysVec4 v10 = light->m_position - x1;
+            if (ysIsSafeToNormalize3(v10) == false)
+            {
+                return ysVec4_zero;
+            }
+
+            ysVec4 w10 = ysNormalize3(v10);
+            ys_float32 cos10_1 = ysDot3(w10, n1);
+            if (cos10_1 <= 0.0f)
+            {
+                return ysVec4_zero;
+            }
+
+            ysSceneRayCastInput shadowInput;
+            shadowInput.m_maxLambda = 1.0f;
+            shadowInput.m_direction = v10;
+            shadowInput.m_origin = x1;
+
+            ysSceneRayCastOutput srco;
+            bool occluded = sRayCastClosestReflective(this, &srco, shadowInput, shape1, primitive1);
+            if (occluded)
+            {
+                return ysVec4_zero;
+            }
+
+            ys_float32 rr10 = ysLengthSqr3(v10);
+            ysVec4 projIrradiance = light->m_radiantIntensity * ysSplat(cos10_1) / ysSplat(rr10);
+            ysVec4 w10_LS1 = ysMulT33(R1, w10);
+            ysBSDF brdf = mat1->EvaluateBRDF(this, w10_LS1, w12_LS1);
+            // In principle, impossible for unidirectional path tracing to sample specular reflection of a point light.
+            return brdf.m_isFinite ? projIrradiance * brdf.m_value : ysVec4_zero;
+        };
+
+        ysVec4 pointLitRadiance = ysVec4_zero;
+        if (input.m_lightSampleCount > 0)
+        {
+            // Next event estimation: Trace shadow rays to a fixed number of lights chosen in proportion to their estimated contribution.
+            ys_int32 sampleCount = input.m_lightSampleCount;
+            for (ys_int32 i = 0; i < sampleCount; ++i)
             {
-                ysVec4 radiance = sAccumulateDirectRadiance(this, -w10, srme.m_emissiveOutputs, srme.m_emissiveCount);
-                if (srme.m_hitReflective)
+                ys_float32 probability;
+                ys_int32 lightIdx = m_infinitesimalLightBVH.SampleEmitter(x1, n1, &probability);
+                if (lightIdx == ys_nullIndex)
                 {
-                    const ysSceneRayCastOutput &opt = srme.m_reflectiveOutput;
-
-                    ysSurfaceData surface0;
-                    surface0.SetShape(this, opt.m_shapeId);
-                    surface0.m_posWS = opt.m_hitPoint;
-                    surface0.m_normalWS = opt.m_hitNormal;
-                    surface0.m_tangentWS = opt.m_hitTangent;
-                    surface0.m_incomingDirectionWS = -w10;
-
-                    ysVec4 incomingRadiance = SampleRadiance(surface0, bounceCount + 1, maxBounceCount, sampleLight);
-                    ysAssert(ysAllGE3(incomingRadiance, ysVec4_zero));
-                    radiance += f012.m_value * incomingRadiance / ysSplat(p.m_perProjectedSolidAngle.m_value);
+                    // No light can contribute to this point
+                    break;
                 }
-        
-                ys_float32 weight = 1.0f;
-                if (sampleLight && p.m_perSolidAngle.m_isFinite)
+                ysAssert(probability > 0.0f);
+
+                const ysLight* light = m_lights + lightIdx;
+                switch (light->m_type)
                 {
-                    ys_float32 numerator = p.m_perSolidAngle.m_value * p.m_perSolidAngle.m_value;
-                    ys_float32 denominator = numerator;
-                    for (ys_int32 i = 0; i < m_emissiveShapeCount; ++i)
+                    case ysLight::Type::e_point:
                     {
-                        const ysShape* emissiveShape = m_shapes + m_emissiveShapeIndices[i];
-
-                        ysRayCastInput rci;
-                        rci.m_maxLambda = ys_maxFloat;
-                        rci.m_direction = w10;
-                        rci.m_origin = x1;
-
-                        ysRayCastOutput rco;
-                        bool samplingTechniquesOverlap = emissiveShape->RayCast(this, &rco, rci);
-                        if (samplingTechniquesOverlap)
-                        {
-                            ys_float32 pAreaTmp = emissiveShape->ProbabilityDensityForGeneratedPoint(this, rco.m_hitPoint);
-                            ys_float32 rr = rco.m_lambda * rco.m_lambda;
-                            ys_float32 c = ysDot3(-w10, rco.m_hitNormal);
-                            ysAssert(c >= 0.0f);
-                            if (c > ys_zeroSafe)
-                            {
-                                ys_float32 pAngleTmp = pAreaTmp * rr / c;
-                                denominator += pAngleTmp * pAngleTmp;
-                            }
-                        }
+                        const ysLightPoint* lightPoint = m_lightPoints + light->m_typeIndex;
+                        pointLitRadiance += ComputePointLitRadiance(lightPoint) / ysSplat(probability);
+                        break;
+                    }
+                    default:
+                    {
+                        ysAssert(false);
+                        break;
                     }
-                    weight = numerator * ysSafeReciprocal(denominator);
                 }
-        
-                surfaceLitRadiance += ysSplat(weight) * radiance;
+            }
+            pointLitRadiance *= ysSplat(1.0f / ys_float32(sampleCount));
+        }
+        else
+        {
+            for (ys_int32 i = 0; i < m_lightPointCount; ++i)
+            {
+                pointLitRadiance += ComputePointLitRadiance(m_lightPoints + i);
             }
         }
-        
+        radiance += throughput * pointLitRadiance;
+
+        // For MIS, we adopt the recommended approach in Chapter 8 of Veach's thesis: the standard balance heuristic with added power
+        // heuristic (exponent = 2) to boost low variance strategies. There are two strategies:
+        // - Pick a direction by sampling the hemisphere, ideally according to the BRDF. (A single sample)
+        // - Pick an emissive shape from the light hierarchy, with probability roughly proportional to its contribution, then pick a point on
+        //   its surface that, barring occlusion by other scene geometry, is visible from the current point. (emitterSampleCount samples)
+        // Each such direction could conceivably have been generated by the other strategy, as the hemisphere sample may find any emissive
+        // shape. It is under these circumstances that MIS must be employed. Only the directly emitted radiance is estimated this way;
+        // radiance reflected by the surface found along the direction is left to the BRDF sample, which continues the path.
+
+        // Probability density (per solid angle, over all light samples) with which the light strategy finds the emissive hit along w10
+        auto ComputeEmitterProbability = [&](const ysSceneRayCastOutput& hit, const ysVec4& w10) -> ys_float32
+        {
+            const ysShape* emissiveShape = m_shapes + hit.m_shapeId.m_index;
+            if (emissiveShape == shape1)
+            {
+                // Never sampled (see below)
+                return 0.0f;
+            }
+            ys_float32 c = ysDot3(-w10, hit.m_hitNormal);
+            if (c <= ys_epsilon) // Prevent division by zero
+            {
+                return 0.0f;
+            }
+            ys_int32 emitterIdx = sEmitterIndexFromShapeIndex(this, hit.m_shapeId.m_index);
+            ys_float32 pEmitter = m_lightBVH.ProbabilityForEmitter(x1, n1, emitterIdx);
+            ys_float32 pArea = emissiveShape->ProbabilityDensityForGeneratedPoint(this, hit.m_hitPoint);
+            ys_float32 rr = ysLengthSqr3(hit.m_hitPoint - x1);
+            return ys_float32(emitterSampleCount) * pEmitter * pArea * rr / c;
+        };
+
         if (sampleLight)
         {
-            // Sample each emissive shape
-            for (ys_int32 i = 0; i < m_emissiveShapeCount; ++i)
+            for (ys_int32 i = 0; i < emitterSampleCount; ++i)
             {
+                ys_float32 pEmitter;
+                ys_int32 emitterIdx = m_lightBVH.SampleEmitter(x1, n1, &pEmitter);
+                if (emitterIdx == ys_nullIndex)
+                {
+                    // No emissive shape can contribute to this point
+                    break;
+                }
+                ysAssert(pEmitter > 0.0f);
+
                 // NOTE: The shape that the generated direction first intersects may actually be something other than this emissive shape.
                 //       So it's a bit inconsistent to refer to this emissive shape as shape '0,' but we do so for convenience.
-                const ysShape* shape0 = m_shapes + m_emissiveShapeIndices[i];
+                ys_int32 shapeIdx0 = m_emissiveShapeIndices[emitterIdx];
+                const ysShape* shape0 = m_shapes + shapeIdx0;
                 if (shape0 == shape1)
                 {
                     continue;
@@ -714,110 +1704,189 @@ ysVec4 ysScene::SampleRadiance(const ysSurfaceData& surfaceData, ys_int32 bounce
                 {
                     continue;
                 }
-                // Convert probability density from 'per area' to 'per solid angle'
-                ys_float32 pAngle = pArea * rr01 / cos01_0;
-                if (pAngle < ys_epsilon)
+                // Convert probability density from 'per area' to 'per solid angle', over all light samples
+                ys_float32 pLight = ys_float32(emitterSampleCount) * pEmitter * pArea * rr01 / cos01_0;
+                if (pLight < ys_epsilon)
                 {
                     // Prevent division by zero
                     continue;
                 }
 
-                ysSceneRayCastInput srci;
-                srci.m_maxLambda = ys_maxFloat;
+                ysBSDF brdf = mat1->EvaluateBRDF(this, w10_LS1, w12_LS1);
+                if (brdf.m_isFinite == false)
+                {
+                    // In principle, impossible for unidirectional path tracing to sample specular reflection of a point on an area light.
+                    continue;
+                }
+
+                // Other emissive shapes crossed on the way are left to the samples that choose them
                 srci.m_direction = v10;
                 srci.m_origin = x1;
+                sRayCastClosestReflective_CollectEmissives(this, &srme, srci, shape1, primitive1);
+                const ysSceneRayCastOutput* hit0 = sFindEmissiveHit(srme, shapeIdx0);
+                if (hit0 == nullptr)
+                {
+                    continue;
+                }
 
-                SingleReflectiveMultipleEmissives srme;
-                sRayCastClosestReflective_CollectEmissives(this, &srme, srci, shape1);
-                if (srme.m_hitReflective || srme.m_emissiveCount > 0)
+                ysVec4 emittedRadiance = sEmittedRadiance(this, w01, *hit0);
+
+                ys_float32 weight;
                 {
-                    ysVec4 radiance = sAccumulateDirectRadiance(this, w01, srme.m_emissiveOutputs, srme.m_emissiveCount);
-                
-                    if (srme.m_hitReflective)
+                    ys_float32 numerator = pLight * pLight;
+                    ys_float32 denominator = numerator;
+                    ysDirectionalProbabilityDensity p = ComputeDirectionalProbability(w10, w10_LS1);
+                    if (p.m_perSolidAngle.m_isFinite)
                     {
-                        const ysSceneRayCastOutput &opt = srme.m_reflectiveOutput;
-
-                        ysSurfaceData surface0;
-                        surface0.SetShape(this, opt.m_shapeId);
-                        surface0.m_posWS = opt.m_hitPoint;
-                        surface0.m_normalWS = opt.m_hitNormal;
-                        surface0.m_tangentWS = opt.m_hitTangent;
-                        surface0.m_incomingDirectionWS = w01;
-
-                        ysVec4 incomingRadiance = SampleRadiance(surface0, bounceCount + 1, maxBounceCount, sampleLight);
-                        ysAssert(ysAllGE3(incomingRadiance, ysVec4_zero));
-                        ysBSDF brdf = mat1->EvaluateBRDF(this, w10_LS1, w12_LS1);
-                        if (brdf.m_isFinite == false)
-                        {
-                            // In principle, impossible for unidirectional path tracing to sample specular reflection of a point on an area light.
-                            continue;
-                        }
-                        radiance += brdf.m_value * incomingRadiance * ysSplat(cos10_1 / pAngle);
+                        // In principle, impossible for area light sampling to overlap with sampling singular directional distribution.
+                        denominator += p.m_perSolidAngle.m_value * p.m_perSolidAngle.m_value;
                     }
+                    weight = numerator / denominator;
+                }
 
-                    ys_float32 weight;
-                    {
-                        ys_float32 numerator = pAngle * pAngle;
-                        ys_float32 denominator = numerator;
-                        for (ys_int32 j = 0; j < m_emissiveShapeCount; ++j)
-                        {
-                            if (j == i)
-                            {
-                                continue;
-                            }
-                            const ysShape* emissiveShape = m_shapes + m_emissiveShapeIndices[j];
-                            if (emissiveShape == shape1)
-                            {
-                                continue;
-                            }
-
-                            ysRayCastInput rci;
-                            rci.m_maxLambda = ys_maxFloat;
-                            rci.m_direction = w10;
-                            rci.m_origin = x1;
-
-                            ysRayCastOutput rco;
-                            bool samplingTechniquesOverlap = emissiveShape->RayCast(this, &rco, rci);
-                            if (samplingTechniquesOverlap)
-                            {
-                                ys_float32 pAreaTmp = emissiveShape->ProbabilityDensityForGeneratedPoint(this, rco.m_hitPoint);
-                                ys_float32 rr = rco.m_lambda * rco.m_lambda;
-                                ys_float32 c = ysDot3(w01, rco.m_hitNormal);
-                                ysAssert(c >= 0.0f);
-                                if (c > ys_epsilon) // Prevent division by zero
-                                {
-                                    ys_float32 pAngleTmp = pAreaTmp * rr / c;
-                                    denominator += pAngleTmp * pAngleTmp;
-                                }
-                            }
-                        }
+                radiance += throughput * brdf.m_value * emittedRadiance * ysSplat(weight * cos10_1 / pLight);
+            }
+        }
 
-                        ysDirectionalProbabilityDensity p = mat1->ProbabilityDensityForGeneratedIncomingDirection(this, w10_LS1, w12_LS1);
-                        if (p.m_perSolidAngle.m_isFinite)
-                        {
-                            // In principle, impossible for area light sampling to overlap with sampling singular directional distribution.
-                            denominator += p.m_perSolidAngle.m_value * p.m_perSolidAngle.m_value;
-                        }
+        // Sample the hemisphere (ideally according to the BRDF*cosine or the learned incident radiance) to find the next surface on the path
+        ysVec4 w10_LS1;
+        ysBSDF f012;
+        ysDirectionalProbabilityDensity p;
+        if (brdfFraction == 1.0f || ysRandom(0.0f, 1.0f) < brdfFraction)
+        {
+            p = mat1->GenerateRandomDirection(this, &w10_LS1, w12_LS1, &f012);
+            if (guide1 != nullptr)
+            {
+                p = ComputeDirectionalProbability(ysMul33(R1, w10_LS1), w10_LS1);
+            }
+        }
+        else
+        {
+            // The guide spans the whole sphere. Directions below the surface are rejected by their zero projected probability below.
+            w10_LS1 = ysMulT33(R1, guide1->GenerateRandomDirection());
+            f012 = mat1->EvaluateBRDF(this, w10_LS1, w12_LS1);
+            p = ComputeDirectionalProbability(ysMul33(R1, w10_LS1), w10_LS1);
+        }
+        if (p.m_perProjectedSolidAngle.m_value <= 0.0f)
+        {
+            break;
+        }
+        ysVec4 w10 = ysMul33(R1, w10_LS1);
 
-                        weight = numerator / denominator;
-                    }
+        srci.m_direction = w10;
+        srci.m_origin = x1;
+        sRayCastClosestReflective_CollectEmissives(this, &srme, srci, shape1, primitive1);
+        if (srme.m_hitReflective == false && srme.m_emissiveCount == 0)
+        {
+            break;
+        }
+
+        throughput *= f012.m_value / ysSplat(p.m_perProjectedSolidAngle.m_value);
+        ysAssert(ysAllGE3(throughput, ysVec4_zero));
+
+        if (guide != nullptr && p.m_perSolidAngle.m_isFinite && guideRecordCount < k_maxGuideRecordCount)
+        {
+            GuideRecord* record = guideRecords + guideRecordCount++;
+            record->posWS = x1;
+            record->dirWS = w10;
+            record->radianceBefore = radiance;
+            record->throughput = throughput;
+            record->probability = p.m_perSolidAngle.m_value;
+        }
 
-                    surfaceLitRadiance += ysSplat(weight) * radiance;
+        // Each emissive surface found along the direction is weighted against the light samples that could have chosen it
+        for (ys_int32 i = 0; i <= srme.m_emissiveCount; ++i)
+        {
+            const ysSceneRayCastOutput& hit = (i < srme.m_emissiveCount) ? srme.m_emissiveOutputs[i] : srme.m_reflectiveOutput;
+            if (i == srme.m_emissiveCount)
+            {
+                // The closest reflective surface may be emissive too
+                if (srme.m_hitReflective == false || m_shapes[hit.m_shapeId.m_index].m_emissiveMaterialId == ys_nullEmissiveMaterialId)
+                {
+                    break;
                 }
             }
+
+            ysVec4 emittedRadiance = sEmittedRadiance(this, -w10, hit);
+
+            ys_float32 weight = 1.0f;
+            if (sampleLight && p.m_perSolidAngle.m_isFinite)
+            {
+                ys_float32 numerator = p.m_perSolidAngle.m_value * p.m_perSolidAngle.m_value;
+                ys_float32 pLight = ComputeEmitterProbability(hit, w10);
+                ys_float32 denominator = numerator + pLight * pLight;
+                weight = numerator * ysSafeReciprocal(denominator);
+            }
+
+            radiance += throughput * emittedRadiance * ysSplat(weight);
+        }
+
+        if (srme.m_hitReflective == false)
+        {
+            break;
+        }
+
+        if (bounceCount + 1 < maxBounceCount && bounceCount + 1 >= input.m_russianRouletteMinBounceCount)
+        {
+            // Another bounce is due and we've already made the minimum number requested. Do Russian Roulette termination.
+            ys_float32 q = ysClamp(ysMax(ysMax(throughput.x, throughput.y), throughput.z), s_minRussianRouletteContinuationProbability, 1.0f);
+            ys_float32 r = ysRandom(0.0f, 1.0f);
+            bool absorbed = (r > q);
+            if (absorbed)
+            {
+                break;
+            }
+            throughput /= ysSplat(q);
         }
+
+        const ysSceneRayCastOutput& opt = srme.m_reflectiveOutput;
+        surface1.SetShape(this, opt.m_shapeId, opt.m_primitiveIndex);
+        surface1.m_posWS = opt.m_hitPoint;
+        surface1.m_normalWS = opt.m_hitNormal;
+        surface1.m_tangentWS = opt.m_hitTangent;
+        surface1.m_incomingDirectionWS = -w10;
     }
 
-    return emittedRadiance + pointLitRadiance + surfaceLitRadiance;
+    // Everything the path gathered past a bounce arrived along its direction, attenuated by the throughput up to and including the bounce.
+    // The guide learns from one color channel-averaged estimate of that incident radiance per bounce.
+    for (ys_int32 i = 0; i < guideRecordCount; ++i)
+    {
+        const GuideRecord& record = guideRecords[i];
+        ysVec4 gathered = radiance - record.radianceBefore;
+        ys_float32 incidentRadiance = 0.0f;
+        incidentRadiance += (record.throughput.x > 0.0f) ? gathered.x / record.throughput.x : 0.0f;
+        incidentRadiance += (record.throughput.y > 0.0f) ? gathered.y / record.throughput.y : 0.0f;
+        incidentRadiance += (record.throughput.z > 0.0f) ? gathered.z / record.throughput.z : 0.0f;
+        incidentRadiance = ysMax(0.0f, incidentRadiance / 3.0f);
+        guide->AddRecord(record.posWS, record.dirWS, incidentRadiance / record.probability);
+    }
+
+    // Similarly, everything the path gathered past a diffuse surface was reflected by it, and dividing out the BRDF leaves the irradiance
+    for (ys_int32 i = 0; i < cacheRecordCount; ++i)
+    {
+        const CacheRecord& record = cacheRecords[i];
+        ysVec4 reflected = radiance - record.radianceBefore;
+        ysVec4 attenuation = record.throughput * record.brdf;
+        ysVec4 irradiance;
+        irradiance.x = (attenuation.x > 0.0f) ? reflected.x / attenuation.x : 0.0f;
+        irradiance.y = (attenuation.y > 0.0f) ? reflected.y / attenuation.y : 0.0f;
+        irradiance.z = (attenuation.z > 0.0f) ? reflected.z / attenuation.z : 0.0f;
+        irradiance.w = 0.0f;
+        cache->AddSample(record.posWS, record.normalWS, ysMax(irradiance, ysVec4_zero));
+    }
+
+    ysAssert(ysAllGE3(radiance, ysVec4_zero));
+    return radiance;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct PathVertex
 {
-    void SetShape(const ysScene* scene, const ysShapeId& shapeId)
+    void SetShape(const ysScene* scene, const ysShapeId& shapeId, ys_int32 primitiveIdx)
     {
         m_shape = scene->m_shapes + shapeId.m_index;
+        m_primitiveIndex = primitiveIdx;
         m_material = (m_shape->m_materialId == ys_nullMaterialId)
             ? nullptr
             : scene->m_materials + m_shape->m_materialId.m_index;
@@ -827,6 +1896,7 @@ struct PathVertex
     }
 
     const ysShape* m_shape;
+    ys_int32 m_primitiveIndex; // (See ysSceneRayCastOutput::m_primitiveIndex)
     const ysMaterial* m_material;
     const ysEmissiveMaterial* m_emissive;
     ysVec4 m_posWS;
@@ -845,6 +1915,16 @@ struct PathVertex
     // BRDF for scattering at this point... or if this is the vertex on the light/sensor, the directional distribution of emitted radiance/
     // importance (directional distribution of radiance is the the radiance divided by the integral of radiance over projected solid angle)
     ysBSDF m_f;
+
+    // Unweighted estimator for the subpath ending at this vertex (excluding the scattering at this vertex): the emitted irradiance (or
+    // important exitance) over the per-area probability of the first vertex, times m_f / (m_p[1] * Russian Roulette continuation
+    // probability) for each preceding vertex.
+    ysVec4 m_estimator;
+
+    // Partial sum for the MIS weight: the squared probability ratios (relative to this subpath) of every strategy that generates fewer
+    // vertices on this subpath, and which is already determined by the vertices preceding the previous one. Filled in when the vertex is
+    // generated so that joining subpaths costs O(1) rather than a walk over both of them. (See EvaluateTruncatedSubpaths)
+    ys_float32 m_misSum;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -854,6 +1934,7 @@ struct InputEyePathVertex
     void InitializePathVertex(PathVertex* pv) const
     {
         pv->m_shape = m_shape;
+        pv->m_primitiveIndex = m_primitiveIndex;
         pv->m_material = m_material;
         pv->m_emissive = m_emissive;
         pv->m_posWS = m_posWS;
@@ -862,6 +1943,7 @@ struct InputEyePathVertex
     }
 
     const ysShape* m_shape;
+    ys_int32 m_primitiveIndex; // (See ysSceneRayCastOutput::m_primitiveIndex)
     const ysMaterial* m_material;
     const ysEmissiveMaterial* m_emissive;
     ysVec4 m_posWS;
@@ -912,33 +1994,50 @@ struct ysScene::GenerateSubpathInput
 
     ys_int32 minEyePathVertexCount;
     ys_int32 maxEyePathVertexCount;
+
+    // If not null, light subpaths are also connected directly to the eye (t=1) and MIS weights account for these strategies.
+    const ysCamera* camera;
+
+    // The number of samples taken with each kind of strategy per eye subpath, relative to the strategies that use the eye subpath alone
+    // (s=0). Both are 1 unless light subpaths are shared between eye subpaths (see ysRender::m_lightSubpathPool).
+    ys_float32 joinSampleCount;         // s>0, t>1: The number of light subpaths each eye subpath is joined to
+    ys_float32 lightTracingSampleCount; // t=1: The number of light subpaths traced per eye subpath
+
+    // Vertex merging: The number of light subpaths merged with each eye subpath times the area of the merge disk (N_VM * pi * r^2, as
+    // in "Light Transport Simulation with Vertex Connection and Merging" by Georgiev et al. 2012). Zero if vertex merging is disabled.
+    ys_float32 mergeEta;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-struct ysScene::GenerateSubpathOutput
+// Kept apart from the eye subpath so that a single light subpath can be joined to many eye subpaths (see ysRender::m_lightSubpathPool)
+struct ysLightSubpath
 {
     static const ys_int32 s_nLCeil = 16;
-    static const ys_int32 s_nECeil = 16;
     PathVertex m_y[s_nLCeil]; // light-path vertices
-    PathVertex m_z[s_nECeil]; //   eye-path vertices
     ys_int32 m_nL;
-    ys_int32 m_nE;
     ys_float32 m_dPdA_L0;
-    ys_float32 m_dPdA_W0;
     bool m_dPdA_L0_finite;
-    bool m_dPdA_W0_finite;
     ysVec4 m_estimatorFactor_L0; // The emitted irradiance divided by the per-area-probability of generating vertex 0 of the light subpath
-    ysVec4 m_estimatorFactor_W0; // ........... importance .................................................................  eye  .......
-
-    // The index of the first vertex on each subpath that could possibly be culled by Russian Roulette; the first few vertices are typically
-    // not considered for RR termination since they contribute the most to the image function. Note that the following indices may exceed
-    // the actual number of vertices generated (m_nL/E) as the subpath may exit the scene or strike "Vantablack."
-    ys_int32 m_russianRouletteBeginL;
-    ys_int32 m_russianRouletteBeginE;
 };
 
-static const ys_float32 s_minRussianRouletteContinuationProbability = 0.001f;
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysScene::GenerateSubpathOutput
+{
+    static const ys_int32 s_nECeil = 16;
+    const ysLightSubpath* m_light; // Not owned. May be shared with other eye subpaths.
+    PathVertex m_z[s_nECeil]; //   eye-path vertices
+    ys_int32 m_nE;
+    ys_float32 m_dPdA_W0;
+    bool m_dPdA_W0_finite;
+    ysVec4 m_estimatorFactor_W0; // The importance divided by the per-area-probability of generating vertex 0 of the eye subpath
+    const ysCamera* m_camera;    // The camera used for light tracing (t=1 strategies), or null if disabled
+    ys_float32 m_dPdA_E1;        // The per-area-probability with which the camera generates vertex 1 of the eye subpath (for light tracing)
+    ys_float32 m_joinSampleCount;
+    ys_float32 m_lightTracingSampleCount;
+    ys_float32 m_mergeEta;
+};
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -951,33 +2050,55 @@ static ysVec4 sDivide(const ysBSDF& f, const ysProbabilityDensity& p)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubpathInput& input) const
+// The per-area probability of generating the vertex following x on x's subpath
+static ys_float32 sForwardProbabilityPerArea(const PathVertex& x)
+{
+    return x.m_p[1].m_perProjectedSolidAngle.m_value * x.m_projToArea1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// One step of the recursion for MIS partial sums. Handing a vertex over from one subpath to the other scales the full path probability by
+// pOther / pThis, where pThis (pOther) is the per-area probability of generating the vertex on its current (the other) subpath.
+// 'joinWeight' is the number of samples taken per eye subpath with the strategy that joins the subpaths right before the vertex (see
+// GenerateSubpathInput::joinSampleCount), or zero if that strategy is impossible, i.e. either vertex at the join is specular.
+// 'mergeWeight' is GenerateSubpathInput::mergeEta if the vertex can be merged (it is not specular, and lies on neither the light nor the
+// eye), or zero otherwise. Merging at the vertex has the probability of the strategy that keeps the vertex on the other subpath, times
+// pOther * pi * r^2.
+static ys_float32 sAccumulateMisSum(ys_float32 misSum, ys_float32 pOther, ys_float32 pThis, ys_float32 joinWeight, ys_float32 mergeWeight)
+{
+    ys_float32 mergeRatio = mergeWeight * pOther;
+    ys_float32 sum = mergeRatio * mergeRatio;
+    if (joinWeight > 0.0f || misSum > 0.0f)
+    {
+        ysAssert(pThis > 0.0f);
+        ys_float32 pRatio = pOther * ysSafeReciprocal(pThis);
+        sum += pRatio * pRatio * (joinWeight * joinWeight + misSum); // Balance heuristic with exponent 2
+    }
+    return sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::GenerateLightSubpath(ysLightSubpath* output, const GenerateSubpathInput& input) const
 {
     const ys_float32 divZeroThresh = ys_epsilon; // Prevent unsafe division.
 
     PathVertex* y = output->m_y;
-    PathVertex* z = output->m_z;
 
     const ys_int32 nLMin = input.minLightPathVertexCount;
     const ys_int32 nLMax = input.maxLightPathVertexCount;
-    const ys_int32 nEMin = input.minEyePathVertexCount;
-    const ys_int32 nEMax = input.maxEyePathVertexCount;
-    ysAssert(nLMin <= nLMax && nEMin <= nEMax);
-    ysAssert(nLMax <= GenerateSubpathOutput::s_nLCeil && nEMax <= GenerateSubpathOutput::s_nECeil);
-    // Eye path must contain at least two vertices AND they must be pregenerated
-    ysAssert(nLMin >= 0 && nEMin >= 2);
+    ysAssert(nLMin <= nLMax);
+    ysAssert(nLMax <= ysLightSubpath::s_nLCeil);
+    ysAssert(nLMin >= 0);
 
     ys_int32 nL;
-    ys_int32 nE;
 
     // Probability to generate the first point on the Light. Don't forget to account for random light selection!
     ys_float32 probArea_L0 = -1.0f;
     bool probArea_L0_finite = false;
-    ys_float32 probArea_W0 = 1.0f;      // TODO
-    bool probArea_W0_finite = false;    // TODO
 
     ysVec4 LSpatialOverPSpatial0 = -ysVec4_zero;
-    ysVec4 WSpatialOverPSpatial0 = input.WSpatialOverPSpatial0;
 
     ////////////////////////////////
     // Generate the LIGHT subpath //
@@ -993,15 +2114,19 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
 
         ysVec4 emittedIrradiance;
         {
-            // Vertex 0: Pick a point on the light
-
-            // TODO: Sample according to wattage
-            ys_int32 emissiveShapeIdxIdx = rand() % m_emissiveShapeCount;
-            ys_int32 emissiveShapeIdx = m_emissiveShapeIndices[emissiveShapeIdxIdx];
+            // Vertex 0: Pick a point on the light, the light being chosen in proportion to its power
+            ys_float32 probEmitter;
+            ys_int32 emitterIdx = m_lightBVH.SampleEmitter(&probEmitter);
+            if (emitterIdx == ys_nullIndex)
+            {
+                // Nothing emits any light
+                break;
+            }
+            ys_int32 emissiveShapeIdx = m_emissiveShapeIndices[emitterIdx];
             const ysShape* emissiveShape = m_shapes + emissiveShapeIdx;
             ysSurfacePoint sp;
             emissiveShape->GenerateRandomSurfacePoint(this, &sp, &probArea_L0);
-            probArea_L0 /= ys_float32(m_emissiveShapeCount); // Note this division!
+            probArea_L0 *= probEmitter; // Note this factor!
             probArea_L0_finite = true; // TODO: Point lights
 
             const ysEmissiveMaterial* emissiveMaterial = m_emissiveMaterials + emissiveShape->m_emissiveMaterialId.m_index;
@@ -1011,6 +2136,7 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
             y[nL].m_material = m_materials + emissiveShape->m_materialId.m_index;
             y[nL].m_emissive = emissiveMaterial;
             y[nL].m_shape = emissiveShape;
+            y[nL].m_primitiveIndex = sp.m_primitiveIndex;
             y[nL].m_posWS = sp.m_point;
             y[nL].m_normalWS = sp.m_normal;
             y[nL].m_tangentWS = sp.m_tangent;
@@ -1018,6 +2144,8 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
             y[nL].m_p[1].SetInvalid();
             y[nL].m_projToArea1 = -1.0f;
             y[nL].m_f.SetInvalid();
+            y[nL].m_estimator = LSpatialOverPSpatial0;
+            y[nL].m_misSum = 0.0f;
 
             nL++;
         }
@@ -1054,11 +2182,12 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
             Ldirectional.m_value = emittedRadiance.m_value / emittedIrradiance;
             Ldirectional.m_isFinite = emittedRadiance.m_isFinite;
 
+            ysVec4 fp = sDivide(Ldirectional, p12.m_perProjectedSolidAngle);
+            ys_float32 q = 1.0f;
             if (nL >= nLMin)
             {
                 // We've already generated the minimum number of vertices requested. Do Russian Roulette termination.
-                ysVec4 fp = sDivide(Ldirectional, p12.m_perProjectedSolidAngle);
-                ys_float32 q = ysClamp(ysMax(ysMax(fp.x, fp.y), fp.z), s_minRussianRouletteContinuationProbability, 1.0f);
+                q = ysClamp(ysMax(ysMax(fp.x, fp.y), fp.z), s_minRussianRouletteContinuationProbability, 1.0f);
                 ys_float32 r = ysRandom(0.0f, 1.0f);
                 bool absorbed = (r > q);
                 if (absorbed)
@@ -1075,7 +2204,7 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
             srci.m_origin = y1->m_posWS;
 
             ysSceneRayCastOutput srco;
-            bool hit = sRayCastClosestReflective(this, &srco, srci, y1->m_shape);
+            bool hit = sRayCastClosestReflective(this, &srco, srci, y1->m_shape, y1->m_primitiveIndex);
             if (hit == false)
             {
                 break;
@@ -1101,7 +2230,7 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
             y1->m_p[1] = p12;
             y1->m_projToArea1 = u12_LS1.z * u21_LS2.z / d12Sqr;
 
-            y2->SetShape(this, srco.m_shapeId);
+            y2->SetShape(this, srco.m_shapeId, srco.m_primitiveIndex);
             y2->m_posWS = srco.m_hitPoint;
             y2->m_normalWS = srco.m_hitNormal;
             y2->m_tangentWS = srco.m_hitTangent;
@@ -1110,6 +2239,8 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
             y2->m_p[1].SetInvalid();
             y2->m_projToArea1 = -1.0f;
             y2->m_f.SetInvalid();
+            y2->m_estimator = y1->m_estimator * fp / ysSplat(q);
+            y2->m_misSum = 0.0f;
 
             nL++;
         }
@@ -1142,10 +2273,11 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
             }
             ysVec4 u12 = ysMul33(R1, u12_LS1);
 
+            ysVec4 fp = sDivide(f012, p012.m_perProjectedSolidAngle);
+            ys_float32 q = 1.0f;
             if (nL >= nLMin)
             {
-                ysVec4 fp = sDivide(f012, p012.m_perProjectedSolidAngle);
-                ys_float32 q = ysClamp(ysMax(ysMax(fp.x, fp.y), fp.z), s_minRussianRouletteContinuationProbability, 1.0f);
+                q = ysClamp(ysMax(ysMax(fp.x, fp.y), fp.z), s_minRussianRouletteContinuationProbability, 1.0f);
                 ys_float32 r = ysRandom(0.0f, 1.0f);
                 bool absorbed = (r > q);
                 if (absorbed)
@@ -1160,7 +2292,7 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
             srci.m_origin = y1->m_posWS;
 
             ysSceneRayCastOutput srco;
-            bool hit = sRayCastClosestReflective(this, &srco, srci, y1->m_shape);
+            bool hit = sRayCastClosestReflective(this, &srco, srci, y1->m_shape, y1->m_primitiveIndex);
             if (hit == false)
             {
                 break;
@@ -1191,20 +2323,63 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
             y1->m_projToArea1 = u12_LS1.z * u21_LS2.z / d12Sqr;
             y1->m_f = f012;
 
-            y2->SetShape(this, srco.m_shapeId);
-            y2->m_posWS = srco.m_hitPoint;
-            y2->m_normalWS = srco.m_hitNormal;
-            y2->m_tangentWS = srco.m_hitTangent;
-            y2->m_p[0].SetInvalid();
-            y2->m_p[1].SetInvalid();
-            y2->m_projToArea1 = -1.0f;
-            y2->m_f.SetInvalid();
+            y2->SetShape(this, srco.m_shapeId, srco.m_primitiveIndex);
+            y2->m_posWS = srco.m_hitPoint;
+            y2->m_normalWS = srco.m_hitNormal;
+            y2->m_tangentWS = srco.m_hitTangent;
+            y2->m_p[0].SetInvalid();
+            y2->m_p[1].SetInvalid();
+            y2->m_projToArea1 = -1.0f;
+            y2->m_f.SetInvalid();
+            y2->m_estimator = y1->m_estimator * fp / ysSplat(q);
+            {
+                // Now that the reverse probability at vertex 1 is known, fold in the strategy which hands vertex 0 over to the eye subpath.
+                ys_int32 i = nL - 2;
+                ys_float32 pThis = (i == 0) ? probArea_L0 : sForwardProbabilityPerArea(y[i - 1]);
+                ys_float32 pOther = y1->m_p[0].m_perProjectedSolidAngle.m_value * y0->m_projToArea1;
+                bool joinable = (i == 0) ? probArea_L0_finite : (y[i - 1].m_f.m_isFinite && y0->m_f.m_isFinite);
+                bool mergeable = (i > 0) && y0->m_f.m_isFinite;
+                ys_float32 joinWeight = joinable ? ((i == 0) ? 1.0f : input.joinSampleCount) : 0.0f;
+                y2->m_misSum = sAccumulateMisSum(y1->m_misSum, pOther, pThis, joinWeight, mergeable ? input.mergeEta : 0.0f);
+            }
+
+            nL++;
+        }
+
+        break;
+    }
+
+    output->m_nL = nL;
+    output->m_dPdA_L0 = probArea_L0;
+    output->m_dPdA_L0_finite = probArea_L0_finite;
+    output->m_estimatorFactor_L0 = LSpatialOverPSpatial0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene::GenerateEyeSubpath(GenerateSubpathOutput* output, const GenerateSubpathInput& input) const
+{
+    const ys_float32 divZeroThresh = ys_epsilon; // Prevent unsafe division.
+
+    PathVertex* z = output->m_z;
+
+    const ys_int32 nEMin = input.minEyePathVertexCount;
+    const ys_int32 nEMax = input.maxEyePathVertexCount;
+    ysAssert(nEMin <= nEMax);
+    ysAssert(nEMax <= GenerateSubpathOutput::s_nECeil);
+    // Eye path must contain at least two vertices AND they must be pregenerated
+    ysAssert(nEMin >= 2);
+
+    ys_int32 nE;
+
+    ys_float32 probArea_W0 = 1.0f;      // TODO
+    bool probArea_W0_finite = false;    // TODO
 
-            nL++;
-        }
+    ysVec4 WSpatialOverPSpatial0 = input.WSpatialOverPSpatial0;
 
-        break;
-    }
+    // Only relevant for light tracing. Strategies with fewer eye vertices are never used.
+    ys_float32 probArea_E1 = -1.0f;
+    const ys_int32 tMin = (input.camera != nullptr) ? 1 : 2;
 
     //////////////////////////////
     // Generate the EYE subpath //
@@ -1231,6 +2406,15 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
         z[0].m_projToArea1 = c / d10Sqr;
         z[0].m_f.m_value = input.WDirectionalOverPDirectional01;
         z[0].m_f.m_isFinite = false;
+        if (input.camera != nullptr)
+        {
+            ys_float32 cosTheta = input.camera->ComputeCosTheta(-u10);
+            probArea_E1 = input.camera->ProbabilityDensityForGeneratedDirection(cosTheta) * z[0].m_projToArea1;
+        }
+        z[0].m_estimator = WSpatialOverPSpatial0;
+        z[0].m_misSum = 0.0f;
+        z[1].m_estimator = z[0].m_estimator * sDivide(z[0].m_f, z[0].m_p[1].m_perProjectedSolidAngle);
+        z[1].m_misSum = 0.0f;
     }
     nE = 2;
     while (nE < nEMax)
@@ -1261,10 +2445,11 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
         }
         ysVec4 u12 = ysMul33(R1, u12_LS1);
 
+        ysVec4 fp = sDivide(f210, p012.m_perProjectedSolidAngle);
+        ys_float32 q = 1.0f;
         if (nE >= nEMin)
         {
-            ysVec4 fp = sDivide(f210, p012.m_perProjectedSolidAngle);
-            ys_float32 q = ysClamp(ysMax(ysMax(fp.x, fp.y), fp.z), s_minRussianRouletteContinuationProbability, 1.0f);
+            q = ysClamp(ysMax(ysMax(fp.x, fp.y), fp.z), s_minRussianRouletteContinuationProbability, 1.0f);
             ys_float32 r = ysRandom(0.0f, 1.0f);
             bool absorbed = (r > q);
             if (absorbed)
@@ -1279,7 +2464,7 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
         srci.m_origin = z1->m_posWS;
 
         ysSceneRayCastOutput srco;
-        bool hit = sRayCastClosestReflective(this, &srco, srci, z1->m_shape);
+        bool hit = sRayCastClosestReflective(this, &srco, srci, z1->m_shape, z1->m_primitiveIndex);
         if (hit == false)
         {
             break;
@@ -1310,7 +2495,7 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
         z1->m_projToArea1 = u12_LS1.z * u21_LS2.z / d12Sqr;
         z1->m_f = f210;
 
-        z2->SetShape(this, srco.m_shapeId);
+        z2->SetShape(this, srco.m_shapeId, srco.m_primitiveIndex);
         z2->m_posWS = srco.m_hitPoint;
         z2->m_normalWS = srco.m_hitNormal;
         z2->m_tangentWS = srco.m_hitTangent;
@@ -1318,60 +2503,197 @@ void ysScene::GenerateSubpaths(GenerateSubpathOutput* output, const GenerateSubp
         z2->m_p[1].SetInvalid();
         z2->m_projToArea1 = -1.0f;
         z2->m_f.SetInvalid();
+        z2->m_estimator = z1->m_estimator * fp / ysSplat(q);
+        z2->m_misSum = 0.0f;
+        {
+            // Same as for the light subpath, except that joins with fewer than tMin eye vertices are never used (see SampleRadiance_Bi).
+            // Merging at vertex 1 is still possible though.
+            ys_int32 i = nE - 2;
+            if (i >= 1)
+            {
+                // Vertex 0 of the eye subpath (the pinhole) is never specular in the sense that light subpaths can always connect to it
+                ys_float32 pThis = (i == 1) ? probArea_E1 : sForwardProbabilityPerArea(z[i - 1]);
+                ys_float32 pOther = z1->m_p[0].m_perProjectedSolidAngle.m_value * z0->m_projToArea1;
+                bool joinable = (i >= tMin) && (i == 1 || z[i - 1].m_f.m_isFinite) && z0->m_f.m_isFinite;
+                bool mergeable = z0->m_f.m_isFinite;
+                ys_float32 joinWeight = joinable ? ((i == 1) ? input.lightTracingSampleCount : input.joinSampleCount) : 0.0f;
+                z2->m_misSum = sAccumulateMisSum(z1->m_misSum, pOther, pThis, joinWeight, mergeable ? input.mergeEta : 0.0f);
+            }
+        }
 
         nE++;
     }
 
-    output->m_nL = nL;
+    output->m_light = nullptr;
     output->m_nE = nE;
-    output->m_dPdA_L0 = probArea_L0;
     output->m_dPdA_W0 = probArea_W0;
-    output->m_dPdA_L0_finite = probArea_L0_finite;
     output->m_dPdA_W0_finite = probArea_W0_finite;
-    output->m_estimatorFactor_L0 = LSpatialOverPSpatial0;
     output->m_estimatorFactor_W0 = WSpatialOverPSpatial0;
-    output->m_russianRouletteBeginL = input.minLightPathVertexCount;
-    output->m_russianRouletteBeginE = input.minEyePathVertexCount;
+    output->m_camera = input.camera;
+    output->m_dPdA_E1 = probArea_E1;
+    output->m_joinSampleCount = input.joinSampleCount;
+    output->m_lightTracingSampleCount = input.lightTracingSampleCount;
+    output->m_mergeEta = input.mergeEta;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Everything the MIS weight of a join (s,t) needs beyond what was stored on the subpaths. Labels follow EvaluateTruncatedSubpaths: x1 is the
+// last vertex on the light subpath, x2 and x3 are the last two vertices on the eye subpath, and x0 is the vertex preceding x1.
+struct MisJoin
+{
+    ys_float32 probArea_L0;
+    bool probAreaFinite_L0;
+    ys_float32 probArea_E0; // Per-area probability of generating x0 as part of the  eye  subpath
+    ys_float32 probArea_E1; // ........................................ x1 ............ eye  .......
+    ys_float32 probArea_L2; // ........................................ x2 ............ light ......
+    ys_float32 probArea_L3; // ........................................ x3 ............ light ......
+    bool finite1;           // Whether x1 is not specular
+    bool finite2;           // ........ x2 ..............
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The sum of (n[i] * P[i] / P[s,t])^2 over every strategy i other than the join (s,t) itself, where P[i] is the full path probability
+// under strategy i and n[i] the number of samples taken with it per eye subpath. This covers both joins and merges. The MIS weight of any
+// strategy follows from it (power heuristic with exponent 2). The ratios for strategies that reassign vertices beyond the join (x0 and x3
+// or earlier) were accumulated into m_misSum when the subpaths were generated. Only the last two steps of the recursion on each side
+// depend on the join.
+// Note: Russian Roulette is left out of the probabilities here. The weights still sum to one over all strategies, so this is unbiased.
+static ys_float32 sSumMisRatios(const ysScene::GenerateSubpathOutput& subpaths, ys_int32 s, ys_int32 t, const MisJoin& join)
+{
+    const PathVertex* y = subpaths.m_light->m_y;
+    const PathVertex* z = subpaths.m_z;
+    const ys_int32 tMin = (subpaths.m_camera != nullptr) ? 1 : 2;
+    const ys_float32 nJoin = subpaths.m_joinSampleCount;
+    const ys_float32 nLightTracing = subpaths.m_lightTracingSampleCount;
+    const ys_float32 eta = subpaths.m_mergeEta;
+
+    ys_float32 weightDenomL = 0.0f;
+    if (s > 0)
+    {
+        ys_float32 misSum0 = 0.0f;
+        if (s > 1)
+        {
+            // Hand x0 over to the eye subpath
+            ys_int32 i = s - 2;
+            ys_float32 pThis = (i == 0) ? join.probArea_L0 : sForwardProbabilityPerArea(y[i - 1]);
+            bool joinable = (i == 0) ? join.probAreaFinite_L0 : (y[i - 1].m_f.m_isFinite && y[i].m_f.m_isFinite);
+            bool mergeable = (i > 0) && y[i].m_f.m_isFinite;
+            ys_float32 joinWeight = joinable ? ((i == 0) ? 1.0f : nJoin) : 0.0f;
+            misSum0 = sAccumulateMisSum(y[s - 1].m_misSum, join.probArea_E0, pThis, joinWeight, mergeable ? eta : 0.0f);
+        }
+
+        // Hand x1 over to the eye subpath
+        ys_int32 i = s - 1;
+        ys_float32 pThis = (i == 0) ? join.probArea_L0 : sForwardProbabilityPerArea(y[i - 1]);
+        bool joinable = (i == 0) ? join.probAreaFinite_L0 : (y[i - 1].m_f.m_isFinite && join.finite1);
+        bool mergeable = (i > 0) && join.finite1;
+        ys_float32 joinWeight = joinable ? ((i == 0) ? 1.0f : nJoin) : 0.0f;
+        weightDenomL = sAccumulateMisSum(misSum0, join.probArea_E1, pThis, joinWeight, mergeable ? eta : 0.0f);
+    }
+    ysAssert(weightDenomL >= 0.0f);
+
+    // Joins with fewer than tMin eye vertices are never used (see SampleRadiance_Bi), so they must not be accounted for either. Light
+    // subpaths can always be joined to vertex 0 of the eye subpath (the pinhole), but never merged with it.
+    ys_float32 weightDenomE = 0.0f;
+    if (t > 1)
+    {
+        ys_float32 misSum3 = 0.0f;
+        if (t > 2)
+        {
+            // Hand x3 over to the light subpath
+            ys_int32 i = t - 2;
+            ys_float32 pThis = (i == 1) ? subpaths.m_dPdA_E1 : sForwardProbabilityPerArea(z[i - 1]);
+            bool joinable = (i >= tMin) && (i == 1 || z[i - 1].m_f.m_isFinite) && z[i].m_f.m_isFinite;
+            bool mergeable = z[i].m_f.m_isFinite;
+            ys_float32 joinWeight = joinable ? ((i == 1) ? nLightTracing : nJoin) : 0.0f;
+            misSum3 = sAccumulateMisSum(z[t - 1].m_misSum, join.probArea_L3, pThis, joinWeight, mergeable ? eta : 0.0f);
+        }
+
+        // Hand x2 over to the light subpath. If s = 0, x2 lies on the light and cannot be merged.
+        ys_int32 i = t - 1;
+        ys_float32 pThis = (i == 1) ? subpaths.m_dPdA_E1 : sForwardProbabilityPerArea(z[i - 1]);
+        bool joinable = (i >= tMin) && (i == 1 || z[i - 1].m_f.m_isFinite) && join.finite2;
+        bool mergeable = (s > 0) && join.finite2;
+        ys_float32 joinWeight = joinable ? ((i == 1) ? nLightTracing : nJoin) : 0.0f;
+        weightDenomE = sAccumulateMisSum(misSum3, join.probArea_L2, pThis, joinWeight, mergeable ? eta : 0.0f);
+    }
+    ysAssert(weightDenomE >= 0.0f);
+
+    return weightDenomL + weightDenomE;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-ysVec4 ysScene::EvaluateTruncatedSubpaths(const GenerateSubpathOutput& subpaths, ys_int32 s, ys_int32 t) const
+ysVec4 ysScene::EvaluateTruncatedSubpaths(const GenerateSubpathOutput& subpaths, ys_int32 s, ys_int32 t, ys_int32* splatPixelIdx) const
 {
-    const ys_float32 rayCastNudge = 0.001f; // Hack. Push ray cast origins out a little to avoid collision with the source shape.
     const ys_float32 divZeroThresh = ys_epsilon; // Prevent unsafe division.
 
-    ysAssert(0 <= s && s <= subpaths.m_nL);
+    // The eye is not part of the scene, so light subpaths can only reach it by connecting to it explicitly (t=1), and only if we have a
+    // camera model to tell us which pixel they land on.
+    const ys_int32 tMin = (subpaths.m_camera != nullptr) ? 1 : 2;
+    YS_REF(tMin);
+
+    const ysLightSubpath& light = *subpaths.m_light;
+    ysAssert(0 <= s && s <= light.m_nL);
     ysAssert(0 <= t && t <= subpaths.m_nE);
     ysAssert(s + t >= 2);
-    ysAssert(t >= 2); // Need this assert only because we don't model the camera as part of the scene
-    PathVertex yz[GenerateSubpathOutput::s_nLCeil + GenerateSubpathOutput::s_nECeil];
-    PathVertex* y = yz + 0;
-    PathVertex* z = yz + s;
-    ysMemCpy(y, subpaths.m_y, sizeof(PathVertex) * s);
-    ysMemCpy(z, subpaths.m_z, sizeof(PathVertex) * t);
-
-    const ysVec4& LSpatialOverPSpatial0 = subpaths.m_estimatorFactor_L0;
-    const ysVec4& WSpatialOverPSpatial0 = subpaths.m_estimatorFactor_W0;
-    ys_float32 probArea_L0 = subpaths.m_dPdA_L0;
-    ys_float32 probArea_W0 = subpaths.m_dPdA_W0;
-    bool probAreaFinite_L0 = subpaths.m_dPdA_L0_finite;
-    bool probAreaFinite_W0 = subpaths.m_dPdA_W0_finite;
-
-    // The emitted radiance and importance at vertex 0. These are only used if one of the subpaths has length 0.
-    // If both subpaths are non-empty, then these are already captured by the emitted irradiance and the "pseudo-BSDF" at vertex 0.
-    ysVec4 L01 = -ysVec4_one;
-    ysVec4 W01 = -ysVec4_one;
-    YS_REF(W01);
+    ysAssert(t >= tMin);
+    const PathVertex* y = light.m_y;
+    const PathVertex* z = subpaths.m_z;
+
+    *splatPixelIdx = ys_nullIndex;
+
+    ys_float32 probArea_L0 = light.m_dPdA_L0;
+    bool probAreaFinite_L0 = light.m_dPdA_L0_finite;
+
+    // The subpath vertices are left untouched. Everything that depends on how they are joined is kept in the following locals, using the
+    // labels from the join below: x1 is the last vertex on the light path, x2 and x3 are the last two vertices on the eye path, and x0 is
+    // the vertex preceding x1.
+    ysVec4 estimatorJoin;
+    ys_float32 probArea_E0 = -1.0f; // Per-area probability of generating x0 as part of the  eye  subpath
+    ys_float32 probArea_E1 = -1.0f; // ........................................ x1 ............ eye  .......
+    ys_float32 probArea_L2 = -1.0f; // ........................................ x2 ............ light ......
+    ys_float32 probArea_L3 = -1.0f; // ........................................ x3 ............ light ......
+
+    // Evaluates the scattering (or emission if s = 1) at x1 towards the direction u12, along with the probabilities of generating the
+    // directions at x1 from either subpath.
+    auto EvaluateLightSubpathEnd = [&](ysBSDF* f1, ysDirectionalProbabilityDensity* p10_1, ysDirectionalProbabilityDensity* p12_1,
+        const ysMtx44& R1, const ysVec4& u12_LS1)
+    {
+        const PathVertex* x1 = y + (s - 1);
+        if (s == 1)
+        {
+            ysAssert(x1->m_emissive != nullptr);
+            ysIrradiance LSpatial = x1->m_emissive->EvaluateIrradiance(this);
+            ysRadiance L = x1->m_emissive->EvaluateRadiance(this, u12_LS1);
+            p10_1->SetInvalid();
+            *p12_1 = x1->m_emissive->ProbabilityDensityForGeneratedDirection(this, u12_LS1);
+            f1->m_value = L.m_value / LSpatial.m_value;
+            f1->m_isFinite = L.m_isFinite;
+        }
+        else
+        {
+            ysAssert(s > 1);
+            const PathVertex* x0 = y + (s - 2);
+            ysVec4 v10 = x0->m_posWS - x1->m_posWS;
+            ysVec4 u10 = ysNormalize3(v10);
+            ysVec4 u10_LS1 = ysMulT33(R1, u10);
+            *p10_1 = x1->m_material->ProbabilityDensityForGeneratedIncomingDirection(this, u10_LS1, u12_LS1);
+            *p12_1 = x1->m_material->ProbabilityDensityForGeneratedOutgoingDirection(this, u10_LS1, u12_LS1);
+            *f1 = x1->m_material->EvaluateBRDF(this, u10_LS1, u12_LS1);
+        }
+    };
 
     /////////////////////////////////
     // Join light and eye subpaths //
     /////////////////////////////////
-    ysAssert(s >= 0 && t >= 2);
-    if (s > 0 && t > 0)
+    ysAssert(s >= 0 && t >= tMin);
+    if (s > 0 && t > 1)
     {
-        PathVertex* x1 = y + (s - 1); // The last vertex on the light path
-        PathVertex* x2 = z + (t - 1); // The last vertex on the  eye  path
+        const PathVertex* x1 = y + (s - 1); // The last vertex on the light path
+        const PathVertex* x2 = z + (t - 1); // The last vertex on the  eye  path
         ysVec4 v12 = x2->m_posWS - x1->m_posWS;
         ys_float32 d12Sqr = ysLengthSqr3(v12);
         if (d12Sqr < divZeroThresh)
@@ -1407,11 +2729,11 @@ ysVec4 ysScene::EvaluateTruncatedSubpaths(const GenerateSubpathOutput& subpaths,
         srci.m_maxLambda = 1.0f;
 
         ysSceneRayCastOutput srco;
-        bool hit = sRayCastClosestReflective(this, &srco, srci, x1->m_shape);
+        bool hit = sRayCastClosestReflective(this, &srco, srci, x1->m_shape, x1->m_primitiveIndex);
         if (hit)
         {
             ysShape* hitShape = m_shapes + srco.m_shapeId.m_index;
-            bool occluded = (hitShape != x2->m_shape);
+            bool occluded = (hitShape != x2->m_shape || srco.m_primitiveIndex != x2->m_primitiveIndex);
             if (occluded)
             {
                 return ysVec4_zero;
@@ -1419,39 +2741,21 @@ ysVec4 ysScene::EvaluateTruncatedSubpaths(const GenerateSubpathOutput& subpaths,
         }
 
         ys_float32 g = u12_LS1.z * u21_LS2.z / d12Sqr;
-        x1->m_projToArea1 = g;
-        x2->m_projToArea1 = g;
 
-        if (s == 1)
-        {
-            ysAssert(x1->m_emissive != nullptr);
-            ysIrradiance LSpatial = x1->m_emissive->EvaluateIrradiance(this);
-            ysRadiance L = x1->m_emissive->EvaluateRadiance(this, u12_LS1);
-            x1->m_p[1] = x1->m_emissive->ProbabilityDensityForGeneratedDirection(this, u12_LS1);
-            x1->m_f.m_value = L.m_value / LSpatial.m_value;
-            x1->m_f.m_isFinite = L.m_isFinite;
-        }
-        else
-        {
-            ysAssert(s > 1);
-            PathVertex* x0 = y + (s - 2);
-            ysVec4 v10 = x0->m_posWS - x1->m_posWS;
-            ysVec4 u10 = ysNormalize3(v10);
-            ysVec4 u10_LS1 = ysMulT33(R1, u10);
-            x1->m_p[0] = x1->m_material->ProbabilityDensityForGeneratedIncomingDirection(this, u10_LS1, u12_LS1);
-            x1->m_p[1] = x1->m_material->ProbabilityDensityForGeneratedOutgoingDirection(this, u10_LS1, u12_LS1);
-            x1->m_f = x1->m_material->EvaluateBRDF(this, u10_LS1, u12_LS1);
-        }
+        ysDirectionalProbabilityDensity p10_1; // Direction x1->x0 generated at x1 as part of the eye subpath (only valid if s > 1)
+        ysDirectionalProbabilityDensity p12_1; // Direction x1->x2 generated at x1 as part of the light subpath
+        ysBSDF f1;
+        EvaluateLightSubpathEnd(&f1, &p10_1, &p12_1, R1, u12_LS1);
 
-        PathVertex* x3 = z + (t - 2);
+        const PathVertex* x3 = z + (t - 2);
         ysVec4 v23 = x3->m_posWS - x2->m_posWS;
         ysVec4 u23 = ysNormalize3(v23);
         ysVec4 u23_LS2 = ysMulT33(R2, u23);
-        x2->m_p[0] = x2->m_material->ProbabilityDensityForGeneratedOutgoingDirection(this, u21_LS2, u23_LS2);
-        x2->m_p[1] = x2->m_material->ProbabilityDensityForGeneratedIncomingDirection(this, u21_LS2, u23_LS2);
-        x2->m_f = x2->m_material->EvaluateBRDF(this, u21_LS2, u23_LS2);
+        ysDirectionalProbabilityDensity p23_2 = x2->m_material->ProbabilityDensityForGeneratedOutgoingDirection(this, u21_LS2, u23_LS2);
+        ysDirectionalProbabilityDensity p21_2 = x2->m_material->ProbabilityDensityForGeneratedIncomingDirection(this, u21_LS2, u23_LS2);
+        ysBSDF f2 = x2->m_material->EvaluateBRDF(this, u21_LS2, u23_LS2);
 
-        if (x1->m_f.m_isFinite == false || x2->m_f.m_isFinite == false)
+        if (f1.m_isFinite == false || f2.m_isFinite == false)
         {
             // Joining light and eye subpaths at specular vertices with non-vanishing BSDFs has probability zero. So even if it happens
             // numerically, pretend it ain't so. The theoretical impossibility is reflected by the fact that the estimator diverges if
@@ -1459,27 +2763,110 @@ ysVec4 ysScene::EvaluateTruncatedSubpaths(const GenerateSubpathOutput& subpaths,
             return ysVec4_zero;
         }
 
-        if (x1->m_p[1].m_perProjectedSolidAngle.m_isFinite == false ||
-            x2->m_p[1].m_perProjectedSolidAngle.m_isFinite == false ||
-            x1->m_p[1].m_perProjectedSolidAngle.m_value < ys_zeroSafe ||
-            x2->m_p[1].m_perProjectedSolidAngle.m_value < ys_zeroSafe)
+        if (p12_1.m_perProjectedSolidAngle.m_isFinite == false ||
+            p21_2.m_perProjectedSolidAngle.m_isFinite == false ||
+            p12_1.m_perProjectedSolidAngle.m_value < ys_zeroSafe ||
+            p21_2.m_perProjectedSolidAngle.m_value < ys_zeroSafe)
+        {
+            return ysVec4_zero;
+        }
+
+        estimatorJoin = f1.m_value * ysSplat(g) * f2.m_value;
+        if (s > 1)
+        {
+            probArea_E0 = p10_1.m_perProjectedSolidAngle.m_value * y[s - 2].m_projToArea1;
+        }
+        probArea_E1 = p21_2.m_perProjectedSolidAngle.m_value * g;
+        probArea_L2 = p12_1.m_perProjectedSolidAngle.m_value * g;
+        probArea_L3 = p23_2.m_perProjectedSolidAngle.m_value * x3->m_projToArea1;
+    }
+    else if (s > 0 && t == 1)
+    {
+        // Light tracing: Join the light subpath directly to the eye. The direction of the join determines which pixel receives the result.
+        ysAssert(subpaths.m_camera != nullptr);
+        const ysCamera* camera = subpaths.m_camera;
+        const PathVertex* x1 = y + (s - 1);
+        const PathVertex* x2 = z + 0;
+        ysVec4 v12 = x2->m_posWS - x1->m_posWS;
+        ys_float32 d12Sqr = ysLengthSqr3(v12);
+        if (d12Sqr < divZeroThresh)
+        {
+            return ysVec4_zero;
+        }
+
+        ysMtx44 R1;
+        {
+            R1.cx = x1->m_tangentWS;
+            R1.cy = ysCross(x1->m_normalWS, x1->m_tangentWS);
+            R1.cz = x1->m_normalWS;
+        }
+
+        ysVec4 u12 = ysNormalize3(v12);
+        ysVec4 u12_LS1 = ysMulT33(R1, u12);
+        if (u12_LS1.z < divZeroThresh)
+        {
+            return ysVec4_zero;
+        }
+
+        ys_float32 cosTheta;
+        ys_int32 pixelIdx = camera->ComputePixelIndex(&cosTheta, -u12);
+        if (pixelIdx == ys_nullIndex)
+        {
+            return ysVec4_zero;
+        }
+
+        ysSceneRayCastInput srci;
+        srci.m_origin = x1->m_posWS;
+        srci.m_direction = v12;
+        srci.m_maxLambda = 1.0f;
+
+        ysSceneRayCastOutput srco;
+        bool occluded = sRayCastClosestReflective(this, &srco, srci, x1->m_shape, x1->m_primitiveIndex);
+        if (occluded)
+        {
+            return ysVec4_zero;
+        }
+
+        ysDirectionalProbabilityDensity p10_1;
+        ysDirectionalProbabilityDensity p12_1;
+        ysBSDF f1;
+        EvaluateLightSubpathEnd(&f1, &p10_1, &p12_1, R1, u12_LS1);
+        if (f1.m_isFinite == false)
         {
             return ysVec4_zero;
         }
+
+        // The pinhole has no orientation, so there is no cosine factor on its side of the join
+        ys_float32 g = u12_LS1.z / d12Sqr;
+        ys_float32 W = camera->EvaluateImportance(cosTheta);
+        estimatorJoin = f1.m_value * ysSplat(g * W);
+        if (s > 1)
+        {
+            probArea_E0 = p10_1.m_perProjectedSolidAngle.m_value * y[s - 2].m_projToArea1;
+        }
+        probArea_E1 = camera->ProbabilityDensityForGeneratedDirection(cosTheta) * g;
+        *splatPixelIdx = pixelIdx;
     }
     else if (t > 0)
     {
         ysAssert(t >= 2);
 
-        PathVertex* x2 = z + (t - 1);
+        const PathVertex* x2 = z + (t - 1);
         if (x2->m_emissive == nullptr)
         {
             return ysVec4_zero;
         }
         const PathVertex* x3 = z + (t - 2);
+        ys_int32 emitterIdx = sEmitterIndexFromShapeIndex(this, ys_int32(x2->m_shape - m_shapes));
+        ys_float32 probEmitter = m_lightBVH.ProbabilityForEmitter(emitterIdx);
+        if (probEmitter <= 0.0f)
+        {
+            // Light subpaths never start on a powerless emitter, but neither is there any light to find on one
+            return ysVec4_zero;
+        }
         probArea_L0 = x2->m_shape->ProbabilityDensityForGeneratedPoint(this, x2->m_posWS);
         ysAssert(probArea_L0 > ys_zeroSafe);
-        probArea_L0 /= (ys_float32)m_emissiveShapeCount;
+        probArea_L0 *= probEmitter;
         probAreaFinite_L0 = true;
         ysMtx44 R2;
         {
@@ -1490,17 +2877,16 @@ ysVec4 ysScene::EvaluateTruncatedSubpaths(const GenerateSubpathOutput& subpaths,
         ysVec4 v23 = x3->m_posWS - x2->m_posWS;
         ysVec4 u23 = ysNormalize3(v23);
         ysVec4 u23_LS2 = ysMulT33(R2, u23);
-        x2->m_p[0] = x2->m_emissive->ProbabilityDensityForGeneratedDirection(this, u23_LS2);
-        ysIrradiance LSpatial = x2->m_emissive->EvaluateIrradiance(this);
+        ysDirectionalProbabilityDensity p23_2 = x2->m_emissive->ProbabilityDensityForGeneratedDirection(this, u23_LS2);
         ysRadiance L = x2->m_emissive->EvaluateRadiance(this, u23_LS2);
         if (L.m_isFinite == false)
         {
             // Sampling the directionally-specular emission has zero probability in principle.
             return ysVec4_zero;
         }
-        L01 = L.m_value;
-        x2->m_f.m_value = L.m_value / LSpatial.m_value;
-        x2->m_f.m_isFinite = L.m_isFinite;
+        estimatorJoin = L.m_value;
+        probArea_L2 = probArea_L0;
+        probArea_L3 = p23_2.m_perProjectedSolidAngle.m_value * x3->m_projToArea1;
     }
     else
     {
@@ -1511,196 +2897,14 @@ ysVec4 ysScene::EvaluateTruncatedSubpaths(const GenerateSubpathOutput& subpaths,
         return ysVec4_zero;
     }
 
-#if 1
-    ////////////////
-    // Validation //
-    ////////////////
-    {
-    //ysAssert(probAreaFinite_L0 || probArea_L0 == 1.0f); // TODO: Need to take into account random light selection
-    ysAssert(probAreaFinite_W0 || probArea_W0 == 1.0f);
-
-    if (s > 0)
-    {
-        // Note that after Russian Roulette is taken into account, the delta function may be squashed such that "m_value <= 1.0f"
-        ysAssert(
-            y[0].m_p[1].m_perProjectedSolidAngle.m_isFinite ||
-            y[0].m_p[1].m_perProjectedSolidAngle.m_value == 1.0f);
-    }
-
-    if (t > 0)
-    {
-        ysAssert(
-            z[0].m_p[1].m_perProjectedSolidAngle.m_isFinite ||
-            z[0].m_p[1].m_perProjectedSolidAngle.m_value == 1.0f);
-    }
-
-    if (s > 0 && t > 0)
-    {
-        ysAssert(
-            y[s - 1].m_p[1].m_perProjectedSolidAngle.m_isFinite ||
-            y[s - 1].m_p[1].m_perProjectedSolidAngle.m_value == 1.0f);
-        ysAssert(
-            z[t - 1].m_p[1].m_perProjectedSolidAngle.m_isFinite ||
-            z[t - 1].m_p[1].m_perProjectedSolidAngle.m_value == 1.0f);
-    }
-
-    for (ys_int32 i = 1; i < s - 1; ++i)
-    {
-        const ysDirectionalProbabilityDensity& p10 = y[i].m_p[0];
-        const ysDirectionalProbabilityDensity& p01 = y[i].m_p[1];
-        YS_REF(p10);
-        YS_REF(p01);
-        ysAssert(p10.m_perProjectedSolidAngle.m_isFinite || p10.m_perProjectedSolidAngle.m_value == 1.0f);
-        ysAssert(p01.m_perProjectedSolidAngle.m_isFinite || p01.m_perProjectedSolidAngle.m_value == 1.0f);
-    }
-
-    for (ys_int32 i = 1; i < t - 1; ++i)
-    {
-        const ysDirectionalProbabilityDensity& p10 = z[i].m_p[0];
-        const ysDirectionalProbabilityDensity& p01 = z[i].m_p[1];
-        YS_REF(p10);
-        YS_REF(p01);
-        ysAssert(p10.m_perProjectedSolidAngle.m_isFinite || p10.m_perProjectedSolidAngle.m_value == 1.0f);
-        ysAssert(p01.m_perProjectedSolidAngle.m_isFinite || p01.m_perProjectedSolidAngle.m_value == 1.0f);
-    }
-    }
-#endif
-
-    /////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    // Bake Russian Roulette continuation probability into the edges                                           //
-    // WARNING: The formula for termination probablity must match the one actually used for subpath generation //
-    /////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    {
-        ys_int32 rrBeginL = ysMax(0, subpaths.m_russianRouletteBeginL - 1);
-        ys_int32 rrBeginE = ysMax(0, subpaths.m_russianRouletteBeginE - 1);
-    
-        {
-            ys_int32 idx = 0;
-            for (ys_int32 i = 0; i < (t == 0 ? s - 1 : s); ++i, ++idx)
-            {
-                if (idx < rrBeginL)
-                {
-                    continue;
-                }
-                PathVertex* pv = y + i;
-                ysVec4 fp = sDivide(pv->m_f, pv->m_p[1].m_perProjectedSolidAngle);
-                ys_float32 q = ysClamp(ysMax(ysMax(fp.x, fp.y), fp.z), s_minRussianRouletteContinuationProbability, 1.0f);
-                pv->m_p[1].m_perSolidAngle.m_value *= q;
-                pv->m_p[1].m_perProjectedSolidAngle.m_value *= q;
-            }
-    
-            for (ys_int32 i = t - 1; i > 0; --i, ++idx)
-            {
-                if (idx < rrBeginL)
-                {
-                    continue;
-                }
-                PathVertex* pv = z + i;
-                ysVec4 fp = sDivide(pv->m_f, pv->m_p[0].m_perProjectedSolidAngle);
-                ys_float32 q = ysClamp(ysMax(ysMax(fp.x, fp.y), fp.z), s_minRussianRouletteContinuationProbability, 1.0f);
-                pv->m_p[0].m_perSolidAngle.m_value *= q;
-                pv->m_p[0].m_perProjectedSolidAngle.m_value *= q;
-            }
-        }
-    
-        {
-            ys_int32 idx = 0;
-            for (ys_int32 i = 0; i < (s == 0 ? t - 1 : t); ++i, ++idx)
-            {
-                if (idx < rrBeginE)
-                {
-                    continue;
-                }
-                PathVertex* pv = z + i;
-                ysVec4 fp = sDivide(pv->m_f, pv->m_p[1].m_perProjectedSolidAngle);
-                ys_float32 q = ysClamp(ysMax(ysMax(fp.x, fp.y), fp.z), s_minRussianRouletteContinuationProbability, 1.0f);
-                pv->m_p[1].m_perSolidAngle.m_value *= q;
-                pv->m_p[1].m_perProjectedSolidAngle.m_value *= q;
-            }
-    
-            for (ys_int32 i = s - 1; i > 0; --i, ++idx)
-            {
-                if (idx < rrBeginE)
-                {
-                    continue;
-                }
-                PathVertex* pv = y + i;
-                ysVec4 fp = sDivide(pv->m_f, pv->m_p[0].m_perProjectedSolidAngle);
-                ys_float32 q = ysClamp(ysMax(ysMax(fp.x, fp.y), fp.z), s_minRussianRouletteContinuationProbability, 1.0f);
-                pv->m_p[0].m_perSolidAngle.m_value *= q;
-                pv->m_p[0].m_perProjectedSolidAngle.m_value *= q;
-            }
-        }
-    }
-
     ////////////////////////////////////
     // Compute (unweighted) estimator //
     ////////////////////////////////////
     ysVec4 estimator;
     {
-        ysVec4 estimatorL = ysVec4_one;
-        if (s > 0)
-        {
-            estimatorL *= LSpatialOverPSpatial0;
-            for (ys_int32 i = 0; i < s - 1; ++i)
-            {
-                if (y[i].m_f.m_isFinite == y[i].m_p[1].m_perProjectedSolidAngle.m_isFinite)
-                {
-                    estimatorL *= y[i].m_f.m_value / ysSplat(y[i].m_p[1].m_perProjectedSolidAngle.m_value);
-                }
-                else
-                {
-                    // This edge was generated by sampling the BSDF (it is NOT the edge connecting the subpaths). Therefore, if the BSDF is
-                    // specular, then the probability distribution with which we generated the in/out directions should also exibit
-                    // singularities. Even if we somehow happen to sample the specular feature of the BSDF with poorly matched distribution,
-                    // we cannot divide by zero here, so just return zero.
-                    ysAssert(false);
-                    return ysVec4_zero;
-                }
-            }
-        }
-
-        ysVec4 estimatorE = ysVec4_one;
-        if (t > 0)
-        {
-            estimatorE *= WSpatialOverPSpatial0;
-            for (ys_int32 i = 0; i < t - 1; ++i)
-            {
-                if (z[i].m_f.m_isFinite == z[i].m_p[1].m_perProjectedSolidAngle.m_isFinite)
-                {
-                    estimatorE *= z[i].m_f.m_value / ysSplat(z[i].m_p[1].m_perProjectedSolidAngle.m_value);
-                }
-                else
-                {
-                    ysAssert(false);
-                    return ysVec4_zero;
-                }
-            }
-        }
-
-        ysVec4 estimatorJoin;
-        ysAssert(s > 0 || t > 0);
-        if (s == 0)
-        {
-            ysAssert(t >= 2);
-            ysAssert(ysAllGE3(L01, ysVec4_zero));
-            estimatorJoin = L01;
-        }
-        else if (t == 0)
-        {
-            ysAssert(s >= 2);
-            ysAssert(ysAllGE3(W01, ysVec4_zero));
-            estimatorJoin = W01;
-        }
-        else
-        {
-            ysAssert(s > 0 && t > 0);
-            ysAssert(y[s - 1].m_projToArea1 == z[t - 1].m_projToArea1);
-            ysAssert(y[s - 1].m_f.m_isFinite && z[t - 1].m_f.m_isFinite);
-            ysVec4 g = ysSplat(y[s - 1].m_projToArea1);
-            estimatorJoin = y[s - 1].m_f.m_value * g * z[t - 1].m_f.m_value;
-        }
-
+        // Russian Roulette continuation probabilities are already baked into the subpath estimators
+        ysVec4 estimatorL = (s > 0) ? y[s - 1].m_estimator : ysVec4_one;
+        ysVec4 estimatorE = z[t - 1].m_estimator;
         estimator = estimatorL * estimatorJoin * estimatorE;
         ysAssert(ysAllGE3(estimator, ysVec4_zero));
     }
@@ -1710,197 +2914,206 @@ ysVec4 ysScene::EvaluateTruncatedSubpaths(const GenerateSubpathOutput& subpaths,
     //////////////////////////////
     ys_float32 weight;
     {
-        // pA and pB are the per-area-probabilities of generating xA[0] and xB[0]
-        auto ComputeSubpathWeightDenominator = [](ys_float32* denom, bool* denomIsFinite,
-            const PathVertex* xA, ys_int32 nA, ys_float32 pA, bool pAIsFinite,
-            const PathVertex* xB, ys_int32 nB, ys_float32 pB, bool pBIsFinite)
-        {
-            if (nA == 0)
-            {
-                *denom = 0.0f;
-                *denomIsFinite = true;
-                return;
-            }
+        MisJoin join;
+        join.probArea_L0 = probArea_L0;
+        join.probAreaFinite_L0 = probAreaFinite_L0;
+        join.probArea_E0 = probArea_E0;
+        join.probArea_E1 = probArea_E1;
+        join.probArea_L2 = probArea_L2;
+        join.probArea_L3 = probArea_L3;
+        join.finite1 = true; // Joins at specular vertices were rejected above
+        join.finite2 = true;
+
+        ys_float32 nThis = (s == 0) ? 1.0f : ((t == 1) ? subpaths.m_lightTracingSampleCount : subpaths.m_joinSampleCount);
+        ys_float32 nThisSqr = nThis * nThis;
+        ys_float32 weightInv = nThisSqr + sSumMisRatios(subpaths, s, t, join);
+        weight = nThisSqr / weightInv;
+    }
 
-            if (nA == 1)
-            {
-                const PathVertex& xBLast = xB[nB - 1];
-                if (xBLast.m_p[1].m_perProjectedSolidAngle.m_isFinite == pAIsFinite)
-                {
-                    ys_float32 pRatio = (xBLast.m_p[1].m_perProjectedSolidAngle.m_value * xBLast.m_projToArea1) / pA;
-                    *denom = pRatio * pRatio; // Balance heuristic with exponent 2
-                    *denomIsFinite = true;
-                }
-                else if (pAIsFinite)
-                {
-                    // To be precise, 'denom' should be the coefficient of the delta function.
-                    // For our use case, it suffices to set a garbage value.
-                    *denom = -1.0f;
-                    *denomIsFinite = false;
-                }
-                else
-                {
-                    *denom = 0.0f;
-                    *denomIsFinite = true;
-                }
-                return;
-            }
+    ysVec4 weightedEstimator = ysSplat(weight) * estimator;
+    return weightedEstimator;
+}
 
-            // Traverse the path backwards, accumulating (P[i]/P[nA-1])^2 from i=nA-2 to i=-1
-            // ... where P[i] is the full path probability assuming xA[i] is the last vertex on subpath A.
-            // P[i]/P[nA-1] = P[i]/P[i+1] * ... * P[nA-3]/P[nA-2] * P[nA-2]/P[nA-1]
 
-            ys_float32 accum;
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysVec4 ysScene::EvaluateMergedSubpaths(const GenerateSubpathOutput& subpaths, ys_int32 s, ys_int32 t) const
+{
+    const ys_float32 divZeroThresh = ys_epsilon; // Prevent unsafe division.
 
-            ys_float32 pRatio;
-            ys_int32 pRatioIsZeroCount;
-            {
-                const bool& p01Finite = xA[nA - 2].m_p[1].m_perProjectedSolidAngle.m_isFinite;
-                const ys_float32& p01 = xA[nA - 2].m_p[1].m_perProjectedSolidAngle.m_value * xA[nA - 2].m_projToArea1;
+    const ysLightSubpath& light = *subpaths.m_light;
+    ysAssert(2 <= s && s <= light.m_nL);
+    ysAssert(2 <= t && t <= subpaths.m_nE);
+    ysAssert(subpaths.m_mergeEta > 0.0f);
+    const PathVertex* y = light.m_y;
+    const PathVertex* z = subpaths.m_z;
+
+    // The light vertex xL is merged into the eye vertex x2, i.e. the light subpath y[0..s-2] is extended to x2 by reusing the direction
+    // in which it reached xL. Labels otherwise follow EvaluateTruncatedSubpaths for the join (s-1,t), which differs from the merge only
+    // in how x2 was generated.
+    const PathVertex* x1 = y + (s - 2);
+    const PathVertex* xL = y + (s - 1);
+    const PathVertex* x2 = z + (t - 1);
+    const PathVertex* x3 = z + (t - 2);
+    if (ysDot3(xL->m_normalWS, x2->m_normalWS) <= 0.0f)
+    {
+        return ysVec4_zero;
+    }
 
-                bool p21Finite;
-                ys_float32 p21;
-                if (nB > 0)
-                {
-                    p21Finite = xB[nB - 1].m_p[1].m_perProjectedSolidAngle.m_isFinite;
-                    p21 = xB[nB - 1].m_p[1].m_perProjectedSolidAngle.m_value * xB[nB - 1].m_projToArea1;
-                }
-                else
-                {
-                    p21Finite = pBIsFinite;
-                    p21 = pB;
-                }
+    ysMtx44 R2;
+    {
+        R2.cx = x2->m_tangentWS;
+        R2.cy = ysCross(x2->m_normalWS, x2->m_tangentWS);
+        R2.cz = x2->m_normalWS;
+    }
+    ysVec4 u21 = ysNormalize3(x1->m_posWS - xL->m_posWS);
+    ysVec4 u21_LS2 = ysMulT33(R2, u21);
+    if (u21_LS2.z < divZeroThresh)
+    {
+        return ysVec4_zero;
+    }
+    ysVec4 u23 = ysNormalize3(x3->m_posWS - x2->m_posWS);
+    ysVec4 u23_LS2 = ysMulT33(R2, u23);
 
-                if (p21Finite == false && p01Finite == true)
-                {
-                    *denom = -1.0f;
-                    *denomIsFinite = false;
-                    return;
-                }
+    ysBSDF f2 = x2->m_material->EvaluateBRDF(this, u21_LS2, u23_LS2);
+    if (f2.m_isFinite == false)
+    {
+        // Merging requires a non-specular vertex.
+        return ysVec4_zero;
+    }
+    ysDirectionalProbabilityDensity p21_2 = x2->m_material->ProbabilityDensityForGeneratedIncomingDirection(this, u21_LS2, u23_LS2);
+    ysDirectionalProbabilityDensity p23_2 = x2->m_material->ProbabilityDensityForGeneratedOutgoingDirection(this, u21_LS2, u23_LS2);
+
+    // The light subpath up to xL is intact, so the probabilities at x1 come straight from the stored vertex.
+    MisJoin join;
+    join.probArea_L0 = light.m_dPdA_L0;
+    join.probAreaFinite_L0 = light.m_dPdA_L0_finite;
+    join.probArea_E0 = (s > 2) ? x1->m_p[0].m_perProjectedSolidAngle.m_value * y[s - 3].m_projToArea1 : -1.0f;
+    join.probArea_E1 = p21_2.m_perProjectedSolidAngle.m_value * x1->m_projToArea1;
+    join.probArea_L2 = sForwardProbabilityPerArea(*x1);
+    join.probArea_L3 = p23_2.m_perProjectedSolidAngle.m_value * x3->m_projToArea1;
+    join.finite1 = x1->m_f.m_isFinite;
+    join.finite2 = true;
+
+    // sSumMisRatios already includes the merge at x2 itself, relative to the join (s-1,t).
+    ys_float32 nJoin = join.finite1 ? subpaths.m_joinSampleCount : 0.0f;
+    ys_float32 mergeRatio = subpaths.m_mergeEta * join.probArea_L2;
+    ys_float32 weightInv = nJoin * nJoin + sSumMisRatios(subpaths, s - 1, t, join);
+    if (weightInv < ys_zeroSafe)
+    {
+        return ysVec4_zero;
+    }
+    ys_float32 weight = mergeRatio * mergeRatio / weightInv;
 
-                pRatio = p21 / p01;
-                if (p21Finite == p01Finite)
-                {
-                    pRatioIsZeroCount = 0;
-                    accum = pRatio * pRatio;
-                }
-                else
-                {
-                    pRatioIsZeroCount = 1;
-                    accum = 0.0f;
-                }
-            }
+    // The estimator at xL already accounts for the probability of reaching it. The remaining density estimate uses a constant kernel over
+    // the merge disk, summed over every light subpath merged with (mergeEta = N_VM * pi * r^2).
+    ysVec4 estimator = xL->m_estimator * f2.m_value * x2->m_estimator / ysSplat(subpaths.m_mergeEta);
+    ysAssert(ysAllGE3(estimator, ysVec4_zero));
+    return ysSplat(weight) * estimator;
+}
 
-            for (ys_int32 i = nA - 2; i >= 1; --i)
-            {
-                const bool& p01Finite = xA[i - 1].m_p[1].m_perProjectedSolidAngle.m_isFinite;
-                const bool& p21Finite = xA[i + 1].m_p[0].m_perProjectedSolidAngle.m_isFinite;
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct MergeData
+{
+    const ysScene* scene;
+    ysScene::GenerateSubpathOutput* subpaths;
+    const ysRender* target;
+    ys_int32 t;
+    ysVec4 radiance;
+};
 
-                if (p21Finite == false && p01Finite == true)
-                {
-                    pRatioIsZeroCount--;
-                }
-                else if (p21Finite == true && p01Finite == false)
-                {
-                    pRatioIsZeroCount++;
-                }
+static void sMergeLightVertex(ys_int32 pointIdx, void* userData)
+{
+    MergeData* md = static_cast<MergeData*>(userData);
+    ys_int32 ref = md->target->m_lightVertexRefs[pointIdx];
+    md->subpaths->m_light = md->target->m_lightSubpathPool + ref / ysLightSubpath::s_nLCeil;
+    ys_int32 s = ref % ysLightSubpath::s_nLCeil + 1;
+    md->radiance += md->scene->EvaluateMergedSubpaths(*md->subpaths, s, md->t);
+}
 
-                if (pRatioIsZeroCount < 0)
-                {
-                    *denom = -1.0f;
-                    *denomIsFinite = false;
-                    return;
-                }
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysVec4 ysScene::SampleRadiance_Bi(const GenerateSubpathInput& input, ysRender* target) const
+{
+    ysAssert(input.camera == nullptr || target != nullptr);
 
-                // p01: The probability to generate xA[i-1]->xA[i] as part of subpath A
-                // p21: The probability to generate xA[i+1]->xA[i] as part of subpath B
-                ys_float32 p01 = xA[i - 1].m_p[1].m_perProjectedSolidAngle.m_value * xA[i - 1].m_projToArea1;
-                ys_float32 p21 = xA[i + 1].m_p[0].m_perProjectedSolidAngle.m_value * xA[i].m_projToArea1;
-                pRatio *= p21 / p01;
-                accum += (pRatioIsZeroCount == 0) ? pRatio * pRatio : 0.0f;
-            }
+    GenerateSubpathOutput subpaths;
+    GenerateEyeSubpath(&subpaths, input);
 
+    // Sum over strategies with s in [sBegin, sEnd] (clamped to the light subpath) and t >= tBegin
+    auto SumStrategies = [&](ys_int32 sBegin, ys_int32 sEnd, ys_int32 tBegin)
+    {
+        ysVec4 sum = ysVec4_zero;
+        sEnd = ysMin(sEnd, subpaths.m_light->m_nL);
+        for (ys_int32 s = sBegin; s <= sEnd; ++s)
+        {
+            // t=0 would require the light subpath to strike the eye, which is impossible for a pinhole.
+            for (ys_int32 t = ysMax(tBegin, 2 - s); t <= subpaths.m_nE; ++t)
             {
-                const bool& p01Finite = pAIsFinite;
-                const bool& p21Finite = xA[1].m_p[0].m_perProjectedSolidAngle.m_isFinite;
-
-                if (p21Finite == false && p01Finite == true)
-                {
-                    pRatioIsZeroCount--;
-                }
-                else if (p21Finite == true && p01Finite == false)
+                ys_int32 splatPixelIdx;
+                ysVec4 value = EvaluateTruncatedSubpaths(subpaths, s, t, &splatPixelIdx);
+                if (splatPixelIdx != ys_nullIndex)
                 {
-                    pRatioIsZeroCount++;
+                    target->AddSplat(splatPixelIdx, value);
                 }
-
-                if (pRatioIsZeroCount < 0)
+                else
                 {
-                    *denom = -1.0f;
-                    *denomIsFinite = false;
-                    return;
+                    sum += value;
                 }
-
-                ys_float32 p01 = pA;
-                ys_float32 p21 = xA[1].m_p[0].m_perProjectedSolidAngle.m_value * xA[0].m_projToArea1;
-                pRatio *= p21 / p01;
-                accum += (pRatioIsZeroCount == 0) ? pRatio * pRatio : 0.0f;
             }
-
-            *denom = accum;
-            *denomIsFinite = true;
-        };
-
-        ys_float32 weightDenomL;
-        bool weightDenomIsFiniteL;
-        ComputeSubpathWeightDenominator(&weightDenomL, &weightDenomIsFiniteL,
-            y, s, probArea_L0, probAreaFinite_L0,
-            z, t, probArea_W0, probAreaFinite_W0);
-        if (weightDenomIsFiniteL == false)
-        {
-            return ysVec4_zero;
         }
-        ysAssert(weightDenomL >= 0.0f);
+        return sum;
+    };
+
+    if (target == nullptr || target->m_lightSubpathPool == nullptr)
+    {
+        ysLightSubpath lightSubpath;
+        GenerateLightSubpath(&lightSubpath, input);
+        subpaths.m_light = &lightSubpath;
 
-        ys_float32 weightDenomE;
-        bool weightDenomIsFiniteE;
-        ComputeSubpathWeightDenominator(&weightDenomE, &weightDenomIsFiniteE,
-            z, t, probArea_W0, probAreaFinite_W0,
-            y, s, probArea_L0, probAreaFinite_L0);
-        if (weightDenomIsFiniteE == false)
+        if (input.camera != nullptr)
         {
-            return ysVec4_zero;
+            // Each traced light subpath counts towards the estimate of every pixel, whether or not it lands on any of them.
+            target->m_splatPathCount++;
         }
-        ysAssert(weightDenomE >= 0.0f);
 
-        ys_float32 weightInv = 1.0f + (weightDenomL + weightDenomE);
-        weight = 1.0f / weightInv;
+        // t=1 is only supported with a camera
+        return SumStrategies(0, ysLightSubpath::s_nLCeil, (input.camera != nullptr) ? 1 : 2);
     }
 
-    ysVec4 weightedEstimator = ysSplat(weight) * estimator;
-    return weightedEstimator;
-}
+    // Join the eye subpath to light subpaths drawn at random from the shared pool. The pool was already connected to the eye (t=1) when it
+    // was traced, and strategies which ignore the light subpath (s=0) must only be counted once.
+    const ysLightSubpath* pool = target->m_lightSubpathPool;
+    ys_int32 poolCount = target->m_lightSubpathPoolCount;
+    ys_int32 joinCount = ys_int32(input.joinSampleCount);
+    ysAssert(poolCount > 0 && joinCount > 0);
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-ysVec4 ysScene::SampleRadiance_Bi(const GenerateSubpathInput& input) const
-{
-    GenerateSubpathOutput subpaths;
-    GenerateSubpaths(&subpaths, input);
+    subpaths.m_light = pool + (rand() % poolCount);
+    ysVec4 radiance = SumStrategies(0, 0, 2);
 
-    if (subpaths.m_nL + subpaths.m_nE < 2)
+    ysVec4 radianceJoined = SumStrategies(1, ysLightSubpath::s_nLCeil, 2);
+    for (ys_int32 k = 1; k < joinCount; ++k)
     {
-        return ysVec4_zero;
+        subpaths.m_light = pool + (rand() % poolCount);
+        radianceJoined += SumStrategies(1, ysLightSubpath::s_nLCeil, 2);
     }
+    radiance += radianceJoined / ysSplat(ys_float32(joinCount));
 
-    ysVec4 radiance = ysVec4_zero;
-    for (ys_int32 s = 0; s <= subpaths.m_nL; ++s)
+    if (input.mergeEta > 0.0f)
     {
-        ys_int32 tBegin = ysMax(0, 2 - s);
-        tBegin = 2; // Require at least two eye vertices for now
-        for (ys_int32 t = tBegin; t <= subpaths.m_nE; ++t)
+        // Merge every eye vertex (except the pinhole) with the nearby light vertices of the whole pool
+        MergeData mergeData;
+        mergeData.scene = this;
+        mergeData.subpaths = &subpaths;
+        mergeData.target = target;
+        mergeData.radiance = ysVec4_zero;
+        for (ys_int32 t = 2; t <= subpaths.m_nE; ++t)
         {
-            radiance += EvaluateTruncatedSubpaths(subpaths, s, t);
+            mergeData.t = t;
+            target->m_lightVertexGrid.Query(subpaths.m_z[t - 1].m_posWS, sMergeLightVertex, &mergeData);
         }
+        radiance += mergeData.radiance;
     }
 
     return radiance;
@@ -1908,10 +3121,19 @@ ysVec4 ysScene::SampleRadiance_Bi(const GenerateSubpathInput& input) const
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-ysVec4 ysScene::RenderPixel(const ysSceneRenderInput& input, const ysVec4& pixelDirLS) const
+ysVec4 ysScene::RenderPixel(const ysSceneRenderInput& input, const ysVec4& pixelDirLS, ysRender* target, ysRender::Features* features) const
 {
     ysVec4 pixelDirWS = ysRotate(input.m_eye.q, pixelDirLS);
 
+    if (features != nullptr)
+    {
+        features->m_albedo = ysVec4_zero;
+        features->m_normalWS = ysVec4_zero;
+        features->m_depth = 0.0f;
+        features->m_shapeIdx = ys_nullIndex;
+        features->m_materialIdx = ys_nullIndex;
+    }
+
     ysSceneRayCastInput rci;
     rci.m_maxLambda = ys_maxFloat;
     rci.m_direction = pixelDirWS;
@@ -1923,7 +3145,7 @@ ysVec4 ysScene::RenderPixel(const ysSceneRenderInput& input, const ysVec4& pixel
         case ysSceneRenderInput::RenderMode::e_regular:
         {
             SingleReflectiveMultipleEmissives srme;
-            sRayCastClosestReflective_CollectEmissives(this, &srme, rci, ys_nullShapeId);
+            sRayCastClosestReflective_CollectEmissives(this, &srme, rci, ys_nullShapeId, ys_nullIndex);
 
             ysVec4 nPixelDirWS = ysNormalize3(pixelDirWS);
 
@@ -1939,6 +3161,18 @@ ysVec4 ysScene::RenderPixel(const ysSceneRenderInput& input, const ysVec4& pixel
                     ? nullptr
                     : m_emissiveMaterials + shape->m_emissiveMaterialId.m_index;
 
+                if (features != nullptr)
+                {
+                    // Mirrors pass on whatever they reflect unattenuated
+                    features->m_albedo = (material->m_type == ysMaterial::Type::e_standard)
+                        ? m_materialStandards[material->m_typeIndex].m_albedoDiffuse
+                        : ysVec4_one;
+                    features->m_normalWS = mainOutput.m_hitNormal;
+                    features->m_depth = mainOutput.m_lambda * ysLength3(pixelDirWS);
+                    features->m_shapeIdx = mainOutput.m_shapeId.m_index;
+                    features->m_materialIdx = shape->m_materialId.m_index;
+                }
+
                 ysAssert(input.m_giInput != nullptr);
                 switch (input.m_giInput->m_type)
                 {
@@ -1950,6 +3184,7 @@ ysVec4 ysScene::RenderPixel(const ysSceneRenderInput& input, const ysVec4& pixel
 
                         ysSurfaceData surfaceData;
                         surfaceData.m_shape = shape;
+                        surfaceData.m_primitiveIndex = mainOutput.m_primitiveIndex;
                         surfaceData.m_material = material;
                         surfaceData.m_emissive = emissive;
                         surfaceData.m_posWS = mainOutput.m_hitPoint;
@@ -1964,7 +3199,8 @@ ysVec4 ysScene::RenderPixel(const ysSceneRenderInput& input, const ysVec4& pixel
                         // Now for our specific implementation, we sample uniformly across the pixel's area such that dP/dwproj = wproj_pixel
                         // (here we have assumed that the pixel subtends an infinitesimal solid angle)
                         // Therefore, we merely need to accumulate radiance += SampleRadiance
-                        radiance += SampleRadiance(surfaceData, 0, giInput->m_maxBounceCount, giInput->m_sampleLight);
+                        ysPathGuide* guide = (target != nullptr && target->m_pathGuide.m_records != nullptr) ? &target->m_pathGuide : nullptr;
+                        radiance += SampleRadiance(surfaceData, *giInput, guide);
                         break;
                     }
                     case ysGlobalIlluminationInput::Type::e_biDirectional:
@@ -1979,12 +3215,14 @@ ysVec4 ysScene::RenderPixel(const ysSceneRenderInput& input, const ysVec4& pixel
                         args.maxEyePathVertexCount = ysMax(2, giInput->m_maxEyeSubpathVertexCount);
 
                         args.eyePathVertex0.m_shape = nullptr;
+                        args.eyePathVertex0.m_primitiveIndex = ys_nullIndex;
                         args.eyePathVertex0.m_material = nullptr;
                         args.eyePathVertex0.m_posWS = input.m_eye.p;
                         args.eyePathVertex0.m_normalWS = ysVec4_zero;
                         args.eyePathVertex0.m_tangentWS = ysVec4_zero;
 
                         args.eyePathVertex1.m_shape = shape;
+                        args.eyePathVertex1.m_primitiveIndex = mainOutput.m_primitiveIndex;
                         args.eyePathVertex1.m_material = material;
                         args.eyePathVertex1.m_emissive = emissive;
                         args.eyePathVertex1.m_posWS = mainOutput.m_hitPoint;
@@ -1994,7 +3232,21 @@ ysVec4 ysScene::RenderPixel(const ysSceneRenderInput& input, const ysVec4& pixel
                         args.WSpatialOverPSpatial0 = ysVec4_one;
                         args.WDirectionalOverPDirectional01 = ysVec4_one;
 
-                        radiance += SampleRadiance_Bi(args);
+                        // Light tracing is only possible if the target has somewhere to put the results
+                        bool lightTracing = (target != nullptr && target->m_splats != nullptr);
+                        args.camera = lightTracing ? &target->m_camera : nullptr;
+
+                        args.joinSampleCount = 1.0f;
+                        args.lightTracingSampleCount = 1.0f;
+                        args.mergeEta = 0.0f;
+                        if (target != nullptr && target->m_lightSubpathPool != nullptr)
+                        {
+                            args.joinSampleCount = ys_float32(ysMax(1, giInput->m_lightSubpathConnectionCount));
+                            args.lightTracingSampleCount = target->m_lightSubpathsPerEyeSubpath;
+                            args.mergeEta = target->m_mergeEta;
+                        }
+
+                        radiance += SampleRadiance_Bi(args, target);
 
                         break;
                     }
@@ -2048,6 +3300,10 @@ struct SharedData
     ys_float32 width;
     ys_float32 pixelHeight;
     ys_float32 pixelWidth;
+
+    // Regular mode only: The range of samples to take for each pixel. Pixels accumulate a sum until the last sample is taken.
+    ys_int32 sampleIdxBegin;
+    ys_int32 sampleIdxEnd;
 };
 
 struct PixelCoordinates
@@ -2077,7 +3333,7 @@ static void ASDF(PixelCoordinates& px, SharedData* sd)
     ys_float32 xMid = width * xFraction;
 
     ys_int32 pixelIdx = input.m_pixelCountX * i + j;
-    ysRender::Pixel* pixel = target->m_pixels + pixelIdx;
+    ysVec4* pixel = target->m_pixels + pixelIdx;
 
     if (input.m_renderMode == ysSceneRenderInput::RenderMode::e_compare)
     {
@@ -2090,7 +3346,7 @@ static void ASDF(PixelCoordinates& px, SharedData* sd)
             ys_float32 x = xMid + ysRandom(-pixelWidth, pixelWidth);
             ys_float32 y = yMid + ysRandom(-pixelHeight, pixelHeight);
             ysVec4 pixelDirLS = ysVecSet(x, y, -1.0f, 0.0f);
-            ysVec4 deltaValue = scene->RenderPixel(tmpInput, pixelDirLS);
+            ysVec4 deltaValue = scene->RenderPixel(tmpInput, pixelDirLS, nullptr, nullptr);
             pixelValueA += deltaValue;
         }
         pixelValueA *= ysSplat(samplesPerPixelInv);
@@ -2104,27 +3360,105 @@ static void ASDF(PixelCoordinates& px, SharedData* sd)
             ys_float32 x = xMid + ysRandom(-pixelWidth, pixelWidth);
             ys_float32 y = yMid + ysRandom(-pixelHeight, pixelHeight);
             ysVec4 pixelDirLS = ysVecSet(x, y, -1.0f, 0.0f);
-            ysVec4 deltaValue = scene->RenderPixel(tmpInput, pixelDirLS);
+            ysVec4 deltaValue = scene->RenderPixel(tmpInput, pixelDirLS, nullptr, nullptr);
             pixelValueB += deltaValue;
         }
         pixelValueB *= ysSplat(samplesPerPixelCompareInv);
 
-        pixel->m_value = (pixelValueB - pixelValueA) + ysVec4_half;
+        *pixel = (pixelValueB - pixelValueA) + ysVec4_half;
+        target->PublishPixel(pixelIdx);
     }
     else
     {
-        pixel->m_value = ysVec4_zero;
-        for (ys_int32 sampleIdx = 0; sampleIdx < input.m_samplesPerPixel; ++sampleIdx)
+        bool aovs = (target->m_aovFlags != 0);
+        if (sd->sampleIdxBegin == 0)
+        {
+            *pixel = ysVec4_zero;
+            target->BeginAOVs(pixelIdx);
+        }
+        for (ys_int32 sampleIdx = sd->sampleIdxBegin; sampleIdx < sd->sampleIdxEnd; ++sampleIdx)
         {
             ys_float32 x = xMid + ysRandom(-pixelWidth, pixelWidth);
             ys_float32 y = yMid + ysRandom(-pixelHeight, pixelHeight);
             ysVec4 pixelDirLS = ysVecSet(x, y, -1.0f, 0.0f);
-            ysVec4 deltaValue = scene->RenderPixel(input, pixelDirLS);
-            pixel->m_value += deltaValue;
+            ysRender::Features features;
+            ysVec4 deltaValue = scene->RenderPixel(input, pixelDirLS, target, aovs ? &features : nullptr);
+            *pixel += deltaValue;
+            if (aovs)
+            {
+                target->AccumulateAOVs(pixelIdx, sampleIdx, features);
+            }
+        }
+        if (sd->sampleIdxEnd == input.m_samplesPerPixel)
+        {
+            *pixel *= ysSplat(samplesPerPixelInv);
+            if (aovs)
+            {
+                target->EndAOVs(pixelIdx, samplesPerPixelInv);
+            }
+            target->PublishPixel(pixelIdx);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct LightSubpathPoolData
+{
+    const ysScene* scene;
+    ysRender* target;
+    ysScene::GenerateSubpathInput input;
+};
+
+static void sTracePooledLightSubpath(ysLightSubpath& lightSubpath, LightSubpathPoolData* pd)
+{
+    const ysScene* scene = pd->scene;
+    ysRender* target = pd->target;
+    const ysScene::GenerateSubpathInput& input = pd->input;
+
+    scene->GenerateLightSubpath(&lightSubpath, input);
+
+    if (target->m_lightVertexPositions != nullptr && lightSubpath.m_nL > 1)
+    {
+        // Publish the vertices that eye subpaths can merge with, i.e. all but the one on the light
+        ys_int32 pathIdx = ys_int32(&lightSubpath - target->m_lightSubpathPool);
+        ys_int32 base = target->m_lightVertexCount.fetch_add(lightSubpath.m_nL - 1);
+        for (ys_int32 j = 1; j < lightSubpath.m_nL; ++j)
+        {
+            target->m_lightVertexPositions[base + j - 1] = lightSubpath.m_y[j].m_posWS;
+            target->m_lightVertexRefs[base + j - 1] = pathIdx * ysLightSubpath::s_nLCeil + j;
+        }
+    }
+
+    if (input.camera == nullptr)
+    {
+        return;
+    }
+
+    // Eye subpaths drawing from the pool skip the t=1 strategies, so connect each pooled light subpath to the eye exactly once here. Only
+    // vertex 0 of the eye subpath (the pinhole) is needed for that.
+    target->m_splatPathCount++;
+
+    ysScene::GenerateSubpathOutput eye;
+    eye.m_light = &lightSubpath;
+    input.eyePathVertex0.InitializePathVertex(eye.m_z + 0);
+    eye.m_z[0].m_estimator = input.WSpatialOverPSpatial0;
+    eye.m_z[0].m_misSum = 0.0f;
+    eye.m_nE = 1;
+    eye.m_camera = input.camera;
+    eye.m_dPdA_E1 = -1.0f;
+    eye.m_joinSampleCount = input.joinSampleCount;
+    eye.m_lightTracingSampleCount = input.lightTracingSampleCount;
+    eye.m_mergeEta = input.mergeEta;
+    for (ys_int32 s = 1; s <= lightSubpath.m_nL; ++s)
+    {
+        ys_int32 splatPixelIdx;
+        ysVec4 value = scene->EvaluateTruncatedSubpaths(eye, s, 1, &splatPixelIdx);
+        if (splatPixelIdx != ys_nullIndex)
+        {
+            target->AddSplat(splatPixelIdx, value);
         }
-        pixel->m_value *= ysSplat(samplesPerPixelInv);
     }
-    pixel->m_isNull = false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2156,11 +3490,110 @@ void ysScene::DoRenderWork(ysRender* target) const
     const ys_float32 pixelWidth = width / ys_float32(input.m_pixelCountX);
 
     const ys_int32 k_pixelBatchCount = 256;
+
+    // The serial path below is for debugging only and always traces a light subpath per eye subpath.
     static bool asdf = false;
+
+    // Bidirectional only: Every batch of pixels is rendered in passes of one sample per pixel, and each pass shares a pool of light subpaths
+    // traced up front. (See ysRender::m_lightSubpathPool)
+    LightSubpathPoolData poolData;
+    poolData.scene = this;
+    poolData.target = target;
+    ys_float32 mergeRadius0 = 0.0f;
+    ys_float32 mergeRadiusAlpha = 1.0f;
+    if (asdf == false &&
+        input.m_renderMode == ysSceneRenderInput::RenderMode::e_regular &&
+        input.m_giInput->m_type == ysGlobalIlluminationInput::Type::e_biDirectional &&
+        static_cast<const ysGlobalIlluminationInput_BiDirectional*>(input.m_giInput)->m_lightSubpathPoolSize > 0)
+    {
+        const ysGlobalIlluminationInput_BiDirectional* giInput = static_cast<const ysGlobalIlluminationInput_BiDirectional*>(input.m_giInput);
+
+        // Every pass traces a full pool, including those of the last batch which may be short on pixels.
+        ys_int32 poolSize = giInput->m_lightSubpathPoolSize;
+        ys_int32 pixelCount = input.m_pixelCountX * input.m_pixelCountY;
+        ys_int32 batchCount = (pixelCount + k_pixelBatchCount - 1) / k_pixelBatchCount;
+
+        target->m_lightSubpathPool = static_cast<ysLightSubpath*>(ysMalloc(sizeof(ysLightSubpath) * poolSize));
+        target->m_lightSubpathPoolCount = poolSize;
+        target->m_lightSubpathsPerEyeSubpath = ys_float32(poolSize) * ys_float32(batchCount) / ys_float32(pixelCount);
+
+        if (giInput->m_vertexMerging && m_bvh.m_nodeCount > 0 && giInput->m_maxLightSubpathVertexCount > 1)
+        {
+            const ysAABB& sceneAABB = m_bvh.m_nodes[0].m_aabb;
+            mergeRadius0 = giInput->m_mergeRadius * ysLength3(sceneAABB.m_max - sceneAABB.m_min);
+            mergeRadiusAlpha = giInput->m_mergeRadiusAlpha;
+        }
+
+        if (mergeRadius0 > 0.0f)
+        {
+            ys_int32 lightVertexCapacity = poolSize * (ysLightSubpath::s_nLCeil - 1);
+            target->m_lightVertexPositions = static_cast<ysVec4*>(ysMalloc(sizeof(ysVec4) * lightVertexCapacity));
+            target->m_lightVertexRefs = static_cast<ys_int32*>(ysMalloc(sizeof(ys_int32) * lightVertexCapacity));
+            target->m_lightVertexGrid.Create(lightVertexCapacity);
+        }
+
+        poolData.input.minLightPathVertexCount = ysMin(1, giInput->m_maxLightSubpathVertexCount);
+        poolData.input.maxLightPathVertexCount = giInput->m_maxLightSubpathVertexCount;
+        poolData.input.eyePathVertex0.m_shape = nullptr;
+        poolData.input.eyePathVertex0.m_primitiveIndex = ys_nullIndex;
+        poolData.input.eyePathVertex0.m_material = nullptr;
+        poolData.input.eyePathVertex0.m_emissive = nullptr;
+        poolData.input.eyePathVertex0.m_posWS = input.m_eye.p;
+        poolData.input.eyePathVertex0.m_normalWS = ysVec4_zero;
+        poolData.input.eyePathVertex0.m_tangentWS = ysVec4_zero;
+        poolData.input.WSpatialOverPSpatial0 = ysVec4_one;
+        poolData.input.camera = (target->m_splats != nullptr) ? &target->m_camera : nullptr;
+        poolData.input.joinSampleCount = ys_float32(ysMax(1, giInput->m_lightSubpathConnectionCount));
+        poolData.input.lightTracingSampleCount = target->m_lightSubpathsPerEyeSubpath;
+        poolData.input.mergeEta = 0.0f;
+    }
+
+    // Unidirectional only: As above, every batch of pixels is rendered in passes of one sample per pixel. The path guide lives for the
+    // whole render and is trained between passes, whenever enough records have piled up for it to be worth the cost.
+    const ys_int32 k_pathGuideRecordsPerUpdate = 1 << 14;
+    if (asdf == false &&
+        input.m_renderMode == ysSceneRenderInput::RenderMode::e_regular &&
+        input.m_giInput->m_type == ysGlobalIlluminationInput::Type::e_uniDirectional &&
+        static_cast<const ysGlobalIlluminationInput_UniDirectional*>(input.m_giInput)->m_pathGuiding &&
+        m_bvh.m_nodeCount > 0)
+    {
+        // A pass over a batch records at most 16 bounces per pixel (see SampleRadiance), so the records never overflow between updates
+        target->m_pathGuide.Create(m_bvh.m_nodes[0].m_aabb, k_pathGuideRecordsPerUpdate + 16 * k_pixelBatchCount);
+    }
+    const bool pathGuiding = (target->m_pathGuide.m_records != nullptr);
+
+    auto RefillLightSubpathPool = [&](ys_int32 passIdx)
+    {
+        ysAssert(target->m_lightSubpathPool != nullptr);
+
+        // The merge radius shrinks with every pass so that the bias from merging vanishes as the pass count grows. (See "Progressive
+        // Photon Mapping: A Probabilistic Approach" by Knaus and Zwicker 2011)
+        ys_float32 mergeRadius = mergeRadius0 * powf(ys_float32(passIdx + 1), 0.5f * (mergeRadiusAlpha - 1.0f));
+        target->m_mergeEta = ys_float32(target->m_lightSubpathPoolCount) * ys_pi * mergeRadius * mergeRadius;
+        target->m_lightVertexCount = 0;
+        poolData.input.mergeEta = target->m_mergeEta;
+
+        if (m_jobSystem == nullptr)
+        {
+            for (ys_int32 k = 0; k < target->m_lightSubpathPoolCount; ++k)
+            {
+                sTracePooledLightSubpath(target->m_lightSubpathPool[k], &poolData);
+            }
+        }
+        else
+        {
+            ysParallelFor(m_jobSystem, target->m_lightSubpathPool, target->m_lightSubpathPoolCount, &poolData, 2, sTracePooledLightSubpath);
+        }
+
+        if (mergeRadius > 0.0f)
+        {
+            target->m_lightVertexGrid.Build(m_jobSystem, target->m_lightVertexPositions, target->m_lightVertexCount, mergeRadius);
+        }
+    };
+
     //if (m_jobSystem == nullptr)
     if (asdf)
     {
-        ys_int32 pixelIdx0 = 0;
         ys_int32 pixelIdx = 0;
         for (ys_int32 i = 0; i < input.m_pixelCountY && target->m_state != ysRender::State::e_terminated; ++i)
         {
@@ -2171,7 +3604,7 @@ void ysScene::DoRenderWork(ysRender* target) const
                 ys_float32 xFraction = 2.0f * ys_float32(j + 1) / ys_float32(input.m_pixelCountX) - 1.0f;
                 ys_float32 xMid = width * xFraction;
 
-                ysRender::Pixel* pixel = target->m_pixels + pixelIdx;
+                ysVec4* pixel = target->m_pixels + pixelIdx;
 
                 if (input.m_renderMode == ysSceneRenderInput::RenderMode::e_compare)
                 {
@@ -2184,7 +3617,7 @@ void ysScene::DoRenderWork(ysRender* target) const
                         ys_float32 x = xMid + ysRandom(-pixelWidth, pixelWidth);
                         ys_float32 y = yMid + ysRandom(-pixelHeight, pixelHeight);
                         ysVec4 pixelDirLS = ysVecSet(x, y, -1.0f, 0.0f);
-                        ysVec4 deltaValue = RenderPixel(tmpInput, pixelDirLS);
+                        ysVec4 deltaValue = RenderPixel(tmpInput, pixelDirLS, nullptr, nullptr);
                         pixelValueA += deltaValue;
                     }
                     pixelValueA *= ysSplat(samplesPerPixelInv);
@@ -2198,49 +3631,41 @@ void ysScene::DoRenderWork(ysRender* target) const
                         ys_float32 x = xMid + ysRandom(-pixelWidth, pixelWidth);
                         ys_float32 y = yMid + ysRandom(-pixelHeight, pixelHeight);
                         ysVec4 pixelDirLS = ysVecSet(x, y, -1.0f, 0.0f);
-                        ysVec4 deltaValue = RenderPixel(tmpInput, pixelDirLS);
+                        ysVec4 deltaValue = RenderPixel(tmpInput, pixelDirLS, nullptr, nullptr);
                         pixelValueB += deltaValue;
                     }
                     pixelValueB *= ysSplat(samplesPerPixelCompareInv);
 
-                    pixel->m_value = (pixelValueB - pixelValueA) + ysVec4_half;
+                    *pixel = (pixelValueB - pixelValueA) + ysVec4_half;
                 }
                 else
                 {
-                    pixel->m_value = ysVec4_zero;
+                    bool aovs = (target->m_aovFlags != 0);
+                    *pixel = ysVec4_zero;
+                    target->BeginAOVs(pixelIdx);
                     for (ys_int32 sampleIdx = 0; sampleIdx < input.m_samplesPerPixel; ++sampleIdx)
                     {
                         ys_float32 x = xMid + ysRandom(-pixelWidth, pixelWidth);
                         ys_float32 y = yMid + ysRandom(-pixelHeight, pixelHeight);
                         ysVec4 pixelDirLS = ysVecSet(x, y, -1.0f, 0.0f);
-                        ysVec4 deltaValue = RenderPixel(input, pixelDirLS);
-                        pixel->m_value += deltaValue;
+                        ysRender::Features features;
+                        ysVec4 deltaValue = RenderPixel(input, pixelDirLS, target, aovs ? &features : nullptr);
+                        *pixel += deltaValue;
+                        if (aovs)
+                        {
+                            target->AccumulateAOVs(pixelIdx, sampleIdx, features);
+                        }
                     }
-                    pixel->m_value *= ysSplat(samplesPerPixelInv);
-                }
-
-                pixel->m_isNull = false;
-
-                pixelIdx++;
-
-                if (pixelIdx - pixelIdx0 == k_pixelBatchCount)
-                {
-                    ysScopedLock lock(&target->m_interruptLock);
-                    for (ys_int32 k = pixelIdx0; k < pixelIdx; ++k)
+                    *pixel *= ysSplat(samplesPerPixelInv);
+                    if (aovs)
                     {
-                        target->m_exposedPixels[k] = target->m_pixels[k];
+                        target->EndAOVs(pixelIdx, samplesPerPixelInv);
                     }
-                    pixelIdx0 = pixelIdx;
                 }
-            }
-        }
 
-        if (pixelIdx - pixelIdx0 > 0)
-        {
-            ysScopedLock lock(&target->m_interruptLock);
-            for (ys_int32 k = pixelIdx0; k < pixelIdx; ++k)
-            {
-                target->m_exposedPixels[k] = target->m_pixels[k];
+                target->PublishPixel(pixelIdx);
+
+                pixelIdx++;
             }
         }
     }
@@ -2255,8 +3680,36 @@ void ysScene::DoRenderWork(ysRender* target) const
         sharedData.width = width;
         sharedData.pixelHeight = pixelHeight;
         sharedData.pixelWidth = pixelWidth;
+        sharedData.sampleIdxBegin = 0;
+        sharedData.sampleIdxEnd = input.m_samplesPerPixel;
         PixelCoordinates pixelBatch[k_pixelBatchCount];
 
+        auto RenderBatch = [&](ys_int32 n)
+        {
+            if (target->m_lightSubpathPool == nullptr && pathGuiding == false)
+            {
+                sharedData.sampleIdxBegin = 0;
+                sharedData.sampleIdxEnd = input.m_samplesPerPixel;
+                ysParallelFor(m_jobSystem, pixelBatch, n, &sharedData, 2, ASDF);
+                return;
+            }
+
+            for (ys_int32 passIdx = 0; passIdx < input.m_samplesPerPixel; ++passIdx)
+            {
+                if (target->m_lightSubpathPool != nullptr)
+                {
+                    RefillLightSubpathPool(passIdx);
+                }
+                sharedData.sampleIdxBegin = passIdx;
+                sharedData.sampleIdxEnd = passIdx + 1;
+                ysParallelFor(m_jobSystem, pixelBatch, n, &sharedData, 2, ASDF);
+                if (pathGuiding && target->m_pathGuide.GetRecordCount() >= k_pathGuideRecordsPerUpdate)
+                {
+                    target->m_pathGuide.Update(m_jobSystem);
+                }
+            }
+        };
+
         ys_int32 n = 0;
         for (ys_int32 i = 0; i < input.m_pixelCountY && target->m_state != ysRender::State::e_terminated; ++i)
         {
@@ -2267,36 +3720,28 @@ void ysScene::DoRenderWork(ysRender* target) const
                 dst->j = j;
                 n++;
 
+                // Pixels publish themselves as they finish (see ysRender::PublishPixel)
                 if (n == k_pixelBatchCount)
                 {
-                    ysParallelFor(m_jobSystem, pixelBatch, n, &sharedData, 2, ASDF);
+                    RenderBatch(n);
                     n = 0;
-
-                    ysScopedLock lock(&target->m_interruptLock);
-                    for (ys_int32 k = 0; k < k_pixelBatchCount; ++k)
-                    {
-                        const PixelCoordinates& src = pixelBatch[k];
-                        ys_int32 pixelIdx = input.m_pixelCountX * src.i + src.j;
-                        target->m_exposedPixels[pixelIdx] = target->m_pixels[pixelIdx];
-                    }
                 }
             }
         }
 
         if (n > 0)
         {
-            ysParallelFor(m_jobSystem, pixelBatch, n, &sharedData, 2, ASDF);
-
-            ysScopedLock lock(&target->m_interruptLock);
-            for (ys_int32 k = 0; k < k_pixelBatchCount; ++k)
-            {
-                const PixelCoordinates& src = pixelBatch[k];
-                ys_int32 pixelIdx = input.m_pixelCountX * src.i + src.j;
-                target->m_exposedPixels[pixelIdx] = target->m_pixels[pixelIdx];
-            }
+            RenderBatch(n);
         }
-
     }
+
+    ysSafeFree(target->m_lightSubpathPool);
+    target->m_lightSubpathPoolCount = 0;
+    ysSafeFree(target->m_lightVertexPositions);
+    ysSafeFree(target->m_lightVertexRefs);
+    target->m_lightVertexGrid.Destroy();
+    target->m_mergeEta = 0.0f;
+    target->m_pathGuide.Destroy();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2351,7 +3796,7 @@ ysVec4 ysScene::DebugRenderPixel(const ysSceneRenderInput& input, ys_float32 pix
             ys_float32 x = xMid + ysRandom(-pixelWidth, pixelWidth);
             ys_float32 y = yMid + ysRandom(-pixelHeight, pixelHeight);
             ysVec4 pixelDirLS = ysVecSet(x, y, -1.0f, 0.0f);
-            ysVec4 deltaValue = RenderPixel(tmpInput, pixelDirLS);
+            ysVec4 deltaValue = RenderPixel(tmpInput, pixelDirLS, nullptr, nullptr);
             pixelValueA += deltaValue;
         }
         pixelValueA *= ysSplat(samplesPerPixelInv);
@@ -2365,7 +3810,7 @@ ysVec4 ysScene::DebugRenderPixel(const ysSceneRenderInput& input, ys_float32 pix
             ys_float32 x = xMid + ysRandom(-pixelWidth, pixelWidth);
             ys_float32 y = yMid + ysRandom(-pixelHeight, pixelHeight);
             ysVec4 pixelDirLS = ysVecSet(x, y, -1.0f, 0.0f);
-            ysVec4 deltaValue = RenderPixel(tmpInput, pixelDirLS);
+            ysVec4 deltaValue = RenderPixel(tmpInput, pixelDirLS, nullptr, nullptr);
             pixelValueB += deltaValue;
         }
         pixelValueB *= ysSplat(samplesPerPixelCompareInv);
@@ -2390,7 +3835,7 @@ ysVec4 ysScene::DebugRenderPixel(const ysSceneRenderInput& input, ys_float32 pix
             ys_float32 x = xMid + ysRandom(-pixelWidth, pixelWidth);
             ys_float32 y = yMid + ysRandom(-pixelHeight, pixelHeight);
             ysVec4 pixelDirLS = ysVecSet(x, y, -1.0f, 0.0f);
-            ysVec4 deltaValue = RenderPixel(input, pixelDirLS);
+            ysVec4 deltaValue = RenderPixel(input, pixelDirLS, nullptr, nullptr);
             pixelValue += deltaValue;
         }
         pixelValue *= ysSplat(samplesPerPixelInv);
@@ -2402,29 +3847,60 @@ ysVec4 ysScene::DebugRenderPixel(const ysSceneRenderInput& input, ys_float32 pix
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void ysScene::DebugDrawGeo(const ysDrawInputGeo& input) const
 {
-    Color colors[1];
-    colors[0] = Color(1.0f, 0.0f, 0.0f);
-    for (ys_int32 i = 0; i < m_triangleCount; ++i)
+    auto DrawTriangle = [&](const ysVec4* v, bool twoSided)
     {
-        const ysTriangle* triangle = m_triangles + i;
-        input.debugDraw->DrawTriangleList(triangle->m_v, colors, 1);
-        if (triangle->m_twoSided)
+        Color colors[1];
+        colors[0] = Color(1.0f, 0.0f, 0.0f);
+        input.debugDraw->DrawTriangleList(v, colors, 1);
+        if (twoSided)
         {
-            ysVec4 cba[3] = { triangle->m_v[2], triangle->m_v[1], triangle->m_v[0] };
+            ysVec4 cba[3] = { v[2], v[1], v[0] };
             input.debugDraw->DrawTriangleList(cba, colors, 1);
         }
         ysVec4 segments[3][2];
-        segments[0][0] = triangle->m_v[0];
-        segments[0][1] = triangle->m_v[1];
-        segments[1][0] = triangle->m_v[1];
-        segments[1][1] = triangle->m_v[2];
-        segments[2][0] = triangle->m_v[2];
-        segments[2][1] = triangle->m_v[0];
+        segments[0][0] = v[0];
+        segments[0][1] = v[1];
+        segments[1][0] = v[1];
+        segments[1][1] = v[2];
+        segments[2][0] = v[2];
+        segments[2][1] = v[0];
         Color c[3];
         c[0] = Color(1.0f, 1.0f, 1.0f);
         c[1] = c[0];
         c[2] = c[1];
         input.debugDraw->DrawSegmentList(&segments[0][0], c, 3);
+    };
+
+    for (ys_int32 i = 0; i < m_triangleCount; ++i)
+    {
+        const ysTriangle* triangle = m_triangles + i;
+        DrawTriangle(triangle->m_v, triangle->m_twoSided);
+    }
+
+    for (ys_int32 i = 0; i < m_meshCount; ++i)
+    {
+        const ysMesh* mesh = m_meshes + i;
+        for (ys_int32 j = 0; j < mesh->m_triangleCount; ++j)
+        {
+            ysVec4 v[3];
+            mesh->GetVertices(j, v);
+            DrawTriangle(v, mesh->m_twoSided);
+        }
+    }
+
+    for (ys_int32 i = 0; i < m_meshInstanceCount; ++i)
+    {
+        const ysMeshInstance* instance = m_meshInstances + i;
+        const ysMesh* mesh = &m_instancedMeshes[instance->m_meshIndex].m_mesh;
+        for (ys_int32 j = 0; j < mesh->m_triangleCount; ++j)
+        {
+            ysVec4 v[3];
+            mesh->GetVertices(j, v);
+            v[0] = ysMul(instance->m_xf, v[0]);
+            v[1] = ysMul(instance->m_xf, v[1]);
+            v[2] = ysMul(instance->m_xf, v[2]);
+            DrawTriangle(v, mesh->m_twoSided);
+        }
     }
 
     for (ys_int32 i = 0; i < m_ellipsoidCount; ++i)
@@ -2453,19 +3929,24 @@ void ysScene::DebugDrawLights(const ysDrawInputLights& input) const
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-ysSceneId ysScene_Create(const ysSceneDef& def)
+static ys_int32 sFindFreeSceneIndex()
 {
-    ys_int32 freeSceneIdx = 0;
-    while (freeSceneIdx < YOSHIPBR_MAX_SCENE_COUNT)
+    for (ys_int32 i = 0; i < YOSHIPBR_MAX_SCENE_COUNT; ++i)
     {
-        if (ysScene::s_scenes[freeSceneIdx] == nullptr)
+        if (ysScene::s_scenes[i] == nullptr)
         {
-            break;
+            return i;
         }
-        freeSceneIdx++;
     }
+    return ys_nullIndex;
+}
 
-    if (freeSceneIdx == YOSHIPBR_MAX_SCENE_COUNT)
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysSceneId ysScene_Create(const ysSceneDef& def)
+{
+    ys_int32 freeSceneIdx = sFindFreeSceneIndex();
+    if (freeSceneIdx == ys_nullIndex)
     {
         return ys_nullSceneId;
     }
@@ -2478,6 +3959,71 @@ ysSceneId ysScene_Create(const ysSceneDef& def)
     return id;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysSceneId ysScene_CreateAsync(const ysSceneDef& def)
+{
+    ys_int32 freeSceneIdx = sFindFreeSceneIndex();
+    if (freeSceneIdx == ys_nullIndex)
+    {
+        return ys_nullSceneId;
+    }
+
+    ysScene::s_scenes[freeSceneIdx] = static_cast<ysScene*>(ysMalloc(sizeof(ysScene)));
+    ysScene::s_scenes[freeSceneIdx]->CreateAsync(def);
+
+    ysSceneId id;
+    id.m_index = freeSceneIdx;
+    return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ys_float32 ysScene_GetCreationProgress(ysSceneId id)
+{
+    ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    return ysScene::s_scenes[id.m_index]->GetCreationProgress();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysScene_PreviewReady(ysSceneId id)
+{
+    ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    return ysScene::s_scenes[id.m_index]->IsPreviewReady();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysScene_CreationFinished(ysSceneId id)
+{
+    ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    return ysScene::s_scenes[id.m_index]->FinishCreation();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+ysSceneId ysScene_CreateFromFile(const char* path)
+{
+    ys_int32 freeSceneIdx = sFindFreeSceneIndex();
+    if (freeSceneIdx == ys_nullIndex)
+    {
+        return ys_nullSceneId;
+    }
+
+    ysScene* scene = static_cast<ysScene*>(ysMalloc(sizeof(ysScene)));
+    if (scene->CreateFromFile(path) == false)
+    {
+        ysFree(scene);
+        return ys_nullSceneId;
+    }
+    ysScene::s_scenes[freeSceneIdx] = scene;
+
+    ysSceneId id;
+    id.m_index = freeSceneIdx;
+    return id;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void ysScene_Destroy(ysSceneId id)
@@ -2488,11 +4034,45 @@ void ysScene_Destroy(ysSceneId id)
     ysScene::s_scenes[id.m_index] = nullptr;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysScene_Save(ysSceneId id, const char* path)
+{
+    ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    ysAssert(ysScene::s_scenes[id.m_index]->m_creationStage == ysScene::CreationStage::e_created);
+    ysScene* scene = ysScene::s_scenes[id.m_index];
+
+    // The file gets the hierarchy in full, so whatever is left of a lazy one is built first, which renders must not be casting against
+    ysAssert(scene->m_bvh.m_lazySubtreeCount == 0 || scene->m_renders.GetCount() == 0);
+    scene->m_bvh.Finalize();
+    return scene->Save(path);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene_UpdateShapes(ysSceneId id, const ysSceneShapesUpdate& update)
+{
+    ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    ysAssert(ysScene::s_scenes[id.m_index]->m_creationStage == ysScene::CreationStage::e_created);
+    ysScene::s_scenes[id.m_index]->UpdateShapes(update);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ysScene_UpdateMaterials(ysSceneId id, const ysSceneMaterialsUpdate& update)
+{
+    ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    ysAssert(ysScene::s_scenes[id.m_index]->IsPreviewReady());
+    ysScene::s_scenes[id.m_index]->UpdateMaterials(update);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void ysScene_Render(ysSceneId id, ysSceneRenderOutput* output, const ysSceneRenderInput& input)
 {
     ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    ysAssert(ysScene::s_scenes[id.m_index]->IsPreviewReady());
+    ysScene::s_scenes[id.m_index]->RequestRadianceCache(input);
     ysScene::s_scenes[id.m_index]->Render(output, input);
 }
 
@@ -2501,6 +4081,8 @@ void ysScene_Render(ysSceneId id, ysSceneRenderOutput* output, const ysSceneRend
 ysVec4 ysScene_DebugRenderPixel(ysSceneId id, const ysSceneRenderInput& input, const ys_float32 pixelX, const ys_float32 pixelY)
 {
     ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    ysAssert(ysScene::s_scenes[id.m_index]->IsPreviewReady());
+    ysScene::s_scenes[id.m_index]->RequestRadianceCache(input);
     return ysScene::s_scenes[id.m_index]->DebugRenderPixel(input, pixelX, pixelY);
 }
 
@@ -2510,6 +4092,11 @@ ysRenderId ysScene_CreateRender(ysSceneId id, const ysSceneRenderInput& input)
 {
     ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
     ysScene* scene = ysScene::s_scenes[id.m_index];
+    ysAssert(scene->IsPreviewReady());
+
+    // Renders started before the full hierarchy is in place stay on the coarse one
+    scene->FinishCreation();
+    scene->RequestRadianceCache(input);
 
     ys_int32 renderIdx = scene->m_renders.Allocate();
     scene->m_renders[renderIdx].Create(scene, input);
@@ -2532,6 +4119,19 @@ void ysScene_DestroyRender(ysRenderId id)
     render.Terminate(scene);
     render.Destroy();
     scene->m_renders.Free(id.m_index);
+
+    // Nothing is left that could be reading the buffers replaced by material updates, the radiance cache they made stale, or the coarse
+    // hierarchy of an asynchronous creation
+    if (scene->m_renders.GetCount() == 0)
+    {
+        scene->FreeRetiredBuffers();
+        if (scene->m_radianceCacheStale.load(std::memory_order_relaxed))
+        {
+            scene->m_radianceCache->Clear();
+            scene->m_radianceCacheStale.store(false, std::memory_order_relaxed);
+        }
+        scene->FinishCreation();
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2539,6 +4139,7 @@ void ysScene_DestroyRender(ysRenderId id)
 ys_int32 ysScene_GetBVHDepth(ysSceneId id)
 {
     ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    ysAssert(ysScene::s_scenes[id.m_index]->IsPreviewReady());
     return ysScene::s_scenes[id.m_index]->m_bvh.m_depth;
 }
 
@@ -2547,6 +4148,7 @@ ys_int32 ysScene_GetBVHDepth(ysSceneId id)
 void ysScene_DebugDrawBVH(ysSceneId id, const ysDrawInputBVH& input)
 {
     ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    ysAssert(ysScene::s_scenes[id.m_index]->IsPreviewReady());
     ysScene::s_scenes[id.m_index]->m_bvh.DebugDraw(input);
 }
 
@@ -2555,6 +4157,7 @@ void ysScene_DebugDrawBVH(ysSceneId id, const ysDrawInputBVH& input)
 void ysScene_DebugDrawGeo(ysSceneId id, const ysDrawInputGeo& input)
 {
     ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    ysAssert(ysScene::s_scenes[id.m_index]->IsPreviewReady());
     ysScene::s_scenes[id.m_index]->DebugDrawGeo(input);
 }
 
@@ -2563,5 +4166,6 @@ void ysScene_DebugDrawGeo(ysSceneId id, const ysDrawInputGeo& input)
 void ysScene_DebugDrawLights(ysSceneId id, const ysDrawInputLights& input)
 {
     ysAssert(ysScene::s_scenes[id.m_index] != nullptr);
+    ysAssert(ysScene::s_scenes[id.m_index]->IsPreviewReady());
     ysScene::s_scenes[id.m_index]->DebugDrawLights(input);
 }
\ No newline at end of file
@@ -4,26 +4,39 @@
 #include "YoshiPBR/ysPool.h"
 #include "YoshiPBR/ysTypes.h"
 
+#include "common/ysMappedFile.h"
+#include "light/ysLightBVH.h"
 #include "scene/ysRender.h"
 
+#include <atomic>
+
 #define YOSHIPBR_MAX_SCENE_COUNT (1)
 
 struct ysDrawInputGeo;
 struct ysLight;
 struct ysLightPoint;
+struct ysLightSubpath;
 struct ysEmissiveMaterial;
 struct ysEmissiveMaterialUniform;
+struct ysGlobalIlluminationInput_UniDirectional;
 struct ysJobSystem;
 struct ysMaterial;
 struct ysMaterialMirror;
 struct ysMaterialStandard;
+struct ysInstancedMesh;
+struct ysMesh;
+struct ysMeshInstance;
+struct ysPathGuide;
+struct ysRadianceCache;
 struct ysRayCastInput;
 struct ysRayCastOutput;
 struct ysSceneDef;
 struct ysSceneRayCastInput;
 struct ysSceneRayCastOutput;
 struct ysSceneRenderInput;
+struct ysSceneMaterialsUpdate;
 struct ysSceneRenderOutput;
+struct ysSceneShapesUpdate;
 struct ysRay;
 struct ysShape;
 struct ysEllipsoid;
@@ -41,15 +54,73 @@ struct ysScene
     void Create(const ysSceneDef&);
     void Destroy();
 
-    ysVec4 SampleRadiance(const ysSurfaceData&, ys_int32 bounceCount, ys_int32 maxBounceCount, bool sampleLight) const;
+    // Asynchronous creation. (See ysScene_CreateAsync) A job on the scene's job system creates everything against a coarse hierarchy
+    // first, which renders may use while the full hierarchy is built into m_pendingBVH. The full hierarchy is swapped in by FinishCreation,
+    // on the user's thread, once no render is left reading the coarse one.
+    enum CreationStage
+    {
+        e_creatingShapes,
+        e_creatingPreview,
+        e_buildingHierarchy,
+        e_hierarchyBuilt,
+        e_created,
+    };
+
+    void CreateAsync(const ysSceneDef&);
+    void DoCreationWork();
+    bool IsPreviewReady() const;
+    bool FinishCreation(); // Returns whether creation is complete
+    ys_float32 GetCreationProgress() const;
+
+    // The parts of creation read from the definition. The bounds and ids of the shapes are returned for the hierarchy to be built from, and
+    // are for the caller to free.
+    void CreateShapes(const ysSceneDef&, ysAABB** aabbs, ysShapeId** shapeIds);
+    void CreateMaterialsAndLights(const ysSceneDef&);
+
+    // Binary scene files. (See ysScene_Save) A scene created from a file is mapped rather than read: its arrays point straight into the
+    // mapping, which it keeps open until destroyed.
+    bool Save(const char* path) const;
+    bool CreateFromFile(const char* path);
+
+    // Comes first in creation, so that the rest of it can run on the workers
+    void CreateJobSystem();
+
+    // The rest of creation, for once the shapes, materials, lights and the hierarchy over the shapes are all in place
+    void CreateDerivedState();
+
+    // Creates the radiance cache the first time a render asks for it. Not to be called from render threads.
+    void RequestRadianceCache(const ysSceneRenderInput&);
+
+    // Forgets whatever buffers point into the mapped file, so that destroying the scene leaves them to the mapping
+    void ReleaseMappedBuffers();
+
+    // Moves or deforms shapes in place. (See ysScene_UpdateShapes)
+    void UpdateShapes(const ysSceneShapesUpdate&);
+
+    // Changes materials and emitter strengths in place, even while rendering. (See ysScene_UpdateMaterials) Every array touched is copied,
+    // edited, and swapped in whole. The copies they replace may still be read by renders in flight, so they are retired rather than freed.
+    void UpdateMaterials(const ysSceneMaterialsUpdate&);
+    void RetireBuffer(void*);
+    void FreeRetiredBuffers();
+
+    // The path guide is optional. If given, it is used to sample directions and is fed the radiance found along them.
+    ysVec4 SampleRadiance(const ysSurfaceData&, const ysGlobalIlluminationInput_UniDirectional&, ysPathGuide* guide) const;
 
     struct GenerateSubpathInput;
     struct GenerateSubpathOutput;
-    void GenerateSubpaths(GenerateSubpathOutput*, const GenerateSubpathInput&) const;
-    ysVec4 EvaluateTruncatedSubpaths(const GenerateSubpathOutput&, ys_int32 truncatedEyeSubpathVertexCount, ys_int32 truncatedLightSubpathVertexCount) const;
-    ysVec4 SampleRadiance_Bi(const GenerateSubpathInput&) const;
-
-    ysVec4 RenderPixel(const ysSceneRenderInput& input, const ysVec4& pixelDirLS) const;
+    void GenerateLightSubpath(ysLightSubpath*, const GenerateSubpathInput&) const;
+    // The light subpath (GenerateSubpathOutput::m_light) is left for the caller to fill in.
+    void GenerateEyeSubpath(GenerateSubpathOutput*, const GenerateSubpathInput&) const;
+    // If the result is to be splatted onto another pixel (light tracing), its index is written to splatPixelIdx (otherwise ys_nullIndex).
+    ysVec4 EvaluateTruncatedSubpaths(const GenerateSubpathOutput&, ys_int32 truncatedLightSubpathVertexCount, ys_int32 truncatedEyeSubpathVertexCount,
+        ys_int32* splatPixelIdx) const;
+    // Vertex merging: The light subpath's vertex s-1 is merged into the eye subpath's vertex t-1.
+    ysVec4 EvaluateMergedSubpaths(const GenerateSubpathOutput&, ys_int32 lightSubpathVertexCount, ys_int32 eyeSubpathVertexCount) const;
+    ysVec4 SampleRadiance_Bi(const GenerateSubpathInput&, ysRender* target) const;
+
+    // target may be null, in which case the render is restricted to strategies that contribute to the given pixel only, and each eye
+    // subpath is joined to a light subpath of its own. If features is given (regular mode only), it receives the surface seen by the eye.
+    ysVec4 RenderPixel(const ysSceneRenderInput& input, const ysVec4& pixelDirLS, ysRender* target, ysRender::Features* features) const;
     void DoRenderWork(ysRender* target) const;
     void Render(ysSceneRenderOutput* output, const ysSceneRenderInput& input) const;
 
@@ -73,6 +144,16 @@ struct ysScene
     ysTriangle* m_triangles;
     ys_int32 m_triangleCount;
 
+    ysMesh* m_meshes;
+    ys_int32 m_meshCount;
+
+    // Meshes placed through instances only, each with a hierarchy over its triangles that its instances share
+    ysInstancedMesh* m_instancedMeshes;
+    ys_int32 m_instancedMeshCount;
+
+    ysMeshInstance* m_meshInstances;
+    ys_int32 m_meshInstanceCount;
+
     //////////////////////////
     // Reflective Materials //
     //////////////////////////
@@ -80,7 +161,8 @@ struct ysScene
     ysMaterial* m_materials;
     ys_int32 m_materialCount;
 
-    ysMaterialStandard* m_materialStandards;
+    // Renders read these while material updates may be swapping in fresh copies (see UpdateMaterials), hence the atomics
+    std::atomic<ysMaterialStandard*> m_materialStandards;
     ys_int32 m_materialStandardCount;
 
     ysMaterialMirror* m_materialMirrors;
@@ -93,7 +175,7 @@ struct ysScene
     ysEmissiveMaterial* m_emissiveMaterials;
     ys_int32 m_emissiveMaterialCount;
 
-    ysEmissiveMaterialUniform* m_emissiveMaterialUniforms;
+    std::atomic<ysEmissiveMaterialUniform*> m_emissiveMaterialUniforms;
     ys_int32 m_emissiveMaterialUniformCount;
 
     ////////////////////////////////////////////////
@@ -103,14 +185,41 @@ struct ysScene
     ysLight* m_lights;
     ys_int32 m_lightCount;
 
-    ysLightPoint* m_lightPoints;
+    std::atomic<ysLightPoint*> m_lightPoints;
     ys_int32 m_lightPointCount;
 
     // These are for quickly iterating over all area light sources
     ys_int32* m_emissiveShapeIndices;
     ys_int32 m_emissiveShapeCount;
+
+    // Hierarchy over all emissive shapes for choosing the most relevant emitter at a given point (or the most powerful one)
+    ysLightBVH m_lightBVH;
+
+    // Same as above, but over m_lights
+    ysLightBVH m_infinitesimalLightBVH;
     
     ysPool<ysRender> m_renders;
 
+    // Buffers replaced by material updates while renders were in progress. Freed once the last render is destroyed.
+    ysArrayG<void*> m_retiredBuffers;
+
+    // Persists across renders, which fill it as they go. Null until a render asks for it.
+    // (See ysGlobalIlluminationInput_UniDirectional::m_radianceCacheBounceCount)
+    ysRadianceCache* m_radianceCache;
+
+    // Set by material updates made while renders were in progress, which would otherwise keep reading (and adding to) what the cache learned
+    // under the old materials. The cache goes unused until the last render is destroyed, and is cleared then.
+    std::atomic<bool> m_radianceCacheStale;
+
     ysJobSystem* m_jobSystem;
+
+    // Only open for scenes created from files
+    ysMappedFile m_file;
+
+    // Asynchronous creation. Everything but the stage and the span count is only touched by the creation job until the preview is ready.
+    std::atomic<CreationStage> m_creationStage;
+    std::atomic<ys_int32> m_createdShapeSpanCount;
+    ys_int32 m_shapeSpanCount;
+    ysSceneDef m_creationDef; // A copy of the caller's, whose arrays must outlive the creation job's use of them
+    ysBVH m_pendingBVH;
 };
\ No newline at end of file
@@ -0,0 +1,471 @@
+#include "scene/ysSceneFile.h"
+#include "scene/ysScene.h"
+#include "light/ysLight.h"
+#include "light/ysLightPoint.h"
+#include "mat/emissive/ysEmissiveMaterial.h"
+#include "mat/emissive/ysEmissiveMaterialUniform.h"
+#include "mat/reflective/ysMaterial.h"
+#include "mat/reflective/ysMaterialMirror.h"
+#include "mat/reflective/ysMaterialStandard.h"
+#include "YoshiPBR/ysEllipsoid.h"
+#include "YoshiPBR/ysMesh.h"
+#include "YoshiPBR/ysMeshInstance.h"
+#include "YoshiPBR/ysShape.h"
+#include "YoshiPBR/ysTriangle.h"
+
+#include <stdio.h>
+
+static const ys_uint64 s_arrayAlignment = 16;
+static const ys_int64 s_maxArrayCount = 0x7FFFFFFF; // Counts are ys_int32 once loaded
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void sGetLayout(ys_uint32* layout)
+{
+    layout[ysSceneFileHeader::e_shape] = sizeof(ysShape);
+    layout[ysSceneFileHeader::e_ellipsoid] = sizeof(ysEllipsoid);
+    layout[ysSceneFileHeader::e_triangle] = sizeof(ysTriangle);
+    layout[ysSceneFileHeader::e_mesh] = sizeof(ysSceneFileMesh);
+    layout[ysSceneFileHeader::e_instancedMesh] = sizeof(ysSceneFileInstancedMesh);
+    layout[ysSceneFileHeader::e_meshInstance] = sizeof(ysMeshInstance);
+    layout[ysSceneFileHeader::e_material] = sizeof(ysMaterial);
+    layout[ysSceneFileHeader::e_materialStandard] = sizeof(ysMaterialStandard);
+    layout[ysSceneFileHeader::e_materialMirror] = sizeof(ysMaterialMirror);
+    layout[ysSceneFileHeader::e_emissiveMaterial] = sizeof(ysEmissiveMaterial);
+    layout[ysSceneFileHeader::e_emissiveMaterialUniform] = sizeof(ysEmissiveMaterialUniform);
+    layout[ysSceneFileHeader::e_light] = sizeof(ysLight);
+    layout[ysSceneFileHeader::e_lightPoint] = sizeof(ysLightPoint);
+    layout[ysSceneFileHeader::e_bvhNode] = sizeof(ysBVH::Node);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysSceneFileWriter
+{
+    FILE* m_file;
+    ys_uint64 m_offset;
+    bool m_failed;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Appends the array at the next aligned offset. Empty arrays take up no space at all.
+static ysSceneFileArray sWriteArray(ysSceneFileWriter* writer, const void* data, ys_int64 count, ys_uint64 elementSize)
+{
+    ysSceneFileArray array;
+    array.m_offset = 0;
+    array.m_count = 0;
+    if (count == 0)
+    {
+        return array;
+    }
+
+    static const ys_uint8 s_padding[s_arrayAlignment] = {};
+    ys_uint64 paddingByteCount = (s_arrayAlignment - writer->m_offset % s_arrayAlignment) % s_arrayAlignment;
+    if (paddingByteCount > 0)
+    {
+        writer->m_failed = writer->m_failed || (fwrite(s_padding, 1, paddingByteCount, writer->m_file) != paddingByteCount);
+        writer->m_offset += paddingByteCount;
+    }
+
+    ys_uint64 byteCount = ys_uint64(count) * elementSize;
+    writer->m_failed = writer->m_failed || (fwrite(data, 1, byteCount, writer->m_file) != byteCount);
+    array.m_offset = writer->m_offset;
+    array.m_count = count;
+    writer->m_offset += byteCount;
+    return array;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The vertices go out tightly packed, whatever the strides of the buffers they come from
+static void sWriteMesh(ysSceneFileWriter* writer, ysSceneFileMesh* dst, const ysMesh& src)
+{
+    ysMemSet(dst, 0, sizeof(ysSceneFileMesh));
+
+    ysFloat3* vertices = static_cast<ysFloat3*>(ysMalloc(sizeof(ysFloat3) * src.m_vertexCount));
+    for (ys_int32 i = 0; i < src.m_vertexCount; ++i)
+    {
+        ysVec4 p = src.GetPosition(i);
+        vertices[i].x = p.x;
+        vertices[i].y = p.y;
+        vertices[i].z = p.z;
+    }
+    dst->m_positions = sWriteArray(writer, vertices, src.m_vertexCount, sizeof(ysFloat3));
+
+    if (src.m_normals != nullptr)
+    {
+        for (ys_int32 i = 0; i < src.m_vertexCount; ++i)
+        {
+            ysVec4 n = src.GetNormal(i);
+            vertices[i].x = n.x;
+            vertices[i].y = n.y;
+            vertices[i].z = n.z;
+        }
+        dst->m_normals = sWriteArray(writer, vertices, src.m_vertexCount, sizeof(ysFloat3));
+    }
+    ysFree(vertices);
+
+    dst->m_indices = sWriteArray(writer, src.m_indices, 3 * ys_int64(src.m_triangleCount), sizeof(ys_int32));
+    dst->m_vertexCount = src.m_vertexCount;
+    dst->m_triangleCount = src.m_triangleCount;
+    dst->m_twoSided = src.m_twoSided;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysScene::Save(const char* path) const
+{
+    // The file holds the nodes as they are, so a lazy hierarchy must have been finalized
+    ysAssert(m_bvh.m_lazySubtreeCount == 0);
+
+    FILE* file = nullptr;
+    if (fopen_s(&file, path, "wb") != 0)
+    {
+        return false;
+    }
+
+    ysSceneFileWriter writer;
+    writer.m_file = file;
+    writer.m_offset = 0;
+    writer.m_failed = false;
+
+    // The header goes first, but is only filled in once everything else has been written. Zeroing it keeps the padding out of the file.
+    ysSceneFileHeader header;
+    ysMemSet(&header, 0, sizeof(ysSceneFileHeader));
+    sWriteArray(&writer, &header, 1, sizeof(ysSceneFileHeader));
+
+    header.m_magic = ysSceneFileHeader::s_magic;
+    header.m_version = ysSceneFileHeader::s_version;
+    sGetLayout(header.m_layout);
+
+    header.m_shapes = sWriteArray(&writer, m_shapes, m_shapeCount, sizeof(ysShape));
+    header.m_ellipsoids = sWriteArray(&writer, m_ellipsoids, m_ellipsoidCount, sizeof(ysEllipsoid));
+    header.m_triangles = sWriteArray(&writer, m_triangles, m_triangleCount, sizeof(ysTriangle));
+    header.m_meshInstances = sWriteArray(&writer, m_meshInstances, m_meshInstanceCount, sizeof(ysMeshInstance));
+
+    {
+        ysSceneFileMesh* meshes = static_cast<ysSceneFileMesh*>(ysMalloc(sizeof(ysSceneFileMesh) * m_meshCount));
+        for (ys_int32 i = 0; i < m_meshCount; ++i)
+        {
+            sWriteMesh(&writer, meshes + i, m_meshes[i]);
+        }
+        header.m_meshes = sWriteArray(&writer, meshes, m_meshCount, sizeof(ysSceneFileMesh));
+        ysFree(meshes);
+    }
+
+    {
+        ysSceneFileInstancedMesh* instancedMeshes = static_cast<ysSceneFileInstancedMesh*>(ysMalloc(sizeof(ysSceneFileInstancedMesh) * m_instancedMeshCount));
+        for (ys_int32 i = 0; i < m_instancedMeshCount; ++i)
+        {
+            const ysInstancedMesh* src = m_instancedMeshes + i;
+            ysSceneFileInstancedMesh* dst = instancedMeshes + i;
+            ysMemSet(dst, 0, sizeof(ysSceneFileInstancedMesh));
+            sWriteMesh(&writer, &dst->m_mesh, src->m_mesh);
+            dst->m_bvhNodes = sWriteArray(&writer, src->m_bvh.m_nodes, src->m_bvh.m_nodeCount, sizeof(ysBVH::Node));
+            dst->m_bvhBuiltAreas = sWriteArray(&writer, src->m_bvh.m_builtAreas, src->m_bvh.m_nodeCount, sizeof(ys_float32));
+            dst->m_areaCDF = sWriteArray(&writer, src->m_areaCDF, src->m_mesh.m_triangleCount, sizeof(ys_float32));
+            dst->m_bvhDepth = src->m_bvh.m_depth;
+            dst->m_surfaceArea = src->m_surfaceArea;
+        }
+        header.m_instancedMeshes = sWriteArray(&writer, instancedMeshes, m_instancedMeshCount, sizeof(ysSceneFileInstancedMesh));
+        ysFree(instancedMeshes);
+    }
+
+    header.m_materials = sWriteArray(&writer, m_materials, m_materialCount, sizeof(ysMaterial));
+    header.m_materialStandards = sWriteArray(&writer, m_materialStandards.load(), m_materialStandardCount, sizeof(ysMaterialStandard));
+    header.m_materialMirrors = sWriteArray(&writer, m_materialMirrors, m_materialMirrorCount, sizeof(ysMaterialMirror));
+    header.m_emissiveMaterials = sWriteArray(&writer, m_emissiveMaterials, m_emissiveMaterialCount, sizeof(ysEmissiveMaterial));
+    header.m_emissiveMaterialUniforms = sWriteArray(&writer, m_emissiveMaterialUniforms.load(), m_emissiveMaterialUniformCount,
+        sizeof(ysEmissiveMaterialUniform));
+    header.m_lights = sWriteArray(&writer, m_lights, m_lightCount, sizeof(ysLight));
+    header.m_lightPoints = sWriteArray(&writer, m_lightPoints.load(), m_lightPointCount, sizeof(ysLightPoint));
+    header.m_emissiveShapeIndices = sWriteArray(&writer, m_emissiveShapeIndices, m_emissiveShapeCount, sizeof(ys_int32));
+    header.m_bvhNodes = sWriteArray(&writer, m_bvh.m_nodes, m_bvh.m_nodeCount, sizeof(ysBVH::Node));
+    header.m_bvhBuiltAreas = sWriteArray(&writer, m_bvh.m_builtAreas, m_bvh.m_nodeCount, sizeof(ys_float32));
+    header.m_bvhDepth = m_bvh.m_depth;
+
+    bool failed = writer.m_failed;
+    failed = failed || (fseek(file, 0, SEEK_SET) != 0);
+    failed = failed || (fwrite(&header, sizeof(ysSceneFileHeader), 1, file) != 1);
+    failed = (fclose(file) != 0) || failed;
+    return failed == false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool sIsValidArray(const ysMappedFile& file, const ysSceneFileArray& array, ys_uint64 elementSize)
+{
+    if (array.m_count == 0)
+    {
+        return true;
+    }
+
+    if (array.m_count < 0 || array.m_count > s_maxArrayCount)
+    {
+        return false;
+    }
+
+    if (array.m_offset % s_arrayAlignment != 0 || array.m_offset > file.m_byteCount)
+    {
+        return false;
+    }
+
+    return ys_uint64(array.m_count) * elementSize <= file.m_byteCount - array.m_offset;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool sIsValidMesh(const ysMappedFile& file, const ysSceneFileMesh& mesh)
+{
+    if (mesh.m_vertexCount < 0 || mesh.m_triangleCount < 0)
+    {
+        return false;
+    }
+
+    if (mesh.m_positions.m_count != mesh.m_vertexCount || sIsValidArray(file, mesh.m_positions, sizeof(ysFloat3)) == false)
+    {
+        return false;
+    }
+
+    if (mesh.m_normals.m_count != 0 && mesh.m_normals.m_count != mesh.m_vertexCount)
+    {
+        return false;
+    }
+
+    if (mesh.m_indices.m_count != 3 * ys_int64(mesh.m_triangleCount))
+    {
+        return false;
+    }
+
+    return sIsValidArray(file, mesh.m_normals, sizeof(ysFloat3)) && sIsValidArray(file, mesh.m_indices, sizeof(ys_int32));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ys_int64 sBVHNodeCount(ys_int64 leafCount)
+{
+    return (leafCount > 0) ? 2 * leafCount - 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Checks the structure of the file: that it was written by a compatible build, that every array lies within it, and that the counts agree
+// with one another. The contents themselves (indices, hierarchy links) are trusted, as checking them would amount to parsing the file.
+static bool sIsValidFile(const ysMappedFile& file)
+{
+    if (file.m_byteCount < sizeof(ysSceneFileHeader))
+    {
+        return false;
+    }
+
+    const ysSceneFileHeader* header = reinterpret_cast<const ysSceneFileHeader*>(file.m_data);
+    if (header->m_magic != ysSceneFileHeader::s_magic || header->m_version != ysSceneFileHeader::s_version)
+    {
+        return false;
+    }
+
+    ys_uint32 layout[ysSceneFileHeader::e_layoutCount];
+    sGetLayout(layout);
+    for (ys_int32 i = 0; i < ysSceneFileHeader::e_layoutCount; ++i)
+    {
+        if (header->m_layout[i] != layout[i])
+        {
+            return false;
+        }
+    }
+
+    bool valid = true;
+    valid = valid && sIsValidArray(file, header->m_shapes, sizeof(ysShape));
+    valid = valid && sIsValidArray(file, header->m_ellipsoids, sizeof(ysEllipsoid));
+    valid = valid && sIsValidArray(file, header->m_triangles, sizeof(ysTriangle));
+    valid = valid && sIsValidArray(file, header->m_meshes, sizeof(ysSceneFileMesh));
+    valid = valid && sIsValidArray(file, header->m_instancedMeshes, sizeof(ysSceneFileInstancedMesh));
+    valid = valid && sIsValidArray(file, header->m_meshInstances, sizeof(ysMeshInstance));
+    valid = valid && sIsValidArray(file, header->m_materials, sizeof(ysMaterial));
+    valid = valid && sIsValidArray(file, header->m_materialStandards, sizeof(ysMaterialStandard));
+    valid = valid && sIsValidArray(file, header->m_materialMirrors, sizeof(ysMaterialMirror));
+    valid = valid && sIsValidArray(file, header->m_emissiveMaterials, sizeof(ysEmissiveMaterial));
+    valid = valid && sIsValidArray(file, header->m_emissiveMaterialUniforms, sizeof(ysEmissiveMaterialUniform));
+    valid = valid && sIsValidArray(file, header->m_lights, sizeof(ysLight));
+    valid = valid && sIsValidArray(file, header->m_lightPoints, sizeof(ysLightPoint));
+    valid = valid && sIsValidArray(file, header->m_emissiveShapeIndices, sizeof(ys_int32));
+    valid = valid && sIsValidArray(file, header->m_bvhNodes, sizeof(ysBVH::Node));
+    valid = valid && sIsValidArray(file, header->m_bvhBuiltAreas, sizeof(ys_float32));
+    if (valid == false)
+    {
+        return false;
+    }
+
+    // Every shape is an ellipsoid, a triangle, a mesh triangle or a mesh instance
+    ys_int64 shapeCount = header->m_ellipsoids.m_count + header->m_triangles.m_count + header->m_meshInstances.m_count;
+
+    const ysSceneFileMesh* meshes = reinterpret_cast<const ysSceneFileMesh*>(file.m_data + header->m_meshes.m_offset);
+    for (ys_int64 i = 0; i < header->m_meshes.m_count; ++i)
+    {
+        if (sIsValidMesh(file, meshes[i]) == false)
+        {
+            return false;
+        }
+        shapeCount += meshes[i].m_triangleCount;
+    }
+
+    const ysSceneFileInstancedMesh* instancedMeshes = reinterpret_cast<const ysSceneFileInstancedMesh*>(file.m_data + header->m_instancedMeshes.m_offset);
+    for (ys_int64 i = 0; i < header->m_instancedMeshes.m_count; ++i)
+    {
+        const ysSceneFileInstancedMesh& instancedMesh = instancedMeshes[i];
+        ys_int32 triangleCount = instancedMesh.m_mesh.m_triangleCount;
+        valid = valid && sIsValidMesh(file, instancedMesh.m_mesh) && triangleCount > 0;
+        valid = valid && instancedMesh.m_bvhNodes.m_count == sBVHNodeCount(triangleCount);
+        valid = valid && instancedMesh.m_bvhBuiltAreas.m_count == instancedMesh.m_bvhNodes.m_count;
+        valid = valid && instancedMesh.m_areaCDF.m_count == triangleCount;
+        valid = valid && sIsValidArray(file, instancedMesh.m_bvhNodes, sizeof(ysBVH::Node));
+        valid = valid && sIsValidArray(file, instancedMesh.m_bvhBuiltAreas, sizeof(ys_float32));
+        valid = valid && sIsValidArray(file, instancedMesh.m_areaCDF, sizeof(ys_float32));
+        if (valid == false)
+        {
+            return false;
+        }
+    }
+
+    valid = valid && header->m_shapes.m_count == shapeCount;
+    valid = valid && header->m_bvhNodes.m_count == sBVHNodeCount(shapeCount);
+    valid = valid && header->m_bvhBuiltAreas.m_count == header->m_bvhNodes.m_count;
+    valid = valid && header->m_materials.m_count == header->m_materialStandards.m_count + header->m_materialMirrors.m_count;
+    valid = valid && header->m_emissiveMaterials.m_count == header->m_emissiveMaterialUniforms.m_count;
+    valid = valid && header->m_lights.m_count == header->m_lightPoints.m_count;
+    valid = valid && header->m_emissiveShapeIndices.m_count <= shapeCount;
+    return valid;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+static T* sMapArray(const ysMappedFile& file, const ysSceneFileArray& array)
+{
+    return (array.m_count > 0) ? reinterpret_cast<T*>(file.m_data + array.m_offset) : nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The mesh points into the file as it would into the caller's buffers, and so leaves them alone when destroyed
+static void sMapMesh(ysMesh* dst, const ysMappedFile& file, const ysSceneFileMesh& src)
+{
+    dst->m_positions = sMapArray<const ys_uint8>(file, src.m_positions);
+    dst->m_normals = sMapArray<const ys_uint8>(file, src.m_normals);
+    dst->m_indices = sMapArray<const ys_int32>(file, src.m_indices);
+    dst->m_positionStride = ys_int32(sizeof(ysFloat3));
+    dst->m_normalStride = ys_int32(sizeof(ysFloat3));
+    dst->m_vertexCount = src.m_vertexCount;
+    dst->m_triangleCount = src.m_triangleCount;
+    dst->m_ownsBuffers = false;
+    dst->m_twoSided = src.m_twoSided;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ysScene::CreateFromFile(const char* path)
+{
+    m_file.Reset();
+    if (m_file.Open(path) == false)
+    {
+        return false;
+    }
+
+    if (sIsValidFile(m_file) == false)
+    {
+        m_file.Close();
+        return false;
+    }
+
+    const ysSceneFileHeader* header = reinterpret_cast<const ysSceneFileHeader*>(m_file.m_data);
+
+    ////////////
+    // Shapes //
+    ////////////
+
+    m_shapes = sMapArray<ysShape>(m_file, header->m_shapes);
+    m_shapeCount = ys_int32(header->m_shapes.m_count);
+
+    m_ellipsoids = sMapArray<ysEllipsoid>(m_file, header->m_ellipsoids);
+    m_ellipsoidCount = ys_int32(header->m_ellipsoids.m_count);
+
+    m_triangles = sMapArray<ysTriangle>(m_file, header->m_triangles);
+    m_triangleCount = ys_int32(header->m_triangles.m_count);
+
+    m_meshInstances = sMapArray<ysMeshInstance>(m_file, header->m_meshInstances);
+    m_meshInstanceCount = ys_int32(header->m_meshInstances.m_count);
+
+    // The mesh headers hold pointers, so unlike everything else they are built anew, around the buffers in the file
+    m_meshCount = ys_int32(header->m_meshes.m_count);
+    m_meshes = static_cast<ysMesh*>(ysMalloc(sizeof(ysMesh) * m_meshCount));
+    const ysSceneFileMesh* meshes = sMapArray<const ysSceneFileMesh>(m_file, header->m_meshes);
+    for (ys_int32 i = 0; i < m_meshCount; ++i)
+    {
+        sMapMesh(m_meshes + i, m_file, meshes[i]);
+    }
+
+    m_instancedMeshCount = ys_int32(header->m_instancedMeshes.m_count);
+    m_instancedMeshes = static_cast<ysInstancedMesh*>(ysMalloc(sizeof(ysInstancedMesh) * m_instancedMeshCount));
+    const ysSceneFileInstancedMesh* instancedMeshes = sMapArray<const ysSceneFileInstancedMesh>(m_file, header->m_instancedMeshes);
+    for (ys_int32 i = 0; i < m_instancedMeshCount; ++i)
+    {
+        ysInstancedMesh* dst = m_instancedMeshes + i;
+        const ysSceneFileInstancedMesh& src = instancedMeshes[i];
+        sMapMesh(&dst->m_mesh, m_file, src.m_mesh);
+        dst->m_bvh.Reset();
+        dst->m_bvh.m_nodes = sMapArray<ysBVH::Node>(m_file, src.m_bvhNodes);
+        dst->m_bvh.m_nodeCount = ys_int32(src.m_bvhNodes.m_count);
+        dst->m_bvh.m_builtAreas = sMapArray<ys_float32>(m_file, src.m_bvhBuiltAreas);
+        dst->m_bvh.m_depth = src.m_bvhDepth;
+        dst->m_areaCDF = sMapArray<ys_float32>(m_file, src.m_areaCDF);
+        dst->m_surfaceArea = src.m_surfaceArea;
+    }
+
+    m_bvh.Reset();
+    m_bvh.m_nodes = sMapArray<ysBVH::Node>(m_file, header->m_bvhNodes);
+    m_bvh.m_nodeCount = ys_int32(header->m_bvhNodes.m_count);
+    m_bvh.m_builtAreas = sMapArray<ys_float32>(m_file, header->m_bvhBuiltAreas);
+    m_bvh.m_depth = header->m_bvhDepth;
+
+    ///////////////
+    // Materials //
+    ///////////////
+
+    m_materials = sMapArray<ysMaterial>(m_file, header->m_materials);
+    m_materialCount = ys_int32(header->m_materials.m_count);
+
+    m_materialStandards = sMapArray<ysMaterialStandard>(m_file, header->m_materialStandards);
+    m_materialStandardCount = ys_int32(header->m_materialStandards.m_count);
+
+    m_materialMirrors = sMapArray<ysMaterialMirror>(m_file, header->m_materialMirrors);
+    m_materialMirrorCount = ys_int32(header->m_materialMirrors.m_count);
+
+    m_emissiveMaterials = sMapArray<ysEmissiveMaterial>(m_file, header->m_emissiveMaterials);
+    m_emissiveMaterialCount = ys_int32(header->m_emissiveMaterials.m_count);
+
+    m_emissiveMaterialUniforms = sMapArray<ysEmissiveMaterialUniform>(m_file, header->m_emissiveMaterialUniforms);
+    m_emissiveMaterialUniformCount = ys_int32(header->m_emissiveMaterialUniforms.m_count);
+
+    ////////////
+    // Lights //
+    ////////////
+
+    m_lights = sMapArray<ysLight>(m_file, header->m_lights);
+    m_lightCount = ys_int32(header->m_lights.m_count);
+
+    m_lightPoints = sMapArray<ysLightPoint>(m_file, header->m_lightPoints);
+    m_lightPointCount = ys_int32(header->m_lightPoints.m_count);
+
+    m_emissiveShapeIndices = sMapArray<ys_int32>(m_file, header->m_emissiveShapeIndices);
+    m_emissiveShapeCount = ys_int32(header->m_emissiveShapeIndices.m_count);
+
+    // The light hierarchies are not stored. They only span the emitters, and are cheap to build next to the hierarchy over every shape.
+    m_lightBVH.Reset();
+    m_infinitesimalLightBVH.Reset();
+    CreateJobSystem();
+    CreateDerivedState();
+    m_pendingBVH.Reset();
+    m_creationStage.store(CreationStage::e_created, std::memory_order_release);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "YoshiPBR/ysTypes.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Binary scene files (see ysScene_Save) are raw images of the scene's arrays, each at a 16 byte aligned offset from the start of the file,
+// so that a loader can map the file and point the scene straight into it. The structs are dumped as they are laid out in memory, so a file
+// is only readable by builds that agree with it on their sizes. (See ysSceneFileHeader::m_layout)
+struct ysSceneFileArray
+{
+    ys_uint64 m_offset; // In bytes, from the start of the file
+    ys_int64 m_count;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Meshes hold pointers, so they are stored as records of where their buffers are. The vertices are tightly packed ysFloat3s.
+struct ysSceneFileMesh
+{
+    ysSceneFileArray m_positions;
+    ysSceneFileArray m_normals; // Empty if the triangles are shaded with their face normals
+    ysSceneFileArray m_indices;
+    ys_int32 m_vertexCount;
+    ys_int32 m_triangleCount;
+    bool m_twoSided;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysSceneFileInstancedMesh
+{
+    ysSceneFileMesh m_mesh;
+    ysSceneFileArray m_bvhNodes;
+    ysSceneFileArray m_bvhBuiltAreas;
+    ysSceneFileArray m_areaCDF;
+    ys_int32 m_bvhDepth;
+    ys_float32 m_surfaceArea;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ysSceneFileHeader
+{
+    static const ys_uint32 s_magic = 0x53425059; // "YPBS" read as little endian bytes
+    static const ys_uint32 s_version = 1;
+
+    // The size of each struct dumped into the file, as of the build that wrote it
+    enum Layout
+    {
+        e_shape,
+        e_ellipsoid,
+        e_triangle,
+        e_mesh,
+        e_instancedMesh,
+        e_meshInstance,
+        e_material,
+        e_materialStandard,
+        e_materialMirror,
+        e_emissiveMaterial,
+        e_emissiveMaterialUniform,
+        e_light,
+        e_lightPoint,
+        e_bvhNode,
+        e_layoutCount,
+    };
+
+    ys_uint32 m_magic;
+    ys_uint32 m_version;
+    ys_uint32 m_layout[e_layoutCount];
+
+    ysSceneFileArray m_shapes;
+    ysSceneFileArray m_ellipsoids;
+    ysSceneFileArray m_triangles;
+    ysSceneFileArray m_meshes; // Of ysSceneFileMesh
+    ysSceneFileArray m_instancedMeshes; // Of ysSceneFileInstancedMesh
+    ysSceneFileArray m_meshInstances;
+    ysSceneFileArray m_materials;
+    ysSceneFileArray m_materialStandards;
+    ysSceneFileArray m_materialMirrors;
+    ysSceneFileArray m_emissiveMaterials;
+    ysSceneFileArray m_emissiveMaterialUniforms;
+    ysSceneFileArray m_lights;
+    ysSceneFileArray m_lightPoints;
+    ysSceneFileArray m_emissiveShapeIndices;
+    ysSceneFileArray m_bvhNodes;
+    ysSceneFileArray m_bvhBuiltAreas;
+    ys_int32 m_bvhDepth;
+};
\ No newline at end of file
@@ -27,12 +27,17 @@ static ysVec4 s_debugPixelValue = ysVec4_zero;
 static bool s_debugRenderPixel = false;
 
 static ysArrayG<Color> s_pixels = ysArrayG<Color>();
+static ysSceneRenderOutputIncremental s_incrementalOutput;
 static ys_int32 s_pixelCountX = 0;
 static ys_int32 s_pixelCountY = 0;
 static ysSceneRenderInput s_renderInput;
 static ysGlobalIlluminationInput_UniDirectional s_uniInput[2];
 static ysGlobalIlluminationInput_BiDirectional s_biInput[2];
 
+// Kept around after the scene is created so that the UI can edit them in place
+static ysMaterialStandardDef s_materialStandards[5];
+static ysEmissiveMaterialUniformDef s_emissiveUniforms[1];
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void glfwErrorCallback(int error, const char* description)
@@ -139,6 +144,11 @@ static void sUpdateUI(ys_int32 windowWidth, ys_int32 windowHeight)
                     ysRender_BeginWork(s_renderId);
 
                     s_pixels.SetCount(xCount * yCount);
+                    for (ys_int32 i = 0; i < s_pixels.GetCount(); ++i)
+                    {
+                        s_pixels[i] = Color(0.0f, 0.0f, 0.0f, 0.0f);
+                    }
+                    s_incrementalOutput.m_tileVersions.SetCount(0);
                     s_pixelCountX = xCount;
                     s_pixelCountY = yCount;
                 }
@@ -165,6 +175,11 @@ static void sUpdateUI(ys_int32 windowWidth, ys_int32 windowHeight)
                                 s_renderInput.m_giInputCompare = nullptr;
                                 ImGui::SliderInt("Bounce Count", &s_uniInput[0].m_maxBounceCount, 0, 100);
                                 ImGui::Checkbox("Sample Light", &s_uniInput[0].m_sampleLight);
+                                ImGui::SliderInt("Light Samples", &s_uniInput[0].m_lightSampleCount, 0, 16);
+                                ImGui::SliderInt("RR Bounce Count", &s_uniInput[0].m_russianRouletteMinBounceCount, 0, 100);
+                                ImGui::Checkbox("Path Guiding", &s_uniInput[0].m_pathGuiding);
+                                ImGui::SliderFloat("Path Guiding BRDF Fraction", &s_uniInput[0].m_pathGuidingBrdfFraction, 0.0f, 1.0f);
+                                ImGui::SliderInt("Radiance Cache Bounces", &s_uniInput[0].m_radianceCacheBounceCount, 0, 4);
                                 break;
                             }
                             case 1:
@@ -173,9 +188,28 @@ static void sUpdateUI(ys_int32 windowWidth, ys_int32 windowHeight)
                                 s_renderInput.m_giInputCompare = nullptr;
                                 ImGui::SliderInt("Max LIGHT Subpath Vertex Count", &s_biInput[0].m_maxLightSubpathVertexCount, 0, 16);
                                 ImGui::SliderInt("Max EYE Subpath Vertex Count", &s_biInput[0].m_maxEyeSubpathVertexCount, 2, 16);
+                                ImGui::Checkbox("Light Tracing", &s_biInput[0].m_lightTracing);
+                                ImGui::SliderInt("Light Subpath Pool Size", &s_biInput[0].m_lightSubpathPoolSize, 0, 4096);
+                                ImGui::SliderInt("Light Subpath Connections", &s_biInput[0].m_lightSubpathConnectionCount, 1, 16);
+                                ImGui::Checkbox("Vertex Merging", &s_biInput[0].m_vertexMerging);
+                                ImGui::SliderFloat("Merge Radius", &s_biInput[0].m_mergeRadius, 0.0f, 0.05f, "%.4f");
                                 break;
                             }
                         }
+
+                        ImGui::Separator();
+                        const char* denoisers[] = { "None", "A-Trous" };
+                        int selectedDenoiser = int(s_renderInput.m_denoiser);
+                        ImGui::Combo("Denoiser", &selectedDenoiser, denoisers, 2);
+                        s_renderInput.m_denoiser = ysSceneRenderInput::Denoiser(selectedDenoiser);
+                        ImGui::SliderInt("Denoise Iterations", &s_renderInput.m_denoiseIterationCount, 1, 8);
+
+                        ImGui::Separator();
+                        const char* tonemaps[] = { "Linear", "Reinhard", "ACES" };
+                        int selectedTonemap = int(s_renderInput.m_tonemap);
+                        ImGui::Combo("Tonemap", &selectedTonemap, tonemaps, 3);
+                        s_renderInput.m_tonemap = ysSceneRenderInput::Tonemap(selectedTonemap);
+                        ImGui::SliderFloat("Exposure", &s_renderInput.m_exposure, 0.0f, 8.0f);
                         break;
                     }
                     case 1:
@@ -200,6 +234,8 @@ static void sUpdateUI(ys_int32 windowWidth, ys_int32 windowHeight)
                                 s_renderInput.m_giInput = s_uniInput + 0;
                                 ImGui::SliderInt("Bounce Count A", &s_uniInput[0].m_maxBounceCount, 0, 100);
                                 ImGui::Checkbox("Sample Light A", &s_uniInput[0].m_sampleLight);
+                                ImGui::SliderInt("Light Samples A", &s_uniInput[0].m_lightSampleCount, 0, 16);
+                                ImGui::SliderInt("RR Bounce Count A", &s_uniInput[0].m_russianRouletteMinBounceCount, 0, 100);
                                 break;
                             }
                             case 1:
@@ -222,6 +258,8 @@ static void sUpdateUI(ys_int32 windowWidth, ys_int32 windowHeight)
                                 s_renderInput.m_giInputCompare = s_uniInput + 1;
                                 ImGui::SliderInt("Bounce Count B", &s_uniInput[1].m_maxBounceCount, 0, 100);
                                 ImGui::Checkbox("Sample Light B", &s_uniInput[1].m_sampleLight);
+                                ImGui::SliderInt("Light Samples B", &s_uniInput[1].m_lightSampleCount, 0, 16);
+                                ImGui::SliderInt("RR Bounce Count B", &s_uniInput[1].m_russianRouletteMinBounceCount, 0, 100);
                                 break;
                             }
                             case 1:
@@ -289,6 +327,46 @@ static void sUpdateUI(ys_int32 windowWidth, ys_int32 windowHeight)
                 ImGui::EndTabItem();
             }
 
+            if (ImGui::BeginTabItem("Materials"))
+            {
+                // Edits take effect immediately, even on the render in progress
+                ysMaterialStandardUpdate materialUpdates[5];
+                ys_int32 materialUpdateCount = 0;
+                for (ys_int32 i = 0; i < 5; ++i)
+                {
+                    char label[32];
+                    snprintf(label, sizeof(label), "Albedo %d", i);
+                    if (ImGui::ColorEdit3(label, (ys_float32*)&s_materialStandards[i].m_albedoDiffuse.simd, ImGuiColorEditFlags_Float))
+                    {
+                        materialUpdates[materialUpdateCount].m_materialStandardIndex = i;
+                        materialUpdates[materialUpdateCount].m_material = s_materialStandards[i];
+                        materialUpdateCount++;
+                    }
+                }
+
+                ysEmissiveMaterialUniformUpdate emissiveUpdates[1];
+                ys_int32 emissiveUpdateCount = 0;
+                ImGuiColorEditFlags hdrFlags = ImGuiColorEditFlags_Float | ImGuiColorEditFlags_HDR;
+                if (ImGui::ColorEdit3("Radiance", (ys_float32*)&s_emissiveUniforms[0].m_radiance.simd, hdrFlags))
+                {
+                    emissiveUpdates[0].m_emissiveMaterialUniformIndex = 0;
+                    emissiveUpdates[0].m_emissiveMaterial = s_emissiveUniforms[0];
+                    emissiveUpdateCount++;
+                }
+
+                if (materialUpdateCount > 0 || emissiveUpdateCount > 0)
+                {
+                    ysSceneMaterialsUpdate update;
+                    update.m_materialStandards = materialUpdates;
+                    update.m_materialStandardCount = materialUpdateCount;
+                    update.m_emissiveMaterialUniforms = emissiveUpdates;
+                    update.m_emissiveMaterialUniformCount = emissiveUpdateCount;
+                    ysScene_UpdateMaterials(s_sceneId, update);
+                }
+
+                ImGui::EndTabItem();
+            }
+
             ImGui::EndTabBar();
         }
         ImGui::End();
@@ -455,7 +533,8 @@ static void sUpdateCamera(ys_float32 moveDistance)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-static void sCreateScene()
+// The mesh, if given, is imported from an OBJ or PLY file and placed in the box as is
+static void sCreateScene(const char* meshPath)
 {
     const ys_float32 h = 4.0f;
     ysVec4 corners[2][2][2];
@@ -563,7 +642,7 @@ static void sCreateScene()
     triangles[11].m_emissiveMaterialType = ysEmissiveMaterialType::e_uniform;
     triangles[11].m_emissiveMaterialTypeIndex = 0;
 
-    ysMaterialStandardDef materialStandards[5];
+    ysMaterialStandardDef* materialStandards = s_materialStandards;
     materialStandards[0].m_albedoDiffuse = ysVecSet(1.0f, 1.0f, 1.0f);
     materialStandards[0].m_albedoSpecular = ysVecSet(0.0f, 0.0f, 0.0f);
     materialStandards[1].m_albedoDiffuse = ysVecSet(1.0f, 0.25f, 0.25f);
@@ -577,7 +656,7 @@ static void sCreateScene()
 
     ysMaterialMirrorDef materialMirrors[1];
 
-    ysEmissiveMaterialUniformDef emissiveUniforms[1];
+    ysEmissiveMaterialUniformDef* emissiveUniforms = s_emissiveUniforms;
     emissiveUniforms[0].m_radiance = ysVecSet(1.0f, 1.0f, 1.0f) * ysSplat(1.0f);
 
     ysLightPointDef lightPoints[1];
@@ -598,7 +677,29 @@ static void sCreateScene()
     sceneDef.m_lightPoints = lightPoints;
     sceneDef.m_lightPointCount = 0;
 
+    ysMeshDef meshes[1];
+    if (meshPath != nullptr)
+    {
+        if (ysMesh_Import(meshes + 0, meshPath))
+        {
+            meshes[0].m_materialType = ysMaterialType::e_standard;
+            meshes[0].m_materialTypeIndex = 0;
+            sceneDef.m_meshes = meshes;
+            sceneDef.m_meshCount = 1;
+        }
+        else
+        {
+            fprintf(stderr, "Failed to import mesh %s\n", meshPath);
+        }
+    }
+
     s_sceneId = ysScene_Create(sceneDef);
+
+    // The scene keeps a copy of its own
+    if (sceneDef.m_meshCount > 0)
+    {
+        ysMesh_FreeImported(meshes + 0);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -616,13 +717,14 @@ static void sDestroyScene()
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-int main(int, char**)
+int main(int argc, char** argv)
 {
     // Enable memory-leak reports
     _CrtSetDbgFlag(_CRTDBG_LEAK_CHECK_DF | _CrtSetDbgFlag(_CRTDBG_REPORT_FLAG));
 
     ysUnitTest_Memory();
     ysUnitTest_JobSystem();
+    ysUnitTest_BVH();
 
     glfwSetErrorCallback(glfwErrorCallback);
     if (glfwInit() == 0)
@@ -676,7 +778,7 @@ int main(int, char**)
     ys_float64 time1 = glfwGetTime();
     ys_float64 frameTime = 0.0;
 
-    sCreateScene();
+    sCreateScene(argc > 1 ? argv[1] : nullptr);
 
     while (!glfwWindowShouldClose(g_mainWindow))
     {
@@ -746,13 +848,19 @@ int main(int, char**)
                 }
                 else
                 {
-                    ysSceneRenderOutputIntermediate output;
-                    ysRender_GetIntermediateOutput(s_renderId, &output);
-                    ysAssert(output.m_pixels.GetCount() == s_pixelCountX * s_pixelCountY);
-                    for (ys_int32 i = 0; i < output.m_pixels.GetCount(); ++i)
+                    ysSceneRenderOutputIncremental& output = s_incrementalOutput;
+                    ysRender_GetIntermediateOutputIncremental(s_renderId, &output);
+                    for (ys_int32 i = 0; i < output.m_tiles.GetCount(); ++i)
                     {
-                        const ysFloat4& rgb = output.m_pixels[i];
-                        s_pixels[i] = Color(rgb.r, rgb.g, rgb.b, rgb.a);
+                        const ysSceneRenderOutputIncremental::Tile& tile = output.m_tiles[i];
+                        for (ys_int32 y = 0; y < tile.m_height; ++y)
+                        {
+                            for (ys_int32 x = 0; x < tile.m_width; ++x)
+                            {
+                                const ysFloat4& rgb = output.m_pixels[tile.m_pixelOffset + tile.m_width * y + x];
+                                s_pixels[s_pixelCountX * (tile.m_y + y) + (tile.m_x + x)] = Color(rgb.r, rgb.g, rgb.b, rgb.a);
+                            }
+                        }
                     }
                 }
             }